@@ -0,0 +1,288 @@
+#include "job_system.h"
+#include "core/profiler/profiler.h"
+
+#include <stdio.h>
+
+static thread_local uint32_t _threadIndex = UINT32_MAX;
+static thread_local JobCounter* _currentCounter = nullptr;
+
+/* ------------------------------------------------------------------------ */
+/* Chase-Lev deque                                                          */
+/* ------------------------------------------------------------------------ */
+
+void JobSystem::WorkQueue::_Store(int64_t index, const Job& job)
+{
+    Slot& slot = slots[index & (CAPACITY - 1)];
+    slot.entry.store(job.entry, std::memory_order_relaxed);
+    slot.pUserData.store(job.pUserData, std::memory_order_relaxed);
+    slot.pCounter.store(job.pCounter, std::memory_order_relaxed);
+}
+
+void JobSystem::WorkQueue::_Load(int64_t index, Job* pJob) const
+{
+    const Slot& slot = slots[index & (CAPACITY - 1)];
+    pJob->entry = slot.entry.load(std::memory_order_relaxed);
+    pJob->pUserData = slot.pUserData.load(std::memory_order_relaxed);
+    pJob->pCounter = slot.pCounter.load(std::memory_order_relaxed);
+}
+
+bool JobSystem::WorkQueue::Push(const Job& job)
+{
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+
+    if (b - t >= CAPACITY)
+        return false;
+
+    _Store(b, job);
+
+    /* 槽位内容先于 bottom 对窃取方可见 */
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+
+    return true;
+}
+
+bool JobSystem::WorkQueue::Pop(Job* pJob)
+{
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+
+    if (t > b) {
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return false;
+    }
+
+    _Load(b, pJob);
+
+    if (t == b) {
+        /* 最后一个元素，和窃取方竞争 */
+        bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return won;
+    }
+
+    return true;
+}
+
+bool JobSystem::WorkQueue::Steal(Job* pJob)
+{
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+
+    if (t >= b)
+        return false;
+
+    /*
+     * CAS 之后 top 前移，所有者可以立即复用这个槽位，所以必须在 CAS 之前读取。
+     * 读取期间槽位可能已被改写，此时 top 也已经前移，CAS 失败，读到的值被丢弃。
+     */
+    Job job;
+    _Load(t, &job);
+
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return false;
+
+    *pJob = job;
+    return true;
+}
+
+/* ------------------------------------------------------------------------ */
+/* JobSystem                                                                */
+/* ------------------------------------------------------------------------ */
+
+JobSystem::JobSystem()
+{
+    /* do nothing... */
+}
+
+JobSystem::~JobSystem()
+{
+    Shutdown();
+}
+
+void JobSystem::Initialize(uint32_t workerCount)
+{
+    if (workerCount == 0)
+        workerCount = std::max(1u, std::thread::hardware_concurrency());
+
+    workers.resize(workerCount);
+    for (uint32_t i = 0; i < workerCount; i++) {
+        workers[i] = new Worker();
+        workers[i]->owner = this;
+        workers[i]->index = i;
+        workers[i]->stealSeed = i * 2654435761u + 1;
+    }
+
+    /* 调用线程作为 0 号工作线程，只在 Wait 中参与执行 */
+    _threadIndex = 0;
+
+    for (uint32_t i = 1; i < workerCount; i++)
+        workers[i]->thread = std::thread(&JobSystem::_WorkerLoop, this, workers[i]);
+
+    printf("[job] job system started with %u workers\n", workerCount);
+}
+
+void JobSystem::Shutdown()
+{
+    if (workers.empty())
+        return;
+
+    exit.store(true);
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        sleepCondition.notify_all();
+    }
+
+    /* 先全部 join，其他线程可能还在窃取已退出线程的队列 */
+    for (Worker* worker : workers)
+        if (worker->thread.joinable())
+            worker->thread.join();
+
+    for (Worker* worker : workers)
+        delete worker;
+
+    workers.clear();
+    _threadIndex = UINT32_MAX;
+}
+
+uint32_t JobSystem::GetThreadIndex()
+{
+    return _threadIndex;
+}
+
+JobCounter* JobSystem::GetCurrentJobCounter()
+{
+    return _currentCounter;
+}
+
+void JobSystem::Run(PFN_JobEntry entry, void* pUserData, JobCounter* pCounter)
+{
+    if (pCounter != nullptr)
+        pCounter->value.fetch_add(1, std::memory_order_relaxed);
+
+    _Submit({ entry, pUserData, pCounter });
+}
+
+void JobSystem::Run(uint32_t count, const JobDecl* pJobs, JobCounter* pCounter)
+{
+    if (pCounter != nullptr)
+        pCounter->value.fetch_add(count, std::memory_order_relaxed);
+
+    for (uint32_t i = 0; i < count; i++)
+        _Submit({ pJobs[i].entry, pJobs[i].pUserData, pCounter });
+}
+
+void JobSystem::Wait(JobCounter* pCounter)
+{
+    uint32_t index = _threadIndex;
+    Worker* worker = index < std::size(workers) ? workers[index] : nullptr;
+
+    /* 等待期间帮忙执行任务，非工作线程只能让出 CPU */
+    while (pCounter->value.load(std::memory_order_acquire) > 0) {
+        if (worker == nullptr || !_TryRunOne(worker))
+            std::this_thread::yield();
+    }
+}
+
+void JobSystem::_Submit(const Job& job)
+{
+    uint32_t index = _threadIndex;
+
+    if (index < std::size(workers)) {
+        /* 队列满时直接在当前线程执行 */
+        if (!workers[index]->queue.Push(job)) {
+            _Execute(job);
+            return;
+        }
+    } else {
+        std::lock_guard<std::mutex> lock(globalMutex);
+        globalQueue.push_back(job);
+    }
+
+    if (sleepingCount.load(std::memory_order_acquire) > 0) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        sleepCondition.notify_one();
+    }
+}
+
+void JobSystem::_Execute(const Job& job)
+{
+    JobCounter* parentCounter = _currentCounter;
+    _currentCounter = job.pCounter;
+
+    job.entry(job.pUserData);
+
+    _currentCounter = parentCounter;
+
+    if (job.pCounter != nullptr)
+        job.pCounter->value.fetch_sub(1, std::memory_order_release);
+}
+
+bool JobSystem::_FetchJob(Worker* worker, Job* pJob)
+{
+    if (worker->queue.Pop(pJob))
+        return true;
+
+    {
+        std::lock_guard<std::mutex> lock(globalMutex);
+        if (!globalQueue.empty()) {
+            *pJob = globalQueue.front();
+            globalQueue.pop_front();
+            return true;
+        }
+    }
+
+    /* 从随机位置开始轮询其他线程 */
+    uint32_t workerCount = static_cast<uint32_t>(std::size(workers));
+    worker->stealSeed = worker->stealSeed * 1664525u + 1013904223u;
+    uint32_t start = worker->stealSeed % workerCount;
+
+    for (uint32_t i = 0; i < workerCount; i++) {
+        Worker* victim = workers[(start + i) % workerCount];
+        if (victim != worker && victim->queue.Steal(pJob))
+            return true;
+    }
+
+    return false;
+}
+
+bool JobSystem::_TryRunOne(Worker* worker)
+{
+    Job job;
+    if (!_FetchJob(worker, &job))
+        return false;
+
+    _Execute(job);
+    return true;
+}
+
+void JobSystem::_WorkerLoop(Worker* worker)
+{
+    _threadIndex = worker->index;
+    QK_PROFILE_THREAD("Job Worker");
+
+    uint32_t idleSpins = 0;
+
+    while (!exit.load(std::memory_order_acquire)) {
+        if (_TryRunOne(worker)) {
+            idleSpins = 0;
+            continue;
+        }
+
+        if (++idleSpins < 64) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        /* 提交方只在有线程休眠时通知，超时兜底可能错过的唤醒 */
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepingCount.fetch_add(1, std::memory_order_release);
+        sleepCondition.wait_for(lock, std::chrono::milliseconds(1));
+        sleepingCount.fetch_sub(1, std::memory_order_release);
+        idleSpins = 0;
+    }
+}
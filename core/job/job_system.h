@@ -0,0 +1,167 @@
+#ifndef JOB_SYSTEM_H_
+#define JOB_SYSTEM_H_
+
+#include <stdint.h>
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* 任务入口，在任意工作线程上执行 */
+typedef void (*PFN_JobEntry)(void* pUserData);
+
+/* 任务计数器，提交时加一，任务（连同挂在它上面的子任务）执行完减一 */
+struct JobCounter
+{
+    std::atomic<uint32_t> value { 0 };
+};
+
+struct JobDecl
+{
+    PFN_JobEntry entry;
+    void* pUserData;
+};
+
+/**
+ * 工作窃取的任务调度器。
+ *
+ * 每个工作线程（包括调用 Initialize 的线程，编号 0）持有一个 Chase-Lev 双端队列，
+ * 自己从底部压入/弹出，空闲时从其他线程的顶部窃取。非工作线程（例如加载线程）
+ * 提交的任务进入一个加锁的全局队列。
+ *
+ * Wait 不会阻塞工作线程：等待期间当前线程继续执行队列中的其他任务，直到计数器
+ * 归零，因此任务中可以提交子任务并等待它们。子任务提交到 GetCurrentJobCounter()
+ * 上即挂到父任务的计数器，父任务的等待者会一直等到子任务也完成。
+ */
+class JobSystem
+{
+public:
+    JobSystem();
+   ~JobSystem();
+
+    /* workerCount 为 0 时使用硬件线程数，调用线程计入其中 */
+    void Initialize(uint32_t workerCount = 0);
+    void Shutdown();
+
+    void Run(PFN_JobEntry entry, void* pUserData, JobCounter* pCounter);
+    void Run(uint32_t count, const JobDecl* pJobs, JobCounter* pCounter);
+    void Wait(JobCounter* pCounter);
+
+    /* func(begin, end)，batchSize 为 0 时按线程数自动切分，返回时全部执行完；没有工作线程时整个范围在调用线程执行 */
+    template<typename F>
+    void ParallelFor(uint32_t count, uint32_t batchSize, const F& func);
+
+    uint32_t GetWorkerCount() const { return static_cast<uint32_t>(std::size(workers)); }
+
+    /* 当前线程的工作线程编号，非工作线程返回 UINT32_MAX */
+    static uint32_t GetThreadIndex();
+    static JobCounter* GetCurrentJobCounter();
+
+private:
+    struct Job
+    {
+        PFN_JobEntry entry;
+        void* pUserData;
+        JobCounter* pCounter;
+    };
+
+    /*
+     * Chase-Lev 双端队列，容量固定。窃取方读取槽位时所有者可能正在改写同一个槽位
+     * （环形复用），所以槽位的每个字段都是原子的，读到的值只有在 CAS 成功后才使用。
+     */
+    struct WorkQueue
+    {
+        static constexpr int64_t CAPACITY = 4096;
+
+        struct Slot
+        {
+            std::atomic<PFN_JobEntry> entry { nullptr };
+            std::atomic<void*> pUserData { nullptr };
+            std::atomic<JobCounter*> pCounter { nullptr };
+        };
+
+        std::atomic<int64_t> top { 0 };
+        std::atomic<int64_t> bottom { 0 };
+        Slot slots[CAPACITY];
+
+        bool Push(const Job& job);
+        bool Pop(Job* pJob);
+        bool Steal(Job* pJob);
+
+        void _Store(int64_t index, const Job& job);
+        void _Load(int64_t index, Job* pJob) const;
+    };
+
+    struct Worker
+    {
+        JobSystem* owner = nullptr;
+        uint32_t index = 0;
+        WorkQueue queue;
+        std::thread thread;
+        uint32_t stealSeed = 0;
+    };
+
+    void _WorkerLoop(Worker* worker);
+    bool _TryRunOne(Worker* worker);
+    bool _FetchJob(Worker* worker, Job* pJob);
+    void _Execute(const Job& job);
+    void _Submit(const Job& job);
+
+    std::vector<Worker*> workers;
+    std::atomic<bool> exit { false };
+
+    // 非工作线程提交的任务
+    std::mutex globalMutex;
+    std::deque<Job> globalQueue;
+
+    // 空闲的工作线程在这里休眠
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+    std::atomic<uint32_t> sleepingCount { 0 };
+};
+
+template<typename F>
+void JobSystem::ParallelFor(uint32_t count, uint32_t batchSize, const F& func)
+{
+    if (count == 0)
+        return;
+
+    /* 没有初始化或已经 Shutdown 时没有线程处理全局队列，直接在调用线程执行 */
+    if (workers.empty()) {
+        func(0u, count);
+        return;
+    }
+
+    if (batchSize == 0)
+        batchSize = std::max(1u, count / (GetWorkerCount() * 4));
+
+    struct Batch
+    {
+        const F* func;
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    uint32_t batchCount = (count + batchSize - 1) / batchSize;
+    std::vector<Batch> batches(batchCount);
+    std::vector<JobDecl> jobs(batchCount);
+
+    for (uint32_t i = 0; i < batchCount; i++) {
+        batches[i] = { &func, i * batchSize, std::min(count, (i + 1) * batchSize) };
+        jobs[i] = { [](void* pUserData) {
+            const Batch* batch = static_cast<const Batch*>(pUserData);
+            (*batch->func)(batch->begin, batch->end);
+        }, &batches[i] };
+    }
+
+    JobCounter counter;
+    Run(batchCount, std::data(jobs), &counter);
+    Wait(&counter);
+}
+
+#endif /* JOB_SYSTEM_H_ */
@@ -0,0 +1,214 @@
+#include "profiler.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+
+/* 每个线程一个环形缓冲，只由所属线程写入；线程退出后缓冲保留，导出时仍能读到 */
+struct _ProfileThreadBuffer
+{
+    static constexpr uint64_t CAPACITY = 16384;
+
+    ProfileEvent events[CAPACITY];
+    std::atomic<uint64_t> head { 0 };
+    uint32_t depth = 0;
+    uint32_t threadId = 0;
+    std::atomic<const char*> name { nullptr };
+};
+
+static constexpr uint64_t FRAME_HISTORY = 64;
+
+static std::atomic<bool> _enabled { true };
+static std::mutex _threadsMutex;
+static std::vector<_ProfileThreadBuffer*> _threads;
+static thread_local _ProfileThreadBuffer* _threadBuffer = nullptr;
+
+static std::atomic<uint64_t> _frameMarks[FRAME_HISTORY];
+static std::atomic<uint64_t> _frameCount { 0 };
+
+static _ProfileThreadBuffer* _GetThreadBuffer()
+{
+    if (_threadBuffer == nullptr) {
+        _threadBuffer = new _ProfileThreadBuffer();
+
+        std::lock_guard<std::mutex> lock(_threadsMutex);
+        _threadBuffer->threadId = static_cast<uint32_t>(std::size(_threads));
+        _threads.push_back(_threadBuffer);
+    }
+
+    return _threadBuffer;
+}
+
+/* 拷贝 [first, last) 范围内仍然有效的事件，拷贝后再检查一次写入位置，丢弃期间被覆盖的部分 */
+static void _CopyEvents(_ProfileThreadBuffer* buffer, uint64_t first, uint64_t last, std::vector<ProfileEvent>& out)
+{
+    size_t start = std::size(out);
+
+    for (uint64_t i = first; i < last; i++)
+        out.push_back(buffer->events[i % _ProfileThreadBuffer::CAPACITY]);
+
+    uint64_t head = buffer->head.load(std::memory_order_acquire);
+    uint64_t oldest = head > _ProfileThreadBuffer::CAPACITY ? head - _ProfileThreadBuffer::CAPACITY : 0;
+
+    if (first < oldest) {
+        size_t overwritten = static_cast<size_t>(std::min(oldest, last) - first);
+        out.erase(out.begin() + start, out.begin() + start + overwritten);
+    }
+}
+
+void Profiler::SetEnabled(bool enabled)
+{
+    _enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool Profiler::IsEnabled()
+{
+    return _enabled.load(std::memory_order_relaxed);
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+    _GetThreadBuffer()->name.store(name, std::memory_order_release);
+}
+
+uint64_t Profiler::Now()
+{
+    static const auto epoch = std::chrono::steady_clock::now();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+}
+
+void Profiler::MarkFrame()
+{
+    uint64_t frame = _frameCount.load(std::memory_order_relaxed);
+    _frameMarks[frame % FRAME_HISTORY].store(Now(), std::memory_order_relaxed);
+    _frameCount.store(frame + 1, std::memory_order_release);
+}
+
+void Profiler::_BeginZone()
+{
+    _GetThreadBuffer()->depth++;
+}
+
+void Profiler::_EndZone(const char* name, uint64_t begin)
+{
+    _ProfileThreadBuffer* buffer = _GetThreadBuffer();
+    buffer->depth--;
+
+    uint64_t head = buffer->head.load(std::memory_order_relaxed);
+    buffer->events[head % _ProfileThreadBuffer::CAPACITY] = { name, begin, Now(), buffer->depth };
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+bool Profiler::CollectLastFrame(ProfileFrame* pFrame)
+{
+    uint64_t frameCount = _frameCount.load(std::memory_order_acquire);
+    if (frameCount < 2)
+        return false;
+
+    pFrame->frameNumber = frameCount - 1;
+    pFrame->begin = _frameMarks[(frameCount - 2) % FRAME_HISTORY].load(std::memory_order_relaxed);
+    pFrame->end = _frameMarks[(frameCount - 1) % FRAME_HISTORY].load(std::memory_order_relaxed);
+    pFrame->threads.clear();
+
+    std::vector<_ProfileThreadBuffer*> threads;
+    {
+        std::lock_guard<std::mutex> lock(_threadsMutex);
+        threads = _threads;
+    }
+
+    for (_ProfileThreadBuffer* buffer : threads) {
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t oldest = head > _ProfileThreadBuffer::CAPACITY ? head - _ProfileThreadBuffer::CAPACITY : 0;
+
+        /* 事件按结束时间写入，从后往前找到第一个在本帧之前结束的事件 */
+        uint64_t first = head;
+        while (first > oldest && buffer->events[(first - 1) % _ProfileThreadBuffer::CAPACITY].end > pFrame->begin)
+            first--;
+
+        ProfileThread thread = { buffer->threadId, buffer->name.load(std::memory_order_acquire), {} };
+        _CopyEvents(buffer, first, head, thread.events);
+
+        std::erase_if(thread.events, [pFrame](const ProfileEvent& event) {
+            return event.begin >= pFrame->end || event.end <= pFrame->begin;
+        });
+
+        if (!thread.events.empty())
+            pFrame->threads.push_back(std::move(thread));
+    }
+
+    return true;
+}
+
+static void _WriteJsonString(FILE* file, const char* str)
+{
+    fputc('"', file);
+    for (const char* c = str; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\')
+            fputc('\\', file);
+        fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+bool Profiler::ExportChromeTrace(const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        printf("[profiler] open %s failed\n", path);
+        return false;
+    }
+
+    std::vector<_ProfileThreadBuffer*> threads;
+    {
+        std::lock_guard<std::mutex> lock(_threadsMutex);
+        threads = _threads;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+    bool first = true;
+    size_t eventCount = 0;
+    std::vector<ProfileEvent> events;
+
+    for (_ProfileThreadBuffer* buffer : threads) {
+        const char* name = buffer->name.load(std::memory_order_acquire);
+        if (name != nullptr) {
+            fprintf(file, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n", buffer->threadId);
+            _WriteJsonString(file, name);
+            fprintf(file, "}}");
+            first = false;
+        }
+
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t oldest = head > _ProfileThreadBuffer::CAPACITY ? head - _ProfileThreadBuffer::CAPACITY : 0;
+
+        events.clear();
+        _CopyEvents(buffer, oldest, head, events);
+
+        /* 时间单位为微秒 */
+        for (const ProfileEvent& event : events) {
+            fprintf(file, "%s{\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"name\":",
+                    first ? "" : ",\n", buffer->threadId, event.begin / 1000.0, (event.end - event.begin) / 1000.0);
+            _WriteJsonString(file, event.name);
+            fputc('}', file);
+            first = false;
+        }
+
+        eventCount += std::size(events);
+    }
+
+    /* 帧边界作为全局 instant 事件 */
+    uint64_t frameCount = _frameCount.load(std::memory_order_acquire);
+    for (uint64_t i = frameCount > FRAME_HISTORY ? frameCount - FRAME_HISTORY : 0; i < frameCount; i++) {
+        fprintf(file, "%s{\"ph\":\"i\",\"s\":\"g\",\"pid\":0,\"tid\":0,\"name\":\"frame\",\"ts\":%.3f}",
+                first ? "" : ",\n", _frameMarks[i % FRAME_HISTORY].load(std::memory_order_relaxed) / 1000.0);
+        first = false;
+    }
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    printf("[profiler] exported %zu events from %zu threads to %s\n", eventCount, std::size(threads), path);
+    return true;
+}
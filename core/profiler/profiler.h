@@ -0,0 +1,104 @@
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include <stdint.h>
+
+// std
+#include <atomic>
+#include <vector>
+
+/**
+ * CPU 帧分析。
+ *
+ * QK_PROFILE_ZONE 在作用域结束时把 (名字, 开始, 结束, 嵌套深度) 写入当前线程的
+ * 环形缓冲，写入方只有线程自己，不加锁。名字必须是常量字符串。
+ * 编译时定义 QK_ENABLE_PROFILER 才会生成代码，运行时可以用 SetEnabled 关闭。
+ */
+
+struct ProfileEvent
+{
+    const char* name;
+    uint64_t begin;                     // 纳秒，Profiler::Now() 的时间基准
+    uint64_t end;
+    uint32_t depth;
+};
+
+struct ProfileThread
+{
+    uint32_t threadId;
+    const char* name;
+    std::vector<ProfileEvent> events;
+};
+
+struct ProfileFrame
+{
+    uint64_t frameNumber;
+    uint64_t begin;
+    uint64_t end;
+    std::vector<ProfileThread> threads;
+};
+
+class Profiler
+{
+public:
+    static void SetEnabled(bool enabled);
+    static bool IsEnabled();
+
+    /* 当前线程在导出和火焰图中显示的名字，需要是常量字符串 */
+    static void SetThreadName(const char* name);
+
+    /* 标记一帧的开始，主循环每帧调用一次 */
+    static void MarkFrame();
+
+    /* 取最近一个完整帧内各线程的事件 */
+    static bool CollectLastFrame(ProfileFrame* pFrame);
+
+    /* 导出所有缓冲中的事件为 Chrome trace JSON，chrome://tracing 和 Perfetto 都能打开 */
+    static bool ExportChromeTrace(const char* path);
+
+    static uint64_t Now();
+
+    static void _BeginZone();
+    static void _EndZone(const char* name, uint64_t begin);
+};
+
+class ProfileZone
+{
+public:
+    ProfileZone(const char* name) : name(name)
+    {
+        if (Profiler::IsEnabled()) {
+            active = true;
+            begin = Profiler::Now();
+            Profiler::_BeginZone();
+        }
+    }
+
+   ~ProfileZone()
+    {
+        if (active)
+            Profiler::_EndZone(name, begin);
+    }
+
+private:
+    const char* name;
+    uint64_t begin = 0;
+    bool active = false;
+};
+
+#define QK_PROFILE_CONCAT_(a, b) a##b
+#define QK_PROFILE_CONCAT(a, b) QK_PROFILE_CONCAT_(a, b)
+
+#ifdef QK_ENABLE_PROFILER
+#define QK_PROFILE_ZONE(name) ProfileZone QK_PROFILE_CONCAT(_qkProfileZone, __LINE__)(name)
+#define QK_PROFILE_FUNCTION() QK_PROFILE_ZONE(__func__)
+#define QK_PROFILE_FRAME() Profiler::MarkFrame()
+#define QK_PROFILE_THREAD(name) Profiler::SetThreadName(name)
+#else
+#define QK_PROFILE_ZONE(name)
+#define QK_PROFILE_FUNCTION()
+#define QK_PROFILE_FRAME()
+#define QK_PROFILE_THREAD(name)
+#endif /* QK_ENABLE_PROFILER */
+
+#endif /* PROFILER_H_ */
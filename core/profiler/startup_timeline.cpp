@@ -0,0 +1,98 @@
+#include "startup_timeline.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+static std::mutex _stepsMutex;
+static std::vector<StartupStep> _steps;
+static uint64_t _origin = UINT64_MAX;
+static uint64_t _firstFrame = 0;
+static std::atomic<bool> _finished { false };
+
+static std::atomic<uint32_t> _threadCount { 0 };
+static thread_local uint32_t _threadIndex = UINT32_MAX;
+
+static uint32_t _GetThreadIndex()
+{
+    if (_threadIndex == UINT32_MAX)
+        _threadIndex = _threadCount.fetch_add(1, std::memory_order_relaxed);
+
+    return _threadIndex;
+}
+
+void StartupTimeline::Begin()
+{
+    _GetThreadIndex();
+
+    std::lock_guard<std::mutex> lock(_stepsMutex);
+    _origin = Profiler::Now();
+}
+
+void StartupTimeline::Record(const char* name, uint64_t begin, uint64_t end)
+{
+    if (IsFinished())
+        return;
+
+    uint32_t thread = _GetThreadIndex();
+
+    std::lock_guard<std::mutex> lock(_stepsMutex);
+
+    /* 没有调用 Begin 时以第一个步骤为零点 */
+    if (_origin == UINT64_MAX)
+        _origin = begin;
+
+    begin = std::max(begin, _origin);
+    _steps.push_back({ name, begin - _origin, std::max(end, begin) - _origin, thread });
+}
+
+void StartupTimeline::MarkFirstFrame()
+{
+    if (_finished.exchange(true, std::memory_order_acq_rel))
+        return;
+
+    std::lock_guard<std::mutex> lock(_stepsMutex);
+
+    if (_origin == UINT64_MAX)
+        _origin = Profiler::Now();
+
+    _firstFrame = Profiler::Now() - _origin;
+
+    std::stable_sort(_steps.begin(), _steps.end(), [](const StartupStep& a, const StartupStep& b) {
+        return a.begin < b.begin;
+    });
+
+    /* 每个步骤一行，右侧的条形按首帧时间缩放，重叠的条形即并行执行的步骤 */
+    const uint32_t BAR_WIDTH = 40;
+    const double total = static_cast<double>(std::max<uint64_t>(_firstFrame, 1));
+
+    printf("[startup] time to first frame: %.2f ms, %zu steps\n", _firstFrame / 1e6, std::size(_steps));
+
+    for (const StartupStep& step : _steps) {
+        char bar[BAR_WIDTH + 1];
+        uint32_t first = static_cast<uint32_t>(step.begin / total * BAR_WIDTH);
+        uint32_t last = static_cast<uint32_t>(step.end / total * BAR_WIDTH);
+        first = std::min(first, BAR_WIDTH - 1);
+        last = std::clamp(last, first, BAR_WIDTH - 1);
+
+        for (uint32_t i = 0; i < BAR_WIDTH; i++)
+            bar[i] = i >= first && i <= last ? '#' : '.';
+        bar[BAR_WIDTH] = '\0';
+
+        printf("[startup] %8.2f ms %8.2f ms  T%-2u |%s| %s\n",
+               step.begin / 1e6, (step.end - step.begin) / 1e6, step.thread, bar, step.name);
+    }
+}
+
+bool StartupTimeline::IsFinished()
+{
+    return _finished.load(std::memory_order_acquire);
+}
+
+uint64_t StartupTimeline::GetTimeToFirstFrame()
+{
+    std::lock_guard<std::mutex> lock(_stepsMutex);
+    return _firstFrame;
+}
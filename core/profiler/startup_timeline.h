@@ -0,0 +1,63 @@
+#ifndef STARTUP_TIMELINE_H_
+#define STARTUP_TIMELINE_H_
+
+#include <stdint.h>
+
+#include "profiler.h"
+
+/**
+ * 启动时间线。
+ *
+ * 记录从 Begin 到第一帧提交之间每个启动步骤的起止时间和所在线程，MarkFirstFrame
+ * 时打印报告，之后的步骤不再记录。与 QK_ENABLE_PROFILER 无关，始终生效；
+ * 开启 profiler 时步骤同时作为 zone 出现在 trace 中。
+ */
+
+struct StartupStep
+{
+    const char* name;
+    uint64_t begin;                     // 纳秒，相对 Begin
+    uint64_t end;
+    uint32_t thread;                    // 按首次记录的顺序编号，0 为调用 Begin 的线程
+};
+
+class StartupTimeline
+{
+public:
+    /* 进程入口调用一次，作为时间零点 */
+    static void Begin();
+
+    static void Record(const char* name, uint64_t begin, uint64_t end);
+
+    /* 第一帧提交后调用，打印报告，重复调用无效 */
+    static void MarkFirstFrame();
+
+    static bool IsFinished();
+    static uint64_t GetTimeToFirstFrame();
+};
+
+class StartupScope
+{
+public:
+    StartupScope(const char* name) : name(name)
+    {
+        if (!StartupTimeline::IsFinished())
+            begin = Profiler::Now();
+    }
+
+   ~StartupScope()
+    {
+        if (begin != UINT64_MAX)
+            StartupTimeline::Record(name, begin, Profiler::Now());
+    }
+
+private:
+    const char* name;
+    uint64_t begin = UINT64_MAX;
+};
+
+#define QK_STARTUP_STEP(name) \
+    StartupScope QK_PROFILE_CONCAT(_qkStartupStep, __LINE__)(name); \
+    QK_PROFILE_ZONE(name)
+
+#endif /* STARTUP_TIMELINE_H_ */
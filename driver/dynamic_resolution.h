@@ -0,0 +1,83 @@
+#ifndef DYNAMIC_RESOLUTION_H_
+#define DYNAMIC_RESOLUTION_H_
+
+#include <stdint.h>
+#include <math.h>
+#include <algorithm>
+
+struct DynamicResolutionSettings
+{
+    bool enabled = true;
+    float minScale = 0.5f;                  // 相对 swapchain 的最小线性缩放
+    float maxScale = 1.0f;                  // 同时决定内部渲染目标的分配尺寸
+    float targetFrameTimeMs = 14.0f;        // 场景 pass 的 GPU 时间预算
+    float lowerThreshold = 0.80f;           // 低于 预算 * lowerThreshold 才提高分辨率
+    float upperThreshold = 1.00f;           // 高于 预算 * upperThreshold 才降低分辨率
+    float maxScaleUpStep = 0.05f;           // 单次提高的最大幅度，避免冲过头
+    uint32_t cooldownFrames = 8;            // 两次调整之间至少间隔的帧数
+};
+
+/**
+ * 根据测得的 GPU 时间调整渲染缩放。
+ *
+ * GPU 时间近似与像素数成正比，即与缩放的平方成正比，所以降分辨率时按
+ * sqrt(预算 / 实测) 一步到位，升分辨率时按 maxScaleUpStep 逐步逼近。
+ * [lowerThreshold, upperThreshold] 之间是滞回区间，落在其中不做调整。
+ */
+class DynamicResolutionController
+{
+public:
+    void SetSettings(const DynamicResolutionSettings& newSettings)
+    {
+        settings = newSettings;
+        scale = std::clamp(scale, settings.minScale, settings.maxScale);
+    }
+
+    const DynamicResolutionSettings& GetSettings() const { return settings; }
+
+    float GetScale() const { return settings.enabled ? scale : settings.maxScale; }
+    float GetAverageFrameTimeMs() const { return averageFrameTimeMs; }
+
+    void Update(float gpuFrameTimeMs)
+    {
+        if (averageFrameTimeMs <= 0.0f)
+            averageFrameTimeMs = gpuFrameTimeMs;
+        else
+            averageFrameTimeMs += (gpuFrameTimeMs - averageFrameTimeMs) * 0.1f;
+
+        if (!settings.enabled)
+            return;
+
+        if (++framesSinceChange < settings.cooldownFrames)
+            return;
+
+        const float budget = settings.targetFrameTimeMs;
+        float newScale = scale;
+
+        if (averageFrameTimeMs > budget * settings.upperThreshold) {
+            newScale = scale * sqrtf(budget / averageFrameTimeMs);
+        } else if (averageFrameTimeMs < budget * settings.lowerThreshold) {
+            float ideal = scale * sqrtf(budget * settings.lowerThreshold / averageFrameTimeMs);
+            newScale = std::min(ideal, scale + settings.maxScaleUpStep);
+        }
+
+        newScale = std::clamp(newScale, settings.minScale, settings.maxScale);
+
+        if (fabsf(newScale - scale) < 0.01f)
+            return;
+
+        /* 耗时近似与像素数成正比，平均值按面积换算到新分辨率，平滑窗口跨越调整继续保留 */
+        averageFrameTimeMs *= (newScale * newScale) / (scale * scale);
+
+        scale = newScale;
+        framesSinceChange = 0;
+    }
+
+private:
+    DynamicResolutionSettings settings = {};
+    float scale = 1.0f;
+    float averageFrameTimeMs = 0.0f;
+    uint32_t framesSinceChange = 0;
+};
+
+#endif /* DYNAMIC_RESOLUTION_H_ */
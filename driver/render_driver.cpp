@@ -4,15 +4,16 @@
 #include "render_driver.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "vkutils.h"
 #include "utils/ioutils.h"
+#include "core/job/job_system.h"
+#include "core/profiler/profiler.h"
+#include "core/profiler/startup_timeline.h"
 
 #define VK_VERSION_1_3_216
 
-#define VK_CHECK_ERROR(err) \
-    if (err != VK_SUCCESS) \
-        return err;
-
 /* volk 全局只初始化一次 */
 static bool volkInitialized = false;
 
@@ -24,8 +25,12 @@ struct Texture2D_T {
     VmaAllocationInfo allocationInfo = {};
     uint32_t width = 0;
     uint32_t height = 0;
+    uint32_t mipLevels = 1;
+    uint32_t arrayLayers = 1;
     VkFormat format = VK_FORMAT_UNDEFINED;
+    VkImageAspectFlags aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    MemoryCategory category = MEMORY_CATEGORY_TEXTURE;
 };
 
 struct Buffer_T {
@@ -35,20 +40,45 @@ struct Buffer_T {
     VkDeviceSize size = 0;
     VmaMemoryUsage memoryUsage = VMA_MEMORY_USAGE_UNKNOWN;
     VmaAllocationInfo allocationInfo;
+    MemoryCategory category = MEMORY_CATEGORY_GENERIC;
+    VkBool32 relocatable = VK_FALSE;                    // 碎片整理时是否允许移动
 };
 
+/* 管线缓存在工作目录下持久化，下次启动时直接命中驱动的编译结果 */
+static const char* PIPELINE_CACHE_PATH = "quokka_pipeline_cache.bin";
+
 struct Pipeline_T {
     VkPipeline vkPipeline = VK_NULL_HANDLE;
     VkPipelineLayout vkPipelineLayout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout vkDescriptorSetLayout = VK_NULL_HANDLE;
     VkPipelineBindPoint vkBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
 };
 
-RenderDriver::RenderDriver()
+/* std140 布局，与 qk_hiz_cull.comp 中的 PyramidParams 保持一致 */
+struct DepthPyramidParams {
+    float viewProjection[16];
+    float size[2];
+    float mipCount;
+    float valid;
+};
+
+struct HizReducePushConstants {
+    int32_t srcSize[2];
+    int32_t dstSize[2];
+};
+
+struct HizCullPushConstants {
+    float viewProjection[16];
+    uint32_t objectCount;
+};
+
+RenderDriver::RenderDriver(VkBool32 headless) : headless(headless)
 {
     VkResult err;
 
 #ifdef USE_VOLK_LOADER
     if (!volkInitialized) {
+        QK_STARTUP_STEP("volkInitialize");
         err = volkInitialize();
         assert(!err);
         volkInitialized = true;
@@ -77,10 +107,51 @@ RenderDriver::RenderDriver()
 
 RenderDriver::~RenderDriver()
 {
+    /* 初始化中途失败时内置管线的任务可能还在执行 */
+    if (jobSystem != VK_NULL_HANDLE)
+        jobSystem->Wait(&builtinPipelineCounter);
+
     vkDeviceWaitIdle(device);
 
+    if (defragmentationPassPending)
+        _EndDefragmentationPass();
+
+    if (defragmentationContext != VK_NULL_HANDLE)
+        _EndDefragmentation();
+
+    if (readbackRing != VK_NULL_HANDLE) {
+        vmaUnmapMemory(allocator, readbackRing->allocation);
+        DestroyBuffer(readbackRing);
+    }
+
+    if (transientRing != VK_NULL_HANDLE) {
+        vmaUnmapMemory(allocator, transientRing->allocation);
+        DestroyBuffer(transientRing);
+    }
+
+    DestroyPipeline(hizReducePipeline);
+    DestroyPipeline(hizCullPipeline);
+
+    for (auto& [hash, entry] : shaderCache)
+        vkDestroyShaderModule(device, entry.module, VK_NULL_HANDLE);
+    _SavePipelineCache();
+    vkDestroyPipelineCache(device, pipelineCache, VK_NULL_HANDLE);
+    _DestroyRenderTargets();
+    vkDestroySampler(device, depthPyramidSampler, VK_NULL_HANDLE);
+    vkDestroyQueryPool(device, timestampQueryPool, VK_NULL_HANDLE);
+
     _DestroyFence(submitFence);
     _DestroySyncObjects();
+
+    for (VkSemaphore semaphore : computeFinishedSemaphores)
+        _DestroySemaphore(semaphore);
+
+    if (computeCommandPool != VK_NULL_HANDLE)
+        vkDestroyCommandPool(device, computeCommandPool, VK_NULL_HANDLE);
+
+    for (VkDescriptorPool frameDescriptorPool : frameDescriptorPools)
+        vkDestroyDescriptorPool(device, frameDescriptorPool, VK_NULL_HANDLE);
+
     vkDestroyDescriptorPool(device, descriptorPool, VK_NULL_HANDLE);
     vkDestroyCommandPool(device, commandPool, VK_NULL_HANDLE);
     // vkDestroySwapchainKHR(device, swapchain, VK_NULL_HANDLE);
@@ -93,6 +164,8 @@ RenderDriver::~RenderDriver()
 
 VkResult RenderDriver::Initialize(VkSurfaceKHR surface)
 {
+    QK_PROFILE_ZONE("RenderDriver::Initialize");
+
     VkResult err;
 
     this->surface = surface;
@@ -100,41 +173,232 @@ VkResult RenderDriver::Initialize(VkSurfaceKHR surface)
     err = _CreateDevice();
     VK_CHECK_ERROR(err);
 
-    err = _CreateSwapchain(VK_NULL_HANDLE);
+    {
+        QK_STARTUP_STEP("CreateSwapchain");
+        err = _CreateSwapchain(VK_NULL_HANDLE);
+        VK_CHECK_ERROR(err);
+    }
+
+    return _InitializeResources();
+}
+
+VkResult RenderDriver::InitializeHeadless(uint32_t width, uint32_t height, VkFormat colorFormat)
+{
+    VkResult err;
+
+    assert(headless);
+
+    err = _CreateDevice();
+    VK_CHECK_ERROR(err);
+
+    /* 没有 swapchain，内部渲染目标就是最终输出，固定分辨率 */
+    swapchainExtent2D = { width, height };
+    surfaceFormat.format = colorFormat;
+    surfaceFormat.colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+
+    DynamicResolutionSettings settings = dynamicResolution.GetSettings();
+    settings.enabled = false;
+    settings.maxScale = 1.0f;
+    dynamicResolution.SetSettings(settings);
+
+    /* 每个 in-flight 帧都可能有一整帧在读回 */
+    VkDeviceSize frameBytes = static_cast<VkDeviceSize>(width) * height * std::max(VkUtils::FormatTexelSize(colorFormat), 4u);
+    readbackRingSize = std::max(readbackRingSize, frameBytes * (MAX_FRAMES_IN_FLIGHT + 1));
+
+    return _InitializeResources();
+}
+
+VkResult RenderDriver::_InitializeResources()
+{
+    QK_STARTUP_STEP("InitializeResources");
+
+    VkResult err;
+
+    /* 管线缓存在内置管线之前创建，着色器标识符需要从这里命中管线。上次运行保存的数据与当前设备不符时丢弃 */
+    size_t pipelineCacheSize = 0;
+    char* pipelineCacheData = io_read_bytecode(PIPELINE_CACHE_PATH, &pipelineCacheSize);
+    if (pipelineCacheData != VK_NULL_HANDLE && !_ValidatePipelineCacheData(pipelineCacheData, pipelineCacheSize)) {
+        io_free_buf(pipelineCacheData);
+        pipelineCacheData = VK_NULL_HANDLE;
+        pipelineCacheSize = 0;
+    }
+
+    VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
+    pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    pipelineCacheCreateInfo.initialDataSize = pipelineCacheSize;
+    pipelineCacheCreateInfo.pInitialData = pipelineCacheData;
+
+    err = vkCreatePipelineCache(device, &pipelineCacheCreateInfo, VK_NULL_HANDLE, &pipelineCache);
+    if (pipelineCacheData != VK_NULL_HANDLE) {
+        printf("[vulkan] load pipeline cache %s, size=%zu\n", PIPELINE_CACHE_PATH, pipelineCacheSize);
+        io_free_buf(pipelineCacheData);
+    }
+    VK_CHECK_ERROR(err);
+
+    /* 内置管线只依赖设备，有任务系统时与下面的池、分配器、同步对象的创建并行 */
+    PFN_JobEntry createBuiltinPipelines = [](void* pUserData) {
+        RenderDriver* driver = static_cast<RenderDriver*>(pUserData);
+        driver->builtinPipelineResult = driver->_CreateBuiltinPipelines();
+    };
+
+    if (jobSystem != VK_NULL_HANDLE)
+        jobSystem->Run(createBuiltinPipelines, this, &builtinPipelineCounter);
+    else
+        createBuiltinPipelines(this);
+
+    {
+        QK_STARTUP_STEP("CreatePools");
+
+        err = _CreateCommandPool();
+        VK_CHECK_ERROR(err);
+
+        err = _CreateDescriptorPool();
+        VK_CHECK_ERROR(err);
+    }
+
+    {
+        QK_STARTUP_STEP("CreateMemoryAllocator");
+        err = _CreateMemoryAllocator();
+        VK_CHECK_ERROR(err);
+    }
+
+    {
+        QK_STARTUP_STEP("CreateSyncObjects");
+
+        err = _InitSyncObjects();
+        VK_CHECK_ERROR(err);
+
+        err = _CreateComputeQueueResources();
+        VK_CHECK_ERROR(err);
+
+        err = _CreateFence(&submitFence);
+        VK_CHECK_ERROR(err);
+    }
+
+    VkSamplerCreateInfo samplerCreateInfo = {};
+    samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+    samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+    samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.minLod = 0.0f;
+    samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+    err = vkCreateSampler(device, &samplerCreateInfo, VK_NULL_HANDLE, &depthPyramidSampler);
     VK_CHECK_ERROR(err);
 
-    err = _CreateCommandPool();
+    /* GPU 计时，驱动动态分辨率 */
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, VK_NULL_HANDLE);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, std::data(queueFamilies));
+
+    const uint32_t timestampValidBits = queueFamilies[queueFamilyIndex].timestampValidBits;
+    if (timestampValidBits > 0) {
+        timestampMask = timestampValidBits >= 64 ? UINT64_MAX : (1ull << timestampValidBits) - 1;
+
+        VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+        queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolCreateInfo.queryCount = MAX_FRAMES_IN_FLIGHT * 2;
+
+        err = vkCreateQueryPool(device, &queryPoolCreateInfo, VK_NULL_HANDLE, &timestampQueryPool);
+        VK_CHECK_ERROR(err);
+    } else {
+        printf("[vulkan] timestamps unsupported, dynamic resolution disabled\n");
+    }
+
+    timestampsWritten.resize(MAX_FRAMES_IN_FLIGHT, VK_FALSE);
+
+    /* 深度金字塔的描述符集用到 hiz reduce 管线的布局 */
+    if (jobSystem != VK_NULL_HANDLE) {
+        QK_STARTUP_STEP("WaitBuiltinPipelines");
+        jobSystem->Wait(&builtinPipelineCounter);
+    }
+
+    err = builtinPipelineResult;
     VK_CHECK_ERROR(err);
 
-    err = _CreateDescriptorPool();
+    {
+        QK_STARTUP_STEP("CreateRenderTargets");
+        err = _CreateRenderTargets();
+        VK_CHECK_ERROR(err);
+    }
+
+    /* 读回环形缓冲在第一次读回时才创建 */
+
+    /* 每帧临时数据环形缓冲，常驻映射 */
+    transientAlignment = std::max(physicalDeviceProperties.limits.minUniformBufferOffsetAlignment,
+                                  physicalDeviceProperties.limits.minStorageBufferOffsetAlignment);
+    transientFrameSize = std::min<VkDeviceSize>(transientFrameSize, physicalDeviceProperties.limits.maxStorageBufferRange);
+
+    err = CreateBuffer(transientFrameSize * (MAX_FRAMES_IN_FLIGHT + 1),
+                       VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                       VMA_MEMORY_USAGE_CPU_TO_GPU, &transientRing);
     VK_CHECK_ERROR(err);
 
-    err = _CreateMemoryAllocator();
+    err = vmaMapMemory(allocator, transientRing->allocation, reinterpret_cast<void**>(&transientRingMapped));
     VK_CHECK_ERROR(err);
 
-    err = _InitSyncObjects();
+    return err;
+}
+
+VkResult RenderDriver::_CreateBuiltinPipelines()
+{
+    QK_STARTUP_STEP("CreateBuiltinPipelines");
+
+    VkResult err;
+
+    /* Hi-Z pyramid 构建与遮挡剔除 */
+    VkDescriptorSetLayoutBinding hizReduceBindings[] = {
+        { 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, VK_NULL_HANDLE },
+        { 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,          1, VK_SHADER_STAGE_COMPUTE_BIT, VK_NULL_HANDLE },
+    };
+
+    err = CreateComputePipeline("qk_hiz_reduce", ARRAY_SIZE(hizReduceBindings), hizReduceBindings, sizeof(HizReducePushConstants), &hizReducePipeline);
     VK_CHECK_ERROR(err);
 
-    err = _CreateFence(&submitFence);
+    VkDescriptorSetLayoutBinding hizCullBindings[] = {
+        { 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, VK_NULL_HANDLE },
+        { 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         1, VK_SHADER_STAGE_COMPUTE_BIT, VK_NULL_HANDLE },
+        { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         1, VK_SHADER_STAGE_COMPUTE_BIT, VK_NULL_HANDLE },
+        { 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         1, VK_SHADER_STAGE_COMPUTE_BIT, VK_NULL_HANDLE },
+    };
+
+    err = CreateComputePipeline("qk_hiz_cull", ARRAY_SIZE(hizCullBindings), hizCullBindings, sizeof(HizCullPushConstants), &hizCullPipeline);
     VK_CHECK_ERROR(err);
 
     return err;
 }
 
 VkResult RenderDriver::CreateBuffer(const size_t size, VkBufferUsageFlags usage, Buffer *pBuffer)
+{
+    return CreateBuffer(size, usage, _GuessMemoryUsage(usage), pBuffer);
+}
+
+VkResult RenderDriver::CreateBuffer(const size_t size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, Buffer *pBuffer)
 {
     VkResult err;
 
+    VmaAllocationCreateInfo allocationCreateInfo = {};
+    allocationCreateInfo.usage = memoryUsage;
+
+    /* 设备专用内存可能被碎片整理搬移，需要能作为拷贝源和目标 */
+    if (allocationCreateInfo.usage == VMA_MEMORY_USAGE_GPU_ONLY)
+        usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
     VkBufferCreateInfo bufferCreateInfo = {};
     bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferCreateInfo.size = size;
     bufferCreateInfo.usage = usage;
-    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-    VmaAllocationCreateInfo allocationCreateInfo = {};
-    allocationCreateInfo.usage = _GuessMemoryUsage(usage);
+    /* 可能被异步计算队列访问的 buffer 使用 CONCURRENT，免去队列族所有权转移 */
+    bufferCreateInfo.sharingMode = _ChooseSharingMode(usage & (VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT), &bufferCreateInfo.queueFamilyIndexCount);
+    bufferCreateInfo.pQueueFamilyIndices = sharedQueueFamilyIndices;
 
     *pBuffer = (Buffer_T*) malloc(sizeof(Buffer_T));
+    allocationCreateInfo.pUserData = *pBuffer;
 
     err = vmaCreateBuffer(allocator,
                           &bufferCreateInfo,
@@ -147,20 +411,76 @@ VkResult RenderDriver::CreateBuffer(const size_t size, VkBufferUsageFlags usage,
     (*pBuffer)->usage = usage;
     (*pBuffer)->size = size;
     (*pBuffer)->memoryUsage = allocationCreateInfo.usage;
+    (*pBuffer)->category = _GuessMemoryCategory(usage, allocationCreateInfo.usage);
+
+    /* 被持久描述符集引用的 buffer 搬移后描述符会失效，不参与碎片整理 */
+    (*pBuffer)->relocatable = allocationCreateInfo.usage == VMA_MEMORY_USAGE_GPU_ONLY
+        && !(usage & (VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+                      | VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT));
+
+    _TrackAllocation((*pBuffer)->category, (*pBuffer)->allocationInfo.size, 1);
 
     return err;
 }
 
 void RenderDriver::DestroyBuffer(Buffer buffer)
 {
+    /* 不能在碎片整理 pass 进行中释放可能被搬移的分配 */
+    if (defragmentationPassPending)
+        _EndDefragmentationPass();
+
+    _TrackAllocation(buffer->category, buffer->allocationInfo.size, -1);
+
     vmaDestroyBuffer(allocator, buffer->vkBuffer, buffer->allocation);
     free(buffer);
 }
 
 VkResult RenderDriver::CreateTexture2D(uint32_t w, uint32_t h, VkFormat format, VkImageUsageFlags usage, Texture2D *pTexture2D)
+{
+    return CreateTexture2D(w, h, 1, format, usage, pTexture2D);
+}
+
+VkResult RenderDriver::CreateTexture2D(uint32_t w, uint32_t h, uint32_t mipLevels, VkFormat format, VkImageUsageFlags usage, Texture2D *pTexture2D)
+{
+    return _CreateTexture2D(w, h, mipLevels, 1, VK_IMAGE_VIEW_TYPE_2D, format, usage, pTexture2D);
+}
+
+VkResult RenderDriver::CreateTexture2DArray(uint32_t w, uint32_t h, uint32_t arrayLayers, uint32_t mipLevels, VkFormat format, VkImageUsageFlags usage, Texture2D *pTexture2D)
+{
+    /* 只有一层时也使用数组视图，着色器统一按 sampler2DArray 采样 */
+    return _CreateTexture2D(w, h, mipLevels, arrayLayers, VK_IMAGE_VIEW_TYPE_2D_ARRAY, format, usage, pTexture2D);
+}
+
+VkResult RenderDriver::_CreateTexture2DView(VkImage image, VkImageViewType viewType, VkFormat format, VkImageAspectFlags aspectMask,
+                                            uint32_t mipLevels, uint32_t arrayLayers, VkImageView* pImageView)
+{
+    VkImageViewCreateInfo imageViewCreateInfo = {};
+    imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    imageViewCreateInfo.image = image;
+    imageViewCreateInfo.viewType = viewType;
+    imageViewCreateInfo.format = format;
+    /* 采样视图只能包含一个 aspect，深度模板格式只取深度 */
+    imageViewCreateInfo.subresourceRange.aspectMask = aspectMask & ~VK_IMAGE_ASPECT_STENCIL_BIT;
+    imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
+    imageViewCreateInfo.subresourceRange.levelCount = mipLevels;
+    imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
+    imageViewCreateInfo.subresourceRange.layerCount = arrayLayers;
+
+    return vkCreateImageView(device, &imageViewCreateInfo, VK_NULL_HANDLE, pImageView);
+}
+
+VkResult RenderDriver::_CreateTexture2D(uint32_t w, uint32_t h, uint32_t mipLevels, uint32_t arrayLayers, VkImageViewType viewType,
+                                        VkFormat format, VkImageUsageFlags usage, Texture2D *pTexture2D)
 {
     VkResult err;
 
+    VkImageAspectFlags aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    if (VkUtils::IsDepthFormat(format)) {
+        aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        if (VkUtils::HasStencilComponent(format))
+            aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+
     VkImageCreateInfo imageCreateInfo = {};
     imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -168,11 +488,12 @@ VkResult RenderDriver::CreateTexture2D(uint32_t w, uint32_t h, VkFormat format,
     imageCreateInfo.extent.width = w;
     imageCreateInfo.extent.height = h;
     imageCreateInfo.extent.depth = 1.0f;
-    imageCreateInfo.mipLevels = 1;
-    imageCreateInfo.arrayLayers = 1;
+    imageCreateInfo.mipLevels = mipLevels;
+    imageCreateInfo.arrayLayers = arrayLayers;
     imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
     imageCreateInfo.usage = (usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
-    imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageCreateInfo.sharingMode = _ChooseSharingMode(usage & VK_IMAGE_USAGE_STORAGE_BIT, &imageCreateInfo.queueFamilyIndexCount);
+    imageCreateInfo.pQueueFamilyIndices = sharedQueueFamilyIndices;
     imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
     VmaAllocationCreateInfo allocationCreateInfo = {};
@@ -185,18 +506,7 @@ VkResult RenderDriver::CreateTexture2D(uint32_t w, uint32_t h, VkFormat format,
     err = vmaCreateImage(allocator, &imageCreateInfo, &allocationCreateInfo, &image, &allocation, &allocationInfo);
     VK_CHECK_ERROR(err);
 
-    VkImageViewCreateInfo imageViewCreateInfo = {};
-    imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    imageViewCreateInfo.image = image;
-    imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    imageViewCreateInfo.format = format;
-    imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
-    imageViewCreateInfo.subresourceRange.levelCount = 1;
-    imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
-    imageViewCreateInfo.subresourceRange.layerCount = 1;
-
-    err = vkCreateImageView(device, &imageViewCreateInfo, VK_NULL_HANDLE, &imageView);
+    err = _CreateTexture2DView(image, viewType, format, aspectMask, mipLevels, arrayLayers, &imageView);
     VK_CHECK_ERROR(err);
 
     *pTexture2D = (Texture2D_T *) malloc(sizeof(Texture2D_T));
@@ -205,65 +515,265 @@ VkResult RenderDriver::CreateTexture2D(uint32_t w, uint32_t h, VkFormat format,
     (*pTexture2D)->vkImageView = imageView;
     (*pTexture2D)->allocation = allocation;
     (*pTexture2D)->allocationInfo = allocationInfo;
+    (*pTexture2D)->sampler = VK_NULL_HANDLE;
     (*pTexture2D)->width = w;
     (*pTexture2D)->height = h;
+    (*pTexture2D)->mipLevels = mipLevels;
+    (*pTexture2D)->arrayLayers = arrayLayers;
     (*pTexture2D)->format = format;
+    (*pTexture2D)->aspectMask = aspectMask;
+    (*pTexture2D)->layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    (*pTexture2D)->category = (usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT))
+        ? MEMORY_CATEGORY_RENDER_TARGET
+        : MEMORY_CATEGORY_TEXTURE;
+
+    _TrackAllocation((*pTexture2D)->category, allocationInfo.size, 1);
 
     return err;
 }
 
 void RenderDriver::DestroyTexture2D(Texture2D Texture2D)
 {
-    vmaDestroyImage(allocator, Texture2D->vkImage, Texture2D->allocation);
-    vkDestroyImageView(device, Texture2D->vkImageView, VK_NULL_HANDLE);
+    /* 未绑定或绑定到外部内存的纹理不持有分配 */
+    if (Texture2D->allocation != VK_NULL_HANDLE) {
+        _TrackAllocation(Texture2D->category, Texture2D->allocationInfo.size, -1);
+        vmaDestroyImage(allocator, Texture2D->vkImage, Texture2D->allocation);
+    } else {
+        vkDestroyImage(device, Texture2D->vkImage, VK_NULL_HANDLE);
+    }
+
+    if (Texture2D->vkImageView != VK_NULL_HANDLE)
+        vkDestroyImageView(device, Texture2D->vkImageView, VK_NULL_HANDLE);
+
     free(Texture2D);
 }
 
+VkResult RenderDriver::CreateUnboundTexture2D(uint32_t w, uint32_t h, VkFormat format, VkImageUsageFlags usage, Texture2D *pTexture2D)
+{
+    return CreateUnboundTexture2DArray(w, h, 1, format, usage, pTexture2D);
+}
+
+VkResult RenderDriver::CreateUnboundTexture2DArray(uint32_t w, uint32_t h, uint32_t arrayLayers, VkFormat format, VkImageUsageFlags usage, Texture2D *pTexture2D)
+{
+    VkResult err;
+
+    VkImageAspectFlags aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    if (VkUtils::IsDepthFormat(format)) {
+        aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        if (VkUtils::HasStencilComponent(format))
+            aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+
+    /* 不附加 TRANSFER_DST，TRANSIENT_ATTACHMENT 的纹理只允许附件用途 */
+    VkImageCreateInfo imageCreateInfo = {};
+    imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageCreateInfo.format = format;
+    imageCreateInfo.extent = { w, h, 1 };
+    imageCreateInfo.mipLevels = 1;
+    imageCreateInfo.arrayLayers = arrayLayers;
+    imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageCreateInfo.usage = usage;
+    imageCreateInfo.sharingMode = _ChooseSharingMode(usage & VK_IMAGE_USAGE_STORAGE_BIT, &imageCreateInfo.queueFamilyIndexCount);
+    imageCreateInfo.pQueueFamilyIndices = sharedQueueFamilyIndices;
+    imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    VkImage image = VK_NULL_HANDLE;
+    err = vkCreateImage(device, &imageCreateInfo, VK_NULL_HANDLE, &image);
+    VK_CHECK_ERROR(err);
+
+    *pTexture2D = (Texture2D_T *) malloc(sizeof(Texture2D_T));
+
+    (*pTexture2D)->vkImage = image;
+    (*pTexture2D)->vkImageView = VK_NULL_HANDLE;
+    (*pTexture2D)->allocation = VK_NULL_HANDLE;
+    (*pTexture2D)->allocationInfo = {};
+    (*pTexture2D)->sampler = VK_NULL_HANDLE;
+    (*pTexture2D)->width = w;
+    (*pTexture2D)->height = h;
+    (*pTexture2D)->mipLevels = 1;
+    (*pTexture2D)->arrayLayers = arrayLayers;
+    (*pTexture2D)->format = format;
+    (*pTexture2D)->aspectMask = aspectMask;
+    (*pTexture2D)->layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    (*pTexture2D)->category = MEMORY_CATEGORY_RENDER_TARGET;
+
+    return VK_SUCCESS;
+}
+
+void RenderDriver::GetTexture2DMemoryRequirements(Texture2D texture, VkMemoryRequirements* pRequirements) const
+{
+    vkGetImageMemoryRequirements(device, texture->vkImage, pRequirements);
+}
+
+VkResult RenderDriver::BindTexture2DMemory(Texture2D texture, VmaAllocation allocation, VkDeviceSize offset)
+{
+    VkResult err;
+
+    err = vmaBindImageMemory2(allocator, allocation, offset, texture->vkImage, VK_NULL_HANDLE);
+    VK_CHECK_ERROR(err);
+
+    VkImageViewType viewType = texture->arrayLayers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+    return _CreateTexture2DView(texture->vkImage, viewType, texture->format, texture->aspectMask,
+                                texture->mipLevels, texture->arrayLayers, &texture->vkImageView);
+}
+
+VkResult RenderDriver::AllocateMemory(const VkMemoryRequirements& requirements, VkBool32 lazilyAllocated, VmaAllocation* pAllocation)
+{
+    VkResult err;
+
+    VmaAllocationCreateInfo allocationCreateInfo = {};
+    allocationCreateInfo.usage = lazilyAllocated ? VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED : VMA_MEMORY_USAGE_GPU_ONLY;
+
+    VmaAllocationInfo allocationInfo = {};
+    err = vmaAllocateMemory(allocator, &requirements, &allocationCreateInfo, pAllocation, &allocationInfo);
+    VK_CHECK_ERROR(err);
+
+    _TrackAllocation(MEMORY_CATEGORY_RENDER_TARGET, allocationInfo.size, 1);
+
+    return VK_SUCCESS;
+}
+
+void RenderDriver::FreeMemory(VmaAllocation allocation)
+{
+    VmaAllocationInfo allocationInfo = {};
+    vmaGetAllocationInfo(allocator, allocation, &allocationInfo);
+
+    _TrackAllocation(MEMORY_CATEGORY_RENDER_TARGET, allocationInfo.size, -1);
+    vmaFreeMemory(allocator, allocation);
+}
+
+VkBool32 RenderDriver::HasLazilyAllocatedMemory() const
+{
+    const VkPhysicalDeviceMemoryProperties* memoryProperties = VK_NULL_HANDLE;
+    vmaGetMemoryProperties(allocator, &memoryProperties);
+
+    for (uint32_t i = 0; i < memoryProperties->memoryTypeCount; i++) {
+        if (memoryProperties->memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)
+            return VK_TRUE;
+    }
+
+    return VK_FALSE;
+}
+
+VkResult RenderDriver::CreateSampler(VkFilter filter, VkSamplerAddressMode addressMode, VkSampler* pSampler)
+{
+    VkSamplerCreateInfo samplerCreateInfo = {};
+    samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerCreateInfo.magFilter = filter;
+    samplerCreateInfo.minFilter = filter;
+    samplerCreateInfo.mipmapMode = filter == VK_FILTER_LINEAR ? VK_SAMPLER_MIPMAP_MODE_LINEAR : VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerCreateInfo.addressModeU = addressMode;
+    samplerCreateInfo.addressModeV = addressMode;
+    samplerCreateInfo.addressModeW = addressMode;
+    samplerCreateInfo.minLod = 0.0f;
+    samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+    return vkCreateSampler(device, &samplerCreateInfo, VK_NULL_HANDLE, pSampler);
+}
+
+VkResult RenderDriver::CreateComparisonSampler(VkCompareOp compareOp, VkSampler* pSampler)
+{
+    VkSamplerCreateInfo samplerCreateInfo = {};
+    samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+    samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+    samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.compareEnable = VK_TRUE;
+    samplerCreateInfo.compareOp = compareOp;
+    samplerCreateInfo.minLod = 0.0f;
+    samplerCreateInfo.maxLod = 0.0f;
+
+    return vkCreateSampler(device, &samplerCreateInfo, VK_NULL_HANDLE, pSampler);
+}
+
+void RenderDriver::DestroySampler(VkSampler sampler)
+{
+    vkDestroySampler(device, sampler, VK_NULL_HANDLE);
+}
+
 VkResult RenderDriver::CreatePipeline(const char *shaderName, Pipeline* pPipeline)
 {
+    GraphicsPipelineCreateInfo createInfo = {};
+    createInfo.shaderName = shaderName;
+
+    return CreateGraphicsPipeline(createInfo, pPipeline);
+}
+
+VkResult RenderDriver::CreateGraphicsPipeline(const GraphicsPipelineCreateInfo& createInfo, Pipeline* pPipeline)
+{
+    QK_PROFILE_ZONE("CreateGraphicsPipeline");
+
     VkResult err;
+    const char* shaderName = createInfo.shaderName;
+    const char* fragmentShaderName = createInfo.fragmentShaderName != VK_NULL_HANDLE ? createInfo.fragmentShaderName : shaderName;
+
+    if (createInfo.pushConstantSize > physicalDeviceProperties.limits.maxPushConstantsSize) {
+        printf("[vulkan] push constant size %u exceeds device limit %u\n", createInfo.pushConstantSize, physicalDeviceProperties.limits.maxPushConstantsSize);
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    /* VkDescriptorSetLayout，没有 binding 时不创建 set */
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+
+    if (createInfo.bindingCount > 0) {
+        VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = {};
+        descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        descriptorSetLayoutCreateInfo.bindingCount = createInfo.bindingCount;
+        descriptorSetLayoutCreateInfo.pBindings = createInfo.pBindings;
+
+        err = vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, VK_NULL_HANDLE, &descriptorSetLayout);
+        VK_CHECK_ERROR(err);
+    }
 
     /* VkPipelineLayoutCreateInfo */
     VkPushConstantRange pushConstantRange = {};
-    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstantRange.stageFlags = createInfo.pushConstantStages;
     pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(float) * 16;
+    pushConstantRange.size = createInfo.pushConstantSize;
 
     VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 0;
-    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.setLayoutCount = descriptorSetLayout != VK_NULL_HANDLE ? 1 : 0;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = createInfo.pushConstantSize > 0 ? 1 : 0;
     pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
     VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
     err = vkCreatePipelineLayout(device, &pipelineLayoutInfo, VK_NULL_HANDLE, &pipelineLayout);
-    VK_CHECK_ERROR(err);
+    if (err != VK_SUCCESS) {
+        _DestroyPipelineLayouts(pipelineLayout, descriptorSetLayout);
+        return err;
+    }
 
-    /* shader module */
-    VkShaderModule vertexShaderModule = VK_NULL_HANDLE;
-    VkShaderModule fragmentShaderModule = VK_NULL_HANDLE;
+    /* shader stage，模块由着色器缓存持有，多个管线共享 */
+    ShaderCacheEntry* shaderEntries[2] = {};
 
-    err = _CreateShaderModule(shaderName, "vert", &vertexShaderModule);
-    VK_CHECK_ERROR(err);
+    err = _AcquireShaderModule(shaderName, "vert", VK_FALSE, &shaderEntries[0]);
+    if (err != VK_SUCCESS) {
+        _DestroyPipelineLayouts(pipelineLayout, descriptorSetLayout);
+        return err;
+    }
 
-    err = _CreateShaderModule(shaderName, "frag", &fragmentShaderModule);
-    VK_CHECK_ERROR(err);
+    /* 纯深度管线没有片元着色器 */
+    const uint32_t stageCount = createInfo.depthOnly ? 1 : 2;
 
-    /* VkPipelineShaderStageCreateInfo */
-    VkPipelineShaderStageCreateInfo shaderStagesCreateInfo[] = {
-        {
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-            .stage = VK_SHADER_STAGE_VERTEX_BIT,
-            .module = vertexShaderModule,
-            .pName = "main",
-        },
-        {
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-            .module = fragmentShaderModule,
-            .pName = "main",
+    if (!createInfo.depthOnly) {
+        err = _AcquireShaderModule(fragmentShaderName, "frag", VK_FALSE, &shaderEntries[1]);
+        if (err != VK_SUCCESS) {
+            _DestroyPipelineLayouts(pipelineLayout, descriptorSetLayout);
+            return err;
         }
-    };
+    }
+
+    const VkShaderStageFlagBits shaderStages[2] = { VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT };
+    VkShaderModuleCreateInfo shaderModuleCreateInfos[2] = {};
+    VkPipelineShaderStageModuleIdentifierCreateInfoEXT shaderIdentifierCreateInfos[2] = {};
+    VkPipelineShaderStageCreateInfo shaderStagesCreateInfo[2] = {};
 
     /* VkVertexInputAttributeDescription */
     VkVertexInputAttributeDescription vertexInputAttributeDescriptions[] = {
@@ -282,6 +792,10 @@ VkResult RenderDriver::CreatePipeline(const char *shaderName, Pipeline* pPipelin
     vertexInputStateCreateInfo.vertexAttributeDescriptionCount = ARRAY_SIZE(vertexInputAttributeDescriptions);
     vertexInputStateCreateInfo.pVertexAttributeDescriptions = &vertexInputAttributeDescriptions[0];
 
+    const VkPipelineVertexInputStateCreateInfo* pVertexInputState = createInfo.pVertexInputState != VK_NULL_HANDLE
+        ? createInfo.pVertexInputState
+        : &vertexInputStateCreateInfo;
+
     /* VkPipelineInputAssemblyStateCreateInfo */
     VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo = {};
     inputAssemblyStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -301,12 +815,12 @@ VkResult RenderDriver::CreatePipeline(const char *shaderName, Pipeline* pPipelin
     rasterizationStateCreateInfo.rasterizerDiscardEnable = VK_FALSE;            // 不丢弃几何体
     rasterizationStateCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;            // 填充多边形方式点、线、面
     rasterizationStateCreateInfo.lineWidth = 1.0f;                              // 线宽
-    rasterizationStateCreateInfo.cullMode = VK_CULL_MODE_BACK_BIT;              // 背面剔除，可改 NONE 或 FRONT
+    rasterizationStateCreateInfo.cullMode = createInfo.cullMode;                // 默认背面剔除
     rasterizationStateCreateInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;           // 前向面定义
-    rasterizationStateCreateInfo.depthBiasEnable = VK_FALSE;                    // 不使用深度偏移
-    rasterizationStateCreateInfo.depthBiasConstantFactor = 0.0f;
+    rasterizationStateCreateInfo.depthBiasEnable = createInfo.depthBiasConstant != 0.0f || createInfo.depthBiasSlope != 0.0f;
+    rasterizationStateCreateInfo.depthBiasConstantFactor = createInfo.depthBiasConstant;
     rasterizationStateCreateInfo.depthBiasClamp = 0.0f;
-    rasterizationStateCreateInfo.depthBiasSlopeFactor = 0.0f;
+    rasterizationStateCreateInfo.depthBiasSlopeFactor = createInfo.depthBiasSlope;
 
     /* VkPipelineMultisampleStateCreateInfo */
     VkPipelineMultisampleStateCreateInfo multisampleStateCreateInfo = {};
@@ -318,18 +832,37 @@ VkResult RenderDriver::CreatePipeline(const char *shaderName, Pipeline* pPipelin
     multisampleStateCreateInfo.alphaToCoverageEnable = VK_FALSE;                // alpha to coverage 禁用
     multisampleStateCreateInfo.alphaToOneEnable = VK_FALSE;                     // alphaToOne 禁用
 
+    /* VkPipelineDepthStencilStateCreateInfo */
+    VkPipelineDepthStencilStateCreateInfo depthStencilStateCreateInfo = {};
+    depthStencilStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencilStateCreateInfo.depthTestEnable = VK_TRUE;
+    depthStencilStateCreateInfo.depthWriteEnable = createInfo.depthWriteEnable;
+    depthStencilStateCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;     // 深度清除为 1.0，近处覆盖远处
+    depthStencilStateCreateInfo.depthBoundsTestEnable = VK_FALSE;
+    depthStencilStateCreateInfo.stencilTestEnable = VK_FALSE;
+    depthStencilStateCreateInfo.minDepthBounds = 0.0f;
+    depthStencilStateCreateInfo.maxDepthBounds = 1.0f;
+
     /* VkPipelineColorBlendStateCreateInfo */
     VkPipelineColorBlendAttachmentState colorBlendAttachmentStage = {};
     colorBlendAttachmentStage.colorWriteMask =
         VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
         VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    colorBlendAttachmentStage.blendEnable = VK_FALSE;                           // 关闭混合
+    colorBlendAttachmentStage.blendEnable = createInfo.blendMode != PIPELINE_BLEND_MODE_OPAQUE;
+    colorBlendAttachmentStage.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    colorBlendAttachmentStage.dstColorBlendFactor = createInfo.blendMode == PIPELINE_BLEND_MODE_ADDITIVE
+        ? VK_BLEND_FACTOR_ONE
+        : VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colorBlendAttachmentStage.colorBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachmentStage.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachmentStage.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colorBlendAttachmentStage.alphaBlendOp = VK_BLEND_OP_ADD;
 
     VkPipelineColorBlendStateCreateInfo colorBlendStateCreateInfo = {};
     colorBlendStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
     colorBlendStateCreateInfo.logicOpEnable = VK_FALSE;                         // 不使用逻辑操作
     colorBlendStateCreateInfo.logicOp = VK_LOGIC_OP_COPY;                       // 无效，因为逻辑操作关闭
-    colorBlendStateCreateInfo.attachmentCount = 1;
+    colorBlendStateCreateInfo.attachmentCount = createInfo.depthOnly ? 0 : 1;
     colorBlendStateCreateInfo.pAttachments = &colorBlendAttachmentStage;
     colorBlendStateCreateInfo.blendConstants[0] = 0.0f;
     colorBlendStateCreateInfo.blendConstants[1] = 0.0f;
@@ -348,46 +881,120 @@ VkResult RenderDriver::CreatePipeline(const char *shaderName, Pipeline* pPipelin
     dynamicStateCreateInfo.pDynamicStates = &dynamicStates[0];
 
     /* dynamic rendering */
+    const VkFormat attachmentDepthFormat = createInfo.depthFormat != VK_FORMAT_UNDEFINED ? createInfo.depthFormat : depthFormat;
+    const VkFormat attachmentColorFormat = createInfo.colorFormat != VK_FORMAT_UNDEFINED ? createInfo.colorFormat : surfaceFormat.format;
+
     VkPipelineRenderingCreateInfo pipelineRenderingInfo = {};
     pipelineRenderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
-    pipelineRenderingInfo.colorAttachmentCount = 1;
-    pipelineRenderingInfo.pColorAttachmentFormats = &surfaceFormat.format;
+    pipelineRenderingInfo.viewMask = createInfo.viewMask;
+    pipelineRenderingInfo.colorAttachmentCount = createInfo.depthOnly ? 0 : 1;
+    pipelineRenderingInfo.pColorAttachmentFormats = &attachmentColorFormat;
+    pipelineRenderingInfo.depthAttachmentFormat = attachmentDepthFormat;
+    if (VkUtils::HasStencilComponent(attachmentDepthFormat))
+        pipelineRenderingInfo.stencilAttachmentFormat = attachmentDepthFormat;
 
     VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
     pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
     pipelineCreateInfo.pNext = &pipelineRenderingInfo;
-    pipelineCreateInfo.stageCount = std::size(shaderStagesCreateInfo);
+    pipelineCreateInfo.stageCount = stageCount;
     pipelineCreateInfo.pStages = shaderStagesCreateInfo;
-    pipelineCreateInfo.pVertexInputState = &vertexInputStateCreateInfo;
+    pipelineCreateInfo.pVertexInputState = pVertexInputState;
     pipelineCreateInfo.pInputAssemblyState = &inputAssemblyStateCreateInfo;
     pipelineCreateInfo.pTessellationState = VK_NULL_HANDLE;
     pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
     pipelineCreateInfo.pRasterizationState = &rasterizationStateCreateInfo;
     pipelineCreateInfo.pMultisampleState = &multisampleStateCreateInfo;
-    pipelineCreateInfo.pDepthStencilState = VK_NULL_HANDLE;
+    pipelineCreateInfo.pDepthStencilState = &depthStencilStateCreateInfo;
     pipelineCreateInfo.pColorBlendState = &colorBlendStateCreateInfo;
     pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
     pipelineCreateInfo.layout = pipelineLayout;
 
     VkPipeline pipeline = VK_NULL_HANDLE;
-    err = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, VK_NULL_HANDLE, &pipeline);
-    VK_CHECK_ERROR(err);
 
-    vkDestroyShaderModule(device, vertexShaderModule, VK_NULL_HANDLE);
-    vkDestroyShaderModule(device, fragmentShaderModule, VK_NULL_HANDLE);
+    /* SPIR-V 已经释放时先只凭标识符从管线缓存中取，需要编译时再重新加载着色器 */
+    std::unique_lock<std::mutex> lock(shaderCacheMutex);
+    VkBool32 useIdentifiers = _CanUseShaderIdentifiers(shaderEntries, stageCount);
+    if (useIdentifiers)
+        for (uint32_t i = 0; i < stageCount; i++)
+            _FillShaderStage(shaderEntries[i], shaderStages[i], VK_TRUE, &shaderModuleCreateInfos[i], &shaderIdentifierCreateInfos[i], &shaderStagesCreateInfo[i]);
+    lock.unlock();
+
+    /* 特化常量在管线编译时折叠，关闭的分支由驱动直接剔除 */
+    for (uint32_t i = 0; i < stageCount; i++)
+        shaderStagesCreateInfo[i].pSpecializationInfo = createInfo.pSpecializationInfo;
+
+    if (useIdentifiers) {
+        pipelineCreateInfo.flags = VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT;
+        err = vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, VK_NULL_HANDLE, &pipeline);
+        pipelineCreateInfo.flags = 0;
+
+        lock.lock();
+        if (err == VK_SUCCESS) {
+            shaderCacheStatistics.identifierPipelines++;
+        } else if (err == VK_PIPELINE_COMPILE_REQUIRED) {
+            shaderCacheStatistics.identifierFallbacks++;
+            pipeline = VK_NULL_HANDLE;
+        } else {
+            _DestroyPipelineLayouts(pipelineLayout, descriptorSetLayout);
+            return err;
+        }
+        lock.unlock();
+    }
+
+    if (pipeline == VK_NULL_HANDLE) {
+        const char* stageShaderNames[2] = { shaderName, fragmentShaderName };
+        const char* stageNames[2] = { "vert", "frag" };
+        for (uint32_t i = 0; i < stageCount; i++) {
+            err = _AcquireShaderModule(stageShaderNames[i], stageNames[i], VK_TRUE, &shaderEntries[i]);
+            if (err != VK_SUCCESS) {
+                _DestroyPipelineLayouts(pipelineLayout, descriptorSetLayout);
+                return err;
+            }
+
+            lock.lock();
+            _FillShaderStage(shaderEntries[i], shaderStages[i], VK_FALSE, &shaderModuleCreateInfos[i], &shaderIdentifierCreateInfos[i], &shaderStagesCreateInfo[i]);
+            lock.unlock();
+
+            shaderStagesCreateInfo[i].pSpecializationInfo = createInfo.pSpecializationInfo;
+        }
+
+        err = vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, VK_NULL_HANDLE, &pipeline);
+        if (err != VK_SUCCESS) {
+            _DestroyPipelineLayouts(pipelineLayout, descriptorSetLayout);
+            return err;
+        }
+    }
 
     Pipeline ret = (Pipeline) malloc(sizeof(Pipeline_T));
     ret->vkPipeline = pipeline;
     ret->vkPipelineLayout = pipelineLayout;
+    ret->vkDescriptorSetLayout = descriptorSetLayout;
+    ret->vkBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     *pPipeline = ret;
 
     return err;
 }
 
+VkBuffer RenderDriver::GetVkBuffer(Buffer buffer)
+{
+    return buffer->vkBuffer;
+}
+
+VkPipeline RenderDriver::GetVkPipeline(Pipeline pipeline)
+{
+    return pipeline->vkPipeline;
+}
+
+VkPipelineLayout RenderDriver::GetVkPipelineLayout(Pipeline pipeline)
+{
+    return pipeline->vkPipelineLayout;
+}
+
 void RenderDriver::DestroyPipeline(Pipeline pipeline)
 {
     vkDestroyPipeline(device, pipeline->vkPipeline, VK_NULL_HANDLE);
     vkDestroyPipelineLayout(device, pipeline->vkPipelineLayout, VK_NULL_HANDLE);
+    vkDestroyDescriptorSetLayout(device, pipeline->vkDescriptorSetLayout, VK_NULL_HANDLE);
     free(pipeline);
 }
 
@@ -423,12 +1030,12 @@ void RenderDriver::BeginCommandBuffer(VkCommandBuffer commandBuffer)
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    deviceTable.vkBeginCommandBuffer(commandBuffer, &beginInfo);
 }
 
 void RenderDriver::EndCommandBuffer(VkCommandBuffer commandBuffer)
 {
-    vkEndCommandBuffer(commandBuffer);
+    deviceTable.vkEndCommandBuffer(commandBuffer);
 }
 
 void RenderDriver::CmdTextureMemoryBarrier(VkCommandBuffer commandBuffer, Texture2D texture, VkImageLayout newLayout)
@@ -456,11 +1063,63 @@ void RenderDriver::CmdTextureMemoryBarrier(VkCommandBuffer commandBuffer, Textur
         goto DO_MEMORY_IAMGE_BARRIER_TAG;
     }
 
-    if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
+    if (oldLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+        /* 局部更新，WAR：等待之前的采样结束 */
         srcAccessMask = 0;
-        dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        goto DO_MEMORY_IAMGE_BARRIER_TAG;
+    }
+
+    if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
+        /* 丢弃旧内容，但仍需等待上一帧的深度写入完成 (WAW) */
+        srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        goto DO_MEMORY_IAMGE_BARRIER_TAG;
+    }
+
+    if (oldLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+        srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        goto DO_MEMORY_IAMGE_BARRIER_TAG;
+    }
+
+    if (oldLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
+        /* WAR：只需要执行依赖 */
+        srcAccessMask = 0;
+        dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        goto DO_MEMORY_IAMGE_BARRIER_TAG;
+    }
+
+    if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL) {
+        /* 上一帧的 blit 还在读 (WAR) */
+        srcAccessMask = 0;
+        dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        goto DO_MEMORY_IAMGE_BARRIER_TAG;
+    }
+
+    if (oldLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+        srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        goto DO_MEMORY_IAMGE_BARRIER_TAG;
+    }
+
+    if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_GENERAL) {
+        srcAccessMask = 0;
+        dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
         srcStageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
         goto DO_MEMORY_IAMGE_BARRIER_TAG;
     }
 
@@ -468,40 +1127,129 @@ void RenderDriver::CmdTextureMemoryBarrier(VkCommandBuffer commandBuffer, Textur
     return;
 
 DO_MEMORY_IAMGE_BARRIER_TAG:
+    CmdTextureMemoryBarrier(commandBuffer, texture, newLayout, VK_FALSE, srcStageMask, srcAccessMask, dstStageMask, dstAccessMask);
+}
+
+void RenderDriver::CmdTextureMemoryBarrier(VkCommandBuffer commandBuffer, Texture2D texture, VkImageLayout newLayout, VkBool32 discard,
+                                           VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask,
+                                           VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask)
+{
     VkImageMemoryBarrier barrier = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
         .srcAccessMask = srcAccessMask,
         .dstAccessMask = dstAccessMask,
-        .oldLayout = oldLayout,
+        .oldLayout = discard ? VK_IMAGE_LAYOUT_UNDEFINED : texture->layout,
         .newLayout = newLayout,
         .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
         .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
         .image = texture->vkImage,
         .subresourceRange = {
-            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .aspectMask = texture->aspectMask,
             .baseMipLevel = 0,
-            .levelCount = 1,
+            .levelCount = texture->mipLevels,
             .baseArrayLayer = 0,
-            .layerCount = 1,
+            .layerCount = texture->arrayLayers,
         }
     };
 
-    vkCmdPipelineBarrier(commandBuffer,
-                         srcStageMask,
-                         dstStageMask,
-                         0,
-                         0, VK_NULL_HANDLE,
-                         0, VK_NULL_HANDLE,
-                         1, &barrier);
+    deviceTable.vkCmdPipelineBarrier(commandBuffer,
+                                     srcStageMask,
+                                     dstStageMask,
+                                     0,
+                                     0, VK_NULL_HANDLE,
+                                     0, VK_NULL_HANDLE,
+                                     1, &barrier);
 
     texture->layout = newLayout;
 }
 
+void RenderDriver::CmdMemoryBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask)
+{
+    VkMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = srcAccessMask,
+        .dstAccessMask = dstAccessMask,
+    };
+
+    deviceTable.vkCmdPipelineBarrier(commandBuffer,
+                                     srcStageMask,
+                                     dstStageMask,
+                                     0,
+                                     1, &barrier,
+                                     0, VK_NULL_HANDLE,
+                                     0, VK_NULL_HANDLE);
+}
+
+void RenderDriver::CmdFillBuffer(VkCommandBuffer commandBuffer, Buffer buffer, VkDeviceSize offset, VkDeviceSize size, uint32_t data)
+{
+    deviceTable.vkCmdFillBuffer(commandBuffer, buffer->vkBuffer, offset, size, data);
+}
+
+void RenderDriver::CmdUpdateBuffer(VkCommandBuffer commandBuffer, Buffer buffer, VkDeviceSize offset, VkDeviceSize size, const void* data)
+{
+    deviceTable.vkCmdUpdateBuffer(commandBuffer, buffer->vkBuffer, offset, size, data);
+}
+
+void RenderDriver::CmdCopyBuffer(VkCommandBuffer commandBuffer, Buffer srcBuffer, VkDeviceSize srcOffset, Buffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize size)
+{
+    VkBufferCopy region = { srcOffset, dstOffset, size };
+    deviceTable.vkCmdCopyBuffer(commandBuffer, srcBuffer->vkBuffer, dstBuffer->vkBuffer, 1, &region);
+}
+
+void RenderDriver::CmdCopyTexture2D(VkCommandBuffer commandBuffer, Texture2D srcTexture, Texture2D dstTexture, const VkRect2D& region)
+{
+    VkImageCopy copyRegion = {
+        .srcSubresource = { srcTexture->aspectMask, 0, 0, 1 },
+        .srcOffset = { region.offset.x, region.offset.y, 0 },
+        .dstSubresource = { dstTexture->aspectMask, 0, 0, 1 },
+        .dstOffset = { region.offset.x, region.offset.y, 0 },
+        .extent = { region.extent.width, region.extent.height, 1 },
+    };
+
+    deviceTable.vkCmdCopyImage(commandBuffer,
+                               srcTexture->vkImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                               dstTexture->vkImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               1, &copyRegion);
+}
+
+void RenderDriver::CmdCopyBufferToTexture2D(VkCommandBuffer commandBuffer, Buffer buffer, VkDeviceSize bufferOffset, Texture2D texture, uint32_t mipLevel, uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t layer)
+{
+    VkBufferImageCopy copyRegion = {
+        .bufferOffset = bufferOffset,
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .mipLevel = mipLevel,
+            .baseArrayLayer = layer,
+            .layerCount = 1,
+        },
+        .imageOffset = { static_cast<int32_t>(x), static_cast<int32_t>(y), 0 },
+        .imageExtent = { w, h, 1 }
+    };
+
+    deviceTable.vkCmdCopyBufferToImage(commandBuffer, buffer->vkBuffer, texture->vkImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+}
+
 void RenderDriver::CmdBeginRendering(VkCommandBuffer commandBuffer)
 {
+    if (timestampQueryPool != VK_NULL_HANDLE) {
+        deviceTable.vkCmdResetQueryPool(commandBuffer, timestampQueryPool, flightIndex * 2, 2);
+        deviceTable.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool, flightIndex * 2);
+    }
+
+    /* 颜色与深度每帧清除，旧内容可以直接丢弃 */
+    if (depthTexture->layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL)
+        depthTexture->layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    sceneColor->layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    CmdTextureMemoryBarrier(commandBuffer, depthTexture, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+    CmdTextureMemoryBarrier(commandBuffer, sceneColor, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+
     VkRenderingAttachmentInfo colorRenderingAttachment = {
         .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
-        .imageView = swapchainImageViews[imageIndex],
+        .imageView = sceneColor->vkImageView,
         .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
         .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
         .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
@@ -510,70 +1258,241 @@ void RenderDriver::CmdBeginRendering(VkCommandBuffer commandBuffer)
         }
     };
 
+    VkRenderingAttachmentInfo depthRenderingAttachment = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+        .imageView = depthTexture->vkImageView,
+        .imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,        // Hi-Z 需要读取本帧深度
+        .clearValue = {
+            .depthStencil = { 1.0f, 0 }
+        }
+    };
+
+    /* 场景只渲染到内部目标左上角 renderExtent2D 大小的区域 */
     VkRenderingInfo renderingInfo = {
         .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
         .renderArea = {
             .offset = { 0, 0 },
-            .extent = swapchainExtent2D
+            .extent = renderExtent2D
         },
         .layerCount = 1,
         .colorAttachmentCount = 1,
-        .pColorAttachments = &colorRenderingAttachment
+        .pColorAttachments = &colorRenderingAttachment,
+        .pDepthAttachment = &depthRenderingAttachment,
+        .pStencilAttachment = VkUtils::HasStencilComponent(depthFormat) ? &depthRenderingAttachment : VK_NULL_HANDLE,
     };
 
-    vkCmdBeginRendering(commandBuffer, &renderingInfo);
+    deviceTable.vkCmdBeginRendering(commandBuffer, &renderingInfo);
+    currentRenderArea = { { 0, 0 }, renderExtent2D };
 }
 
 void RenderDriver::CmdEndRendering(VkCommandBuffer commandBuffer)
 {
-    vkCmdEndRendering(commandBuffer);
+    deviceTable.vkCmdEndRendering(commandBuffer);
 
-    VkImageMemoryBarrier imageMemoryBarrier = {
-        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-        .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-        .dstAccessMask = 0,
-        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-        .image = swapchainImages[imageIndex],
-        .subresourceRange = {
-            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-            .baseMipLevel = 0,
-            .levelCount = 1,
-            .baseArrayLayer = 0,
-            .layerCount = 1,
+    /* 放大到 swapchain 分辨率 */
+    CmdTextureMemoryBarrier(commandBuffer, sceneColor, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+    if (headless) {
+        if (timestampQueryPool != VK_NULL_HANDLE) {
+            deviceTable.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool, flightIndex * 2 + 1);
+            timestampsWritten[flightIndex] = VK_TRUE;
         }
+        return;
+    }
+
+    _CmdImageBarrier(commandBuffer, swapchainImages[imageIndex],
+                     VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                     VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+    VkImageBlit blitRegion = {
+        .srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+        .srcOffsets = {
+            { 0, 0, 0 },
+            { static_cast<int32_t>(renderExtent2D.width), static_cast<int32_t>(renderExtent2D.height), 1 }
+        },
+        .dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+        .dstOffsets = {
+            { 0, 0, 0 },
+            { static_cast<int32_t>(swapchainExtent2D.width), static_cast<int32_t>(swapchainExtent2D.height), 1 }
+        },
+    };
+
+    deviceTable.vkCmdBlitImage(commandBuffer,
+                               sceneColor->vkImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                               swapchainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               1, &blitRegion,
+                               VK_FILTER_LINEAR);
+
+    _CmdImageBarrier(commandBuffer, swapchainImages[imageIndex],
+                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                     VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+
+    if (timestampQueryPool != VK_NULL_HANDLE) {
+        deviceTable.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool, flightIndex * 2 + 1);
+        timestampsWritten[flightIndex] = VK_TRUE;
+    }
+}
+
+void RenderDriver::CmdBeginOverlayRendering(VkCommandBuffer commandBuffer, VkRenderingFlags flags)
+{
+    /* UI 等叠加层始终以 swapchain 原生分辨率绘制，flags 可指定内容来自 secondary command buffer */
+    VkRenderingAttachmentInfo colorRenderingAttachment = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+        .imageView = swapchainImageViews[imageIndex],
+        .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .loadOp = VK_ATTACHMENT_LOAD_OP_LOAD,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+    };
+
+    VkRenderingInfo renderingInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+        .flags = flags,
+        .renderArea = {
+            .offset = { 0, 0 },
+            .extent = swapchainExtent2D
+        },
+        .layerCount = 1,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &colorRenderingAttachment,
     };
 
-    vkCmdPipelineBarrier(commandBuffer,
-                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-                         VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                         0,
-                         0, VK_NULL_HANDLE,
-                         0, VK_NULL_HANDLE,
-                         1, &imageMemoryBarrier);
+    deviceTable.vkCmdBeginRendering(commandBuffer, &renderingInfo);
+    currentRenderArea = { { 0, 0 }, swapchainExtent2D };
+}
+
+void RenderDriver::CmdEndOverlayRendering(VkCommandBuffer commandBuffer)
+{
+    deviceTable.vkCmdEndRendering(commandBuffer);
+
+    _CmdImageBarrier(commandBuffer, swapchainImages[imageIndex],
+                     VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                     VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                     VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
 }
 
 void RenderDriver::CmdBindPipeline(VkCommandBuffer commandBuffer, Pipeline pipeline)
 {
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->vkPipeline);
+    deviceTable.vkCmdBindPipeline(commandBuffer, pipeline->vkBindPoint, pipeline->vkPipeline);
+
+    if (pipeline->vkBindPoint != VK_PIPELINE_BIND_POINT_GRAPHICS)
+        return;
+
+    CmdSetViewportScissor(commandBuffer);
+}
+
+void RenderDriver::CmdBeginDepthRendering(VkCommandBuffer commandBuffer, Texture2D depth, const VkRect2D& area, VkBool32 clear)
+{
+    /* CLEAR 只作用于 renderArea，区域外的内容保留 */
+    VkRenderingAttachmentInfo depthRenderingAttachment = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+        .imageView = depth->vkImageView,
+        .imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        .loadOp = clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .clearValue = {
+            .depthStencil = { 1.0f, 0 }
+        }
+    };
+
+    VkRenderingInfo renderingInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+        .renderArea = area,
+        .layerCount = 1,
+        .colorAttachmentCount = 0,
+        .pColorAttachments = VK_NULL_HANDLE,
+        .pDepthAttachment = &depthRenderingAttachment,
+        .pStencilAttachment = VkUtils::HasStencilComponent(depth->format) ? &depthRenderingAttachment : VK_NULL_HANDLE,
+    };
+
+    deviceTable.vkCmdBeginRendering(commandBuffer, &renderingInfo);
+    currentRenderArea = area;
+}
+
+void RenderDriver::CmdEndDepthRendering(VkCommandBuffer commandBuffer)
+{
+    deviceTable.vkCmdEndRendering(commandBuffer);
+}
+
+void RenderDriver::CmdBeginMultiviewRendering(VkCommandBuffer commandBuffer, Texture2D color, Texture2D depth, uint32_t viewMask, VkBool32 clear)
+{
+    assert(multiviewSupported && viewMask != 0);
+
+    const VkAttachmentLoadOp loadOp = clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+
+    VkRenderingAttachmentInfo colorRenderingAttachment = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+        .imageView = color != VK_NULL_HANDLE ? color->vkImageView : VK_NULL_HANDLE,
+        .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .loadOp = loadOp,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .clearValue = {
+            .color = { 0.0f, 0.0f, 0.0f, 1.0f }
+        }
+    };
+
+    VkRenderingAttachmentInfo depthRenderingAttachment = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+        .imageView = depth != VK_NULL_HANDLE ? depth->vkImageView : VK_NULL_HANDLE,
+        .imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        .loadOp = loadOp,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .clearValue = {
+            .depthStencil = { 1.0f, 0 }
+        }
+    };
+
+    Texture2D reference = color != VK_NULL_HANDLE ? color : depth;
+    const VkRect2D area = { { 0, 0 }, { reference->width, reference->height } };
+
+    /* viewMask 非 0 时 layerCount 被忽略，视图数量由 viewMask 决定 */
+    VkRenderingInfo renderingInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+        .renderArea = area,
+        .layerCount = 1,
+        .viewMask = viewMask,
+        .colorAttachmentCount = color != VK_NULL_HANDLE ? 1u : 0u,
+        .pColorAttachments = color != VK_NULL_HANDLE ? &colorRenderingAttachment : VK_NULL_HANDLE,
+        .pDepthAttachment = depth != VK_NULL_HANDLE ? &depthRenderingAttachment : VK_NULL_HANDLE,
+        .pStencilAttachment = depth != VK_NULL_HANDLE && VkUtils::HasStencilComponent(depth->format) ? &depthRenderingAttachment : VK_NULL_HANDLE,
+    };
+
+    deviceTable.vkCmdBeginRendering(commandBuffer, &renderingInfo);
+    currentRenderArea = area;
+}
+
+void RenderDriver::CmdEndMultiviewRendering(VkCommandBuffer commandBuffer)
+{
+    deviceTable.vkCmdEndRendering(commandBuffer);
+}
 
+void RenderDriver::CmdSetViewportScissor(VkCommandBuffer commandBuffer)
+{
     VkViewport viewport = {
-        .x = 0,
-        .y = 0,
-        .width = static_cast<float>(swapchainExtent2D.width),
-        .height = static_cast<float>(swapchainExtent2D.height),
+        .x = static_cast<float>(currentRenderArea.offset.x),
+        .y = static_cast<float>(currentRenderArea.offset.y),
+        .width = static_cast<float>(currentRenderArea.extent.width),
+        .height = static_cast<float>(currentRenderArea.extent.height),
         .minDepth = 0.0f,
         .maxDepth = 1.0f
     };
 
-    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    deviceTable.vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    deviceTable.vkCmdSetScissor(commandBuffer, 0, 1, &currentRenderArea);
+}
 
-    VkRect2D scissor = {
-        .offset = { 0, 0 },
-        .extent = swapchainExtent2D,
-    };
+void RenderDriver::CmdBindDescriptorSet(VkCommandBuffer commandBuffer, Pipeline pipeline, VkDescriptorSet descriptorSet)
+{
+    deviceTable.vkCmdBindDescriptorSets(commandBuffer, pipeline->vkBindPoint, pipeline->vkPipelineLayout, 0, 1, &descriptorSet, 0, VK_NULL_HANDLE);
+}
 
-    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+void RenderDriver::CmdBindDescriptorSet(VkCommandBuffer commandBuffer, Pipeline pipeline, VkDescriptorSet descriptorSet, uint32_t dynamicOffsetCount, const uint32_t* pDynamicOffsets)
+{
+    /* 动态偏移按 binding 序号顺序给出 */
+    deviceTable.vkCmdBindDescriptorSets(commandBuffer, pipeline->vkBindPoint, pipeline->vkPipelineLayout, 0, 1, &descriptorSet, dynamicOffsetCount, pDynamicOffsets);
 }
 
 void RenderDriver::CmdBindVertexBuffer(VkCommandBuffer commandBuffer, Buffer buffer, VkDeviceSize offset)
@@ -588,112 +1507,401 @@ void RenderDriver::CmdBindVertexBuffers(VkCommandBuffer commandBuffer, uint32_t
     for (uint32_t i = 0; i < count; i++)
         buffers[i] = pBuffers[i]->vkBuffer;
 
-    vkCmdBindVertexBuffers(commandBuffer, 0, count, std::data(buffers), pOffsets);
+    deviceTable.vkCmdBindVertexBuffers(commandBuffer, 0, count, std::data(buffers), pOffsets);
+}
+
+void RenderDriver::CmdBindIndexBuffer(VkCommandBuffer commandBuffer, Buffer buffer, VkDeviceSize offset, VkIndexType indexType)
+{
+    deviceTable.vkCmdBindIndexBuffer(commandBuffer, buffer->vkBuffer, offset, indexType);
 }
 
 void RenderDriver::CmdPushConstants(VkCommandBuffer commandBuffer, Pipeline pipeline, VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size, const void *data)
 {
-    vkCmdPushConstants(commandBuffer, pipeline->vkPipelineLayout, stageFlags, offset, size, data);
+    deviceTable.vkCmdPushConstants(commandBuffer, pipeline->vkPipelineLayout, stageFlags, offset, size, data);
 }
 
 void RenderDriver::CmdDraw(VkCommandBuffer commandBuffer, uint32_t vertexCount)
 {
-    vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+    deviceTable.vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
 }
 
-void RenderDriver::SubmitQueue(VkCommandBuffer commandBuffer, VkSemaphore waitSemaphore, VkSemaphore signalSemaphore, VkFence fence)
+void RenderDriver::CmdDraw(VkCommandBuffer commandBuffer, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
 {
-    VkResult err;
+    deviceTable.vkCmdDraw(commandBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
+}
 
-    if (fence != VK_NULL_HANDLE)
-        vkResetFences(device, 1, &fence);
+void RenderDriver::CmdDrawIndexed(VkCommandBuffer commandBuffer, uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance)
+{
+    deviceTable.vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+}
 
-    VkSubmitInfo submitInfo = {};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+void RenderDriver::CmdDrawIndirect(VkCommandBuffer commandBuffer, Buffer buffer, VkDeviceSize offset, uint32_t drawCount)
+{
+    const uint32_t stride = sizeof(VkDrawIndirectCommand);
 
-    if (waitSemaphore != VK_NULL_HANDLE) {
-        VkPipelineStageFlags pipelineStageFlags[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-        submitInfo.waitSemaphoreCount = 1;
-        submitInfo.pWaitSemaphores = &waitSemaphore;
-        submitInfo.pWaitDstStageMask = pipelineStageFlags;
+    if (multiDrawIndirectSupported) {
+        deviceTable.vkCmdDrawIndirect(commandBuffer, buffer->vkBuffer, offset, drawCount, stride);
+        return;
     }
 
-    if (signalSemaphore != VK_NULL_HANDLE) {
-        submitInfo.signalSemaphoreCount = 1;
-        submitInfo.pSignalSemaphores = &signalSemaphore;
+    for (uint32_t i = 0; i < drawCount; i++)
+        deviceTable.vkCmdDrawIndirect(commandBuffer, buffer->vkBuffer, offset + i * stride, 1, stride);
+}
+
+void RenderDriver::CmdDispatch(VkCommandBuffer commandBuffer, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
+{
+    deviceTable.vkCmdDispatch(commandBuffer, groupCountX, groupCountY, groupCountZ);
+}
+
+void RenderDriver::CmdDispatchIndirect(VkCommandBuffer commandBuffer, Buffer buffer, VkDeviceSize offset)
+{
+    deviceTable.vkCmdDispatchIndirect(commandBuffer, buffer->vkBuffer, offset);
+}
+
+void RenderDriver::CmdBuildDepthPyramid(VkCommandBuffer commandBuffer, const float* viewProjection)
+{
+    CmdTextureMemoryBarrier(commandBuffer, depthTexture, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    /* 上一帧的剔除还在读 pyramid 和参数 (WAR) */
+    deviceTable.vkCmdPipelineBarrier(commandBuffer,
+                                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                     0,
+                                     0, VK_NULL_HANDLE,
+                                     0, VK_NULL_HANDLE,
+                                     0, VK_NULL_HANDLE);
+
+    DepthPyramidParams params = {};
+    memcpy(params.viewProjection, viewProjection, sizeof(params.viewProjection));
+    params.size[0] = static_cast<float>(depthPyramid->width);
+    params.size[1] = static_cast<float>(depthPyramid->height);
+    params.mipCount = static_cast<float>(depthPyramid->mipLevels);
+    params.valid = 1.0f;
+
+    deviceTable.vkCmdUpdateBuffer(commandBuffer, depthPyramidParams->vkBuffer, 0, sizeof(params), &params);
+
+    CmdBindPipeline(commandBuffer, hizReducePipeline);
+
+    /* 只有 renderExtent2D 范围内的深度有效 */
+    uint32_t srcWidth = renderExtent2D.width;
+    uint32_t srcHeight = renderExtent2D.height;
+
+    for (uint32_t level = 0; level < depthPyramid->mipLevels; level++) {
+        uint32_t dstWidth = std::max(depthPyramid->width >> level, 1u);
+        uint32_t dstHeight = std::max(depthPyramid->height >> level, 1u);
+
+        deviceTable.vkCmdBindDescriptorSets(commandBuffer,
+                                            VK_PIPELINE_BIND_POINT_COMPUTE,
+                                            hizReducePipeline->vkPipelineLayout,
+                                            0, 1, &depthPyramidDescriptorSets[level],
+                                            0, VK_NULL_HANDLE);
+
+        HizReducePushConstants pc = {
+            .srcSize = { static_cast<int32_t>(srcWidth), static_cast<int32_t>(srcHeight) },
+            .dstSize = { static_cast<int32_t>(dstWidth), static_cast<int32_t>(dstHeight) },
+        };
+
+        deviceTable.vkCmdPushConstants(commandBuffer, hizReducePipeline->vkPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pc), &pc);
+        deviceTable.vkCmdDispatch(commandBuffer, (dstWidth + 7) / 8, (dstHeight + 7) / 8, 1);
+
+        /* 下一级从这一级读取 */
+        VkImageMemoryBarrier barrier = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_GENERAL,
+            .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = depthPyramid->vkImage,
+            .subresourceRange = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = level,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            }
+        };
+
+        deviceTable.vkCmdPipelineBarrier(commandBuffer,
+                                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                         0,
+                                         0, VK_NULL_HANDLE,
+                                         0, VK_NULL_HANDLE,
+                                         1, &barrier);
+
+        srcWidth = dstWidth;
+        srcHeight = dstHeight;
     }
 
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
+    VkMemoryBarrier paramsBarrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_UNIFORM_READ_BIT,
+    };
 
-    err = vkQueueSubmit(queue, 1, &submitInfo, fence);
-    assert(!err);
+    deviceTable.vkCmdPipelineBarrier(commandBuffer,
+                                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                     0,
+                                     1, &paramsBarrier,
+                                     0, VK_NULL_HANDLE,
+                                     0, VK_NULL_HANDLE);
 }
 
-void RenderDriver::SubmitAndPresentFrame(VkCommandBuffer commandBuffer)
+void RenderDriver::CmdCullOcclusion(VkCommandBuffer commandBuffer, Buffer objectBuffer, Buffer drawBuffer, uint32_t objectCount, const float* viewProjection)
 {
     VkResult err;
 
-    SubmitQueue(commandBuffer, imageAvailableSemaphores[flightIndex], renderFinishedSemaphores[imageIndex], inFlightFences[flightIndex]);
+    /* 上一次的间接绘制还在读 drawBuffer (WAR) */
+    deviceTable.vkCmdPipelineBarrier(commandBuffer,
+                                     VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                     0,
+                                     0, VK_NULL_HANDLE,
+                                     0, VK_NULL_HANDLE,
+                                     0, VK_NULL_HANDLE);
+
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    err = _AllocateFrameDescriptorSet(hizCullPipeline->vkDescriptorSetLayout, &descriptorSet);
+    assert(!err);
 
-    VkPresentInfoKHR presentInfo = {
-        .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-        .waitSemaphoreCount = 1,
-        .pWaitSemaphores = &renderFinishedSemaphores[imageIndex],
-        .swapchainCount = 1,
-        .pSwapchains = &swapchain,
-        .pImageIndices = &imageIndex,
+    VkDescriptorImageInfo pyramidInfo = { depthPyramidSampler, depthPyramid->vkImageView, VK_IMAGE_LAYOUT_GENERAL };
+    VkDescriptorBufferInfo paramsInfo = { depthPyramidParams->vkBuffer, 0, sizeof(DepthPyramidParams) };
+    VkDescriptorBufferInfo objectInfo = { objectBuffer->vkBuffer, 0, VK_WHOLE_SIZE };
+    VkDescriptorBufferInfo drawInfo = { drawBuffer->vkBuffer, 0, VK_WHOLE_SIZE };
+
+    VkWriteDescriptorSet writes[] = {
+        { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, VK_NULL_HANDLE, descriptorSet, 0, 0, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &pyramidInfo, VK_NULL_HANDLE, VK_NULL_HANDLE },
+        { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, VK_NULL_HANDLE, descriptorSet, 1, 0, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_NULL_HANDLE, &paramsInfo, VK_NULL_HANDLE },
+        { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, VK_NULL_HANDLE, descriptorSet, 2, 0, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_NULL_HANDLE, &objectInfo, VK_NULL_HANDLE },
+        { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, VK_NULL_HANDLE, descriptorSet, 3, 0, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_NULL_HANDLE, &drawInfo, VK_NULL_HANDLE },
     };
 
-    err = vkQueuePresentKHR(queue, &presentInfo);
-    assert(!err);
+    deviceTable.vkUpdateDescriptorSets(device, ARRAY_SIZE(writes), writes, 0, VK_NULL_HANDLE);
+
+    CmdBindPipeline(commandBuffer, hizCullPipeline);
+    deviceTable.vkCmdBindDescriptorSets(commandBuffer,
+                                        VK_PIPELINE_BIND_POINT_COMPUTE,
+                                        hizCullPipeline->vkPipelineLayout,
+                                        0, 1, &descriptorSet,
+                                        0, VK_NULL_HANDLE);
+
+    HizCullPushConstants pc = {};
+    memcpy(pc.viewProjection, viewProjection, sizeof(pc.viewProjection));
+    pc.objectCount = objectCount;
+
+    deviceTable.vkCmdPushConstants(commandBuffer, hizCullPipeline->vkPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pc), &pc);
+    deviceTable.vkCmdDispatch(commandBuffer, (objectCount + 63) / 64, 1, 1);
+
+    VkMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+    };
+
+    deviceTable.vkCmdPipelineBarrier(commandBuffer,
+                                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                     VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                                     0,
+                                     1, &barrier,
+                                     0, VK_NULL_HANDLE,
+                                     0, VK_NULL_HANDLE);
 }
 
-void RenderDriver::CopyBuffer(Buffer srcBuffer, uint64_t srcOffset, Buffer dstBuffer, uint64_t dstOffset, uint64_t size)
+void RenderDriver::SubmitQueue(VkCommandBuffer commandBuffer, VkSemaphore waitSemaphore, VkSemaphore signalSemaphore, VkFence fence)
 {
-    VkCommandBuffer commandBuffer;
-    CreateCommandBuffer(&commandBuffer);
-    BeginCommandBuffer(commandBuffer);
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
 
-    VkBufferCopy copyRegion = {};
-    copyRegion.srcOffset = srcOffset;
-    copyRegion.dstOffset = dstOffset;
-    copyRegion.size = size;
+    _QueueSubmit(queue, commandBuffer,
+                 waitSemaphore != VK_NULL_HANDLE ? 1 : 0, &waitSemaphore, VK_NULL_HANDLE, &waitStage,
+                 signalSemaphore != VK_NULL_HANDLE ? 1 : 0, &signalSemaphore, VK_NULL_HANDLE, fence);
+}
+
+void RenderDriver::_QueueSubmit(VkQueue submitQueue, VkCommandBuffer commandBuffer,
+                                uint32_t waitCount, const VkSemaphore* pWaitSemaphores, const uint64_t* pWaitValues, const VkPipelineStageFlags* pWaitStages,
+                                uint32_t signalCount, const VkSemaphore* pSignalSemaphores, const uint64_t* pSignalValues, VkFence fence)
+{
+    VkResult err;
 
-    vkCmdCopyBuffer(commandBuffer, srcBuffer->vkBuffer, dstBuffer->vkBuffer, 1, &copyRegion);
+    if (fence != VK_NULL_HANDLE)
+        deviceTable.vkResetFences(device, 1, &fence);
 
-    EndCommandBuffer(commandBuffer);
-    SubmitQueue(commandBuffer, VK_NULL_HANDLE, VK_NULL_HANDLE, submitFence);
-    vkWaitForFences(device, 1, &submitFence, VK_TRUE, UINT32_MAX);
+    /* 二值信号量对应的 value 会被忽略 */
+    VkTimelineSemaphoreSubmitInfo timelineSubmitInfo = {};
+    timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineSubmitInfo.waitSemaphoreValueCount = pWaitValues != VK_NULL_HANDLE ? waitCount : 0;
+    timelineSubmitInfo.pWaitSemaphoreValues = pWaitValues;
+    timelineSubmitInfo.signalSemaphoreValueCount = pSignalValues != VK_NULL_HANDLE ? signalCount : 0;
+    timelineSubmitInfo.pSignalSemaphoreValues = pSignalValues;
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineSubmitInfo;
+    submitInfo.waitSemaphoreCount = waitCount;
+    submitInfo.pWaitSemaphores = pWaitSemaphores;
+    submitInfo.pWaitDstStageMask = pWaitStages;
+    submitInfo.signalSemaphoreCount = signalCount;
+    submitInfo.pSignalSemaphores = pSignalSemaphores;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+
+    err = deviceTable.vkQueueSubmit(submitQueue, 1, &submitInfo, fence);
+    assert(!err);
 }
 
-void RenderDriver::WriteTexture2D(Texture2D texture, uint64_t size, void *pixels)
+VkCommandBuffer RenderDriver::BeginAsyncCompute()
 {
-    Buffer stagingBuffer;
-    CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, &stagingBuffer);
-    WriteBuffer(stagingBuffer, size, pixels);
+    if (computeQueue == VK_NULL_HANDLE)
+        return frameCommandBuffers[flightIndex];
 
-    VkCommandBuffer commandBuffer;
-    CreateCommandBuffer(&commandBuffer);
+    VkCommandBuffer commandBuffer = computeCommandBuffers[flightIndex];
+    deviceTable.vkResetCommandBuffer(commandBuffer, 0);
     BeginCommandBuffer(commandBuffer);
 
-    CmdTextureMemoryBarrier(commandBuffer, texture, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    return commandBuffer;
+}
 
-    VkBufferImageCopy copyRegion = {
-        .bufferOffset = 0,
+void RenderDriver::SubmitAsyncCompute(VkCommandBuffer commandBuffer, VkBool32 waitPreviousFrame)
+{
+    if (computeQueue == VK_NULL_HANDLE) {
+        CmdMemoryBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+                             | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+        return;
+    }
+
+    EndCommandBuffer(commandBuffer);
+    _FlushTransientRing();
+
+    /* 等待最近一次图形提交 signal 的值；还没有提交过时（第一帧）不等待，否则等待永远不会满足 */
+    uint64_t waitValue = lastSignaledFrameNumber;
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+    _QueueSubmit(computeQueue, commandBuffer,
+                 waitPreviousFrame && waitValue > 0 ? 1 : 0, &frameTimelineSemaphore, &waitValue, &waitStage,
+                 1, &computeFinishedSemaphores[flightIndex], VK_NULL_HANDLE, VK_NULL_HANDLE);
+
+    computeSubmitted[flightIndex] = VK_TRUE;
+}
+
+uint64_t RenderDriver::GetCompletedFrameNumber() const
+{
+    uint64_t value = 0;
+    deviceTable.vkGetSemaphoreCounterValue(device, frameTimelineSemaphore, &value);
+    return value;
+}
+
+void RenderDriver::SubmitAndPresentFrame(VkCommandBuffer commandBuffer)
+{
+    QK_PROFILE_ZONE("SubmitAndPresentFrame");
+
+    VkResult err;
+
+    VkSemaphore waitSemaphores[2] = {};
+    uint64_t waitValues[2] = { 0, 0 };
+    VkPipelineStageFlags waitStages[2] = {};
+    uint32_t waitCount = 0;
+
+    _FlushTransientRing();
+
+    if (!headless) {
+        waitSemaphores[waitCount] = imageAvailableSemaphores[flightIndex];
+        waitStages[waitCount++] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+    }
+
+    if (computeQueue != VK_NULL_HANDLE && computeSubmitted[flightIndex]) {
+        waitSemaphores[waitCount] = computeFinishedSemaphores[flightIndex];
+        waitStages[waitCount++] = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+            | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+        computeSubmitted[flightIndex] = VK_FALSE;
+    }
+
+    VkSemaphore signalSemaphores[2] = { frameTimelineSemaphore };
+    uint64_t signalValues[2] = { frameNumber, 0 };
+    uint32_t signalCount = 1;
+
+    if (!headless)
+        signalSemaphores[signalCount++] = renderFinishedSemaphores[imageIndex];
+
+    {
+        QK_PROFILE_ZONE("QueueSubmit");
+        _QueueSubmit(queue, commandBuffer,
+                     waitCount, waitSemaphores, waitValues, waitStages,
+                     signalCount, signalSemaphores, signalValues, inFlightFences[flightIndex]);
+        lastSignaledFrameNumber = frameNumber;
+    }
+
+    /* 离屏模式只提交不呈现 */
+    if (headless)
+        return;
+
+    VkPresentInfoKHR presentInfo = {
+        .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores = &renderFinishedSemaphores[imageIndex],
+        .swapchainCount = 1,
+        .pSwapchains = &swapchain,
+        .pImageIndices = &imageIndex,
+    };
+
+    QK_PROFILE_ZONE("QueuePresent");
+    err = deviceTable.vkQueuePresentKHR(queue, &presentInfo);
+    assert(!err);
+}
+
+void RenderDriver::CopyBuffer(Buffer srcBuffer, uint64_t srcOffset, Buffer dstBuffer, uint64_t dstOffset, uint64_t size)
+{
+    QK_PROFILE_ZONE("CopyBuffer");
+
+    VkCommandBuffer commandBuffer;
+    CreateCommandBuffer(&commandBuffer);
+    BeginCommandBuffer(commandBuffer);
+
+    VkBufferCopy copyRegion = {};
+    copyRegion.srcOffset = srcOffset;
+    copyRegion.dstOffset = dstOffset;
+    copyRegion.size = size;
+
+    deviceTable.vkCmdCopyBuffer(commandBuffer, srcBuffer->vkBuffer, dstBuffer->vkBuffer, 1, &copyRegion);
+
+    EndCommandBuffer(commandBuffer);
+    SubmitQueue(commandBuffer, VK_NULL_HANDLE, VK_NULL_HANDLE, submitFence);
+    deviceTable.vkWaitForFences(device, 1, &submitFence, VK_TRUE, UINT32_MAX);
+}
+
+void RenderDriver::WriteTexture2D(Texture2D texture, uint64_t size, const void *pixels)
+{
+    QK_PROFILE_ZONE("WriteTexture2D");
+
+    Buffer stagingBuffer;
+    CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, &stagingBuffer);
+    WriteBuffer(stagingBuffer, size, pixels);
+
+    VkCommandBuffer commandBuffer;
+    CreateCommandBuffer(&commandBuffer);
+    BeginCommandBuffer(commandBuffer);
+
+    CmdTextureMemoryBarrier(commandBuffer, texture, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+    VkBufferImageCopy copyRegion = {
+        .bufferOffset = 0,
         .bufferRowLength = 0,
         .bufferImageHeight = 0,
         .imageSubresource = {
             .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
             .mipLevel = 0,
             .baseArrayLayer = 0,
-            .layerCount = 1,
+            .layerCount = texture->arrayLayers,
         },
         .imageOffset = { 0, 0, 0 },
         .imageExtent = { texture->width, texture->height, 1 }
     };
 
-    vkCmdCopyBufferToImage(
+    deviceTable.vkCmdCopyBufferToImage(
         commandBuffer,
         stagingBuffer->vkBuffer,
         texture->vkImage,
@@ -703,24 +1911,379 @@ void RenderDriver::WriteTexture2D(Texture2D texture, uint64_t size, void *pixels
 
     EndCommandBuffer(commandBuffer);
     SubmitQueue(commandBuffer, VK_NULL_HANDLE, VK_NULL_HANDLE, submitFence);
-    vkWaitForFences(device, 1, &submitFence, VK_TRUE, UINT32_MAX);
+    deviceTable.vkWaitForFences(device, 1, &submitFence, VK_TRUE, UINT32_MAX);
 
     DestroyBuffer(stagingBuffer);
 }
 
+VkResult RenderDriver::AllocateDescriptorSet(Pipeline pipeline, VkDescriptorSet* pDescriptorSet)
+{
+    /* 分配自本帧的临时池，下次轮到这一帧时自动回收 */
+    return _AllocateFrameDescriptorSet(pipeline->vkDescriptorSetLayout, pDescriptorSet);
+}
+
+VkResult RenderDriver::AllocatePersistentDescriptorSet(Pipeline pipeline, VkDescriptorSet* pDescriptorSet)
+{
+    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {};
+    descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptorSetAllocateInfo.descriptorPool = descriptorPool;
+    descriptorSetAllocateInfo.descriptorSetCount = 1;
+    descriptorSetAllocateInfo.pSetLayouts = &pipeline->vkDescriptorSetLayout;
+
+    return deviceTable.vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, pDescriptorSet);
+}
+
+void RenderDriver::FreeDescriptorSet(VkDescriptorSet descriptorSet)
+{
+    deviceTable.vkFreeDescriptorSets(device, descriptorPool, 1, &descriptorSet);
+}
+
+VkResult RenderDriver::AllocateTransient(VkDeviceSize size, TransientAllocation* pAllocation)
+{
+    VkDeviceSize offset = (transientHead + transientAlignment - 1) & ~(transientAlignment - 1);
+
+    if (offset + size > transientFrameSize) {
+        printf("[vulkan] transient ring overflow, frame used %llu bytes, request %llu bytes\n",
+               static_cast<unsigned long long>(transientHead), static_cast<unsigned long long>(size));
+        return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+    }
+
+    transientHead = offset + size;
+
+    VkDeviceSize ringOffset = static_cast<VkDeviceSize>(flightIndex) * transientFrameSize + offset;
+    pAllocation->pData = transientRingMapped + ringOffset;
+    pAllocation->dynamicOffset = static_cast<uint32_t>(ringOffset);
+
+    return VK_SUCCESS;
+}
+
+void RenderDriver::_FlushTransientRing()
+{
+    /* 非 coherent 内存需要 flush，异步计算和图形提交前各调用一次，只 flush 新写入的部分 */
+    if (transientHead == transientFlushed)
+        return;
+
+    VkDeviceSize frameOffset = static_cast<VkDeviceSize>(flightIndex) * transientFrameSize;
+    vmaFlushAllocation(allocator, transientRing->allocation, frameOffset + transientFlushed, transientHead - transientFlushed);
+    transientFlushed = transientHead;
+}
+
+void RenderDriver::WriteDescriptorBuffer(VkDescriptorSet descriptorSet, uint32_t binding, VkDescriptorType type, Buffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+    VkDescriptorBufferInfo bufferInfo = { buffer->vkBuffer, offset, range };
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = descriptorSet;
+    write.dstBinding = binding;
+    write.descriptorCount = 1;
+    write.descriptorType = type;
+    write.pBufferInfo = &bufferInfo;
+
+    deviceTable.vkUpdateDescriptorSets(device, 1, &write, 0, VK_NULL_HANDLE);
+}
+
+void RenderDriver::WriteDescriptorTexture(VkDescriptorSet descriptorSet, uint32_t binding, VkDescriptorType type, Texture2D texture, VkSampler sampler, VkImageLayout layout)
+{
+    VkDescriptorImageInfo imageInfo = { sampler, texture->vkImageView, layout };
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = descriptorSet;
+    write.dstBinding = binding;
+    write.descriptorCount = 1;
+    write.descriptorType = type;
+    write.pImageInfo = &imageInfo;
+
+    deviceTable.vkUpdateDescriptorSets(device, 1, &write, 0, VK_NULL_HANDLE);
+}
+
+void RenderDriver::WriteDescriptorDepthPyramid(VkDescriptorSet descriptorSet, uint32_t binding)
+{
+    VkDescriptorImageInfo pyramidInfo = { depthPyramidSampler, depthPyramid->vkImageView, VK_IMAGE_LAYOUT_GENERAL };
+    VkDescriptorBufferInfo paramsInfo = { depthPyramidParams->vkBuffer, 0, sizeof(DepthPyramidParams) };
+
+    VkWriteDescriptorSet writes[] = {
+        { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, VK_NULL_HANDLE, descriptorSet, binding + 0, 0, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &pyramidInfo, VK_NULL_HANDLE, VK_NULL_HANDLE },
+        { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, VK_NULL_HANDLE, descriptorSet, binding + 1, 0, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_NULL_HANDLE, &paramsInfo, VK_NULL_HANDLE },
+    };
+
+    deviceTable.vkUpdateDescriptorSets(device, ARRAY_SIZE(writes), writes, 0, VK_NULL_HANDLE);
+}
+
+ReadbackHandle RenderDriver::CmdReadbackBuffer(VkCommandBuffer commandBuffer, Buffer buffer, VkDeviceSize offset, VkDeviceSize size,
+                                               PFN_ReadbackCallback callback, void* pUserData)
+{
+    ReadbackHandle handle = 0;
+    VkDeviceSize dstOffset = _AllocateReadback(size, callback, pUserData, &handle);
+    if (handle == 0)
+        return 0;
+
+    CmdMemoryBarrier(commandBuffer,
+                     VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_MEMORY_WRITE_BIT,
+                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+
+    CmdCopyBuffer(commandBuffer, buffer, offset, readbackRing, dstOffset, size);
+
+    CmdMemoryBarrier(commandBuffer,
+                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                     VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+
+    return handle;
+}
+
+ReadbackHandle RenderDriver::CmdReadbackTexture2D(VkCommandBuffer commandBuffer, Texture2D texture, uint32_t mipLevel, VkOffset2D offset, VkExtent2D extent,
+                                                  PFN_ReadbackCallback callback, void* pUserData)
+{
+    const uint32_t texelSize = VkUtils::FormatTexelSize(texture->format);
+    if (texelSize == 0 || texture->layout == VK_IMAGE_LAYOUT_UNDEFINED || mipLevel >= texture->mipLevels) {
+        printf("[vulkan] unsupported texture readback (format %d, layout %d)\n", texture->format, texture->layout);
+        return 0;
+    }
+
+    ReadbackHandle handle = 0;
+    VkDeviceSize dstOffset = _AllocateReadback(static_cast<VkDeviceSize>(extent.width) * extent.height * texelSize, callback, pUserData, &handle);
+    if (handle == 0)
+        return 0;
+
+    /* 只拷贝第一个 aspect，深度模板格式读回的是深度；数组纹理只读回第 0 层，屏障也只覆盖这一层 */
+    VkImageAspectFlags aspectMask = (texture->aspectMask & VK_IMAGE_ASPECT_DEPTH_BIT) ? static_cast<VkImageAspectFlags>(VK_IMAGE_ASPECT_DEPTH_BIT) : texture->aspectMask;
+
+    VkImageMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+        .oldLayout = texture->layout,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = texture->vkImage,
+        .subresourceRange = {
+            .aspectMask = texture->aspectMask,
+            .baseMipLevel = mipLevel,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        }
+    };
+
+    deviceTable.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                                     0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, 1, &barrier);
+
+    VkBufferImageCopy copyRegion = {
+        .bufferOffset = dstOffset,
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource = {
+            .aspectMask = aspectMask,
+            .mipLevel = mipLevel,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        },
+        .imageOffset = { offset.x, offset.y, 0 },
+        .imageExtent = { extent.width, extent.height, 1 }
+    };
+
+    deviceTable.vkCmdCopyImageToBuffer(commandBuffer, texture->vkImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackRing->vkBuffer, 1, &copyRegion);
+
+    /* 恢复原来的布局，纹理记录的 layout 保持不变 */
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.newLayout = texture->layout;
+
+    deviceTable.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+                                     0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, 1, &barrier);
+
+    CmdMemoryBarrier(commandBuffer,
+                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                     VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+
+    return handle;
+}
+
+VkBool32 RenderDriver::GetReadbackResult(ReadbackHandle handle, const void** ppData, VkDeviceSize* pSize)
+{
+    for (const ReadbackEntry& entry : readbackEntries) {
+        if (entry.handle != handle)
+            continue;
+
+        if (!entry.ready || entry.released)
+            return VK_FALSE;
+
+        *ppData = readbackRingMapped + entry.offset;
+        if (pSize != VK_NULL_HANDLE)
+            *pSize = entry.size;
+
+        return VK_TRUE;
+    }
+
+    return VK_FALSE;
+}
+
+void RenderDriver::ReleaseReadback(ReadbackHandle handle)
+{
+    for (ReadbackEntry& entry : readbackEntries) {
+        if (entry.handle == handle) {
+            entry.released = VK_TRUE;
+            break;
+        }
+    }
+
+    /* 只能从队首回收，中间释放的等前面的都释放后一起回收 */
+    size_t count = 0;
+    while (count < readbackEntries.size() && readbackEntries[count].released)
+        count++;
+
+    readbackEntries.erase(readbackEntries.begin(), readbackEntries.begin() + count);
+
+    if (readbackEntries.empty())
+        readbackRingHead = 0;
+}
+
+void RenderDriver::PollReadbacks()
+{
+    /* AcquiredNextFrame 中会自动调用，帧循环结束后 DeviceWaitIdle 再调用一次取回剩余的结果 */
+    _ProcessReadbacks();
+}
+
+VkDeviceSize RenderDriver::_AllocateReadback(VkDeviceSize size, PFN_ReadbackCallback callback, void* pUserData, ReadbackHandle* pHandle)
+{
+    const VkDeviceSize alignment = std::max<VkDeviceSize>(16, physicalDeviceProperties.limits.nonCoherentAtomSize);
+
+    *pHandle = 0;
+
+    /* 读回环形缓冲在第一次读回时才创建，窗口程序多数用不到 */
+    if (readbackRing == VK_NULL_HANDLE) {
+        if (CreateBuffer(readbackRingSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU, &readbackRing) != VK_SUCCESS) {
+            printf("[vulkan] create readback ring failed\n");
+            readbackRing = VK_NULL_HANDLE;
+            return 0;
+        }
+
+        if (vmaMapMemory(allocator, readbackRing->allocation, reinterpret_cast<void**>(&readbackRingMapped)) != VK_SUCCESS) {
+            printf("[vulkan] map readback ring failed\n");
+            DestroyBuffer(readbackRing);
+            readbackRing = VK_NULL_HANDLE;
+            return 0;
+        }
+    }
+
+    const VkDeviceSize alignedSize = (size + alignment - 1) & ~(alignment - 1);
+
+    VkDeviceSize offset = (readbackRingHead + alignment - 1) & ~(alignment - 1);
+
+    if (!readbackEntries.empty()) {
+        const VkDeviceSize tail = readbackEntries.front().offset;
+
+        if (offset >= tail) {
+            /* [tail, head) 在使用中，优先放在 head 之后，放不下则回绕到 0 */
+            if (offset + alignedSize > readbackRingSize)
+                offset = 0;
+            if (offset == 0 && alignedSize >= tail)
+                offset = VK_WHOLE_SIZE;
+        } else if (offset + alignedSize >= tail) {
+            offset = VK_WHOLE_SIZE;
+        }
+    } else {
+        offset = 0;
+    }
+
+    if (offset == VK_WHOLE_SIZE || offset + alignedSize > readbackRingSize) {
+        printf("[vulkan] readback ring full, request of %llu bytes dropped\n", static_cast<unsigned long long>(size));
+        return 0;
+    }
+
+    ReadbackEntry entry = {};
+    entry.handle = nextReadbackHandle++;
+    entry.offset = offset;
+    entry.size = size;
+    entry.frameNumber = frameNumber;
+    entry.callback = callback;
+    entry.pUserData = pUserData;
+    readbackEntries.push_back(entry);
+
+    readbackRingHead = offset + alignedSize;
+    *pHandle = entry.handle;
+
+    return offset;
+}
+
+void RenderDriver::_ProcessReadbacks()
+{
+    QK_PROFILE_ZONE("ProcessReadbacks");
+
+    if (readbackEntries.empty())
+        return;
+
+    const uint64_t completedFrame = GetCompletedFrameNumber();
+    std::vector<ReadbackEntry> finished;
+
+    for (ReadbackEntry& entry : readbackEntries) {
+        if (entry.ready || entry.frameNumber > completedFrame)
+            continue;
+
+        vmaInvalidateAllocation(allocator, readbackRing->allocation, entry.offset, entry.size);
+        entry.ready = VK_TRUE;
+
+        if (entry.callback != VK_NULL_HANDLE)
+            finished.push_back(entry);
+    }
+
+    /* 回调中可能发起新的读回，不能在遍历 readbackEntries 时调用 */
+    for (const ReadbackEntry& entry : finished) {
+        entry.callback(entry.handle, readbackRingMapped + entry.offset, entry.size, entry.pUserData);
+        ReleaseReadback(entry.handle);
+    }
+}
+
 void RenderDriver::DeviceWaitIdle()
 {
+    QK_PROFILE_ZONE("DeviceWaitIdle");
     vkDeviceWaitIdle(device);
 }
 
 void RenderDriver::AcquiredNextFrame(VkCommandBuffer* pCommandBuffer)
 {
+    QK_PROFILE_ZONE("AcquiredNextFrame");
+
     flightIndex = (flightIndex + 1) % MAX_FRAMES_IN_FLIGHT;
 
     *pCommandBuffer = frameCommandBuffers[flightIndex];
 
-    vkWaitForFences(device, 1, &inFlightFences[flightIndex], VK_TRUE, UINT32_MAX);
-    vkResetFences(device, 1, &inFlightFences[flightIndex]);
+    {
+        QK_PROFILE_ZONE("WaitForFrameFence");
+        deviceTable.vkWaitForFences(device, 1, &inFlightFences[flightIndex], VK_TRUE, UINT32_MAX);
+    }
+    deviceTable.vkResetFences(device, 1, &inFlightFences[flightIndex]);
+
+    /* 这一帧上一次使用的临时描述符集和临时数据已经执行完毕 */
+    deviceTable.vkResetDescriptorPool(device, frameDescriptorPools[flightIndex], 0);
+    transientHead = 0;
+    transientFlushed = 0;
+
+    frameNumber++;
+    _UpdateMemoryBudget();
+    _StepDefragmentation();
+    _ProcessReadbacks();
+
+    if (timestampQueryPool != VK_NULL_HANDLE && timestampsWritten[flightIndex]) {
+        uint64_t timestamps[2] = {};
+        VkResult err = deviceTable.vkGetQueryPoolResults(device, timestampQueryPool, flightIndex * 2, 2,
+                                                         sizeof(timestamps), timestamps, sizeof(uint64_t),
+                                                         VK_QUERY_RESULT_64_BIT);
+        if (err == VK_SUCCESS) {
+            /* 按有效位回绕相减 */
+            uint64_t ticks = ((timestamps[1] & timestampMask) - (timestamps[0] & timestampMask)) & timestampMask;
+            double ns = static_cast<double>(ticks) * physicalDeviceProperties.limits.timestampPeriod;
+            dynamicResolution.Update(static_cast<float>(ns / 1000000.0));
+        }
+    }
+
+    if (headless) {
+        _UpdateRenderExtent();
+        return;
+    }
 
     VkSurfaceCapabilitiesKHR capabilities;
     vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &capabilities);
@@ -730,12 +2293,34 @@ void RenderDriver::AcquiredNextFrame(VkCommandBuffer* pCommandBuffer)
     if (currentExtent2D.width != swapchainExtent2D.width || currentExtent2D.height != swapchainExtent2D.height)
         RebuildSwapchain();
 
-    vkAcquireNextImageKHR(device, swapchain, UINT32_MAX, imageAvailableSemaphores[flightIndex], VK_NULL_HANDLE, &imageIndex);
+    _UpdateRenderExtent();
+
+    QK_PROFILE_ZONE("AcquireNextImage");
+    deviceTable.vkAcquireNextImageKHR(device, swapchain, UINT32_MAX, imageAvailableSemaphores[flightIndex], VK_NULL_HANDLE, &imageIndex);
+}
+
+void RenderDriver::SetDynamicResolution(const DynamicResolutionSettings& settings)
+{
+    bool reallocate = settings.maxScale != dynamicResolution.GetSettings().maxScale;
+
+    dynamicResolution.SetSettings(settings);
+
+    /* maxScale 决定内部目标的分配尺寸 */
+    if (reallocate && device != VK_NULL_HANDLE) {
+        DeviceWaitIdle();
+        _DestroyRenderTargets();
+        _CreateRenderTargets();
+    }
 }
 
 void RenderDriver::RebuildSwapchain()
 {
+    QK_PROFILE_ZONE("RebuildSwapchain");
+
     _CreateSwapchain(swapchain);
+
+    _DestroyRenderTargets();
+    _CreateRenderTargets();
 }
 
 void RenderDriver::ReadBuffer(Buffer buffer, size_t size, void *data)
@@ -746,8 +2331,30 @@ void RenderDriver::ReadBuffer(Buffer buffer, size_t size, void *data)
     vmaUnmapMemory(allocator, buffer->allocation);
 }
 
-void RenderDriver::WriteBuffer(Buffer buffer, size_t size, void *data)
+void* RenderDriver::MapBuffer(Buffer buffer)
+{
+    void* data = VK_NULL_HANDLE;
+    vmaMapMemory(allocator, buffer->allocation, &data);
+
+    /* 非 HOST_COHERENT 内存读取前需要 invalidate */
+    if (buffer->memoryUsage == VMA_MEMORY_USAGE_GPU_TO_CPU)
+        vmaInvalidateAllocation(allocator, buffer->allocation, 0, VK_WHOLE_SIZE);
+
+    return data;
+}
+
+void RenderDriver::UnmapBuffer(Buffer buffer)
+{
+    if (buffer->memoryUsage != VMA_MEMORY_USAGE_GPU_TO_CPU)
+        vmaFlushAllocation(allocator, buffer->allocation, 0, VK_WHOLE_SIZE);
+
+    vmaUnmapMemory(allocator, buffer->allocation);
+}
+
+void RenderDriver::WriteBuffer(Buffer buffer, size_t size, const void *data)
 {
+    QK_PROFILE_ZONE("WriteBuffer");
+
     if (buffer->memoryUsage == VMA_MEMORY_USAGE_GPU_ONLY) {
         Buffer stagingBuffer;
         CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, &stagingBuffer);
@@ -764,8 +2371,34 @@ void RenderDriver::WriteBuffer(Buffer buffer, size_t size, void *data)
     vmaUnmapMemory(allocator, buffer->allocation);
 }
 
+/* 环境变量 0/false/off 为关，其余非空值为开，未设置时使用默认值 */
+static VkBool32 _GetEnvironmentFlag(const char* name, VkBool32 defaultValue)
+{
+    const char* value = getenv(name);
+    if (value == VK_NULL_HANDLE || value[0] == '\0')
+        return defaultValue;
+
+    return strcmp(value, "0") != 0 && strcmp(value, "false") != 0 && strcmp(value, "off") != 0;
+}
+
+static bool _IsInstanceLayerSupported(const char* layerName)
+{
+    uint32_t layerCount = 0;
+    vkEnumerateInstanceLayerProperties(&layerCount, VK_NULL_HANDLE);
+    std::vector<VkLayerProperties> layers(layerCount);
+    vkEnumerateInstanceLayerProperties(&layerCount, std::data(layers));
+
+    for (const VkLayerProperties& layer : layers)
+        if (strcmp(layer.layerName, layerName) == 0)
+            return true;
+
+    return false;
+}
+
 VkResult RenderDriver::_CreateInstance()
 {
+    QK_STARTUP_STEP("CreateInstance");
+
     VkResult err;
 
     VkApplicationInfo applicationInfo = {};
@@ -776,28 +2409,55 @@ VkResult RenderDriver::_CreateInstance()
     applicationInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
     applicationInfo.apiVersion = VK_API_VERSION_1_3;
 
-    const std::vector<const char*> layers = {
-        "VK_LAYER_KHRONOS_validation"
-    };
+    /*
+     * 验证层的加载占启动时间的大头，默认值由构建选项 QK_ENABLE_VALIDATION 决定，
+     * 运行时可以用 QK_VULKAN_VALIDATION / QK_VULKAN_DEBUG_UTILS 覆盖。
+     */
+#ifdef QK_ENABLE_VALIDATION
+    validationEnabled = _GetEnvironmentFlag("QK_VULKAN_VALIDATION", VK_TRUE);
+#else
+    validationEnabled = _GetEnvironmentFlag("QK_VULKAN_VALIDATION", VK_FALSE);
+#endif /* QK_ENABLE_VALIDATION */
+    debugUtilsEnabled = _GetEnvironmentFlag("QK_VULKAN_DEBUG_UTILS", validationEnabled);
+
+    const char* validationLayerName = "VK_LAYER_KHRONOS_validation";
+    if (validationEnabled && !_IsInstanceLayerSupported(validationLayerName)) {
+        printf("[vulkan] %s not installed, validation disabled\n", validationLayerName);
+        validationEnabled = VK_FALSE;
+    }
+
+    std::vector<const char*> layers;
+    if (validationEnabled)
+        layers.push_back(validationLayerName);
 
-    const std::vector<const char*> extensions = {
-        VK_KHR_SURFACE_EXTENSION_NAME,
-    #if defined(_WIN32)
-        "VK_KHR_win32_surface",
-    #elif defined(__APPLE__)
-        "VK_MVK_macos_surface",
-        "VK_EXT_metal_surface",
-    #elif defined(__linux__)
-        VK_KHR_XLIB_SURFACE_EXTENSION_NAME,
-    #endif
-        VK_EXT_DEBUG_UTILS_EXTENSION_NAME,
+    printf("[vulkan] validation: %s, debug utils: %s\n", validationEnabled ? "on" : "off", debugUtilsEnabled ? "on" : "off");
 
+    std::vector<const char*> extensions = {
 #if VK_HEADER_VERSION >= 216
         "VK_KHR_portability_enumeration",
         "VK_KHR_get_physical_device_properties2",
 #endif
     };
 
+    /* 离屏模式不需要窗口系统，也就不要求 surface 扩展 */
+    if (!headless) {
+        const std::vector<const char*> surfaceExtensions = {
+            VK_KHR_SURFACE_EXTENSION_NAME,
+        #if defined(_WIN32)
+            "VK_KHR_win32_surface",
+        #elif defined(__APPLE__)
+            "VK_MVK_macos_surface",
+            "VK_EXT_metal_surface",
+        #elif defined(__linux__)
+            VK_KHR_XLIB_SURFACE_EXTENSION_NAME,
+        #endif
+        };
+        extensions.insert(extensions.begin(), surfaceExtensions.begin(), surfaceExtensions.end());
+    }
+
+    if (debugUtilsEnabled)
+        extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+
     VkInstanceCreateInfo instanceCreateInfo = {};
     instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 #if VK_HEADER_VERSION >= 216
@@ -817,6 +2477,8 @@ VkResult RenderDriver::_CreateInstance()
 
 VkResult RenderDriver::_CreateDevice()
 {
+    QK_STARTUP_STEP("CreateDevice");
+
     VkResult err;
 
     physicalDevice = VkUtils::PickBestPhysicalDevice(instance);
@@ -826,15 +2488,21 @@ VkResult RenderDriver::_CreateDevice()
     queueFamilyIndex = VkUtils::FindQueueFamilyIndex(physicalDevice, surface);
     assert(queueFamilyIndex != UINT32_MAX);
 
+    computeQueueFamilyIndex = VkUtils::FindDedicatedComputeQueueFamilyIndex(physicalDevice);
+
     float priorities = 1.0f;
-    VkDeviceQueueCreateInfo queueCreateInfo = {};
-    queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-    queueCreateInfo.queueFamilyIndex = queueFamilyIndex;
-    queueCreateInfo.queueCount = 1;
-    queueCreateInfo.pQueuePriorities = &priorities;
-
-    const std::vector<const char*> extensions = {
-        VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+    VkDeviceQueueCreateInfo queueCreateInfos[2] = {};
+    queueCreateInfos[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queueCreateInfos[0].queueFamilyIndex = queueFamilyIndex;
+    queueCreateInfos[0].queueCount = 1;
+    queueCreateInfos[0].pQueuePriorities = &priorities;
+
+    queueCreateInfos[1] = queueCreateInfos[0];
+    queueCreateInfos[1].queueFamilyIndex = computeQueueFamilyIndex;
+
+    uint32_t queueCreateInfoCount = computeQueueFamilyIndex != UINT32_MAX ? 2 : 1;
+
+    std::vector<const char*> extensions = {
         VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME,
         VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME,
         VK_KHR_MAINTENANCE3_EXTENSION_NAME,
@@ -843,24 +2511,136 @@ VkResult RenderDriver::_CreateDevice()
 #endif
     };
 
-    /* dynamic rendering */
+    if (!headless)
+        extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+
+    /* 有 VK_EXT_memory_budget 时 VMA 可以拿到驱动给出的真实预算 */
+    memoryBudgetSupported = VkUtils::IsDeviceExtensionSupported(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (memoryBudgetSupported)
+        extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+    VkPhysicalDeviceFeatures supportedFeatures = {};
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
+    VkPhysicalDeviceFeatures enabledFeatures = {};
+    enabledFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+    multiDrawIndirectSupported = supportedFeatures.multiDrawIndirect;
+
+    /* 间接绘制用 firstInstance 携带 draw 序号，着色器以 gl_InstanceIndex 索引 per-draw 数据 */
+    enabledFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+    drawIndirectFirstInstanceSupported = supportedFeatures.drawIndirectFirstInstance;
+
+    /* 片元着色器写 SSBO（虚拟纹理的反馈），不支持时对应的功能退化 */
+    enabledFeatures.fragmentStoresAndAtomics = supportedFeatures.fragmentStoresAndAtomics;
+    fragmentStoresAndAtomicsSupported = supportedFeatures.fragmentStoresAndAtomics;
+
+    /* dynamic rendering */
     VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeature = {};
     dynamicRenderingFeature.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
     dynamicRenderingFeature.dynamicRendering = VK_TRUE;
 
+    /* timeline semaphore，用于跨队列同步和帧完成查询 */
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeature = {};
+    timelineSemaphoreFeature.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    timelineSemaphoreFeature.timelineSemaphore = VK_TRUE;
+    dynamicRenderingFeature.pNext = &timelineSemaphoreFeature;
+
+    /*
+     * 着色器缓存相关的可选特性：shader module identifier 配合 FAIL_ON_PIPELINE_COMPILE_REQUIRED
+     * 可以不带 SPIR-V 从管线缓存创建管线，maintenance5 允许 stage 直接携带 VkShaderModuleCreateInfo。
+     * 查询到的结构体原样挂到创建设备的 pNext 链上。
+     */
+    VkPhysicalDevicePipelineCreationCacheControlFeatures cacheControlFeature = {};
+    cacheControlFeature.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_CREATION_CACHE_CONTROL_FEATURES;
+
+    VkPhysicalDeviceShaderModuleIdentifierFeaturesEXT shaderModuleIdentifierFeature = {};
+    shaderModuleIdentifierFeature.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_MODULE_IDENTIFIER_FEATURES_EXT;
+
+    VkPhysicalDeviceMaintenance5FeaturesKHR maintenance5Feature = {};
+    maintenance5Feature.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MAINTENANCE_5_FEATURES_KHR;
+
+    /* 多视图（Vulkan 1.1 核心）：一次提交渲染到数组纹理的多个层 */
+    VkPhysicalDeviceMultiviewFeatures multiviewFeature = {};
+    multiviewFeature.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES;
+    cacheControlFeature.pNext = &multiviewFeature;
+
+    void** ppNextFeature = &multiviewFeature.pNext;
+
+    VkBool32 shaderModuleIdentifierExtension = VkUtils::IsDeviceExtensionSupported(physicalDevice, VK_EXT_SHADER_MODULE_IDENTIFIER_EXTENSION_NAME);
+    if (shaderModuleIdentifierExtension) {
+        *ppNextFeature = &shaderModuleIdentifierFeature;
+        ppNextFeature = &shaderModuleIdentifierFeature.pNext;
+    }
+
+    VkBool32 maintenance5Extension = VkUtils::IsDeviceExtensionSupported(physicalDevice, VK_KHR_MAINTENANCE_5_EXTENSION_NAME);
+    if (maintenance5Extension) {
+        *ppNextFeature = &maintenance5Feature;
+        ppNextFeature = &maintenance5Feature.pNext;
+    }
+
+    VkPhysicalDeviceFeatures2 supportedFeatures2 = {};
+    supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supportedFeatures2.pNext = &cacheControlFeature;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures2);
+
+    shaderModuleIdentifierSupported = shaderModuleIdentifierFeature.shaderModuleIdentifier && cacheControlFeature.pipelineCreationCacheControl;
+    if (shaderModuleIdentifierExtension)
+        extensions.push_back(VK_EXT_SHADER_MODULE_IDENTIFIER_EXTENSION_NAME);
+
+    inlineShaderStageSupported = maintenance5Feature.maintenance5;
+    if (maintenance5Extension)
+        extensions.push_back(VK_KHR_MAINTENANCE_5_EXTENSION_NAME);
+
+    multiviewSupported = multiviewFeature.multiview;
+    if (multiviewSupported) {
+        VkPhysicalDeviceMultiviewProperties multiviewProperties = {};
+        multiviewProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_PROPERTIES;
+
+        VkPhysicalDeviceProperties2 properties2 = {};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &multiviewProperties;
+        vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+
+        maxMultiviewViewCount = multiviewProperties.maxMultiviewViewCount;
+    }
+
+    printf("[vulkan] multiview: %s (max %u views)\n", multiviewSupported ? "yes" : "no", maxMultiviewViewCount);
+    printf("[vulkan] shader module identifier: %s, inline shader stages: %s\n",
+           shaderModuleIdentifierSupported ? "yes" : "no", inlineShaderStageSupported ? "yes" : "no");
+
+    timelineSemaphoreFeature.pNext = &cacheControlFeature;
+
     VkDeviceCreateInfo deviceCreateInfo = {};
     deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     deviceCreateInfo.pNext = &dynamicRenderingFeature;
-    deviceCreateInfo.queueCreateInfoCount = 1;
-    deviceCreateInfo.pQueueCreateInfos = &queueCreateInfo;
+    deviceCreateInfo.queueCreateInfoCount = queueCreateInfoCount;
+    deviceCreateInfo.pQueueCreateInfos = queueCreateInfos;
     deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(std::size(extensions));
     deviceCreateInfo.ppEnabledExtensionNames = std::data(extensions);
+    deviceCreateInfo.pEnabledFeatures = &enabledFeatures;
 
     err = vkCreateDevice(physicalDevice, &deviceCreateInfo, VK_NULL_HANDLE, &device);
     VK_CHECK_ERROR(err);
 
+#ifdef USE_VOLK_LOADER
+    /* 设备级函数直接取驱动入口，跳过 loader 的 trampoline */
+    volkLoadDeviceTable(&deviceTable, device);
+    if (deviceDispatchMode == DEVICE_DISPATCH_GLOBAL)
+        volkLoadDevice(device);
+#endif /* USE_VOLK_LOADER */
+
     vkGetDeviceQueue(device, queueFamilyIndex, 0, &queue);
 
+    if (computeQueueFamilyIndex != UINT32_MAX) {
+        vkGetDeviceQueue(device, computeQueueFamilyIndex, 0, &computeQueue);
+        sharedQueueFamilyIndices[0] = queueFamilyIndex;
+        sharedQueueFamilyIndices[1] = computeQueueFamilyIndex;
+        printf("[vulkan] async compute queue family: %u\n", computeQueueFamilyIndex);
+    }
+
+    depthFormat = VkUtils::ChooseDepthFormat(physicalDevice);
+    assert(depthFormat != VK_FORMAT_UNDEFINED);
+
 TAG_DEVICE_Create_END:
     return err;
 }
@@ -878,10 +2658,24 @@ VkResult RenderDriver::_CreateMemoryAllocator()
     allocatorCreateInfo.physicalDevice = physicalDevice;
     allocatorCreateInfo.device = device;
     allocatorCreateInfo.pVulkanFunctions = &vulkanFunctions;
+    allocatorCreateInfo.vulkanApiVersion = VK_API_VERSION_1_3;
+
+    if (memoryBudgetSupported)
+        allocatorCreateInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
 
     err = vmaCreateAllocator(&allocatorCreateInfo, &allocator);
     VK_CHECK_ERROR(err);
 
+    const VkPhysicalDeviceMemoryProperties* memoryProperties = VK_NULL_HANDLE;
+    vmaGetMemoryProperties(allocator, &memoryProperties);
+
+    memoryStatistics.heapCount = memoryProperties->memoryHeapCount;
+    memoryStatistics.memoryBudgetExtension = memoryBudgetSupported;
+    for (uint32_t i = 0; i < memoryProperties->memoryHeapCount; i++)
+        memoryStatistics.heapFlags[i] = memoryProperties->memoryHeaps[i].flags;
+
+    _UpdateMemoryBudget();
+
     return err;
 }
 
@@ -920,7 +2714,7 @@ VkResult RenderDriver::_CreateSwapchain(VkSwapchainKHR oldSwapchain)
     swapchainCreateInfo.imageColorSpace = surfaceFormat.colorSpace;
     swapchainCreateInfo.imageExtent = swapchainExtent2D;
     swapchainCreateInfo.imageArrayLayers = 1;
-    swapchainCreateInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    swapchainCreateInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
     swapchainCreateInfo.preTransform = surfaceCapabilities.currentTransform;
     swapchainCreateInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     swapchainCreateInfo.presentMode = VK_PRESENT_MODE_FIFO_KHR;
@@ -934,120 +2728,675 @@ VkResult RenderDriver::_CreateSwapchain(VkSwapchainKHR oldSwapchain)
     if (oldSwapchain != VK_NULL_HANDLE)
         _DestroySwapchain();
 
-    swapchain = tmpSwapchain;
+    swapchain = tmpSwapchain;
+
+    /* Create swapchain resources */
+    err = vkGetSwapchainImagesKHR(device, swapchain, &minImageCount, nullptr);
+    VK_CHECK_ERROR(err);
+
+    swapchainImages.resize(minImageCount);
+    swapchainImageViews.resize(minImageCount);
+    renderFinishedSemaphores.resize(minImageCount);
+    
+    err = vkGetSwapchainImagesKHR(device, swapchain, &minImageCount, std::data(swapchainImages));
+    VK_CHECK_ERROR(err);
+
+    for (uint32_t i = 0; i < minImageCount; i++) {
+        VkImage swapchainImage = swapchainImages[i];
+
+        VkImageViewCreateInfo imageViewCreateInfo = {};
+        imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        imageViewCreateInfo.image = swapchainImage;
+        imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        imageViewCreateInfo.format = surfaceFormat.format;
+        imageViewCreateInfo.components = {
+            VK_COMPONENT_SWIZZLE_IDENTITY,
+            VK_COMPONENT_SWIZZLE_IDENTITY,
+            VK_COMPONENT_SWIZZLE_IDENTITY,
+            VK_COMPONENT_SWIZZLE_IDENTITY
+        };
+        imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
+        imageViewCreateInfo.subresourceRange.levelCount = 1;
+        imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
+        imageViewCreateInfo.subresourceRange.layerCount = 1;
+        imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+
+        err = vkCreateImageView(device, &imageViewCreateInfo, VK_NULL_HANDLE, &swapchainImageViews[i]);
+        VK_CHECK_ERROR(err);
+
+        err = _CreateSemaphore(&renderFinishedSemaphores[i]);
+        VK_CHECK_ERROR(err);
+    }
+
+    return err;
+}
+
+VkResult RenderDriver::_CreateCommandPool()
+{
+    VkResult err;
+
+    VkCommandPoolCreateInfo commandPoolCreateInfo = {};
+    commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT
+                                  | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    commandPoolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+
+    err = vkCreateCommandPool(device, &commandPoolCreateInfo, VK_NULL_HANDLE, &commandPool);
+    VK_CHECK_ERROR(err);
+
+    return err;
+}
+
+VkResult RenderDriver::_CreateDescriptorPool()
+{
+    VkResult err;
+
+    VkDescriptorPoolSize pool_size[] = {
+        { VK_DESCRIPTOR_TYPE_SAMPLER,                256 },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 256 },
+        { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,          256 },
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,          256 },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER,   256 },
+        { VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER,   256 },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         256 },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         256 },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 256 },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 256 },
+        { VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,       256 },
+    };
+
+    VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {};
+    descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptorPoolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+    descriptorPoolCreateInfo.maxSets = 1024;
+    descriptorPoolCreateInfo.poolSizeCount = ARRAY_SIZE(pool_size);
+    descriptorPoolCreateInfo.pPoolSizes = pool_size;
+
+    err = vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, VK_NULL_HANDLE, &descriptorPool);
+    VK_CHECK_ERROR(err);
+
+    /* 每帧临时描述符集，AcquiredNextFrame 中整体重置 */
+    descriptorPoolCreateInfo.flags = 0;
+    frameDescriptorPools.resize(MAX_FRAMES_IN_FLIGHT);
+
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        err = vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, VK_NULL_HANDLE, &frameDescriptorPools[i]);
+        VK_CHECK_ERROR(err);
+    }
+
+    return err;
+}
+
+VkResult RenderDriver::_CreateRenderTargets()
+{
+    VkResult err;
+
+    /* 内部渲染目标按最大缩放分配，缩放变化时只改变渲染区域，不重新分配 */
+    float maxScale = dynamicResolution.GetSettings().maxScale;
+    uint32_t targetWidth = std::max(static_cast<uint32_t>(swapchainExtent2D.width * maxScale), 1u);
+    uint32_t targetHeight = std::max(static_cast<uint32_t>(swapchainExtent2D.height * maxScale), 1u);
+
+    err = CreateTexture2D(targetWidth,
+                          targetHeight,
+                          surfaceFormat.format,
+                          VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                          &sceneColor);
+    VK_CHECK_ERROR(err);
+
+    err = CreateTexture2D(targetWidth,
+                          targetHeight,
+                          depthFormat,
+                          VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                          &depthTexture);
+    VK_CHECK_ERROR(err);
+
+    /* pyramid 第 0 级取不大于深度尺寸的 2 的幂，归约时按覆盖范围取最大值以保证保守 */
+    uint32_t pyramidWidth = VkUtils::PreviousPowerOfTwo(targetWidth);
+    uint32_t pyramidHeight = VkUtils::PreviousPowerOfTwo(targetHeight);
+    uint32_t pyramidLevels = VkUtils::MipLevelCount(pyramidWidth, pyramidHeight);
+
+    err = CreateTexture2D(pyramidWidth,
+                          pyramidHeight,
+                          pyramidLevels,
+                          VK_FORMAT_R32_SFLOAT,
+                          VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                          &depthPyramid);
+    VK_CHECK_ERROR(err);
+
+    depthPyramidMipViews.resize(pyramidLevels);
+    depthPyramidDescriptorSets.resize(pyramidLevels);
+
+    for (uint32_t level = 0; level < pyramidLevels; level++) {
+        VkImageViewCreateInfo imageViewCreateInfo = {};
+        imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        imageViewCreateInfo.image = depthPyramid->vkImage;
+        imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        imageViewCreateInfo.format = depthPyramid->format;
+        imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        imageViewCreateInfo.subresourceRange.baseMipLevel = level;
+        imageViewCreateInfo.subresourceRange.levelCount = 1;
+        imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
+        imageViewCreateInfo.subresourceRange.layerCount = 1;
+
+        err = vkCreateImageView(device, &imageViewCreateInfo, VK_NULL_HANDLE, &depthPyramidMipViews[level]);
+        VK_CHECK_ERROR(err);
+    }
+
+    std::vector<VkDescriptorSetLayout> setLayouts(pyramidLevels, hizReducePipeline->vkDescriptorSetLayout);
+
+    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {};
+    descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptorSetAllocateInfo.descriptorPool = descriptorPool;
+    descriptorSetAllocateInfo.descriptorSetCount = pyramidLevels;
+    descriptorSetAllocateInfo.pSetLayouts = std::data(setLayouts);
+
+    err = deviceTable.vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, std::data(depthPyramidDescriptorSets));
+    VK_CHECK_ERROR(err);
+
+    for (uint32_t level = 0; level < pyramidLevels; level++) {
+        /* 第 0 级从深度缓冲读取，其余从上一级读取 */
+        VkDescriptorImageInfo srcInfo = level == 0
+            ? VkDescriptorImageInfo { depthPyramidSampler, depthTexture->vkImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL }
+            : VkDescriptorImageInfo { depthPyramidSampler, depthPyramidMipViews[level - 1], VK_IMAGE_LAYOUT_GENERAL };
+        VkDescriptorImageInfo dstInfo = { VK_NULL_HANDLE, depthPyramidMipViews[level], VK_IMAGE_LAYOUT_GENERAL };
+
+        VkWriteDescriptorSet writes[] = {
+            { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, VK_NULL_HANDLE, depthPyramidDescriptorSets[level], 0, 0, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &srcInfo, VK_NULL_HANDLE, VK_NULL_HANDLE },
+            { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, VK_NULL_HANDLE, depthPyramidDescriptorSets[level], 1, 0, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, &dstInfo, VK_NULL_HANDLE, VK_NULL_HANDLE },
+        };
+
+        deviceTable.vkUpdateDescriptorSets(device, ARRAY_SIZE(writes), writes, 0, VK_NULL_HANDLE);
+    }
+
+    err = CreateBuffer(sizeof(DepthPyramidParams), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, &depthPyramidParams);
+    VK_CHECK_ERROR(err);
+
+    /* pyramid 转到 GENERAL，参数清零 (valid = 0)，第一帧不做遮挡测试 */
+    VkCommandBuffer commandBuffer;
+    err = CreateCommandBuffer(&commandBuffer);
+    VK_CHECK_ERROR(err);
+
+    BeginCommandBuffer(commandBuffer);
+    CmdTextureMemoryBarrier(commandBuffer, depthPyramid, VK_IMAGE_LAYOUT_GENERAL);
+    deviceTable.vkCmdFillBuffer(commandBuffer, depthPyramidParams->vkBuffer, 0, VK_WHOLE_SIZE, 0);
+    EndCommandBuffer(commandBuffer);
+
+    SubmitQueue(commandBuffer, VK_NULL_HANDLE, VK_NULL_HANDLE, submitFence);
+    deviceTable.vkWaitForFences(device, 1, &submitFence, VK_TRUE, UINT64_MAX);
+    DestroyCommandBuffer(commandBuffer);
+
+    _UpdateRenderExtent();
+
+    return err;
+}
+
+void RenderDriver::_DestroyRenderTargets()
+{
+    if (!depthPyramidDescriptorSets.empty())
+        deviceTable.vkFreeDescriptorSets(device, descriptorPool, std::size(depthPyramidDescriptorSets), std::data(depthPyramidDescriptorSets));
+    depthPyramidDescriptorSets.clear();
+
+    for (VkImageView imageView : depthPyramidMipViews)
+        vkDestroyImageView(device, imageView, VK_NULL_HANDLE);
+    depthPyramidMipViews.clear();
+
+    DestroyBuffer(depthPyramidParams);
+    DestroyTexture2D(depthPyramid);
+    DestroyTexture2D(depthTexture);
+    DestroyTexture2D(sceneColor);
+}
+
+void RenderDriver::_UpdateRenderExtent()
+{
+    float scale = dynamicResolution.GetScale();
+
+    renderExtent2D.width = std::clamp(static_cast<uint32_t>(swapchainExtent2D.width * scale), 1u, sceneColor->width);
+    renderExtent2D.height = std::clamp(static_cast<uint32_t>(swapchainExtent2D.height * scale), 1u, sceneColor->height);
+}
+
+void RenderDriver::_CmdImageBarrier(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+                                    VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask,
+                                    VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask)
+{
+    VkImageMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = srcAccessMask,
+        .dstAccessMask = dstAccessMask,
+        .oldLayout = oldLayout,
+        .newLayout = newLayout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        }
+    };
+
+    deviceTable.vkCmdPipelineBarrier(commandBuffer,
+                                     srcStageMask,
+                                     dstStageMask,
+                                     0,
+                                     0, VK_NULL_HANDLE,
+                                     0, VK_NULL_HANDLE,
+                                     1, &barrier);
+}
+
+/* FNV-1a 64，着色器缓存按 SPIR-V 内容去重 */
+static uint64_t _HashShaderCode(const void* code, size_t size)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(code);
+
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+
+    return hash ^ size;
+}
+
+VkResult RenderDriver::_AcquireShaderModule(const char* shaderName, const char* stage, VkBool32 requireCode, ShaderCacheEntry** ppEntry)
+{
+    VkResult err = VK_SUCCESS;
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s.%s.spv", shaderName, stage);
+
+    /* 已加载过的着色器不再读文件，只剩标识符的条目在需要 SPIR-V 时重新加载 */
+    std::unique_lock<std::mutex> lock(shaderCacheMutex);
+
+    auto named = shaderNameCache.find(path);
+    if (named != shaderNameCache.end()) {
+        ShaderCacheEntry* pEntry = &shaderCache[named->second];
+        if (pEntry->module != VK_NULL_HANDLE || !pEntry->code.empty() || (!requireCode && pEntry->identifierSize > 0)) {
+            shaderCacheStatistics.hits++;
+            *ppEntry = pEntry;
+            return err;
+        }
+    }
+
+    /* 读文件期间不持有锁，其他线程可以同时加载别的着色器 */
+    lock.unlock();
+
+    QK_PROFILE_ZONE("CreateShaderModule");
+
+    size_t size;
+
+    /* 优先从资源包的映射中直接读取，不存在时回退到单独的文件 */
+    const void* code = VK_NULL_HANDLE;
+    char *buf = VK_NULL_HANDLE;
+    AssetSpan span = {};
+
+    if (assetPack != VK_NULL_HANDLE && io_pack_find(assetPack, path, &span)) {
+        code = span.data;
+        size = span.size;
+    } else {
+        buf = io_read_bytecode(path, &size);
+        if (buf == VK_NULL_HANDLE) {
+            printf("[vulkan] shader module %s not found\n", path);
+            return VK_ERROR_INITIALIZATION_FAILED;
+        }
+        code = buf;
+    }
+
+    uint64_t hash = _HashShaderCode(code, size);
+
+    lock.lock();
+
+    /* 不同名字但内容相同的着色器共享同一个条目，哈希冲突时顺延到下一个键 */
+    ShaderCacheEntry* pEntry = VK_NULL_HANDLE;
+    for (;;) {
+        auto found = shaderCache.find(hash);
+        if (found == shaderCache.end()) {
+            pEntry = &shaderCache[hash];
+            break;
+        }
+
+        if (_MatchShaderKey(found->second, code, size)) {
+            pEntry = &found->second;
+            break;
+        }
+
+        shaderCacheStatistics.collisions++;
+        hash++;
+    }
+
+    shaderNameCache[path] = hash;
+
+    if (pEntry->module != VK_NULL_HANDLE || !pEntry->code.empty()) {
+        if (buf != VK_NULL_HANDLE)
+            io_free_buf(buf);
+        shaderCacheStatistics.hits++;
+        *ppEntry = pEntry;
+        return err;
+    }
+
+    shaderCacheStatistics.misses++;
+    printf("[vulkan] load shader module %s, code size=%ld%s\n", path, size, buf == VK_NULL_HANDLE ? " (pack)" : "");
+
+    VkShaderModuleCreateInfo shaderModuleCreateInfo = {};
+    shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    shaderModuleCreateInfo.codeSize = size;
+    shaderModuleCreateInfo.pCode = static_cast<const uint32_t*>(code);
+
+    if (shaderStageMode == SHADER_STAGE_MODE_INLINE) {
+        pEntry->code.assign(shaderModuleCreateInfo.pCode, shaderModuleCreateInfo.pCode + size / sizeof(uint32_t));
+        shaderCacheStatistics.inlineCodeBytes += size;
+    } else {
+        err = vkCreateShaderModule(device, &shaderModuleCreateInfo, VK_NULL_HANDLE, &pEntry->module);
+        pEntry->key.assign(shaderModuleCreateInfo.pCode, shaderModuleCreateInfo.pCode + size / sizeof(uint32_t));
+    }
+
+    /* 标识符只取决于 SPIR-V 内容，不需要真正创建模块也能查询 */
+    if (err == VK_SUCCESS && shaderModuleIdentifierSupported && pEntry->identifierSize == 0) {
+        VkShaderModuleIdentifierEXT identifier = {};
+        identifier.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_IDENTIFIER_EXT;
+
+        if (pEntry->module != VK_NULL_HANDLE)
+            deviceTable.vkGetShaderModuleIdentifierEXT(device, pEntry->module, &identifier);
+        else
+            deviceTable.vkGetShaderModuleCreateInfoIdentifierEXT(device, &shaderModuleCreateInfo, &identifier);
+
+        pEntry->identifierSize = std::min<uint32_t>(identifier.identifierSize, VK_MAX_SHADER_MODULE_IDENTIFIER_SIZE_EXT);
+        memcpy(pEntry->identifier, identifier.identifier, pEntry->identifierSize);
+    }
+
+    if (buf != VK_NULL_HANDLE)
+        io_free_buf(buf);
+    VK_CHECK_ERROR(err);
+
+    *ppEntry = pEntry;
+
+    return err;
+}
+
+VkBool32 RenderDriver::_ValidatePipelineCacheData(const void* data, size_t size) const
+{
+    VkPipelineCacheHeaderVersionOne header = {};
+    if (size < sizeof(header)) {
+        printf("[vulkan] pipeline cache %s truncated, discarded\n", PIPELINE_CACHE_PATH);
+        return VK_FALSE;
+    }
+
+    memcpy(&header, data, sizeof(header));
+
+    /* 驱动、设备或驱动版本（pipelineCacheUUID）变化后旧数据无效 */
+    if (header.headerSize < sizeof(header) || header.headerSize > size
+        || header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+        || header.vendorID != physicalDeviceProperties.vendorID
+        || header.deviceID != physicalDeviceProperties.deviceID
+        || memcmp(header.pipelineCacheUUID, physicalDeviceProperties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+        printf("[vulkan] pipeline cache %s does not match this device, discarded\n", PIPELINE_CACHE_PATH);
+        return VK_FALSE;
+    }
+
+    return VK_TRUE;
+}
+
+void RenderDriver::_SavePipelineCache()
+{
+    if (pipelineCache == VK_NULL_HANDLE)
+        return;
+
+    size_t size = 0;
+    if (vkGetPipelineCacheData(device, pipelineCache, &size, VK_NULL_HANDLE) != VK_SUCCESS || size == 0)
+        return;
+
+    std::vector<char> data(size);
+    if (vkGetPipelineCacheData(device, pipelineCache, &size, std::data(data)) != VK_SUCCESS)
+        return;
+
+    /* 先写临时文件再替换，中途退出不会留下损坏的缓存 */
+    char tempPath[PATH_MAX];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", PIPELINE_CACHE_PATH);
+
+    FILE* file = fopen(tempPath, "wb");
+    if (file == VK_NULL_HANDLE)
+        return;
+
+    bool written = fwrite(std::data(data), 1, size, file) == size;
+    written = fclose(file) == 0 && written;
+
+    remove(PIPELINE_CACHE_PATH);
+    if (!written || rename(tempPath, PIPELINE_CACHE_PATH) != 0) {
+        remove(tempPath);
+        return;
+    }
+
+    printf("[vulkan] save pipeline cache %s, size=%zu\n", PIPELINE_CACHE_PATH, size);
+}
+
+VkBool32 RenderDriver::_MatchShaderKey(const ShaderCacheEntry& entry, const void* code, size_t size) const
+{
+    /* 上次创建失败留下的空条目直接复用 */
+    if (entry.module == VK_NULL_HANDLE && entry.code.empty() && entry.key.empty() && entry.identifierSize == 0)
+        return VK_TRUE;
 
-    /* Create swapchain resources */
-    err = vkGetSwapchainImagesKHR(device, swapchain, &minImageCount, nullptr);
-    VK_CHECK_ERROR(err);
+    /* 优先逐字节比较保留的 SPIR-V，代码已释放时比较驱动根据内容给出的标识符 */
+    const std::vector<uint32_t>& key = !entry.code.empty() ? entry.code : entry.key;
+    if (!key.empty())
+        return key.size() * sizeof(uint32_t) == size && memcmp(std::data(key), code, size) == 0;
 
-    swapchainImages.resize(minImageCount);
-    swapchainImageViews.resize(minImageCount);
-    renderFinishedSemaphores.resize(minImageCount);
-    
-    err = vkGetSwapchainImagesKHR(device, swapchain, &minImageCount, std::data(swapchainImages));
-    VK_CHECK_ERROR(err);
+    if (entry.identifierSize == 0)
+        return VK_FALSE;
 
-    for (uint32_t i = 0; i < minImageCount; i++) {
-        VkImage swapchainImage = swapchainImages[i];
+    VkShaderModuleCreateInfo shaderModuleCreateInfo = {};
+    shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    shaderModuleCreateInfo.codeSize = size;
+    shaderModuleCreateInfo.pCode = static_cast<const uint32_t*>(code);
 
-        VkImageViewCreateInfo imageViewCreateInfo = {};
-        imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-        imageViewCreateInfo.image = swapchainImage;
-        imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-        imageViewCreateInfo.format = surfaceFormat.format;
-        imageViewCreateInfo.components = {
-            VK_COMPONENT_SWIZZLE_IDENTITY,
-            VK_COMPONENT_SWIZZLE_IDENTITY,
-            VK_COMPONENT_SWIZZLE_IDENTITY,
-            VK_COMPONENT_SWIZZLE_IDENTITY
-        };
-        imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
-        imageViewCreateInfo.subresourceRange.levelCount = 1;
-        imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
-        imageViewCreateInfo.subresourceRange.layerCount = 1;
-        imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    VkShaderModuleIdentifierEXT identifier = {};
+    identifier.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_IDENTIFIER_EXT;
+    deviceTable.vkGetShaderModuleCreateInfoIdentifierEXT(device, &shaderModuleCreateInfo, &identifier);
 
-        err = vkCreateImageView(device, &imageViewCreateInfo, VK_NULL_HANDLE, &swapchainImageViews[i]);
-        VK_CHECK_ERROR(err);
+    return identifier.identifierSize == entry.identifierSize && memcmp(identifier.identifier, entry.identifier, entry.identifierSize) == 0;
+}
 
-        err = _CreateSemaphore(&renderFinishedSemaphores[i]);
-        VK_CHECK_ERROR(err);
+VkBool32 RenderDriver::_CanUseShaderIdentifiers(ShaderCacheEntry* const* ppEntries, uint32_t count) const
+{
+    if (!shaderModuleIdentifierSupported)
+        return VK_FALSE;
+
+    /* 有 SPIR-V 时直接提供，驱动同样会命中管线缓存，只有代码已释放时标识符才有意义 */
+    VkBool32 released = VK_FALSE;
+    for (uint32_t i = 0; i < count; i++) {
+        if (ppEntries[i]->identifierSize == 0)
+            return VK_FALSE;
+        if (ppEntries[i]->module == VK_NULL_HANDLE && ppEntries[i]->code.empty())
+            released = VK_TRUE;
     }
 
-    return err;
+    return released;
 }
 
-VkResult RenderDriver::_CreateCommandPool()
+void RenderDriver::_FillShaderStage(const ShaderCacheEntry* pEntry, VkShaderStageFlagBits stage, VkBool32 useIdentifier,
+                                    VkShaderModuleCreateInfo* pModuleCreateInfo, VkPipelineShaderStageModuleIdentifierCreateInfoEXT* pIdentifierCreateInfo,
+                                    VkPipelineShaderStageCreateInfo* pStageCreateInfo) const
 {
-    VkResult err;
-
-    VkCommandPoolCreateInfo commandPoolCreateInfo = {};
-    commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT
-                                  | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
-    commandPoolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+    *pStageCreateInfo = {};
+    pStageCreateInfo->sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pStageCreateInfo->stage = stage;
+    pStageCreateInfo->pName = "main";
+
+    if (useIdentifier) {
+        *pIdentifierCreateInfo = {};
+        pIdentifierCreateInfo->sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_MODULE_IDENTIFIER_CREATE_INFO_EXT;
+        pIdentifierCreateInfo->identifierSize = pEntry->identifierSize;
+        pIdentifierCreateInfo->pIdentifier = pEntry->identifier;
+        pStageCreateInfo->pNext = pIdentifierCreateInfo;
+    } else if (pEntry->module != VK_NULL_HANDLE) {
+        pStageCreateInfo->module = pEntry->module;
+    } else {
+        *pModuleCreateInfo = {};
+        pModuleCreateInfo->sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        pModuleCreateInfo->codeSize = pEntry->code.size() * sizeof(uint32_t);
+        pModuleCreateInfo->pCode = pEntry->code.data();
+        pStageCreateInfo->pNext = pModuleCreateInfo;
+    }
+}
 
-    err = vkCreateCommandPool(device, &commandPoolCreateInfo, VK_NULL_HANDLE, &commandPool);
-    VK_CHECK_ERROR(err);
+void RenderDriver::SetShaderStageMode(ShaderStageMode mode)
+{
+    if (mode == SHADER_STAGE_MODE_INLINE && !inlineShaderStageSupported) {
+        printf("[vulkan] VK_KHR_maintenance5 not supported, inline shader stages fall back to shader modules\n");
+        mode = SHADER_STAGE_MODE_MODULE;
+    }
 
-    return err;
+    shaderStageMode = mode;
 }
 
-VkResult RenderDriver::_CreateDescriptorPool()
+void RenderDriver::ReleaseShaderCode()
 {
-    VkResult err;
+    std::lock_guard<std::mutex> lock(shaderCacheMutex);
 
-    VkDescriptorPoolSize pool_size[] = {
-        { VK_DESCRIPTOR_TYPE_SAMPLER,                256 },
-        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 256 },
-        { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,          256 },
-        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,          256 },
-        { VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER,   256 },
-        { VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER,   256 },
-        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         256 },
-        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         256 },
-        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 256 },
-        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 256 },
-        { VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,       256 },
-    };
+    /* 管线创建后模块即可销毁，已有管线不受影响 */
+    for (auto it = shaderCache.begin(); it != shaderCache.end(); ) {
+        ShaderCacheEntry& entry = it->second;
 
-    VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {};
-    descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    descriptorPoolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-    descriptorPoolCreateInfo.maxSets = 1024;
-    descriptorPoolCreateInfo.poolSizeCount = ARRAY_SIZE(pool_size);
-    descriptorPoolCreateInfo.pPoolSizes = pool_size;
+        vkDestroyShaderModule(device, entry.module, VK_NULL_HANDLE);
+        entry.module = VK_NULL_HANDLE;
 
-    err = vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, VK_NULL_HANDLE, &descriptorPool);
-    VK_CHECK_ERROR(err);
+        shaderCacheStatistics.inlineCodeBytes -= entry.code.size() * sizeof(uint32_t);
+        entry.code.clear();
+        entry.code.shrink_to_fit();
+        entry.key.clear();
+        entry.key.shrink_to_fit();
 
-    return err;
+        it = entry.identifierSize > 0 ? std::next(it) : shaderCache.erase(it);
+    }
+
+    for (auto it = shaderNameCache.begin(); it != shaderNameCache.end(); )
+        it = shaderCache.count(it->second) ? std::next(it) : shaderNameCache.erase(it);
 }
 
-VkResult RenderDriver::_CreateShaderModule(const char* shaderName, const char* stage, VkShaderModule* pShaderModule)
+void RenderDriver::GetShaderCacheStatistics(ShaderCacheStatistics* pStatistics) const
 {
-    size_t size;
+    std::lock_guard<std::mutex> lock(shaderCacheMutex);
+
+    *pStatistics = shaderCacheStatistics;
+    pStatistics->entryCount = static_cast<uint32_t>(shaderCache.size());
+}
+
+VkResult RenderDriver::CreateComputePipeline(const char* shaderName, uint32_t bindingCount, const VkDescriptorSetLayoutBinding* pBindings, uint32_t pushConstantSize, Pipeline* pPipeline)
+{
+    QK_PROFILE_ZONE("CreateComputePipeline");
+
     VkResult err;
 
-    char path[PATH_MAX];
-    snprintf(path, sizeof(path), "%s.%s.spv", shaderName, stage);
+    /* VkDescriptorSetLayout */
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = {};
+    descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descriptorSetLayoutCreateInfo.bindingCount = bindingCount;
+    descriptorSetLayoutCreateInfo.pBindings = pBindings;
+
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    err = vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, VK_NULL_HANDLE, &descriptorSetLayout);
+    VK_CHECK_ERROR(err);
+
+    /* VkPipelineLayoutCreateInfo */
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = pushConstantSize;
 
-    char *buf = io_read_bytecode(path, &size);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = pushConstantSize > 0 ? 1 : 0;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    err = vkCreatePipelineLayout(device, &pipelineLayoutInfo, VK_NULL_HANDLE, &pipelineLayout);
+    if (err != VK_SUCCESS) {
+        _DestroyPipelineLayouts(pipelineLayout, descriptorSetLayout);
+        return err;
+    }
 
-    printf("[vulkan] load shader module %s, code size=%ld\n", path, size);
+    /* shader stage */
+    ShaderCacheEntry* shaderEntry = VK_NULL_HANDLE;
+    err = _AcquireShaderModule(shaderName, "comp", VK_FALSE, &shaderEntry);
+    if (err != VK_SUCCESS) {
+        _DestroyPipelineLayouts(pipelineLayout, descriptorSetLayout);
+        return err;
+    }
 
     VkShaderModuleCreateInfo shaderModuleCreateInfo = {};
-    shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    shaderModuleCreateInfo.codeSize = size;
-    shaderModuleCreateInfo.pCode = reinterpret_cast<uint32_t*>(buf);
+    VkPipelineShaderStageModuleIdentifierCreateInfoEXT shaderIdentifierCreateInfo = {};
 
-    err = vkCreateShaderModule(device, &shaderModuleCreateInfo, VK_NULL_HANDLE, pShaderModule);
-    io_free_buf(buf);
-    VK_CHECK_ERROR(err);
+    VkComputePipelineCreateInfo pipelineCreateInfo = {};
+    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineCreateInfo.layout = pipelineLayout;
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+
+    std::unique_lock<std::mutex> lock(shaderCacheMutex);
+    VkBool32 useIdentifiers = _CanUseShaderIdentifiers(&shaderEntry, 1);
+    if (useIdentifiers)
+        _FillShaderStage(shaderEntry, VK_SHADER_STAGE_COMPUTE_BIT, VK_TRUE, &shaderModuleCreateInfo, &shaderIdentifierCreateInfo, &pipelineCreateInfo.stage);
+    lock.unlock();
+
+    if (useIdentifiers) {
+        pipelineCreateInfo.flags = VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT;
+        err = vkCreateComputePipelines(device, pipelineCache, 1, &pipelineCreateInfo, VK_NULL_HANDLE, &pipeline);
+        pipelineCreateInfo.flags = 0;
+
+        lock.lock();
+        if (err == VK_SUCCESS) {
+            shaderCacheStatistics.identifierPipelines++;
+        } else if (err == VK_PIPELINE_COMPILE_REQUIRED) {
+            shaderCacheStatistics.identifierFallbacks++;
+            pipeline = VK_NULL_HANDLE;
+        } else {
+            _DestroyPipelineLayouts(pipelineLayout, descriptorSetLayout);
+            return err;
+        }
+        lock.unlock();
+    }
+
+    if (pipeline == VK_NULL_HANDLE) {
+        err = _AcquireShaderModule(shaderName, "comp", VK_TRUE, &shaderEntry);
+        if (err != VK_SUCCESS) {
+            _DestroyPipelineLayouts(pipelineLayout, descriptorSetLayout);
+            return err;
+        }
+
+        lock.lock();
+        _FillShaderStage(shaderEntry, VK_SHADER_STAGE_COMPUTE_BIT, VK_FALSE, &shaderModuleCreateInfo, &shaderIdentifierCreateInfo, &pipelineCreateInfo.stage);
+        lock.unlock();
+
+        err = vkCreateComputePipelines(device, pipelineCache, 1, &pipelineCreateInfo, VK_NULL_HANDLE, &pipeline);
+        if (err != VK_SUCCESS) {
+            _DestroyPipelineLayouts(pipelineLayout, descriptorSetLayout);
+            return err;
+        }
+    }
+
+    Pipeline ret = (Pipeline) malloc(sizeof(Pipeline_T));
+    ret->vkPipeline = pipeline;
+    ret->vkPipelineLayout = pipelineLayout;
+    ret->vkDescriptorSetLayout = descriptorSetLayout;
+    ret->vkBindPoint = VK_PIPELINE_BIND_POINT_COMPUTE;
+    *pPipeline = ret;
 
     return err;
 }
 
+VkResult RenderDriver::_AllocateFrameDescriptorSet(VkDescriptorSetLayout layout, VkDescriptorSet* pDescriptorSet)
+{
+    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {};
+    descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptorSetAllocateInfo.descriptorPool = frameDescriptorPools[flightIndex];
+    descriptorSetAllocateInfo.descriptorSetCount = 1;
+    descriptorSetAllocateInfo.pSetLayouts = &layout;
+
+    return deviceTable.vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, pDescriptorSet);
+}
+
 VkResult RenderDriver::_CreateFence(VkFence *pFence)
 {
     VkResult err;
@@ -1097,6 +3446,12 @@ void RenderDriver::_DestroySemaphore(VkSemaphore semaphore)
     vkDestroySemaphore(device, semaphore, VK_NULL_HANDLE);
 }
 
+void RenderDriver::_DestroyPipelineLayouts(VkPipelineLayout pipelineLayout, VkDescriptorSetLayout descriptorSetLayout)
+{
+    vkDestroyPipelineLayout(device, pipelineLayout, VK_NULL_HANDLE);
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, VK_NULL_HANDLE);
+}
+
 VkResult RenderDriver::_InitSyncObjects()
 {
     VkResult err;
@@ -1116,6 +3471,18 @@ VkResult RenderDriver::_InitSyncObjects()
         VK_CHECK_ERROR(err);
     }
 
+    VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo = {};
+    semaphoreTypeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    semaphoreTypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    semaphoreTypeCreateInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+    semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreCreateInfo.pNext = &semaphoreTypeCreateInfo;
+
+    err = vkCreateSemaphore(device, &semaphoreCreateInfo, VK_NULL_HANDLE, &frameTimelineSemaphore);
+    VK_CHECK_ERROR(err);
+
     return err;
 }
 
@@ -1127,6 +3494,56 @@ void RenderDriver::_DestroySyncObjects()
         _DestroyFence(inFlightFences[i]);
         _DestroySemaphore(imageAvailableSemaphores[i]);
     }
+
+    _DestroySemaphore(frameTimelineSemaphore);
+}
+
+VkResult RenderDriver::_CreateComputeQueueResources()
+{
+    VkResult err = VK_SUCCESS;
+
+    if (computeQueue == VK_NULL_HANDLE)
+        return err;
+
+    VkCommandPoolCreateInfo commandPoolCreateInfo = {};
+    commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    commandPoolCreateInfo.queueFamilyIndex = computeQueueFamilyIndex;
+
+    err = vkCreateCommandPool(device, &commandPoolCreateInfo, VK_NULL_HANDLE, &computeCommandPool);
+    VK_CHECK_ERROR(err);
+
+    computeCommandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+
+    VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandBufferAllocateInfo.commandBufferCount = MAX_FRAMES_IN_FLIGHT;
+    commandBufferAllocateInfo.commandPool = computeCommandPool;
+
+    err = vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, std::data(computeCommandBuffers));
+    VK_CHECK_ERROR(err);
+
+    computeFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+    computeSubmitted.resize(MAX_FRAMES_IN_FLIGHT, VK_FALSE);
+
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        err = _CreateSemaphore(&computeFinishedSemaphores[i]);
+        VK_CHECK_ERROR(err);
+    }
+
+    return err;
+}
+
+VkSharingMode RenderDriver::_ChooseSharingMode(VkBool32 shared, uint32_t* pQueueFamilyIndexCount) const
+{
+    if (shared && computeQueue != VK_NULL_HANDLE) {
+        *pQueueFamilyIndexCount = 2;
+        return VK_SHARING_MODE_CONCURRENT;
+    }
+
+    *pQueueFamilyIndexCount = 0;
+    return VK_SHARING_MODE_EXCLUSIVE;
 }
 
 VmaMemoryUsage RenderDriver::_GuessMemoryUsage(VkBufferUsageFlags usage)
@@ -1145,4 +3562,262 @@ VmaMemoryUsage RenderDriver::_GuessMemoryUsage(VkBufferUsageFlags usage)
 
     // 默认：CPU -> GPU
     return VMA_MEMORY_USAGE_CPU_TO_GPU;
+}
+
+MemoryCategory RenderDriver::_GuessMemoryCategory(VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage)
+{
+    if (memoryUsage == VMA_MEMORY_USAGE_GPU_TO_CPU)
+        return MEMORY_CATEGORY_READBACK;
+
+    if (memoryUsage == VMA_MEMORY_USAGE_CPU_TO_GPU && (usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT))
+        return MEMORY_CATEGORY_STAGING;
+
+    if (usage & VK_BUFFER_USAGE_VERTEX_BUFFER_BIT)
+        return MEMORY_CATEGORY_VERTEX;
+
+    if (usage & VK_BUFFER_USAGE_INDEX_BUFFER_BIT)
+        return MEMORY_CATEGORY_INDEX;
+
+    if (usage & VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT)
+        return MEMORY_CATEGORY_INDIRECT;
+
+    if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
+        return MEMORY_CATEGORY_UNIFORM;
+
+    if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+        return MEMORY_CATEGORY_STORAGE;
+
+    return MEMORY_CATEGORY_GENERIC;
+}
+
+const char* RenderDriver::GetMemoryCategoryName(MemoryCategory category)
+{
+    switch (category) {
+        case MEMORY_CATEGORY_GENERIC:       return "generic";
+        case MEMORY_CATEGORY_VERTEX:        return "vertex";
+        case MEMORY_CATEGORY_INDEX:         return "index";
+        case MEMORY_CATEGORY_UNIFORM:       return "uniform";
+        case MEMORY_CATEGORY_STORAGE:       return "storage";
+        case MEMORY_CATEGORY_INDIRECT:      return "indirect";
+        case MEMORY_CATEGORY_STAGING:       return "staging";
+        case MEMORY_CATEGORY_READBACK:      return "readback";
+        case MEMORY_CATEGORY_TEXTURE:       return "texture";
+        case MEMORY_CATEGORY_RENDER_TARGET: return "render target";
+        default:                            return "unknown";
+    }
+}
+
+void RenderDriver::GetMemoryStatistics(MemoryStatistics* pStatistics) const
+{
+    *pStatistics = memoryStatistics;
+    pStatistics->defragmenting = defragmentationContext != VK_NULL_HANDLE;
+}
+
+VkResult RenderDriver::DumpMemoryStatistics(const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if (file == VK_NULL_HANDLE)
+        return VK_ERROR_INITIALIZATION_FAILED;
+
+    char* statsString = VK_NULL_HANDLE;
+    vmaBuildStatsString(allocator, &statsString, VK_TRUE);
+    fputs(statsString, file);
+    vmaFreeStatsString(allocator, statsString);
+
+    fclose(file);
+    printf("[vulkan] memory statistics dumped to %s\n", path);
+
+    return VK_SUCCESS;
+}
+
+void RenderDriver::SetMemoryBudgetCallback(PFN_MemoryBudgetCallback callback, float threshold, void* pUserData)
+{
+    memoryBudgetCallback = callback;
+    memoryBudgetThreshold = threshold;
+    memoryBudgetUserData = pUserData;
+}
+
+VkResult RenderDriver::BeginDefragmentation()
+{
+    if (defragmentationContext != VK_NULL_HANDLE)
+        return VK_SUCCESS;
+
+    /* 每帧最多搬移的量，控制单帧拷贝开销 */
+    VmaDefragmentationInfo defragmentationInfo = {};
+    defragmentationInfo.flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT;
+    defragmentationInfo.maxBytesPerPass = 16ull * 1024 * 1024;
+    defragmentationInfo.maxAllocationsPerPass = 64;
+
+    return vmaBeginDefragmentation(allocator, &defragmentationInfo, &defragmentationContext);
+}
+
+void RenderDriver::_TrackAllocation(MemoryCategory category, VkDeviceSize size, int32_t sign)
+{
+    MemoryCategoryStatistics& stats = memoryStatistics.categories[category];
+
+    if (sign > 0) {
+        stats.allocationCount++;
+        stats.bytes += size;
+    } else {
+        stats.allocationCount--;
+        stats.bytes -= size;
+    }
+}
+
+void RenderDriver::_UpdateMemoryBudget()
+{
+    vmaSetCurrentFrameIndex(allocator, static_cast<uint32_t>(frameNumber));
+    vmaGetHeapBudgets(allocator, memoryStatistics.heapBudgets);
+
+    if (memoryBudgetCallback == VK_NULL_HANDLE)
+        return;
+
+    for (uint32_t i = 0; i < memoryStatistics.heapCount; i++) {
+        const VmaBudget& budget = memoryStatistics.heapBudgets[i];
+
+        if (budget.budget > 0 && budget.usage > static_cast<VkDeviceSize>(budget.budget * memoryBudgetThreshold))
+            memoryBudgetCallback(i, budget.usage, budget.budget, memoryBudgetUserData);
+    }
+}
+
+/**
+ * 增量碎片整理，每帧最多推进一个 pass：
+ *
+ *   1. vmaBeginDefragmentationPass 给出要搬移的分配，为每个 buffer 在新位置创建 VkBuffer，
+ *      录制拷贝并立即把句柄切换到新 buffer，之后录制的帧使用新位置；
+ *   2. 等 MAX_FRAMES_IN_FLIGHT 帧之后，引用旧 buffer 的帧和拷贝都已完成，
+ *      销毁旧 buffer 并 vmaEndDefragmentationPass 释放旧内存。
+ */
+void RenderDriver::_StepDefragmentation()
+{
+    VkResult err;
+
+    if (defragmentationContext == VK_NULL_HANDLE)
+        return;
+
+    if (defragmentationPassPending) {
+        if (frameNumber < defragmentationPassFrame + MAX_FRAMES_IN_FLIGHT)
+            return;
+
+        _EndDefragmentationPass();
+
+        if (defragmentationContext == VK_NULL_HANDLE)
+            return;
+    }
+
+    err = vmaBeginDefragmentationPass(allocator, defragmentationContext, &defragmentationPass);
+
+    if (err != VK_INCOMPLETE) {
+        _EndDefragmentation();
+        return;
+    }
+
+    err = CreateCommandBuffer(&defragmentationCommandBuffer);
+    assert(!err);
+    BeginCommandBuffer(defragmentationCommandBuffer);
+
+    for (uint32_t i = 0; i < defragmentationPass.moveCount; i++) {
+        VmaDefragmentationMove& move = defragmentationPass.pMoves[i];
+
+        VmaAllocationInfo allocationInfo = {};
+        vmaGetAllocationInfo(allocator, move.srcAllocation, &allocationInfo);
+
+        /* 只有 buffer 设置了 pUserData，纹理的 view 和描述符无法安全重建 */
+        Buffer buffer = static_cast<Buffer>(allocationInfo.pUserData);
+        if (buffer == VK_NULL_HANDLE || !buffer->relocatable) {
+            move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+            continue;
+        }
+
+        VkBufferCreateInfo bufferCreateInfo = {};
+        bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferCreateInfo.size = buffer->size;
+        bufferCreateInfo.usage = buffer->usage;
+        bufferCreateInfo.sharingMode = _ChooseSharingMode(buffer->usage & (VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT), &bufferCreateInfo.queueFamilyIndexCount);
+        bufferCreateInfo.pQueueFamilyIndices = sharedQueueFamilyIndices;
+
+        VkBuffer newBuffer = VK_NULL_HANDLE;
+        err = vkCreateBuffer(device, &bufferCreateInfo, VK_NULL_HANDLE, &newBuffer);
+        if (err != VK_SUCCESS) {
+            move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+            continue;
+        }
+
+        err = vmaBindBufferMemory(allocator, move.dstTmpAllocation, newBuffer);
+        if (err != VK_SUCCESS) {
+            vkDestroyBuffer(device, newBuffer, VK_NULL_HANDLE);
+            move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+            continue;
+        }
+
+        VkBufferCopy copyRegion = { 0, 0, buffer->size };
+        deviceTable.vkCmdCopyBuffer(defragmentationCommandBuffer, buffer->vkBuffer, newBuffer, 1, &copyRegion);
+
+        defragmentationRetiredBuffers.push_back(buffer->vkBuffer);
+        defragmentationMovedBuffers.push_back(buffer);
+        buffer->vkBuffer = newBuffer;
+    }
+
+    /* 之后提交的所有命令都能看到搬移后的数据 */
+    VkMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+    };
+
+    deviceTable.vkCmdPipelineBarrier(defragmentationCommandBuffer,
+                                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                     VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                                     0,
+                                     1, &barrier,
+                                     0, VK_NULL_HANDLE,
+                                     0, VK_NULL_HANDLE);
+
+    EndCommandBuffer(defragmentationCommandBuffer);
+    SubmitQueue(defragmentationCommandBuffer, VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE);
+
+    defragmentationPassPending = VK_TRUE;
+    defragmentationPassFrame = frameNumber;
+}
+
+void RenderDriver::_EndDefragmentationPass()
+{
+    /* 正常情况下由 _StepDefragmentation 在帧数足够后调用，此时 GPU 已经不再使用旧 buffer；
+       其余情况 (销毁资源、析构) 直接等待设备空闲 */
+    if (frameNumber < defragmentationPassFrame + MAX_FRAMES_IN_FLIGHT)
+        vkDeviceWaitIdle(device);
+
+    for (VkBuffer retiredBuffer : defragmentationRetiredBuffers)
+        vkDestroyBuffer(device, retiredBuffer, VK_NULL_HANDLE);
+    defragmentationRetiredBuffers.clear();
+
+    DestroyCommandBuffer(defragmentationCommandBuffer);
+    defragmentationCommandBuffer = VK_NULL_HANDLE;
+    defragmentationPassPending = VK_FALSE;
+
+    VkResult err = vmaEndDefragmentationPass(allocator, defragmentationContext, &defragmentationPass);
+
+    /* 旧分配句柄此时已经指向新内存 */
+    for (Buffer buffer : defragmentationMovedBuffers)
+        vmaGetAllocationInfo(allocator, buffer->allocation, &buffer->allocationInfo);
+    defragmentationMovedBuffers.clear();
+
+    if (err == VK_SUCCESS)
+        _EndDefragmentation();
+}
+
+void RenderDriver::_EndDefragmentation()
+{
+    VmaDefragmentationStats stats = {};
+    vmaEndDefragmentation(allocator, defragmentationContext, &stats);
+    defragmentationContext = VK_NULL_HANDLE;
+
+    memoryStatistics.defragmentationMoves += stats.allocationsMoved;
+    memoryStatistics.defragmentationBytesMoved += stats.bytesMoved;
+    memoryStatistics.defragmentationBytesFreed += stats.bytesFreed;
+
+    printf("[vulkan] defragmentation finished, moved %u allocations (%llu bytes), freed %llu bytes\n",
+           stats.allocationsMoved,
+           static_cast<unsigned long long>(stats.bytesMoved),
+           static_cast<unsigned long long>(stats.bytesFreed));
 }
\ No newline at end of file
@@ -10,27 +10,197 @@
 #include <vma/vk_mem_alloc.h>
 #include <quokka/typedefs.h>
 
+#include "dynamic_resolution.h"
+#include "core/job/job_system.h"
+#include "utils/asset_pack.h"
+
 // std
 #include <assert.h>
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 typedef struct Texture2D_T *Texture2D;
 typedef struct Buffer_T *Buffer;
 typedef struct Pipeline_T *Pipeline;
 
+/* 显存统计分类，创建资源时根据用途推断 */
+enum MemoryCategory
+{
+    MEMORY_CATEGORY_GENERIC = 0,
+    MEMORY_CATEGORY_VERTEX,
+    MEMORY_CATEGORY_INDEX,
+    MEMORY_CATEGORY_UNIFORM,
+    MEMORY_CATEGORY_STORAGE,
+    MEMORY_CATEGORY_INDIRECT,
+    MEMORY_CATEGORY_STAGING,
+    MEMORY_CATEGORY_READBACK,
+    MEMORY_CATEGORY_TEXTURE,
+    MEMORY_CATEGORY_RENDER_TARGET,
+    MEMORY_CATEGORY_COUNT,
+};
+
+struct MemoryCategoryStatistics
+{
+    uint32_t allocationCount;
+    VkDeviceSize bytes;
+};
+
+struct MemoryStatistics
+{
+    uint32_t heapCount;
+    VmaBudget heapBudgets[VK_MAX_MEMORY_HEAPS];
+    VkMemoryHeapFlags heapFlags[VK_MAX_MEMORY_HEAPS];
+    MemoryCategoryStatistics categories[MEMORY_CATEGORY_COUNT];
+    VkBool32 memoryBudgetExtension;
+    VkBool32 defragmenting;
+    uint32_t defragmentationMoves;
+    VkDeviceSize defragmentationBytesMoved;
+    VkDeviceSize defragmentationBytesFreed;
+};
+
+/* 某个堆的使用量超过 预算 * threshold 时每帧回调一次，用于驱逐资源 */
+typedef void (*PFN_MemoryBudgetCallback)(uint32_t heapIndex, VkDeviceSize usage, VkDeviceSize budget, void* pUserData);
+
+/* Hi-Z 遮挡剔除的输入对象，std430 布局与 qk_hiz_cull.comp 保持一致 */
+struct OcclusionCullObject
+{
+    float sphere[4];                    // xyz = 世界空间包围球中心, w = 半径
+    uint32_t vertexCount;
+    uint32_t firstVertex;
+    uint32_t _padding[2];
+};
+
+/*
+ * 图形管线描述。set 0 的 binding 由调用方给出，per-draw 数据走动态偏移的
+ * UBO/SSBO 时把 binding 声明为 UNIFORM_BUFFER_DYNAMIC / STORAGE_BUFFER_DYNAMIC，
+ * 描述符集只写一次，每个 draw 只改绑定时的偏移。
+ */
+enum PipelineBlendMode
+{
+    PIPELINE_BLEND_MODE_OPAQUE,
+    PIPELINE_BLEND_MODE_ALPHA,              // src * a + dst * (1 - a)
+    PIPELINE_BLEND_MODE_ADDITIVE,           // src * a + dst
+};
+
+struct GraphicsPipelineCreateInfo
+{
+    const char* shaderName = VK_NULL_HANDLE;
+    const char* fragmentShaderName = VK_NULL_HANDLE;        // 为空时与 shaderName 相同，用于只有片元阶段不同的变体
+    uint32_t bindingCount = 0;
+    const VkDescriptorSetLayoutBinding* pBindings = VK_NULL_HANDLE;
+    uint32_t pushConstantSize = sizeof(float) * 16;
+    VkShaderStageFlags pushConstantStages = VK_SHADER_STAGE_VERTEX_BIT;
+    const VkSpecializationInfo* pSpecializationInfo = VK_NULL_HANDLE;     // 顶点和片元阶段共用
+    const VkPipelineVertexInputStateCreateInfo* pVertexInputState = VK_NULL_HANDLE;  // 为空时使用 pos2 + color3
+    VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+    VkBool32 depthWriteEnable = VK_TRUE;
+    PipelineBlendMode blendMode = PIPELINE_BLEND_MODE_OPAQUE;
+    VkBool32 depthOnly = VK_FALSE;                          // 没有颜色附件，只加载顶点着色器
+    VkFormat depthFormat = VK_FORMAT_UNDEFINED;             // UNDEFINED 时使用场景深度格式
+    float depthBiasConstant = 0.0f;                         // 两者都为 0 时不启用深度偏移
+    float depthBiasSlope = 0.0f;
+    VkFormat colorFormat = VK_FORMAT_UNDEFINED;             // UNDEFINED 时使用场景颜色格式
+    uint32_t viewMask = 0;                                  // 非 0 时为多视图管线，与 CmdBeginMultiviewRendering 的 viewMask 相同
+};
+
+/* 每帧临时数据，dynamicOffset 直接作为 CmdBindDescriptorSet 的动态偏移 */
+struct TransientAllocation
+{
+    void* pData;
+    uint32_t dynamicOffset;
+};
+
+/* 与 qk_draw_data.glsl 中的 FrameData 保持一致，std140 */
+struct FrameUniformData
+{
+    float viewProjection[16];
+    float view[16];
+    float projection[16];
+    float cameraPosition[4];            // w 未使用
+    float time;
+    uint32_t frameNumber;
+    uint32_t _padding[2];
+};
+
+/*
+ * 设备级函数的分发方式。驱动内部每帧调用的命令（vkCmd*、vkQueueSubmit 等）始终走
+ * 本 RenderDriver 的 VolkDeviceTable，直接进入驱动入口。GLOBAL 额外用 volkLoadDevice
+ * 改写 volk 的全局函数指针，ImGui 后端等同样受益，但进程中只能有一个设备；多个设备
+ * 或多个 RenderDriver 共存时全部使用 TABLE，全局指针保持 loader 的 trampoline。
+ */
+enum DeviceDispatchMode
+{
+    DEVICE_DISPATCH_GLOBAL = 0,
+    DEVICE_DISPATCH_TABLE,
+};
+
+/* 管线着色器阶段的提供方式，两种方式下着色器都按内容哈希缓存，多个管线共享 */
+enum ShaderStageMode
+{
+    SHADER_STAGE_MODE_MODULE = 0,           // 缓存的 VkShaderModule
+    SHADER_STAGE_MODE_INLINE,               // 缓存 SPIR-V，VkShaderModuleCreateInfo 直接挂在 stage 的 pNext 上 (VK_KHR_maintenance5)
+};
+
+struct ShaderCacheStatistics
+{
+    uint32_t entryCount;
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t collisions;                // 哈希相同但 SPIR-V 不同，顺延到下一个键的次数
+    uint32_t identifierPipelines;       // 只用标识符从管线缓存创建成功的管线数
+    uint32_t identifierFallbacks;       // 标识符未命中，重新加载 SPIR-V 的次数
+    VkDeviceSize inlineCodeBytes;
+};
+
+/* 异步读回句柄，0 表示无效 */
+typedef uint64_t ReadbackHandle;
+
+/* 读回完成时在 AcquiredNextFrame 中回调，pData 只在回调期间有效 */
+typedef void (*PFN_ReadbackCallback)(ReadbackHandle handle, const void* pData, VkDeviceSize size, void* pUserData);
+
 class RenderDriver
 {
 public:
-    RenderDriver();
+    RenderDriver(VkBool32 headless = VK_FALSE);
    ~RenderDriver();
 
     VkResult Initialize(VkSurfaceKHR surface);
 
+    /* 离屏渲染，没有 surface 和 swapchain，CmdEndRendering 后场景颜色处于 TRANSFER_SRC 布局 */
+    VkResult InitializeHeadless(uint32_t width, uint32_t height, VkFormat colorFormat);
+
     VkResult CreateBuffer(size_t size, VkBufferUsageFlags usage, Buffer *pBuffer);
+    VkResult CreateBuffer(size_t size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, Buffer *pBuffer);
     void DestroyBuffer(Buffer buffer);
     VkResult CreateTexture2D(uint32_t w, uint32_t h, VkFormat format, VkImageUsageFlags usage, Texture2D *pTexture2D);
+    VkResult CreateTexture2D(uint32_t w, uint32_t h, uint32_t mipLevels, VkFormat format, VkImageUsageFlags usage, Texture2D *pTexture2D);
+    /* 2D 数组纹理，视图类型为 VK_IMAGE_VIEW_TYPE_2D_ARRAY，布局转换作用于所有层 */
+    VkResult CreateTexture2DArray(uint32_t w, uint32_t h, uint32_t arrayLayers, uint32_t mipLevels, VkFormat format, VkImageUsageFlags usage, Texture2D *pTexture2D);
     void DestroyTexture2D(Texture2D Texture2D);
+    /*
+     * 不绑定内存的纹理，用于内存别名：GetTexture2DMemoryRequirements 查询需求后，
+     * BindTexture2DMemory 绑定到 AllocateMemory 分配的内存中的某个偏移并创建视图。
+     * DestroyTexture2D 只销毁 image 和视图，内存由调用方 FreeMemory。
+     */
+    VkResult CreateUnboundTexture2D(uint32_t w, uint32_t h, VkFormat format, VkImageUsageFlags usage, Texture2D *pTexture2D);
+    /* arrayLayers 大于 1 时视图类型为 VK_IMAGE_VIEW_TYPE_2D_ARRAY */
+    VkResult CreateUnboundTexture2DArray(uint32_t w, uint32_t h, uint32_t arrayLayers, VkFormat format, VkImageUsageFlags usage, Texture2D *pTexture2D);
+    void GetTexture2DMemoryRequirements(Texture2D texture, VkMemoryRequirements* pRequirements) const;
+    VkResult BindTexture2DMemory(Texture2D texture, VmaAllocation allocation, VkDeviceSize offset);
+    /* lazilyAllocated 时只使用 LAZILY_ALLOCATED 的内存类型，没有时返回错误 */
+    VkResult AllocateMemory(const VkMemoryRequirements& requirements, VkBool32 lazilyAllocated, VmaAllocation* pAllocation);
+    void FreeMemory(VmaAllocation allocation);
+    VkBool32 HasLazilyAllocatedMemory() const;
+    VkResult CreateSampler(VkFilter filter, VkSamplerAddressMode addressMode, VkSampler* pSampler);
+    /* 深度比较采样器，对应着色器中的 sampler2DShadow，双线性过滤得到 2x2 PCF */
+    VkResult CreateComparisonSampler(VkCompareOp compareOp, VkSampler* pSampler);
+    void DestroySampler(VkSampler sampler);
     VkResult CreatePipeline(const char *shaderName, Pipeline* pPipeline);
+    VkResult CreateGraphicsPipeline(const GraphicsPipelineCreateInfo& createInfo, Pipeline* pPipeline);
+    VkResult CreateComputePipeline(const char* shaderName, uint32_t bindingCount, const VkDescriptorSetLayoutBinding* pBindings, uint32_t pushConstantSize, Pipeline* pPipeline);
     void DestroyPipeline(Pipeline pipeline);
     VkResult CreateCommandBuffer(VkCommandBuffer* pCommandBuffer);
     void DestroyCommandBuffer(VkCommandBuffer commandBuffer);
@@ -39,67 +209,267 @@ public:
     void BeginCommandBuffer(VkCommandBuffer commandBuffer);
     void EndCommandBuffer(VkCommandBuffer commandBuffer);
     void CmdTextureMemoryBarrier(VkCommandBuffer commandBuffer, Texture2D texture, VkImageLayout newLayout);
+    /* 显式指定同步范围；discard 时旧布局按 UNDEFINED 处理，丢弃原有内容 */
+    void CmdTextureMemoryBarrier(VkCommandBuffer commandBuffer, Texture2D texture, VkImageLayout newLayout, VkBool32 discard,
+                                 VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask,
+                                 VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask);
+    void CmdMemoryBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask);
+    void CmdFillBuffer(VkCommandBuffer commandBuffer, Buffer buffer, VkDeviceSize offset, VkDeviceSize size, uint32_t data);
+    /* 内联到命令缓冲中的小块更新，size 不超过 65536 且为 4 的倍数 */
+    void CmdUpdateBuffer(VkCommandBuffer commandBuffer, Buffer buffer, VkDeviceSize offset, VkDeviceSize size, const void* data);
+    void CmdCopyBuffer(VkCommandBuffer commandBuffer, Buffer srcBuffer, VkDeviceSize srcOffset, Buffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize size);
+    /* 拷贝 mip 0 第 0 层中相同的区域，src 处于 TRANSFER_SRC，dst 处于 TRANSFER_DST 布局 */
+    void CmdCopyTexture2D(VkCommandBuffer commandBuffer, Texture2D srcTexture, Texture2D dstTexture, const VkRect2D& region);
+    void CmdCopyBufferToTexture2D(VkCommandBuffer commandBuffer, Buffer buffer, VkDeviceSize bufferOffset, Texture2D texture, uint32_t mipLevel, uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t layer = 0);
     void CmdBeginRendering(VkCommandBuffer commandBuffer);
     void CmdEndRendering(VkCommandBuffer commandBuffer);
+    /* 只渲染到 depth 的 area 区域，depth 需要处于 DEPTH_STENCIL_ATTACHMENT_OPTIMAL；clear 为假时保留原有内容 */
+    void CmdBeginDepthRendering(VkCommandBuffer commandBuffer, Texture2D depth, const VkRect2D& area, VkBool32 clear);
+    void CmdEndDepthRendering(VkCommandBuffer commandBuffer);
+    /*
+     * 多视图渲染：viewMask 的第 i 位渲染到数组纹理的第 i 层，着色器中 gl_ViewIndex 为 i。
+     * 几何只提交一次，由驱动广播到每个视图。color 可为空，附件需要处于 attachment 布局。
+     */
+    void CmdBeginMultiviewRendering(VkCommandBuffer commandBuffer, Texture2D color, Texture2D depth, uint32_t viewMask, VkBool32 clear);
+    void CmdEndMultiviewRendering(VkCommandBuffer commandBuffer);
+    void CmdBeginOverlayRendering(VkCommandBuffer commandBuffer, VkRenderingFlags flags = 0);
+    void CmdEndOverlayRendering(VkCommandBuffer commandBuffer);
     void CmdBindPipeline(VkCommandBuffer commandBuffer, Pipeline pipeline);
+    /* viewport 和 scissor 设为当前渲染区域，CmdBindPipeline 绑定图形管线时会调用 */
+    void CmdSetViewportScissor(VkCommandBuffer commandBuffer);
+    void CmdBindDescriptorSet(VkCommandBuffer commandBuffer, Pipeline pipeline, VkDescriptorSet descriptorSet);
+    void CmdBindDescriptorSet(VkCommandBuffer commandBuffer, Pipeline pipeline, VkDescriptorSet descriptorSet, uint32_t dynamicOffsetCount, const uint32_t* pDynamicOffsets);
     void CmdBindVertexBuffer(VkCommandBuffer commandBuffer, Buffer buffer, VkDeviceSize offset);
     void CmdBindVertexBuffers(VkCommandBuffer commandBuffer, uint32_t count, Buffer *pBuffers, VkDeviceSize *pOffsets);
+    void CmdBindIndexBuffer(VkCommandBuffer commandBuffer, Buffer buffer, VkDeviceSize offset, VkIndexType indexType);
     void CmdPushConstants(VkCommandBuffer commandBuffer, Pipeline pipeline, VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size, const void* data);
     void CmdDraw(VkCommandBuffer commandBuffer, uint32_t vertexCount);
+    void CmdDraw(VkCommandBuffer commandBuffer, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance);
+    void CmdDrawIndexed(VkCommandBuffer commandBuffer, uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance);
+    void CmdDrawIndirect(VkCommandBuffer commandBuffer, Buffer buffer, VkDeviceSize offset, uint32_t drawCount);
+    void CmdDispatch(VkCommandBuffer commandBuffer, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ);
+    void CmdDispatchIndirect(VkCommandBuffer commandBuffer, Buffer buffer, VkDeviceSize offset);
+    void CmdBuildDepthPyramid(VkCommandBuffer commandBuffer, const float* viewProjection);
+    void CmdCullOcclusion(VkCommandBuffer commandBuffer, Buffer objectBuffer, Buffer drawBuffer, uint32_t objectCount, const float* viewProjection);
     void SubmitQueue(VkCommandBuffer commandBuffer, VkSemaphore waitSemaphore, VkSemaphore signalSemaphore, VkFence fence);
     void SubmitAndPresentFrame(VkCommandBuffer commandBuffer);
 
+    /*
+     * 异步计算：有独立的计算队列族时返回该队列本帧的命令缓冲，提交后本帧的图形
+     * 提交会在使用计算结果的阶段之前等待它。没有独立队列时直接返回正在录制的
+     * 图形命令缓冲，SubmitAsyncCompute 退化为一个 compute -> graphics 的屏障。
+     * waitPreviousFrame 为真时计算队列先等待上一帧的图形工作完成。
+     */
+    VkCommandBuffer BeginAsyncCompute();
+    void SubmitAsyncCompute(VkCommandBuffer commandBuffer, VkBool32 waitPreviousFrame);
+
     void AcquiredNextFrame(VkCommandBuffer* pCommandBuffer);
     void RebuildSwapchain();
     void ReadBuffer(Buffer buffer, size_t size, void* data);
-    void WriteBuffer(Buffer buffer, size_t size, void* data);
+    void* MapBuffer(Buffer buffer);
+    void UnmapBuffer(Buffer buffer);
+    void WriteBuffer(Buffer buffer, size_t size, const void* data);
     void CopyBuffer(Buffer srcBuffer, uint64_t srcOffset, Buffer dstBuffer, uint64_t dstOffset, uint64_t size);
-    void WriteTexture2D(Texture2D texture, uint64_t size, void* pixels);
+    /* 写入 mip 0 的所有层，数组纹理的各层在 pixels 中依次紧密排列 */
+    void WriteTexture2D(Texture2D texture, uint64_t size, const void* pixels);
+    VkResult AllocateDescriptorSet(Pipeline pipeline, VkDescriptorSet* pDescriptorSet);
+    VkResult AllocatePersistentDescriptorSet(Pipeline pipeline, VkDescriptorSet* pDescriptorSet);
+    void FreeDescriptorSet(VkDescriptorSet descriptorSet);
+    void WriteDescriptorBuffer(VkDescriptorSet descriptorSet, uint32_t binding, VkDescriptorType type, Buffer buffer, VkDeviceSize offset, VkDeviceSize range);
+    void WriteDescriptorTexture(VkDescriptorSet descriptorSet, uint32_t binding, VkDescriptorType type, Texture2D texture, VkSampler sampler, VkImageLayout layout);
+    /* 上一帧的深度 pyramid：binding 为 COMBINED_IMAGE_SAMPLER (GENERAL 布局)，binding+1 为生成它时的参数 UBO，与 qk_hiz_cull.comp 相同 */
+    void WriteDescriptorDepthPyramid(VkDescriptorSet descriptorSet, uint32_t binding);
     void DeviceWaitIdle();
 
+    /*
+     * 每帧临时数据环形缓冲：常驻映射，按 UBO/SSBO 的最小偏移对齐，下次轮到这一帧时
+     * 整体回收。把 GetTransientBuffer() 以 offset 0 写进 *_DYNAMIC 描述符（range 为
+     * 单次绑定能看到的大小），之后每个 draw 只需要传入 dynamicOffset。
+     * 大量 draw 时可以一次分配 N 个 per-draw 结构体作为 SSBO，着色器用
+     * gl_InstanceIndex 索引，CmdDraw / 间接绘制时把 firstInstance 设为 draw 序号。
+     */
+    VkResult AllocateTransient(VkDeviceSize size, TransientAllocation* pAllocation);
+
+    /*
+     * 异步读回：把拷贝录制到命令缓冲中，数据写入 host cached 的环形缓冲，
+     * 录制它的帧在 timeline 上完成后可以通过 GetReadbackResult 取得，或者
+     * 在之后的 AcquiredNextFrame 中回调。没有回调的读回需要 ReleaseReadback
+     * 归还环形缓冲空间。环形缓冲已满时返回 0。
+     */
+    ReadbackHandle CmdReadbackBuffer(VkCommandBuffer commandBuffer, Buffer buffer, VkDeviceSize offset, VkDeviceSize size,
+                                     PFN_ReadbackCallback callback, void* pUserData);
+    ReadbackHandle CmdReadbackTexture2D(VkCommandBuffer commandBuffer, Texture2D texture, uint32_t mipLevel, VkOffset2D offset, VkExtent2D extent,
+                                        PFN_ReadbackCallback callback, void* pUserData);
+    VkBool32 GetReadbackResult(ReadbackHandle handle, const void** ppData, VkDeviceSize* pSize);
+    void ReleaseReadback(ReadbackHandle handle);
+    void PollReadbacks();
+    void SetDynamicResolution(const DynamicResolutionSettings& settings);
+
+    /* 着色器先在资源包中按 "<name>.<stage>.spv" 查找，创建管线期间资源包需要保持映射 */
+    void SetAssetPack(AssetPack pack) { assetPack = pack; }
+
+    /*
+     * Initialize 之前设置时内置管线在任务系统上与其余初始化并行创建。
+     * CreatePipeline / CreateGraphicsPipeline / CreateComputePipeline 可以在多个线程上同时调用。
+     */
+    void SetJobSystem(JobSystem* pJobSystem) { jobSystem = pJobSystem; }
+
+    /* Initialize 之前设置 */
+    void SetDeviceDispatchMode(DeviceDispatchMode mode) { deviceDispatchMode = mode; }
+
+    /* 不支持 VK_KHR_maintenance5 时 INLINE 回退为 MODULE */
+    void SetShaderStageMode(ShaderStageMode mode);
+
+    /*
+     * 释放缓存的 VkShaderModule 和 SPIR-V，只保留 VK_EXT_shader_module_identifier
+     * 的标识符。之后用到这些着色器的管线先只凭标识符从管线缓存中创建，缓存未命中
+     * 时才重新读取 SPIR-V。不支持该扩展时相当于清空着色器缓存。不能与创建管线同时调用。
+     */
+    void ReleaseShaderCode();
+    void GetShaderCacheStatistics(ShaderCacheStatistics* pStatistics) const;
+
+    void GetMemoryStatistics(MemoryStatistics* pStatistics) const;
+    VkResult DumpMemoryStatistics(const char* path);
+    void SetMemoryBudgetCallback(PFN_MemoryBudgetCallback callback, float threshold, void* pUserData);
+    VkResult BeginDefragmentation();
+    static const char* GetMemoryCategoryName(MemoryCategory category);
+
     VkInstance GetInstance() const { return instance; }
     VkPhysicalDevice GetPhysicalDevice() const { return physicalDevice; }
     uint32_t GetQueueFamilyIndex() const { return queueFamilyIndex; }
     VkQueue GetGraphicsQueue() const { return queue; }
     VkQueue GetPresentQueue() const { return queue; }
     VkDevice GetDevice() const { return device; }
+    const VolkDeviceTable& GetDeviceTable() const { return deviceTable; }
+
+    /* 底层句柄，供直接录制 Vulkan 命令的代码使用 */
+    static VkBuffer GetVkBuffer(Buffer buffer);
+    static VkPipeline GetVkPipeline(Pipeline pipeline);
+    static VkPipelineLayout GetVkPipelineLayout(Pipeline pipeline);
     VkDescriptorPool GetDescriptorPool() const { return descriptorPool; }
+    Buffer GetTransientBuffer() const { return transientRing; }
+    VkDeviceSize GetTransientFrameSize() const { return transientFrameSize; }
     uint32_t GetMinImageCount() const { return minImageCount; }
     VkExtent2D GetSwapchainExtent2D() const { return swapchainExtent2D; }
+    VkFormat GetSurfaceFormat() const { return surfaceFormat.format; }
+    VkFormat GetDepthFormat() const { return depthFormat; }
+    Texture2D GetDepthTexture() const { return depthTexture; }
+    Texture2D GetSceneColorTexture() const { return sceneColor; }
+    VkBool32 IsHeadless() const { return headless; }
+    VkBool32 IsValidationEnabled() const { return validationEnabled; }
+    VkBool32 IsDebugUtilsEnabled() const { return debugUtilsEnabled; }
     float GetSwapchainAspectRatio() const { return swapchainExtent2D.width / swapchainExtent2D.height; }
+    uint32_t GetFlightIndex() const { return flightIndex; }
+    uint32_t GetMaxFramesInFlight() const { return MAX_FRAMES_IN_FLIGHT; }
+    uint64_t GetFrameNumber() const { return frameNumber; }
+    uint64_t GetCompletedFrameNumber() const;
+    VkSemaphore GetFrameTimelineSemaphore() const { return frameTimelineSemaphore; }
+    VkBool32 HasAsyncCompute() const { return computeQueue != VK_NULL_HANDLE; }
+    VkBool32 HasDrawIndirectFirstInstance() const { return drawIndirectFirstInstanceSupported; }
+    VkBool32 HasFragmentStoresAndAtomics() const { return fragmentStoresAndAtomicsSupported; }
+    VkBool32 HasShaderModuleIdentifier() const { return shaderModuleIdentifierSupported; }
+    VkBool32 HasInlineShaderStages() const { return inlineShaderStageSupported; }
+    VkBool32 HasMultiview() const { return multiviewSupported; }
+    uint32_t GetMaxMultiviewViewCount() const { return maxMultiviewViewCount; }
+    VkPipelineCache GetPipelineCache() const { return pipelineCache; }
+    uint32_t GetComputeQueueFamilyIndex() const { return computeQueueFamilyIndex; }
+    VkExtent2D GetRenderExtent2D() const { return renderExtent2D; }
+    float GetRenderScale() const { return dynamicResolution.GetScale(); }
+    float GetGpuFrameTimeMs() const { return dynamicResolution.GetAverageFrameTimeMs(); }
+    const DynamicResolutionSettings& GetDynamicResolution() const { return dynamicResolution.GetSettings(); }
 
 private:
+    VkResult _InitializeResources();
     VkResult _CreateInstance();
     VkResult _CreateDevice();
     VkResult _CreateMemoryAllocator();
     VkResult _CreateSwapchain(VkSwapchainKHR oldSwapchain);
     VkResult _CreateCommandPool();
     VkResult _CreateDescriptorPool();
-    VkResult _CreateShaderModule(const char* shaderName, const char* stage, VkShaderModule* pShaderModule);
+    VkResult _CreateRenderTargets();
+    VkResult _CreateBuiltinPipelines();
+    VkResult _CreateTexture2DView(VkImage image, VkImageViewType viewType, VkFormat format, VkImageAspectFlags aspectMask,
+                                  uint32_t mipLevels, uint32_t arrayLayers, VkImageView* pImageView);
+    VkResult _CreateTexture2D(uint32_t w, uint32_t h, uint32_t mipLevels, uint32_t arrayLayers, VkImageViewType viewType,
+                              VkFormat format, VkImageUsageFlags usage, Texture2D *pTexture2D);
+
+    /* 着色器缓存，条目按 SPIR-V 内容哈希索引，"<name>.<stage>.spv" 到哈希另有一张表，命中时不再读文件 */
+    struct ShaderCacheEntry
+    {
+        VkShaderModule module;
+        std::vector<uint32_t> code;                                 // 只在 INLINE 模式下保留
+        std::vector<uint32_t> key;                                  // MODULE 模式下的 SPIR-V 原文，哈希命中后逐字节比较
+        uint32_t identifierSize;
+        uint8_t identifier[VK_MAX_SHADER_MODULE_IDENTIFIER_SIZE_EXT];
+    };
+
+    VkResult _AcquireShaderModule(const char* shaderName, const char* stage, VkBool32 requireCode, ShaderCacheEntry** ppEntry);
+    VkBool32 _CanUseShaderIdentifiers(ShaderCacheEntry* const* ppEntries, uint32_t count) const;
+    VkBool32 _MatchShaderKey(const ShaderCacheEntry& entry, const void* code, size_t size) const;
+    VkBool32 _ValidatePipelineCacheData(const void* data, size_t size) const;
+    void _SavePipelineCache();
+    void _FillShaderStage(const ShaderCacheEntry* pEntry, VkShaderStageFlagBits stage, VkBool32 useIdentifier,
+                          VkShaderModuleCreateInfo* pModuleCreateInfo, VkPipelineShaderStageModuleIdentifierCreateInfoEXT* pIdentifierCreateInfo,
+                          VkPipelineShaderStageCreateInfo* pStageCreateInfo) const;
+    VkResult _AllocateFrameDescriptorSet(VkDescriptorSetLayout layout, VkDescriptorSet* pDescriptorSet);
+    VkResult _CreateComputeQueueResources();
     VkResult _CreateFence(VkFence* pFence);
     VkResult _CreateSemaphore(VkSemaphore* pSemaphore);
 
     void _DestroySwapchain();
+    void _DestroyRenderTargets();
+    void _UpdateRenderExtent();
+    void _CmdImageBarrier(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+                          VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask,
+                          VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask);
     void _DestroyFence(VkFence fence);
     void _DestroySemaphore(VkSemaphore semaphore);
+    /* 创建管线失败时释放已经创建的布局，VK_NULL_HANDLE 会被忽略 */
+    void _DestroyPipelineLayouts(VkPipelineLayout pipelineLayout, VkDescriptorSetLayout descriptorSetLayout);
 
     VkResult _InitSyncObjects();
 
+    void _UpdateMemoryBudget();
+    void _StepDefragmentation();
+    void _EndDefragmentationPass();
+    void _EndDefragmentation();
+    void _TrackAllocation(MemoryCategory category, VkDeviceSize size, int32_t sign);
+
     void _DestroySyncObjects();
 
+    VkDeviceSize _AllocateReadback(VkDeviceSize size, PFN_ReadbackCallback callback, void* pUserData, ReadbackHandle* pHandle);
+    void _ProcessReadbacks();
+    void _FlushTransientRing();
+    void _QueueSubmit(VkQueue submitQueue, VkCommandBuffer commandBuffer,
+                      uint32_t waitCount, const VkSemaphore* pWaitSemaphores, const uint64_t* pWaitValues, const VkPipelineStageFlags* pWaitStages,
+                      uint32_t signalCount, const VkSemaphore* pSignalSemaphores, const uint64_t* pSignalValues, VkFence fence);
+    VkSharingMode _ChooseSharingMode(VkBool32 shared, uint32_t* pQueueFamilyIndexCount) const;
+
     static VmaMemoryUsage _GuessMemoryUsage(VkBufferUsageFlags usage);
+    static MemoryCategory _GuessMemoryCategory(VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage);
+
+    VkBool32 headless = VK_FALSE;
+    VkBool32 validationEnabled = VK_FALSE;
+    VkBool32 debugUtilsEnabled = VK_FALSE;
+    AssetPack assetPack = VK_NULL_HANDLE;
+    JobSystem* jobSystem = VK_NULL_HANDLE;
+    JobCounter builtinPipelineCounter;
+    VkResult builtinPipelineResult = VK_SUCCESS;
 
     // Vulkan handles
     VkInstance instance = VK_NULL_HANDLE;
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
     VkSurfaceKHR surface = VK_NULL_HANDLE;
     VkDevice device = VK_NULL_HANDLE;
+    VolkDeviceTable deviceTable = {};
+    DeviceDispatchMode deviceDispatchMode = DEVICE_DISPATCH_GLOBAL;
     VkQueue queue = VK_NULL_HANDLE;
     VmaAllocator allocator = VK_NULL_HANDLE;
     VkSwapchainKHR swapchain = VK_NULL_HANDLE;
     VkCommandPool commandPool = VK_NULL_HANDLE;
     VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
     VkFence submitFence = VK_NULL_HANDLE;
+    std::vector<VkDescriptorPool> frameDescriptorPools;
 
     // Vulkan swapchain resources
     uint32_t minImageCount = 0;
@@ -109,16 +479,105 @@ private:
     uint32_t imageIndex = 0;
     std::vector<VkSemaphore> renderFinishedSemaphores;
 
+    // Internal render target (dynamic resolution)
+    Texture2D sceneColor = VK_NULL_HANDLE;
+    VkExtent2D renderExtent2D = {};
+    VkRect2D currentRenderArea = {};
+    DynamicResolutionController dynamicResolution;
+    VkQueryPool timestampQueryPool = VK_NULL_HANDLE;
+    uint64_t timestampMask = 0;                 // 时间戳只有 timestampValidBits 位有效
+    std::vector<VkBool32> timestampsWritten;
+
+    // Depth buffer & Hi-Z pyramid
+    VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+    Texture2D depthTexture = VK_NULL_HANDLE;
+    Texture2D depthPyramid = VK_NULL_HANDLE;
+    std::vector<VkImageView> depthPyramidMipViews;
+    std::vector<VkDescriptorSet> depthPyramidDescriptorSets;
+    Buffer depthPyramidParams = VK_NULL_HANDLE;
+    VkSampler depthPyramidSampler = VK_NULL_HANDLE;
+    Pipeline hizReducePipeline = VK_NULL_HANDLE;
+    Pipeline hizCullPipeline = VK_NULL_HANDLE;
+
     // Sync objects
     uint32_t flightIndex = 0;
     uint32_t MAX_FRAMES_IN_FLIGHT = 2;
     std::vector<VkCommandBuffer> frameCommandBuffers;
     std::vector<VkSemaphore> imageAvailableSemaphores;
     std::vector<VkFence> inFlightFences;
+    VkSemaphore frameTimelineSemaphore = VK_NULL_HANDLE;          // 每帧图形提交时 signal 为 frameNumber
+    uint64_t lastSignaledFrameNumber = 0;                         // 已经提交 signal 的最大 timeline 值，0 表示还没有
+
+    // Async compute
+    VkQueue computeQueue = VK_NULL_HANDLE;
+    uint32_t computeQueueFamilyIndex = UINT32_MAX;
+    uint32_t sharedQueueFamilyIndices[2] = {};
+    VkCommandPool computeCommandPool = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> computeCommandBuffers;
+    std::vector<VkSemaphore> computeFinishedSemaphores;
+    std::vector<VkBool32> computeSubmitted;
 
     uint32_t queueFamilyIndex = UINT32_MAX;
     VkSurfaceFormatKHR surfaceFormat = {};
     VkPhysicalDeviceProperties physicalDeviceProperties = {};
+    VkBool32 multiDrawIndirectSupported = VK_FALSE;
+    VkBool32 drawIndirectFirstInstanceSupported = VK_FALSE;
+    VkBool32 fragmentStoresAndAtomicsSupported = VK_FALSE;
+    VkBool32 memoryBudgetSupported = VK_FALSE;
+    VkBool32 shaderModuleIdentifierSupported = VK_FALSE;
+    VkBool32 inlineShaderStageSupported = VK_FALSE;
+    VkBool32 multiviewSupported = VK_FALSE;
+    uint32_t maxMultiviewViewCount = 0;
+    uint64_t frameNumber = 0;
+
+    // Shader cache
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    ShaderStageMode shaderStageMode = SHADER_STAGE_MODE_MODULE;
+    std::unordered_map<uint64_t, ShaderCacheEntry> shaderCache;
+    std::unordered_map<std::string, uint64_t> shaderNameCache;
+    mutable std::mutex shaderCacheMutex;
+    ShaderCacheStatistics shaderCacheStatistics = {};
+
+    // Async readback ring
+    struct ReadbackEntry
+    {
+        ReadbackHandle handle;
+        VkDeviceSize offset;
+        VkDeviceSize size;
+        uint64_t frameNumber;
+        PFN_ReadbackCallback callback;
+        void* pUserData;
+        VkBool32 ready;
+        VkBool32 released;
+    };
+
+    Buffer readbackRing = VK_NULL_HANDLE;
+    uint8_t* readbackRingMapped = VK_NULL_HANDLE;
+    VkDeviceSize readbackRingSize = 32 * 1024 * 1024;
+    VkDeviceSize readbackRingHead = 0;
+    ReadbackHandle nextReadbackHandle = 1;
+    std::vector<ReadbackEntry> readbackEntries;                     // 按分配顺序，队首是最早的
+
+    // Per-frame transient ring，每帧占一段 transientFrameSize，末尾多留一段保证动态偏移 + range 不越界
+    Buffer transientRing = VK_NULL_HANDLE;
+    uint8_t* transientRingMapped = VK_NULL_HANDLE;
+    VkDeviceSize transientFrameSize = 8 * 1024 * 1024;
+    VkDeviceSize transientAlignment = 256;
+    VkDeviceSize transientHead = 0;                                 // 本帧区域内的偏移
+    VkDeviceSize transientFlushed = 0;
+
+    // Memory statistics & defragmentation
+    MemoryStatistics memoryStatistics = {};
+    PFN_MemoryBudgetCallback memoryBudgetCallback = VK_NULL_HANDLE;
+    float memoryBudgetThreshold = 0.9f;
+    void* memoryBudgetUserData = VK_NULL_HANDLE;
+    VmaDefragmentationContext defragmentationContext = VK_NULL_HANDLE;
+    VmaDefragmentationPassMoveInfo defragmentationPass = {};
+    VkBool32 defragmentationPassPending = VK_FALSE;
+    uint64_t defragmentationPassFrame = 0;
+    VkCommandBuffer defragmentationCommandBuffer = VK_NULL_HANDLE;
+    std::vector<VkBuffer> defragmentationRetiredBuffers;
+    std::vector<Buffer> defragmentationMovedBuffers;
 };
 
 #endif /* RENDER_DRIVER_H_ */
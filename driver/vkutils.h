@@ -7,6 +7,12 @@
 
 #include <vector>
 #include <assert.h>
+#include <string.h>
+
+/* 失败时把 VkResult 原样返回给调用方 */
+#define VK_CHECK_ERROR(err) \
+    if (err != VK_SUCCESS) \
+        return err;
 
 namespace VkUtils
 {
@@ -55,8 +61,10 @@ namespace VkUtils
         vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &count, std::data(queueFamilies));
 
         for (uint32_t i = 0; i < std::size(queueFamilies); i++) {
-            VkBool32 isSupport = VK_FALSE;
-            vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &isSupport);
+            /* 没有 surface 时 (离屏渲染) 只要求图形能力 */
+            VkBool32 isSupport = surface == VK_NULL_HANDLE;
+            if (surface != VK_NULL_HANDLE)
+                vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &isSupport);
 
             VkQueueFamilyProperties& queueFamily = queueFamilies[i];
             if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT && isSupport)
@@ -66,6 +74,40 @@ namespace VkUtils
         return UINT32_MAX;
     }
 
+    /* 只支持计算不支持图形的队列族，一般对应硬件上独立的异步计算引擎 */
+    inline static uint32_t FindDedicatedComputeQueueFamilyIndex(VkPhysicalDevice physicalDevice)
+    {
+        uint32_t count = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &count, VK_NULL_HANDLE);
+
+        std::vector<VkQueueFamilyProperties> queueFamilies(count);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &count, std::data(queueFamilies));
+
+        for (uint32_t i = 0; i < std::size(queueFamilies); i++) {
+            VkQueueFlags flags = queueFamilies[i].queueFlags;
+            if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT))
+                return i;
+        }
+
+        return UINT32_MAX;
+    }
+
+    inline static bool IsDeviceExtensionSupported(VkPhysicalDevice physicalDevice, const char* extensionName)
+    {
+        uint32_t count = 0;
+        vkEnumerateDeviceExtensionProperties(physicalDevice, VK_NULL_HANDLE, &count, VK_NULL_HANDLE);
+
+        std::vector<VkExtensionProperties> extensions(count);
+        vkEnumerateDeviceExtensionProperties(physicalDevice, VK_NULL_HANDLE, &count, std::data(extensions));
+
+        for (const VkExtensionProperties& extension : extensions) {
+            if (strcmp(extension.extensionName, extensionName) == 0)
+                return true;
+        }
+
+        return false;
+    }
+
     inline static VkSurfaceFormatKHR ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& formats)
     {
         VkSurfaceFormatKHR chosenSurfaceFormat = {};
@@ -80,6 +122,108 @@ namespace VkUtils
         return chosenSurfaceFormat;
     }
 
+    inline static VkFormat ChooseDepthFormat(VkPhysicalDevice physicalDevice)
+    {
+        const VkFormat candidates[] = {
+            VK_FORMAT_D32_SFLOAT,
+            VK_FORMAT_D32_SFLOAT_S8_UINT,
+            VK_FORMAT_D24_UNORM_S8_UINT,
+        };
+
+        const VkFormatFeatureFlags requiredFeatures =
+            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+
+        for (VkFormat format : candidates) {
+            VkFormatProperties properties;
+            vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+
+            if ((properties.optimalTilingFeatures & requiredFeatures) == requiredFeatures)
+                return format;
+        }
+
+        return VK_FORMAT_UNDEFINED;
+    }
+
+    inline static bool IsDepthFormat(VkFormat format)
+    {
+        switch (format) {
+            case VK_FORMAT_D16_UNORM:
+            case VK_FORMAT_X8_D24_UNORM_PACK32:
+            case VK_FORMAT_D32_SFLOAT:
+            case VK_FORMAT_D16_UNORM_S8_UINT:
+            case VK_FORMAT_D24_UNORM_S8_UINT:
+            case VK_FORMAT_D32_SFLOAT_S8_UINT:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    inline static bool HasStencilComponent(VkFormat format)
+    {
+        return format == VK_FORMAT_D16_UNORM_S8_UINT
+            || format == VK_FORMAT_D24_UNORM_S8_UINT
+            || format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+    }
+
+    inline static uint32_t PreviousPowerOfTwo(uint32_t v)
+    {
+        uint32_t r = 1;
+        while (r * 2 <= v)
+            r *= 2;
+        return r;
+    }
+
+    inline static uint32_t MipLevelCount(uint32_t w, uint32_t h)
+    {
+        uint32_t levels = 1;
+        while (w > 1 || h > 1) {
+            w = w > 1 ? w / 2 : 1;
+            h = h > 1 ? h / 2 : 1;
+            levels++;
+        }
+        return levels;
+    }
+
+    /* 拷贝到 buffer 时每个像素的字节数，深度格式只计深度分量，未知格式返回 0 */
+    inline static uint32_t FormatTexelSize(VkFormat format)
+    {
+        switch (format) {
+            case VK_FORMAT_R8_UNORM:
+            case VK_FORMAT_R8_UINT:
+            case VK_FORMAT_S8_UINT:
+                return 1;
+            case VK_FORMAT_R16_SFLOAT:
+            case VK_FORMAT_R16_UINT:
+            case VK_FORMAT_D16_UNORM:
+            case VK_FORMAT_D16_UNORM_S8_UINT:
+                return 2;
+            case VK_FORMAT_R8G8B8A8_UNORM:
+            case VK_FORMAT_R8G8B8A8_SRGB:
+            case VK_FORMAT_R8G8B8A8_UINT:
+            case VK_FORMAT_B8G8R8A8_UNORM:
+            case VK_FORMAT_B8G8R8A8_SRGB:
+            case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+            case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+            case VK_FORMAT_R16G16_SFLOAT:
+            case VK_FORMAT_R32_SFLOAT:
+            case VK_FORMAT_R32_UINT:
+            case VK_FORMAT_D32_SFLOAT:
+            case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            case VK_FORMAT_X8_D24_UNORM_PACK32:
+            case VK_FORMAT_D24_UNORM_S8_UINT:
+                return 4;
+            case VK_FORMAT_R16G16B16A16_SFLOAT:
+            case VK_FORMAT_R32G32_SFLOAT:
+                return 8;
+            case VK_FORMAT_R32G32B32A32_SFLOAT:
+            case VK_FORMAT_R32G32B32A32_UINT:
+                return 16;
+            default:
+                return 0;
+        }
+    }
+
 }
 
 #endif /* VKUTILS_H_ */
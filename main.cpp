@@ -4,6 +4,7 @@
 #include <GLFW/glfw3.h>
 
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #ifdef WIN32
@@ -12,7 +13,23 @@
 
 #include <stb/stb_image.h>
 
+#include "core/job/job_system.h"
+#include "core/profiler/profiler.h"
+#include "core/profiler/startup_timeline.h"
+#include "rendering/atlas/texture_atlas.h"
 #include "rendering/camera/camera.h"
+#include "rendering/camera/camera_set.h"
+#include "rendering/debug/debug_panels.h"
+#include "rendering/lighting/clustered_lighting.h"
+#include "rendering/material/material.h"
+#include "rendering/mesh/mesh_lod.h"
+#include "rendering/mesh/packed_mesh.h"
+#include "rendering/particles/particle_system.h"
+#include "rendering/probe/reflection_probe.h"
+#include "rendering/queue/render_queue.h"
+#include "rendering/shadow/cascaded_shadow_map.h"
+#include "rendering/transient/transient_pool.h"
+#include "rendering/vt/virtual_texture.h"
 
 #include <imgui/qk_imgui.h>
 
@@ -28,6 +45,73 @@ Vertex vertices[] = {
     {{ -0.5f,  0.5f }, { 0.0f, 0.0f, 1.0f }}  // 右
 };
 
+/* 程序生成的石板地面，按 mip 0 的纹素坐标计算，页的边框像素自然与相邻页一致 */
+static bool _GenerateGroundPage(uint32_t mipLevel, uint32_t pageX, uint32_t pageY, uint32_t pageSize, uint32_t border,
+                                void* pPixels, QK_MAYBE_UNUSED void* pUserData)
+{
+    const float stoneSize = 256.0f;
+    const float groutSize = 8.0f;
+    const float scale = static_cast<float>(1u << mipLevel);
+    const uint32_t size = pageSize + border * 2;
+    uint8_t* pixels = static_cast<uint8_t*>(pPixels);
+
+    for (uint32_t y = 0; y < size; y++) {
+        for (uint32_t x = 0; x < size; x++) {
+            const float tx = (static_cast<float>(pageX * pageSize + x) - border + 0.5f) * scale;
+            const float ty = (static_cast<float>(pageY * pageSize + y) - border + 0.5f) * scale;
+            const float stoneX = floorf(tx / stoneSize);
+            const float stoneY = floorf(ty / stoneSize);
+
+            /* 粗糙的 mip 中一个像素覆盖的范围大于缝隙，按缝隙的面积占比混合 */
+            float grout;
+            if (scale > groutSize) {
+                grout = 2.0f * groutSize / stoneSize;
+            } else {
+                grout = (tx - stoneX * stoneSize < groutSize || ty - stoneY * stoneSize < groutSize) ? 1.0f : 0.0f;
+            }
+
+            const float stone = 0.8f + 0.2f * (0.5f + 0.5f * sinf(stoneX * 12.9898f + stoneY * 78.233f));
+            const float detail = 0.92f + 0.08f * sinf(tx * 0.21f) * sinf(ty * 0.17f);
+            const float value = (stone * detail) * (1.0f - grout) + 0.45f * grout;
+
+            uint8_t* pixel = pixels + (y * size + x) * 4;
+            pixel[0] = static_cast<uint8_t>(value * 255.0f);
+            pixel[1] = static_cast<uint8_t>(value * 245.0f);
+            pixel[2] = static_cast<uint8_t>(value * 230.0f);
+            pixel[3] = 255;
+        }
+    }
+
+    return true;
+}
+
+/* 粒子精灵：0 软边圆点（与原来着色器中的圆点相同），1 圆环，2 四角星，3 方形光斑；白色，形状只在 alpha 中 */
+static void _GenerateParticleSprite(uint32_t kind, uint32_t size, uint8_t* pPixels)
+{
+    for (uint32_t y = 0; y < size; y++) {
+        for (uint32_t x = 0; x < size; x++) {
+            const float u = (static_cast<float>(x) + 0.5f) / size * 2.0f - 1.0f;
+            const float v = (static_cast<float>(y) + 0.5f) / size * 2.0f - 1.0f;
+            const float r = sqrtf(u * u + v * v);
+
+            float alpha;
+            switch (kind) {
+                case 0:  alpha = 1.0f - r * r; break;
+                case 1:  alpha = 1.0f - fabsf(r - 0.7f) * 5.0f; break;
+                case 2:  alpha = (1.0f - r) * std::max(1.0f - fabsf(u) * 6.0f, 1.0f - fabsf(v) * 6.0f); break;
+                default: alpha = (1.0f - fabsf(u) * fabsf(u)) * (1.0f - fabsf(v) * fabsf(v)); break;
+            }
+
+            const uint8_t value = static_cast<uint8_t>(std::clamp(alpha, 0.0f, 1.0f) * 255.0f);
+            uint8_t* pixel = pPixels + (y * size + x) * 4;
+            pixel[0] = 255;
+            pixel[1] = 255;
+            pixel[2] = 255;
+            pixel[3] = value;
+        }
+    }
+}
+
 int main()
 {
 #ifdef WIN32
@@ -47,13 +131,55 @@ int main()
     chdir(_cwd);
 #endif
 
-    glfwInit();
+    QK_PROFILE_THREAD("Main");
+    StartupTimeline::Begin();
+
+    /* 主线程作为 0 号工作线程 */
+    JobSystem jobSystem;
+    jobSystem.Initialize();
+
+    /* 资源包索引、ImGui 上下文和字体烘焙不依赖设备，与窗口、实例、设备的创建并行 */
+    AssetPack assetPack = VK_NULL_HANDLE;
+    JobCounter assetPackCounter;
+    jobSystem.Run([](void* pUserData) {
+        QK_STARTUP_STEP("OpenAssetPack");
+
+        /* 资源包存在时着色器从映射中直接创建，预读其中的着色器 */
+        AssetPack* pAssetPack = static_cast<AssetPack*>(pUserData);
+        if (!io_pack_open("quokka.qkpack", pAssetPack))
+            return;
+
+        for (uint32_t i = 0; i < io_pack_entry_count(*pAssetPack); i++) {
+            const AssetPackEntry* entry = io_pack_entry(*pAssetPack, i);
+            uint32_t length = 0;
+            const char* name = io_pack_entry_name(*pAssetPack, entry, &length);
+
+            if (length <= 4 || memcmp(name + length - 4, ".spv", 4) != 0)
+                continue;
+
+            AssetSpan span = {};
+            io_pack_entry_span(*pAssetPack, entry, &span);
+            io_pack_prefetch(*pAssetPack, &span);
+        }
+    }, &assetPack, &assetPackCounter);
+
+    JobCounter imguiCounter;
+    jobSystem.Run([](QK_MAYBE_UNUSED void* pUserData) {
+        QK_STARTUP_STEP("ImGuiCreateContext");
+        QkImGuiCreateContext();
+    }, VK_NULL_HANDLE, &imguiCounter);
 
-//    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    GLFWwindow* hwindow = nullptr;
+    {
+        QK_STARTUP_STEP("CreateWindow");
 
-    GLFWwindow* hwindow =
-        glfwCreateWindow(800, 600, "Quokka", nullptr, nullptr);
+        glfwInit();
+
+    //    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+
+        hwindow = glfwCreateWindow(800, 600, "Quokka", nullptr, nullptr);
+    }
 
     if (hwindow == nullptr)
         throw std::runtime_error("Failed to create GLFW window");
@@ -63,43 +189,365 @@ int main()
     VkSurfaceKHR surface = VK_NULL_HANDLE;
     VkResult err = glfwCreateWindowSurface(driver->GetInstance(), hwindow, VK_NULL_HANDLE, &surface);
     assert(!err);
+
+    /* 内置管线在 Initialize 中读取着色器，需要先拿到资源包 */
+    jobSystem.Wait(&assetPackCounter);
+    if (assetPack != VK_NULL_HANDLE)
+        driver->SetAssetPack(assetPack);
+
+    driver->SetJobSystem(&jobSystem);
     driver->Initialize(surface);
 
+    MaterialSystem materialSystem(driver.get());
+    if (materialSystem.Initialize() != VK_SUCCESS)
+        throw std::runtime_error("Failed to initialize material system");
+
+    /* 场景材质的管线变体与 ImGui 后端、顶点数据的初始化并行创建 */
+    struct MaterialJob
+    {
+        MaterialSystem* materialSystem;
+        Material material;
+    } materialJob = { &materialSystem, {} };
+
+    JobCounter pipelineCounter;
+    jobSystem.Run([](void* pUserData) {
+        QK_STARTUP_STEP("CreateScenePipelines");
+        MaterialJob* job = static_cast<MaterialJob*>(pUserData);
+
+        MaterialCreateInfo createInfo = {};
+        createInfo.shaderName = "qk_material_shader";
+        createInfo.features = MATERIAL_FEATURE_VERTEX_COLOR;
+        createInfo.parameters.baseColor[0] = 1.0f;
+        createInfo.parameters.baseColor[1] = 1.0f;
+        createInfo.parameters.baseColor[2] = 1.0f;
+        createInfo.parameters.baseColor[3] = 1.0f;
+        job->materialSystem->CreateMaterial(createInfo, &job->material);
+    }, &materialJob, &pipelineCounter);
+
     ImGui_ImplVulkan_InitInfo _ImGuiVulkanInitInfo = {};
     _ImGuiVulkanInitInfo.Instance = driver->GetInstance();
     _ImGuiVulkanInitInfo.PhysicalDevice = driver->GetPhysicalDevice();
     _ImGuiVulkanInitInfo.Device = driver->GetDevice();
     _ImGuiVulkanInitInfo.QueueFamily = driver->GetQueueFamilyIndex();
     _ImGuiVulkanInitInfo.Queue = driver->GetGraphicsQueue();
-    _ImGuiVulkanInitInfo.PipelineCache = VK_NULL_HANDLE;
+    _ImGuiVulkanInitInfo.PipelineCache = driver->GetPipelineCache();
     _ImGuiVulkanInitInfo.DescriptorPool = driver->GetDescriptorPool();
     _ImGuiVulkanInitInfo.UseDynamicRendering = VK_TRUE;
     _ImGuiVulkanInitInfo.PipelineRenderingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+    VkFormat _ImGuiColorAttachmentFormat = driver->GetSurfaceFormat();
+    _ImGuiVulkanInitInfo.PipelineRenderingCreateInfo.colorAttachmentCount = 1;
+    _ImGuiVulkanInitInfo.PipelineRenderingCreateInfo.pColorAttachmentFormats = &_ImGuiColorAttachmentFormat;
     _ImGuiVulkanInitInfo.MinImageCount = driver->GetMinImageCount();
     _ImGuiVulkanInitInfo.ImageCount = driver->GetMinImageCount();
     _ImGuiVulkanInitInfo.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
 
-    QkImGuiVulkanHInit(hwindow, &_ImGuiVulkanInitInfo);
+    {
+        jobSystem.Wait(&imguiCounter);
 
-    Pipeline pipeline;
-    driver->CreatePipeline("qk_simple_shader", &pipeline);
+        QK_STARTUP_STEP("ImGuiInit");
+        QkImGuiVulkanHInit(hwindow, &_ImGuiVulkanInitInfo);
+    }
 
     Buffer vertexBuffer;
     size_t vertexBufferSize = sizeof(vertices);
     driver->CreateBuffer(vertexBufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, &vertexBuffer);
     driver->WriteBuffer(vertexBuffer, vertexBufferSize, vertices);
 
+    /* 遮挡剔除对象，间接绘制命令由 GPU 生成 */
+    OcclusionCullObject cullObjects[] = {
+        { { 0.0f, 0.0f, 0.0f, 0.6f }, ARRAY_SIZE(vertices), 0, { 0, 0 } },
+    };
+
+    Buffer cullObjectBuffer;
+    driver->CreateBuffer(sizeof(cullObjects), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, &cullObjectBuffer);
+    driver->WriteBuffer(cullObjectBuffer, sizeof(cullObjects), cullObjects);
+
+    Buffer drawIndirectBuffer;
+    driver->CreateBuffer(sizeof(VkDrawIndirectCommand) * ARRAY_SIZE(cullObjects), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, &drawIndirectBuffer);
+
     glm::vec3 position(0.0f, 0.0f, 3.0f);
     float aspectRatio = driver->GetSwapchainAspectRatio();
     Camera camera(position, aspectRatio);
 
+    {
+        QK_STARTUP_STEP("WaitScenePipelines");
+        jobSystem.Wait(&pipelineCounter);
+    }
+
+    const Material sceneMaterial = materialJob.material;
+
+    RenderQueue renderQueue(driver.get(), &jobSystem);
+
+    /* 起伏的地面网格，使用压缩顶点布局，粒子落在上面；向远处平铺多块，按屏幕误差选择 LOD */
+    const uint32_t groundCells = 128;
+    const uint32_t groundTileCount = 6;
+    const float groundTileSize = 6.0f;
+    const float groundFrequency = glm::pi<float>();     // 一块地面正好包含整数个周期，相邻块的高度连续
+    std::vector<MeshVertex> groundVertices;
+    std::vector<uint32_t> groundIndices;
+
+    for (uint32_t z = 0; z <= groundCells; z++) {
+        for (uint32_t x = 0; x <= groundCells; x++) {
+            float u = static_cast<float>(x) / groundCells;
+            float v = static_cast<float>(z) / groundCells;
+            float px = u * groundTileSize - 3.0f;
+            float pz = v * groundTileSize - 4.0f;
+            float py = -0.8f + 0.05f * sinf(groundFrequency * px) * cosf(groundFrequency * pz);
+            float dx = 0.05f * groundFrequency * cosf(groundFrequency * px) * cosf(groundFrequency * pz);
+            float dz = -0.05f * groundFrequency * sinf(groundFrequency * px) * sinf(groundFrequency * pz);
+            glm::vec3 normal = glm::normalize(glm::vec3(-dx, 1.0f, -dz));
+            groundVertices.push_back({ { px, py, pz }, { normal.x, normal.y, normal.z }, { u, v }, { 0.4f + 0.3f * u, 0.45f, 0.4f + 0.3f * v, 1.0f } });
+        }
+    }
+
+    for (uint32_t z = 0; z < groundCells; z++) {
+        for (uint32_t x = 0; x < groundCells; x++) {
+            uint32_t i = z * (groundCells + 1) + x;
+            uint32_t quad[] = { i, i + groundCells + 1, i + 1, i + 1, i + groundCells + 1, i + groundCells + 2 };
+            groundIndices.insert(groundIndices.end(), quad, quad + ARRAY_SIZE(quad));
+        }
+    }
+
+    std::vector<uint32_t> groundLodIndices;
+    std::vector<MeshLodLevel> groundLevels;
+    {
+        QK_STARTUP_STEP("GenerateGroundLods");
+        MeshLod::GenerateChain(groundVertices.data(), static_cast<uint32_t>(groundVertices.size()), groundIndices.data(), static_cast<uint32_t>(groundIndices.size()),
+                               MeshLodCreateInfo{}, &groundLodIndices, &groundLevels);
+    }
+
+    PackedMeshCreateInfo groundCreateInfo = {};
+    groundCreateInfo.layout = PackedMesh::GetCompressedLayout();
+    groundCreateInfo.vertexCount = static_cast<uint32_t>(groundVertices.size());
+    groundCreateInfo.pVertices = groundVertices.data();
+    groundCreateInfo.indexCount = static_cast<uint32_t>(groundLodIndices.size());
+    groundCreateInfo.pIndices = groundLodIndices.data();
+    groundCreateInfo.levelCount = static_cast<uint32_t>(groundLevels.size());
+    groundCreateInfo.pLevels = groundLevels.data();
+
+    PackedMesh groundMesh(driver.get());
+    groundMesh.Initialize(groundCreateInfo);
+
+    /* 上下浮动的方块作为动态遮挡物，与地面使用同一种布局 */
+    std::vector<MeshVertex> boxVertices;
+    std::vector<uint32_t> boxIndices;
+    const glm::vec3 boxNormals[] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+
+    for (const glm::vec3& normal : boxNormals) {
+        /* 与地面相同的绕序：a, a + v, a + u，其中 v x u = normal */
+        glm::vec3 u = fabsf(normal.y) > 0.5f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        glm::vec3 v = glm::cross(u, normal);
+        uint32_t base = static_cast<uint32_t>(boxVertices.size());
+
+        const float corners[4][2] = { { -1.0f, -1.0f }, { -1.0f, 1.0f }, { 1.0f, -1.0f }, { 1.0f, 1.0f } };
+        for (const auto& corner : corners) {
+            glm::vec3 p = (normal + u * corner[0] + v * corner[1]) * 0.25f;
+            boxVertices.push_back({ { p.x, p.y, p.z }, { normal.x, normal.y, normal.z }, { corner[0] * 0.5f + 0.5f, corner[1] * 0.5f + 0.5f }, { 0.9f, 0.55f, 0.3f, 1.0f } });
+        }
+
+        uint32_t quad[] = { base, base + 1, base + 2, base + 2, base + 1, base + 3 };
+        boxIndices.insert(boxIndices.end(), quad, quad + ARRAY_SIZE(quad));
+    }
+
+    PackedMeshCreateInfo boxCreateInfo = {};
+    boxCreateInfo.layout = PackedMesh::GetCompressedLayout();
+    boxCreateInfo.vertexCount = static_cast<uint32_t>(boxVertices.size());
+    boxCreateInfo.pVertices = boxVertices.data();
+    boxCreateInfo.indexCount = static_cast<uint32_t>(boxIndices.size());
+    boxCreateInfo.pIndices = boxIndices.data();
+
+    PackedMesh boxMesh(driver.get());
+    boxMesh.Initialize(boxCreateInfo);
+
+    /* 地面和方块的颜色从虚拟纹理中采样，页按片元着色器的反馈流式加载 */
+    VirtualTextureCreateInfo virtualTextureCreateInfo = {};
+    virtualTextureCreateInfo.pageProvider = _GenerateGroundPage;
+
+    VirtualTexture virtualTexture(driver.get());
+    if (virtualTexture.Initialize(virtualTextureCreateInfo) != VK_SUCCESS)
+        throw std::runtime_error("Failed to initialize virtual texture");
+
+    /* 场景网格接收级联阴影和分簇点光源，binding 1、2 为阴影图集和参数，3 ~ 6 为光源和簇，7 ~ 10 为虚拟纹理，11、12 为反射探针 */
+    VkDescriptorSetLayoutBinding sceneBindings[13] = {
+        { 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, VK_NULL_HANDLE },
+        { 2, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, VK_NULL_HANDLE },
+        { 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, VK_NULL_HANDLE },
+        { 4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, VK_NULL_HANDLE },
+        { 5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, VK_NULL_HANDLE },
+        { 6, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, VK_NULL_HANDLE },
+    };
+    VirtualTexture::GetDescriptorSetLayoutBindings(7, VK_SHADER_STAGE_FRAGMENT_BIT, &sceneBindings[7]);
+    ReflectionProbe::GetDescriptorSetLayoutBindings(11, VK_SHADER_STAGE_FRAGMENT_BIT, &sceneBindings[11]);
+
+    GraphicsPipelineCreateInfo meshCreateInfo = {};
+    meshCreateInfo.shaderName = "qk_mesh_lit";
+    meshCreateInfo.fragmentShaderName = virtualTexture.IsFeedbackEnabled() ? VK_NULL_HANDLE : "qk_mesh_lit_nofeedback";
+    meshCreateInfo.bindingCount = ARRAY_SIZE(sceneBindings);
+    meshCreateInfo.pBindings = sceneBindings;
+
+    Pipeline meshPipeline = VK_NULL_HANDLE;
+    PackedMesh::CreatePipeline(driver.get(), meshCreateInfo, groundMesh.GetLayout(), &meshPipeline);
+
+    GraphicsPipelineCreateInfo casterCreateInfo = {};
+    casterCreateInfo.shaderName = "qk_mesh_shadow_caster";
+    CascadedShadowMap::FillCasterPipelineInfo(&casterCreateInfo);
+
+    Pipeline shadowCasterPipeline = VK_NULL_HANDLE;
+    PackedMesh::CreatePipeline(driver.get(), casterCreateInfo, groundMesh.GetLayout(), &shadowCasterPipeline);
+
+    CascadedShadowMap shadowMap(driver.get());
+    shadowMap.Initialize(CascadedShadowMapCreateInfo{});
+
+    /* 地面是静态遮挡物，只在级联重新拟合时渲染；方块每次更新级联时叠加 */
+    struct ShadowCasterContext
+    {
+        PackedMesh* groundMesh;
+        PackedMesh* boxMesh;
+        Pipeline pipeline;
+        uint32_t groundTileCount;
+        float groundTileSize;
+        glm::mat4 boxModel;
+    } shadowCasters = { &groundMesh, &boxMesh, shadowCasterPipeline, groundTileCount, groundTileSize, glm::mat4(1.0f) };
+
+    ClusteredLighting lighting(driver.get());
+    lighting.Initialize(ClusteredLightingCreateInfo{});
+
+    /* 地面上方漂浮的彩色点光源 */
+    std::vector<PointLight> pointLights(1024);
+    for (uint32_t i = 0; i < pointLights.size(); i++) {
+        PointLight& light = pointLights[i];
+        light.radius = 0.9f + 0.3f * sinf(i * 2.3f);
+        light.color[0] = 0.5f + 0.5f * sinf(i * 0.37f);
+        light.color[1] = 0.5f + 0.5f * sinf(i * 0.71f + 2.0f);
+        light.color[2] = 0.5f + 0.5f * sinf(i * 1.13f + 4.0f);
+        light.intensity = 1.5f;
+    }
+
+    /* 方块位置的反射探针：立方体贴图的 6 个面在一次多视图渲染中完成，每 30 帧刷新，地面和方块的着色器采样它作为反射 */
+    ReflectionProbe reflectionProbe(driver.get());
+    if (reflectionProbe.Initialize(ReflectionProbeCreateInfo{}) != VK_SUCCESS)
+        throw std::runtime_error("Failed to initialize reflection probe");
+
+    Pipeline probePipeline = VK_NULL_HANDLE;
+    if (reflectionProbe.IsCaptureSupported()) {
+        VkDescriptorSetLayoutBinding probeBindings[] = {
+            { 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, VK_NULL_HANDLE },
+        };
+
+        GraphicsPipelineCreateInfo probeCreateInfo = {};
+        probeCreateInfo.shaderName = "qk_mesh_multiview";
+        probeCreateInfo.bindingCount = ARRAY_SIZE(probeBindings);
+        probeCreateInfo.pBindings = probeBindings;
+        reflectionProbe.FillCapturePipelineInfo(&probeCreateInfo);
+
+        PackedMesh::CreatePipeline(driver.get(), probeCreateInfo, groundMesh.GetLayout(), &probePipeline);
+    }
+
+    /* 探针深度只在捕获时使用，放在瞬态资源池中，tile 架构上使用 lazy 内存 */
+    TransientResourcePool transientPool(driver.get());
+    TransientTextureDesc probeDepthDesc = {};
+    probeDepthDesc.width = reflectionProbe.GetCreateInfo().size;
+    probeDepthDesc.height = reflectionProbe.GetCreateInfo().size;
+    probeDepthDesc.layers = 6;
+    probeDepthDesc.format = reflectionProbe.GetCreateInfo().depthFormat;
+    probeDepthDesc.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    probeDepthDesc.name = "ProbeDepth";
+
+    struct ProbeCaptureContext
+    {
+        RenderDriver* driver;
+        PackedMesh* groundMesh;
+        Pipeline pipeline;
+        uint32_t groundTileCount;
+        float groundTileSize;
+    } probeCapture = { driver.get(), &groundMesh, probePipeline, groundTileCount, groundTileSize };
+
+    MeshLodSelector lodSelector;
+    std::vector<MeshLodState> groundLodStates(groundTileCount);
+
+    /* 地面和方块各用一个常驻 set，绑定的资源在整个运行期间不变，只在这里写一次；各块共用同一个 set，渲染队列可以省掉重复绑定 */
+    VkDescriptorSet groundSet = VK_NULL_HANDLE;
+    VkDescriptorSet boxSet = VK_NULL_HANDLE;
+    if (driver->AllocatePersistentDescriptorSet(meshPipeline, &groundSet) != VK_SUCCESS ||
+        driver->AllocatePersistentDescriptorSet(meshPipeline, &boxSet) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate mesh descriptor sets");
+
+    const std::pair<VkDescriptorSet, const PackedMesh*> meshSets[] = { { groundSet, &groundMesh }, { boxSet, &boxMesh } };
+    for (const auto& [set, mesh] : meshSets) {
+        mesh->WriteDescriptor(set, 0);
+        shadowMap.WriteDescriptor(set, 1);
+        lighting.WriteDescriptor(set, 3);
+        virtualTexture.WriteDescriptorSet(set, 7);
+        reflectionProbe.WriteDescriptor(set, 11);
+    }
+
+    /* 三角形后方的喷泉，粒子落下时与上一帧的场景深度碰撞 */
+    ParticleSystemCreateInfo particleCreateInfo = {};
+    particleCreateInfo.maxParticles = 1 << 20;
+    particleCreateInfo.drag = 0.1f;
+
+    ParticleSystem particleSystem(driver.get());
+    particleSystem.Initialize(particleCreateInfo);
+
+    ParticleEmitter fountain = {};
+    fountain.position[1] = -0.6f;
+    fountain.position[2] = -0.5f;
+    fountain.radius = 0.02f;
+    fountain.velocity[1] = 3.0f;
+    fountain.velocityJitter = 0.6f;
+    fountain.color[0] = 0.3f;
+    fountain.color[1] = 0.6f;
+    fountain.color[2] = 1.0f;
+    fountain.color[3] = 0.5f;
+    fountain.lifetimeMin = 2.0f;
+    fountain.lifetimeMax = 4.0f;
+    fountain.sizeMin = 0.004f;
+    fountain.sizeMax = 0.01f;
+    fountain.rate = 250000.0f;
+    particleSystem.SetEmitter(fountain);
+
+    /* 喷泉的粒子按下标使用图集中的几种精灵 */
+    TextureAtlasCreateInfo atlasCreateInfo = {};
+    atlasCreateInfo.width = 256;
+    atlasCreateInfo.height = 256;
+    atlasCreateInfo.layerCount = 1;
+    atlasCreateInfo.maxUploadBytesPerFrame = 256 << 10;
+
+    TextureAtlas spriteAtlas(driver.get());
+    if (spriteAtlas.Initialize(atlasCreateInfo) != VK_SUCCESS)
+        throw std::runtime_error("Failed to initialize sprite atlas");
+
+    const uint32_t spriteSize = 32;
+    std::vector<uint8_t> spritePixels(spriteSize * spriteSize * 4);
+    AtlasRegion spriteRegions[4] = {};
+
+    for (uint32_t i = 0; i < ARRAY_SIZE(spriteRegions); i++) {
+        _GenerateParticleSprite(i, spriteSize, spritePixels.data());
+        spriteAtlas.Insert(spriteSize, spriteSize, spritePixels.data(), &spriteRegions[i]);
+    }
+
+    particleSystem.SetSpriteAtlas(&spriteAtlas, ARRAY_SIZE(spriteRegions), spriteRegions);
+
+    double lastTime = glfwGetTime();
+
     bool showDemoWindow = true;
+    bool showMemoryPanel = true;
+    bool showProfilerPanel = true;
 
     while (!glfwWindowShouldClose(hwindow)) {
-        glfwPollEvents();
+        QK_PROFILE_FRAME();
+
+        {
+            QK_PROFILE_ZONE("PollEvents");
+            glfwPollEvents();
+        }
 
         camera.Update();
 
+        double currentTime = glfwGetTime();
+        float deltaTime = std::min(static_cast<float>(currentTime - lastTime), 0.1f);
+        lastTime = currentTime;
+
         /* 计算 MVP 矩阵 */
         glm::mat4 PC_MVP = camera.GetProjectionMatrix() * camera.GetViewMatrix() * glm::mat4(1.0f);
 
@@ -107,32 +555,178 @@ int main()
         driver->AcquiredNextFrame(&cmd);
         driver->BeginCommandBuffer(cmd);
 
+        driver->CmdCullOcclusion(cmd, cullObjectBuffer, drawIndirectBuffer, ARRAY_SIZE(cullObjects), glm::value_ptr(PC_MVP));
+
+        shadowCasters.boxModel = glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, -0.3f + 0.2f * sinf(static_cast<float>(currentTime) * 1.5f), -1.2f));
+
+        renderQueue.Reset();
+
+        DrawPacket scenePacket = {};
+        scenePacket.material = sceneMaterial.id;
+        scenePacket.pipeline = sceneMaterial.pipeline;
+        scenePacket.descriptorSet = materialSystem.GetDescriptorSet();
+        scenePacket.vertexBuffer = vertexBuffer;
+        scenePacket.indirectBuffer = drawIndirectBuffer;
+        scenePacket.indirectDrawCount = ARRAY_SIZE(cullObjects);
+
+        MaterialPushConstants pushConstants = {};
+        memcpy(pushConstants.mvp, glm::value_ptr(PC_MVP), sizeof(pushConstants.mvp));
+        pushConstants.materialIndex = sceneMaterial.id;
+        renderQueue.Submit(scenePacket, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(pushConstants), &pushConstants);
+
+        /* 地面各块和方块与场景一起经过渲染队列，同一 pipeline 的绑定合并，由近到远绘制；各块共用地面的 set */
+        lodSelector.BeginFrame(camera, driver->GetRenderExtent2D());
+        for (uint32_t tile = 0; tile < groundTileCount; tile++) {
+            const glm::vec3 offset(0.0f, 0.0f, -groundTileSize * tile);
+            const float* center = groundMesh.GetBoundingCenter();
+            const float tileCenter[3] = { center[0] + offset.x, center[1] + offset.y, center[2] + offset.z };
+
+            uint32_t level = lodSelector.Select(groundMesh, tileCenter, groundMesh.GetBoundingRadius(), 1.0f, &groundLodStates[tile]);
+            glm::mat4 tileMVP = PC_MVP * glm::translate(glm::mat4(1.0f), offset);
+
+            const MeshLodLevel& range = groundMesh.GetLevel(level);
+
+            DrawPacket tilePacket = {};
+            tilePacket.pipeline = meshPipeline;
+            tilePacket.depth = glm::distance(camera.GetPosition(), glm::make_vec3(tileCenter));
+            tilePacket.descriptorSet = groundSet;
+            tilePacket.indexBuffer = groundMesh.GetIndexBuffer();
+            tilePacket.indexCount = range.indexCount;
+            tilePacket.firstIndex = range.firstIndex;
+            tilePacket.instanceCount = 1;
+
+            PackedMeshPushConstants tilePushConstants = {};
+            groundMesh.GetPushConstants(glm::value_ptr(tileMVP), &tilePushConstants);
+            renderQueue.Submit(tilePacket, VK_SHADER_STAGE_VERTEX_BIT, sizeof(tilePushConstants), &tilePushConstants);
+        }
+
+        {
+            const MeshLodLevel& range = boxMesh.GetLevel(0);
+
+            DrawPacket boxPacket = {};
+            boxPacket.pipeline = meshPipeline;
+            boxPacket.material = 1;                     // 与地面各块区分，不插进它们中间打断共用的 set
+            boxPacket.depth = glm::distance(camera.GetPosition(), glm::vec3(shadowCasters.boxModel[3]));
+            boxPacket.descriptorSet = boxSet;
+            boxPacket.indexBuffer = boxMesh.GetIndexBuffer();
+            boxPacket.indexCount = range.indexCount;
+            boxPacket.firstIndex = range.firstIndex;
+            boxPacket.instanceCount = 1;
+
+            glm::mat4 boxMVP = PC_MVP * shadowCasters.boxModel;
+            PackedMeshPushConstants boxPushConstants = {};
+            boxMesh.GetPushConstants(glm::value_ptr(boxMVP), &boxPushConstants);
+            renderQueue.Submit(boxPacket, VK_SHADER_STAGE_VERTEX_BIT, sizeof(boxPushConstants), &boxPushConstants);
+        }
+
+        renderQueue.Sort();
+        materialSystem.CmdUpload(cmd);
+        particleSystem.CmdSimulate(cmd, deltaTime);
+        spriteAtlas.CmdUpload(cmd);
+
+        shadowMap.CmdUpdate(cmd, camera, [](VkCommandBuffer commandBuffer, QK_MAYBE_UNUSED uint32_t cascade, const float* viewProjection, VkBool32 staticCasters, void* pUserData) {
+            ShadowCasterContext* context = static_cast<ShadowCasterContext*>(pUserData);
+            glm::mat4 lightViewProjection = glm::make_mat4(viewProjection);
+
+            if (!staticCasters) {
+                glm::mat4 boxMVP = lightViewProjection * context->boxModel;
+                context->boxMesh->CmdDraw(commandBuffer, context->pipeline, glm::value_ptr(boxMVP));
+                return;
+            }
+
+            /* 静态深度很少重新渲染，直接使用最高精度的 LOD，避免与接收端的自阴影错位 */
+            for (uint32_t tile = 0; tile < context->groundTileCount; tile++) {
+                glm::mat4 tileMVP = lightViewProjection * glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -context->groundTileSize * tile));
+                context->groundMesh->CmdDraw(commandBuffer, context->pipeline, glm::value_ptr(tileMVP), 0);
+            }
+        }, &shadowCasters);
+
+        for (uint32_t i = 0; i < pointLights.size(); i++) {
+            const float phase = static_cast<float>(currentTime) * 0.5f + i * 2.39996f;
+            pointLights[i].position[0] = 3.0f * sinf(phase * 0.7f + i);
+            pointLights[i].position[1] = -0.6f + 0.1f * sinf(phase * 1.3f);
+            pointLights[i].position[2] = 2.0f - 36.0f * (i + 0.5f) / pointLights.size() + 0.5f * cosf(phase);
+        }
+
+        /* 每帧声明相同的瞬态纹理，Compile 只在第一次分配 */
+        Texture2D probeDepth = VK_NULL_HANDLE;
+        if (probePipeline != VK_NULL_HANDLE) {
+            transientPool.BeginFrame();
+            TransientTexture probeDepthTransient = transientPool.Declare(probeDepthDesc);
+            transientPool.Use(probeDepthTransient, 0);
+
+            if (transientPool.Compile() == VK_SUCCESS && reflectionProbe.IsCaptureDue()) {
+                transientPool.CmdAcquire(cmd, probeDepthTransient, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+                probeDepth = transientPool.GetTexture(probeDepthTransient);
+            }
+        }
+
+        reflectionProbe.CmdUpdate(cmd, glm::vec3(shadowCasters.boxModel[3]), probeDepth, [](VkCommandBuffer commandBuffer, const CameraSet& views, void* pUserData) {
+            ProbeCaptureContext* context = static_cast<ProbeCaptureContext*>(pUserData);
+
+            /* 地面每块只提交一次，由驱动广播到 6 个面；探针分辨率低，使用较粗的 LOD */
+            for (uint32_t tile = 0; tile < context->groundTileCount; tile++) {
+                VkDescriptorSet probeSet = VK_NULL_HANDLE;
+                if (context->driver->AllocateDescriptorSet(context->pipeline, &probeSet) != VK_SUCCESS)
+                    continue;
+
+                views.WriteDescriptor(probeSet, 1);
+                glm::mat4 tileModel = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -context->groundTileSize * tile));
+                context->groundMesh->CmdDraw(commandBuffer, context->pipeline, probeSet, glm::value_ptr(tileModel), 1);
+            }
+        }, &probeCapture);
+
+        lighting.SetLights(static_cast<uint32_t>(pointLights.size()), pointLights.data());
+        lighting.CmdCull(cmd, camera);
+        virtualTexture.CmdUpdate(cmd);
+
         driver->CmdBeginRendering(cmd);
+        renderQueue.Execute(cmd, 0);
+
+        particleSystem.CmdDraw(cmd, glm::value_ptr(camera.GetViewMatrix()), glm::value_ptr(PC_MVP));
+        driver->CmdEndRendering(cmd);
+        virtualTexture.CmdResolveFeedback(cmd);
 
-        driver->CmdBindPipeline(cmd, pipeline);
-        driver->CmdPushConstants(cmd, pipeline, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), glm::value_ptr(PC_MVP));
-        driver->CmdBindVertexBuffer(cmd, vertexBuffer, 0);
-        driver->CmdDraw(cmd, ARRAY_SIZE(vertices));
+        /* 下一帧的遮挡剔除使用本帧深度 */
+        driver->CmdBuildDepthPyramid(cmd, glm::value_ptr(PC_MVP));
 
         QkImGuiVulkanHNewFrame(cmd);
         ImGui::ShowDemoWindow(&showDemoWindow);
+        QkImGuiMemoryPanel(driver.get(), &showMemoryPanel);
+        QkImGuiProfilerPanel(&showProfilerPanel);
+
+        /* UI 以原生分辨率绘制在放大后的场景之上，UI 不变时执行缓存的 secondary command buffer */
+        driver->CmdBeginOverlayRendering(cmd, QkImGuiVulkanHRender());
         QkImGuiVulkanHEndFrame(cmd);
 
-        driver->CmdEndRendering(cmd);
+        driver->CmdEndOverlayRendering(cmd);
 
         driver->EndCommandBuffer(cmd);
         driver->SubmitAndPresentFrame(cmd);
+
+        StartupTimeline::MarkFirstFrame();
     }
 
     driver->DeviceWaitIdle();
 
     QkImGuiVulkanHTerminate();
 
-    driver->DestroyPipeline(pipeline);
+    driver->FreeDescriptorSet(groundSet);
+    driver->FreeDescriptorSet(boxSet);
+    renderQueue.ReleasePipeline(meshPipeline);
+    driver->DestroyPipeline(meshPipeline);
+    driver->DestroyPipeline(shadowCasterPipeline);
+    if (probePipeline != VK_NULL_HANDLE)
+        driver->DestroyPipeline(probePipeline);
     driver->DestroyBuffer(vertexBuffer);
+    driver->DestroyBuffer(cullObjectBuffer);
+    driver->DestroyBuffer(drawIndirectBuffer);
 
     glfwDestroyWindow(hwindow);
     glfwTerminate();
 
+    if (assetPack != VK_NULL_HANDLE)
+        io_pack_close(assetPack);
+
     return 0;
 }
\ No newline at end of file
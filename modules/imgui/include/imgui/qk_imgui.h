@@ -5,10 +5,40 @@
 #include <imgui/imgui_impl_glfw.h>
 #include <imgui/imgui_impl_vulkan.h>
 
+/*
+ * 创建 ImGui 上下文并烘焙默认字体，不涉及窗口和 Vulkan，可以在任务线程上与设备
+ * 初始化并行执行，完成后再调用 QkImGuiVulkanHInit。没有预先调用时由 Init 完成。
+ */
+void QkImGuiCreateContext();
+
 void QkImGuiVulkanHInit(GLFWwindow* window, ImGui_ImplVulkan_InitInfo* info);
 void QkImGuiVulkanHTerminate();
 
+struct QkImGuiDrawCacheStatistics
+{
+    uint64_t recordedFrames;
+    uint64_t reusedFrames;
+    uint64_t inlineFrames;
+    bool lastFrameReused;
+};
+
 void QkImGuiVulkanHNewFrame([[maybe_unused]] VkCommandBuffer commandBuffer);
+
+/*
+ * 生成本帧的绘制数据并决定绘制方式：绘制数据连续不变时以缓存的 secondary command
+ * buffer 执行，否则内联绘制。返回值作为开始这段 rendering 的 flags，为
+ * VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT 时其中不能再有内联的绘制命令。
+ */
+VkRenderingFlags QkImGuiVulkanHRender();
+
+/* 在 rendering 中调用，之前没有调用 QkImGuiVulkanHRender 时总是内联绘制 */
 void QkImGuiVulkanHEndFrame(VkCommandBuffer commandBuffer);
 
+/* 编辑器之外的场景不需要铺满视口的 DockSpace，默认开启 */
+void QkImGuiSetDockSpaceEnabled(bool enabled);
+
+/* 外部改变了 UI 引用的描述符内容（例如重建了 ImGui::Image 用到的纹理）时调用 */
+void QkImGuiInvalidateDrawCache();
+QkImGuiDrawCacheStatistics QkImGuiGetDrawCacheStatistics();
+
 #endif /* QK_IMGUI_H_ */
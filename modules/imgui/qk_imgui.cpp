@@ -1,9 +1,123 @@
 #include <qk_imgui.h>
+#include <imgui/imgui_internal.h>
 
 #include <quokka/typedefs.h>
 
-void QkImGuiVulkanHInit(GLFWwindow* window, ImGui_ImplVulkan_InitInfo* info)
+#include <string.h>
+#include <vector>
+
+/*
+ * 主视口的 UI 默认直接录制在调用方的命令缓冲中。ImDrawData 连续两帧相同时录制一份
+ * secondary command buffer，之后只要不变就直接执行它，跳过顶点/索引上传和命令录制；
+ * 一旦变化就回到内联绘制。每次重新录制换用环中的下一个 secondary，仍在 GPU 上使用的
+ * 那份不会被改写。内联绘制会轮换后端的顶点缓冲，缓存的 secondary 引用的那一份随时
+ * 可能被覆盖，所以内联绘制之后缓存失效。
+ */
+struct QkImGuiDrawCache
+{
+    VkDevice device = VK_NULL_HANDLE;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> commandBuffers;
+    uint32_t index = 0;
+    uint64_t hash = 0;                  // 缓存的 secondary 对应的绘制数据
+    uint64_t lastHash = 0;              // 上一帧的绘制数据
+    bool valid = false;
+    bool lastValid = false;
+    bool rendered = false;              // 本帧已经调用过 QkImGuiVulkanHRender
+    bool useSecondary = false;          // 本帧以 secondary 执行
+    bool dockSpace = true;
+    VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    QkImGuiDrawCacheStatistics statistics = {};
+};
+
+static QkImGuiDrawCache _DrawCache;
+
+static uint64_t _HashBytes(uint64_t hash, const void* data, size_t size)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    const uint64_t prime = 0x100000001B3ull;
+
+    /* 按 8 字节一组混合，UI 顶点数据量不大，足够快 */
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+        hash = (hash ^ word) * prime;
+        hash ^= hash >> 29;
+    }
+
+    for (; i < size; i++)
+        hash = (hash ^ bytes[i]) * prime;
+
+    return hash;
+}
+
+/* 返回 false 表示这一帧不能复用缓存（有用户回调或纹理更新） */
+static bool _HashDrawData(const ImDrawData* drawData, uint64_t* pHash)
+{
+    uint64_t hash = 0xCBF29CE484222325ull;
+
+    if (drawData->Textures != nullptr)
+        for (const ImTextureData* tex : *drawData->Textures)
+            if (tex->Status != ImTextureStatus_OK)
+                return false;
+
+    hash = _HashBytes(hash, &drawData->DisplayPos, sizeof(drawData->DisplayPos));
+    hash = _HashBytes(hash, &drawData->DisplaySize, sizeof(drawData->DisplaySize));
+    hash = _HashBytes(hash, &drawData->FramebufferScale, sizeof(drawData->FramebufferScale));
+
+    for (const ImDrawList* drawList : drawData->CmdLists) {
+        for (const ImDrawCmd& cmd : drawList->CmdBuffer) {
+            if (cmd.UserCallback != nullptr)
+                return false;
+
+            ImTextureID texId = cmd.GetTexID();
+            hash = _HashBytes(hash, &cmd.ClipRect, sizeof(cmd.ClipRect));
+            hash = _HashBytes(hash, &texId, sizeof(texId));
+            hash = _HashBytes(hash, &cmd.VtxOffset, sizeof(cmd.VtxOffset));
+            hash = _HashBytes(hash, &cmd.IdxOffset, sizeof(cmd.IdxOffset));
+            hash = _HashBytes(hash, &cmd.ElemCount, sizeof(cmd.ElemCount));
+        }
+
+        hash = _HashBytes(hash, drawList->VtxBuffer.Data, drawList->VtxBuffer.size_in_bytes());
+        hash = _HashBytes(hash, drawList->IdxBuffer.Data, drawList->IdxBuffer.size_in_bytes());
+    }
+
+    *pHash = hash;
+    return true;
+}
+
+static void _RecordDrawData(ImDrawData* drawData, VkCommandBuffer secondary)
+{
+    vkResetCommandBuffer(secondary, 0);
+
+    VkCommandBufferInheritanceRenderingInfo inheritanceRenderingInfo = {};
+    inheritanceRenderingInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+    inheritanceRenderingInfo.colorAttachmentCount = 1;
+    inheritanceRenderingInfo.pColorAttachmentFormats = &_DrawCache.colorFormat;
+    inheritanceRenderingInfo.rasterizationSamples = _DrawCache.samples;
+
+    VkCommandBufferInheritanceInfo inheritanceInfo = {};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.pNext = &inheritanceRenderingInfo;
+
+    /* 缓存的 secondary 会被多个在途帧同时执行 */
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+    vkBeginCommandBuffer(secondary, &beginInfo);
+    ImGui_ImplVulkan_RenderDrawData(drawData, secondary);
+    vkEndCommandBuffer(secondary);
+}
+
+void QkImGuiCreateContext()
 {
+    if (ImGui::GetCurrentContext() != nullptr)
+        return;
+
     // Setup Dear ImGui context
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -24,12 +138,54 @@ void QkImGuiVulkanHInit(GLFWwindow* window, ImGui_ImplVulkan_InitInfo* info)
         style.Colors[ImGuiCol_WindowBg].w = 1.0f;
     }
 
+    /*
+     * 预先烘焙默认字体的 ASCII 字形，首帧不再光栅化。Vulkan 后端支持动态纹理，
+     * 需要先声明 RendererHasTextures，否则 atlas 会按旧后端的方式预载全部字形。
+     * 字形数据在首帧随 ImTextureData 上传。
+     */
+    io.BackendFlags |= ImGuiBackendFlags_RendererHasTextures;
+    ImFontAtlasBuildMain(io.Fonts);
+
+    ImFont* font = io.Fonts->Fonts[0];
+    ImFontBaked* baked = font->GetFontBaked(style.FontSizeBase > 0.0f ? style.FontSizeBase : font->LegacySize);
+    for (ImWchar c = 0x20; c < 0x7F; c++)
+        baked->FindGlyph(c);
+}
+
+void QkImGuiVulkanHInit(GLFWwindow* window, ImGui_ImplVulkan_InitInfo* info)
+{
+    QkImGuiCreateContext();
+
     ImGui_ImplGlfw_InitForVulkan(window, true);
     ImGui_ImplVulkan_Init(info);
+
+    // draw data cache
+    _DrawCache.device = info->Device;
+    _DrawCache.colorFormat = info->PipelineRenderingCreateInfo.pColorAttachmentFormats[0];
+    _DrawCache.samples = info->MSAASamples != 0 ? info->MSAASamples : VK_SAMPLE_COUNT_1_BIT;
+
+    VkCommandPoolCreateInfo commandPoolCreateInfo = {};
+    commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    commandPoolCreateInfo.queueFamilyIndex = info->QueueFamily;
+    vkCreateCommandPool(info->Device, &commandPoolCreateInfo, VK_NULL_HANDLE, &_DrawCache.commandPool);
+
+    _DrawCache.commandBuffers.resize(info->ImageCount);
+
+    VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandBufferAllocateInfo.commandPool = _DrawCache.commandPool;
+    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    commandBufferAllocateInfo.commandBufferCount = info->ImageCount;
+    vkAllocateCommandBuffers(info->Device, &commandBufferAllocateInfo, std::data(_DrawCache.commandBuffers));
 }
 
 void QkImGuiVulkanHTerminate()
 {
+    vkDestroyCommandPool(_DrawCache.device, _DrawCache.commandPool, VK_NULL_HANDLE);
+    _DrawCache.commandBuffers.clear();
+    _DrawCache.valid = false;
+
     ImGui_ImplGlfw_Shutdown();
     ImGui_ImplVulkan_Shutdown();
 }
@@ -41,21 +197,87 @@ void QkImGuiVulkanHNewFrame(QK_MAYBE_UNUSED VkCommandBuffer commandBuffer)
     ImGui::NewFrame();
 
     // docking
-    ImGui::DockSpaceOverViewport();
+    if (_DrawCache.dockSpace)
+        ImGui::DockSpaceOverViewport();
 }
 
-void QkImGuiVulkanHEndFrame(VkCommandBuffer commandBuffer)
+VkRenderingFlags QkImGuiVulkanHRender()
 {
-    ImGuiIO& io = ImGui::GetIO(); (void)io;
-
     // Rendering
     ImGui::Render();
     ImDrawData* main_draw_data = ImGui::GetDrawData();
-    ImGui_ImplVulkan_RenderDrawData(main_draw_data, commandBuffer);
+
+    uint64_t hash = 0;
+    bool cacheable = _HashDrawData(main_draw_data, &hash);
+
+    /* 已缓存的数据直接复用；连续两帧相同才值得录制 secondary，否则内联绘制 */
+    bool reuse = cacheable && _DrawCache.valid && hash == _DrawCache.hash;
+    bool record = !reuse && cacheable && _DrawCache.lastValid && hash == _DrawCache.lastHash;
+
+    _DrawCache.lastHash = hash;
+    _DrawCache.lastValid = cacheable;
+    _DrawCache.rendered = true;
+    _DrawCache.useSecondary = reuse || record;
+
+    if (record) {
+        _DrawCache.index = (_DrawCache.index + 1) % static_cast<uint32_t>(std::size(_DrawCache.commandBuffers));
+        _RecordDrawData(main_draw_data, _DrawCache.commandBuffers[_DrawCache.index]);
+
+        _DrawCache.hash = hash;
+        _DrawCache.valid = true;
+        _DrawCache.statistics.recordedFrames++;
+    } else if (reuse) {
+        _DrawCache.statistics.reusedFrames++;
+    } else {
+        _DrawCache.valid = false;
+        _DrawCache.statistics.inlineFrames++;
+    }
+
+    _DrawCache.statistics.lastFrameReused = reuse;
+
+    return _DrawCache.useSecondary ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT : 0;
+}
+
+void QkImGuiVulkanHEndFrame(VkCommandBuffer commandBuffer)
+{
+    ImGuiIO& io = ImGui::GetIO(); (void)io;
+
+    /* 没有先调用 QkImGuiVulkanHRender 时按内联方式绘制 */
+    if (!_DrawCache.rendered) {
+        ImGui::Render();
+        _DrawCache.valid = false;
+        _DrawCache.lastValid = false;
+        _DrawCache.useSecondary = false;
+        _DrawCache.statistics.inlineFrames++;
+        _DrawCache.statistics.lastFrameReused = false;
+    }
+
+    if (_DrawCache.useSecondary)
+        vkCmdExecuteCommands(commandBuffer, 1, &_DrawCache.commandBuffers[_DrawCache.index]);
+    else
+        ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
+
+    _DrawCache.rendered = false;
 
     // Update and Render additional Platform Windows
     if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable) {
         ImGui::UpdatePlatformWindows();
         ImGui::RenderPlatformWindowsDefault();
     }
-}
\ No newline at end of file
+}
+
+void QkImGuiSetDockSpaceEnabled(bool enabled)
+{
+    _DrawCache.dockSpace = enabled;
+}
+
+void QkImGuiInvalidateDrawCache()
+{
+    _DrawCache.valid = false;
+    _DrawCache.lastValid = false;
+}
+
+QkImGuiDrawCacheStatistics QkImGuiGetDrawCacheStatistics()
+{
+    return _DrawCache.statistics;
+}
@@ -0,0 +1,265 @@
+#include "texture_atlas.h"
+
+#include <string.h>
+
+#include "driver/vkutils.h"
+
+/* staging 中每张图片的起始偏移按 16 字节对齐，满足 bufferOffset 的对齐要求 */
+static const VkDeviceSize STAGING_ALIGNMENT = 16;
+
+TextureAtlas::TextureAtlas(RenderDriver* driver) : driver(driver)
+{
+    /* do nothing... */
+}
+
+TextureAtlas::~TextureAtlas()
+{
+    for (Buffer buffer : stagingBuffers)
+        driver->DestroyBuffer(buffer);
+
+    if (sampler != VK_NULL_HANDLE)
+        driver->DestroySampler(sampler);
+
+    if (texture != VK_NULL_HANDLE)
+        driver->DestroyTexture2D(texture);
+}
+
+VkResult TextureAtlas::Initialize(const TextureAtlasCreateInfo& createInfo)
+{
+    VkResult err;
+
+    info = createInfo;
+    texelSize = VkUtils::FormatTexelSize(info.format);
+
+    if (texelSize == 0 || info.width == 0 || info.height == 0 || info.layerCount == 0 ||
+        info.padding * 2 >= std::min(info.width, info.height) || info.maxUploadBytesPerFrame == 0) {
+        printf("[vulkan] invalid texture atlas create info\n");
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    err = driver->CreateTexture2DArray(info.width, info.height, info.layerCount, 1, info.format,
+                                       VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, &texture);
+    VK_CHECK_ERROR(err);
+
+    err = driver->CreateSampler(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, &sampler);
+    VK_CHECK_ERROR(err);
+
+    /* 每个 in-flight 帧一份 staging 缓冲，CPU 只写 fence 已经完成的那一份 */
+    const uint32_t frameCount = driver->GetMaxFramesInFlight();
+    stagingBuffers.resize(frameCount, VK_NULL_HANDLE);
+
+    for (uint32_t i = 0; i < frameCount; i++) {
+        err = driver->CreateBuffer(info.maxUploadBytesPerFrame, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &stagingBuffers[i]);
+        VK_CHECK_ERROR(err);
+    }
+
+    skylines.resize(info.layerCount);
+
+    return VK_SUCCESS;
+}
+
+VkResult TextureAtlas::Insert(uint32_t w, uint32_t h, const void* pPixels, AtlasRegion* pRegion)
+{
+    const uint32_t padding = info.padding;
+    const uint32_t paddedWidth = w + padding * 2;
+    const uint32_t paddedHeight = h + padding * 2;
+    const VkDeviceSize paddedBytes = static_cast<VkDeviceSize>(paddedWidth) * paddedHeight * texelSize;
+
+    if (w == 0 || h == 0 || paddedWidth > info.width || paddedHeight > info.height || paddedBytes > info.maxUploadBytesPerFrame) {
+        printf("[vulkan] texture atlas cannot hold a %ux%u image\n", w, h);
+        return VK_ERROR_OUT_OF_POOL_MEMORY;
+    }
+
+    uint32_t layer = 0;
+    uint32_t index = 0, x = 0, y = 0;
+
+    /* 第一个放得下的层，未使用的层在轮到时才打开，已用的层尽量填满 */
+    for (; layer < info.layerCount; layer++) {
+        std::vector<SkylineNode>& skyline = skylines[layer];
+        if (skyline.empty())
+            skyline.push_back({ 0, 0, info.width });
+
+        if (_FindPosition(skyline, paddedWidth, paddedHeight, &index, &x, &y))
+            break;
+    }
+
+    if (layer == info.layerCount) {
+        printf("[vulkan] texture atlas is full, %ux%u image rejected\n", w, h);
+        return VK_ERROR_OUT_OF_POOL_MEMORY;
+    }
+
+    _AddSkylineLevel(skylines[layer], index, x, y, paddedWidth, paddedHeight);
+
+    /* 四周的 padding 复制最近的边缘纹素 */
+    PendingUpload upload = { layer, x, y, paddedWidth, paddedHeight, {} };
+    upload.pixels.resize(paddedBytes);
+
+    const uint8_t* src = static_cast<const uint8_t*>(pPixels);
+    for (uint32_t py = 0; py < paddedHeight; py++) {
+        const uint32_t sy = std::min(py > padding ? py - padding : 0, h - 1);
+        uint8_t* dstRow = upload.pixels.data() + static_cast<size_t>(py) * paddedWidth * texelSize;
+        const uint8_t* srcRow = src + static_cast<size_t>(sy) * w * texelSize;
+
+        for (uint32_t px = 0; px < paddedWidth; px++) {
+            const uint32_t sx = std::min(px > padding ? px - padding : 0, w - 1);
+            memcpy(dstRow + px * texelSize, srcRow + sx * texelSize, texelSize);
+        }
+    }
+
+    pendingUploads.push_back(std::move(upload));
+
+    pRegion->uvMin[0] = static_cast<float>(x + padding) / info.width;
+    pRegion->uvMin[1] = static_cast<float>(y + padding) / info.height;
+    pRegion->uvMax[0] = static_cast<float>(x + padding + w) / info.width;
+    pRegion->uvMax[1] = static_cast<float>(y + padding + h) / info.height;
+    pRegion->layer = layer;
+
+    usedArea += static_cast<uint64_t>(paddedWidth) * paddedHeight;
+    statistics.regionCount++;
+
+    return VK_SUCCESS;
+}
+
+void TextureAtlas::Clear()
+{
+    for (std::vector<SkylineNode>& skyline : skylines)
+        skyline.clear();
+
+    pendingUploads.clear();
+    usedArea = 0;
+    statistics.regionCount = 0;
+}
+
+void TextureAtlas::CmdUpload(VkCommandBuffer commandBuffer)
+{
+    statistics.uploadedRegions = 0;
+
+    /* 第一次调用时即使没有图片也要离开 UNDEFINED，之后的帧才能采样 */
+    if (layoutInitialized && pendingUploads.empty())
+        return;
+
+    driver->CmdTextureMemoryBarrier(commandBuffer, texture, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+    Buffer staging = stagingBuffers[driver->GetFlightIndex()];
+    uint8_t* mapped = static_cast<uint8_t*>(driver->MapBuffer(staging));
+    VkDeviceSize stagingOffset = 0;
+
+    /* 超出本帧 staging 的图片留到下一帧 */
+    size_t count = 0;
+    for (; count < pendingUploads.size(); count++) {
+        const PendingUpload& upload = pendingUploads[count];
+        if (stagingOffset + upload.pixels.size() > info.maxUploadBytesPerFrame)
+            break;
+
+        memcpy(mapped + stagingOffset, upload.pixels.data(), upload.pixels.size());
+        driver->CmdCopyBufferToTexture2D(commandBuffer, staging, stagingOffset, texture, 0,
+                                         upload.x, upload.y, upload.width, upload.height, upload.layer);
+
+        stagingOffset = (stagingOffset + upload.pixels.size() + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+    }
+
+    driver->UnmapBuffer(staging);
+
+    pendingUploads.erase(pendingUploads.begin(), pendingUploads.begin() + count);
+    statistics.uploadedRegions = static_cast<uint32_t>(count);
+
+    driver->CmdTextureMemoryBarrier(commandBuffer, texture, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    layoutInitialized = VK_TRUE;
+}
+
+void TextureAtlas::WriteDescriptorSet(VkDescriptorSet descriptorSet, uint32_t binding)
+{
+    driver->WriteDescriptorTexture(descriptorSet, binding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, texture, sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+void TextureAtlas::GetDescriptorSetLayoutBinding(uint32_t binding, VkShaderStageFlags stageFlags, VkDescriptorSetLayoutBinding* pBinding)
+{
+    *pBinding = { binding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, stageFlags, VK_NULL_HANDLE };
+}
+
+void TextureAtlas::GetStatistics(TextureAtlasStatistics* pStatistics) const
+{
+    *pStatistics = statistics;
+    pStatistics->pendingUploads = static_cast<uint32_t>(pendingUploads.size());
+
+    pStatistics->usedLayers = 0;
+    for (const std::vector<SkylineNode>& skyline : skylines) {
+        if (!skyline.empty())
+            pStatistics->usedLayers++;
+    }
+
+    const uint64_t layerArea = static_cast<uint64_t>(info.width) * info.height;
+    pStatistics->occupancy = pStatistics->usedLayers > 0
+        ? static_cast<float>(static_cast<double>(usedArea) / (layerArea * pStatistics->usedLayers))
+        : 0.0f;
+}
+
+bool TextureAtlas::_FindPosition(const std::vector<SkylineNode>& skyline, uint32_t w, uint32_t h, uint32_t* pIndex, uint32_t* pX, uint32_t* pY) const
+{
+    uint32_t bestTop = UINT32_MAX;
+    uint32_t bestWidth = UINT32_MAX;
+    bool found = false;
+
+    for (uint32_t i = 0; i < skyline.size(); i++) {
+        const uint32_t x = skyline[i].x;
+        if (x + w > info.width)
+            break;
+
+        /* 矩形左边对齐节点 i，底边落在它覆盖的所有节点中最高的那个上 */
+        uint32_t y = 0;
+        uint32_t covered = 0;
+        for (uint32_t j = i; j < skyline.size() && covered < w; j++) {
+            y = std::max(y, skyline[j].y);
+            covered += skyline[j].width;
+        }
+
+        if (y + h > info.height)
+            continue;
+
+        /* 顶边最低优先，相同时选更窄的节点，减少留下的缝隙 */
+        if (y + h < bestTop || (y + h == bestTop && skyline[i].width < bestWidth)) {
+            bestTop = y + h;
+            bestWidth = skyline[i].width;
+            *pIndex = i;
+            *pX = x;
+            *pY = y;
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+void TextureAtlas::_AddSkylineLevel(std::vector<SkylineNode>& skyline, uint32_t index, uint32_t x, uint32_t y, uint32_t w, uint32_t h)
+{
+    skyline.insert(skyline.begin() + index, { x, y + h, w });
+
+    /* 新节点覆盖掉的部分从后面的节点中裁掉 */
+    for (size_t i = index + 1; i < skyline.size(); ) {
+        const SkylineNode& prev = skyline[i - 1];
+        const uint32_t prevEnd = prev.x + prev.width;
+
+        if (skyline[i].x >= prevEnd)
+            break;
+
+        const uint32_t shrink = prevEnd - skyline[i].x;
+        if (skyline[i].width <= shrink) {
+            skyline.erase(skyline.begin() + i);
+            continue;
+        }
+
+        skyline[i].x += shrink;
+        skyline[i].width -= shrink;
+        break;
+    }
+
+    /* 合并高度相同的相邻节点 */
+    for (size_t i = 0; i + 1 < skyline.size(); ) {
+        if (skyline[i].y == skyline[i + 1].y) {
+            skyline[i].width += skyline[i + 1].width;
+            skyline.erase(skyline.begin() + i + 1);
+        } else {
+            i++;
+        }
+    }
+}
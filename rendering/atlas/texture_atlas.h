@@ -0,0 +1,109 @@
+#ifndef TEXTURE_ATLAS_H_
+#define TEXTURE_ATLAS_H_
+
+#include "driver/render_driver.h"
+
+// std
+#include <vector>
+
+struct TextureAtlasCreateInfo
+{
+    uint32_t width = 1024;                      // 每层的尺寸
+    uint32_t height = 1024;
+    uint32_t layerCount = 8;                    // 数组层数，创建时一次分配
+    uint32_t padding = 1;                       // 四周复制边缘像素的宽度，避免双线性过滤串色
+    VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+    VkDeviceSize maxUploadBytesPerFrame = 4 << 20;  // 每帧 staging 大小，也是单张图片（含 padding）的上限
+};
+
+/* 图片在图集中的位置，uv 指向去掉 padding 后的区域 */
+struct AtlasRegion
+{
+    float uvMin[2];
+    float uvMax[2];
+    uint32_t layer;
+};
+
+struct TextureAtlasStatistics
+{
+    uint32_t usedLayers;                        // 已经放入过图片的层数
+    uint32_t regionCount;
+    uint32_t pendingUploads;
+    uint32_t uploadedRegions;                   // 最近一帧上传的图片数
+    float occupancy;                            // 已用层中被图片覆盖的面积比例
+};
+
+/**
+ * 把大量小图打包进一张 2D 数组纹理。
+ *
+ * 每层一个 skyline 装箱器，Insert 时按层的顺序找第一个放得下的层，层内选择
+ * 放置后顶边最低的位置。像素先拷贝到 CPU 端的队列，在 CmdUpload 中通过每帧
+ * 一份的 staging 缓冲上传。所有图片共享同一个视图和 sampler，按 layer 和 uv
+ * 采样，精灵类 draw 可以合批而不需要切换描述符。
+ *
+ * 只支持追加，Clear 之后重新打包。
+ */
+class TextureAtlas
+{
+public:
+    TextureAtlas(RenderDriver* driver);
+   ~TextureAtlas();
+
+    VkResult Initialize(const TextureAtlasCreateInfo& createInfo);
+
+    /* pPixels 为 w * h 个紧密排列的纹素，格式与图集相同；所有层都放不下时返回 VK_ERROR_OUT_OF_POOL_MEMORY */
+    VkResult Insert(uint32_t w, uint32_t h, const void* pPixels, AtlasRegion* pRegion);
+
+    /* 清空装箱状态，之前返回的区域全部失效，纹理内容保留到被覆盖为止 */
+    void Clear();
+
+    /* 在使用图集的 pass 之前调用，上传排队的图片并转换到 SHADER_READ_ONLY */
+    void CmdUpload(VkCommandBuffer commandBuffer);
+
+    /* combined image sampler，着色器中声明为 sampler2DArray */
+    void WriteDescriptorSet(VkDescriptorSet descriptorSet, uint32_t binding);
+    static void GetDescriptorSetLayoutBinding(uint32_t binding, VkShaderStageFlags stageFlags, VkDescriptorSetLayoutBinding* pBinding);
+
+    void GetStatistics(TextureAtlasStatistics* pStatistics) const;
+
+    Texture2D GetTexture() const { return texture; }
+
+private:
+    struct SkylineNode
+    {
+        uint32_t x;
+        uint32_t y;
+        uint32_t width;
+    };
+
+    struct PendingUpload
+    {
+        uint32_t layer;
+        uint32_t x;
+        uint32_t y;
+        uint32_t width;
+        uint32_t height;
+        std::vector<uint8_t> pixels;
+    };
+
+    bool _FindPosition(const std::vector<SkylineNode>& skyline, uint32_t w, uint32_t h, uint32_t* pIndex, uint32_t* pX, uint32_t* pY) const;
+    void _AddSkylineLevel(std::vector<SkylineNode>& skyline, uint32_t index, uint32_t x, uint32_t y, uint32_t w, uint32_t h);
+
+    RenderDriver* driver = VK_NULL_HANDLE;
+    TextureAtlasCreateInfo info = {};
+    uint32_t texelSize = 0;
+
+    Texture2D texture = VK_NULL_HANDLE;
+    VkSampler sampler = VK_NULL_HANDLE;
+    std::vector<Buffer> stagingBuffers;
+    VkBool32 layoutInitialized = VK_FALSE;
+
+    /* 每层一条 skyline，空 vector 表示该层还没有使用 */
+    std::vector<std::vector<SkylineNode>> skylines;
+    std::vector<PendingUpload> pendingUploads;
+    uint64_t usedArea = 0;
+
+    TextureAtlasStatistics statistics = {};
+};
+
+#endif /* TEXTURE_ATLAS_H_ */
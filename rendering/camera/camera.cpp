@@ -75,3 +75,33 @@ const glm::mat4& Camera::GetViewMatrix() const
     return view;
 }
 
+
+const glm::vec3& Camera::GetPosition() const
+{
+    return position;
+}
+
+const glm::vec3& Camera::GetDirection() const
+{
+    return direction;
+}
+
+float Camera::GetFov() const
+{
+    return fov;
+}
+
+float Camera::GetAspectRatio() const
+{
+    return aspectRatio;
+}
+
+float Camera::GetNear() const
+{
+    return near;
+}
+
+float Camera::GetFar() const
+{
+    return far;
+}
@@ -21,6 +21,13 @@ public:
     const glm::mat4& GetViewMatrix() const;
     const glm::mat4& GetProjectionMatrix() const;
 
+    const glm::vec3& GetPosition() const;
+    const glm::vec3& GetDirection() const;
+    float GetFov() const;                       // 垂直视场角，角度
+    float GetAspectRatio() const;
+    float GetNear() const;
+    float GetFar() const;
+
 private:
     void MarkViewDirty() { viewDirty = true; }
     void MarkProjectionDirty() { projectionDirty = true; }
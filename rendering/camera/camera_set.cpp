@@ -0,0 +1,106 @@
+#include "camera_set.h"
+
+#include <algorithm>
+#include <string.h>
+
+CameraSet::CameraSet(RenderDriver* driver) : driver(driver)
+{
+    /* do nothing... */
+}
+
+CameraSet::~CameraSet()
+{
+    if (uniformBuffer != VK_NULL_HANDLE)
+        driver->DestroyBuffer(uniformBuffer);
+}
+
+VkResult CameraSet::Initialize()
+{
+    for (uint32_t i = 0; i < QK_MULTIVIEW_MAX_VIEWS; i++) {
+        views[i] = glm::mat4(1.0f);
+        projections[i] = glm::mat4(1.0f);
+    }
+
+    return driver->CreateBuffer(sizeof(MultiviewUniformData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, &uniformBuffer);
+}
+
+void CameraSet::SetViewCount(uint32_t count)
+{
+    uint32_t maxViewCount = std::min<uint32_t>(QK_MULTIVIEW_MAX_VIEWS, driver->GetMaxMultiviewViewCount());
+    viewCount = std::clamp<uint32_t>(count, 1, std::max<uint32_t>(maxViewCount, 1));
+}
+
+void CameraSet::SetView(uint32_t index, const glm::mat4& view, const glm::mat4& projection)
+{
+    views[index] = view;
+    projections[index] = projection;
+}
+
+void CameraSet::SetView(uint32_t index, const Camera& camera)
+{
+    SetView(index, camera.GetViewMatrix(), camera.GetProjectionMatrix());
+}
+
+void CameraSet::SetStereo(const Camera& camera, float eyeSeparation)
+{
+    const glm::vec3 direction = glm::normalize(camera.GetDirection());
+    const glm::vec3 right = glm::normalize(glm::cross(direction, glm::vec3(0.0f, 1.0f, 0.0f)));
+    const glm::vec3 up = glm::cross(right, direction);
+
+    SetViewCount(2);
+    for (uint32_t eye = 0; eye < 2; eye++) {
+        const glm::vec3 position = camera.GetPosition() + right * (eye == 0 ? -0.5f : 0.5f) * eyeSeparation;
+        SetView(eye, glm::lookAt(position, position + direction, up), camera.GetProjectionMatrix());
+    }
+}
+
+void CameraSet::SetCubemap(const glm::vec3& position, float near, float far)
+{
+    /* 投影不翻转 y，层的第 0 行对应 NDC 的 y = -1，朝向与 OpenGL 的立方体贴图约定一致 */
+    static const glm::vec3 directions[6] = {
+        {  1.0f,  0.0f,  0.0f }, { -1.0f,  0.0f,  0.0f },
+        {  0.0f,  1.0f,  0.0f }, {  0.0f, -1.0f,  0.0f },
+        {  0.0f,  0.0f,  1.0f }, {  0.0f,  0.0f, -1.0f },
+    };
+
+    static const glm::vec3 ups[6] = {
+        {  0.0f, -1.0f,  0.0f }, {  0.0f, -1.0f,  0.0f },
+        {  0.0f,  0.0f,  1.0f }, {  0.0f,  0.0f, -1.0f },
+        {  0.0f, -1.0f,  0.0f }, {  0.0f, -1.0f,  0.0f },
+    };
+
+    const glm::mat4 projection = glm::perspectiveRH_ZO(glm::radians(90.0f), 1.0f, near, far);
+
+    SetViewCount(6);
+    for (uint32_t face = 0; face < viewCount; face++)
+        SetView(face, glm::lookAt(position, position + directions[face], ups[face]), projection);
+}
+
+void CameraSet::CmdUpload(VkCommandBuffer commandBuffer)
+{
+    MultiviewUniformData data = {};
+    for (uint32_t i = 0; i < viewCount; i++) {
+        const glm::mat4 viewProjection = projections[i] * views[i];
+        const glm::vec3 position = glm::vec3(glm::inverse(views[i])[3]);
+
+        memcpy(data.viewProjection[i], glm::value_ptr(viewProjection), sizeof(data.viewProjection[i]));
+        memcpy(data.view[i], glm::value_ptr(views[i]), sizeof(data.view[i]));
+        memcpy(data.cameraPosition[i], glm::value_ptr(position), sizeof(float) * 3);
+    }
+
+    /* WAR：上一次渲染的顶点着色器读完之后再更新 */
+    driver->CmdMemoryBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+    driver->CmdUpdateBuffer(commandBuffer, uniformBuffer, 0, sizeof(data), &data);
+
+    driver->CmdMemoryBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                             VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_UNIFORM_READ_BIT);
+}
+
+void CameraSet::WriteDescriptor(VkDescriptorSet descriptorSet, uint32_t binding) const
+{
+    driver->WriteDescriptorBuffer(descriptorSet, binding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniformBuffer, 0, sizeof(MultiviewUniformData));
+}
@@ -0,0 +1,66 @@
+#ifndef CAMERA_SET_H_
+#define CAMERA_SET_H_
+
+#include "driver/render_driver.h"
+#include "rendering/camera/camera.h"
+
+/* 与 qk_multiview.glsl 中的 QK_MULTIVIEW_MAX_VIEWS 保持一致，足够一次渲染立方体贴图的 6 个面 */
+#define QK_MULTIVIEW_MAX_VIEWS 6
+
+/* std140，与 qk_multiview.glsl 中的 MultiviewData 保持一致 */
+struct MultiviewUniformData
+{
+    float viewProjection[QK_MULTIVIEW_MAX_VIEWS][16];
+    float view[QK_MULTIVIEW_MAX_VIEWS][16];
+    float cameraPosition[QK_MULTIVIEW_MAX_VIEWS][4];    // w 未使用
+};
+
+/**
+ * 一次渲染的多个视图。
+ *
+ * 第 i 个视图渲染到数组纹理的第 i 层：CmdBeginMultiviewRendering 使用 GetViewMask()，
+ * 管线的 viewMask 相同，顶点着色器通过 qk_multiview.glsl 以 gl_ViewIndex 取各自的矩阵。
+ * 几何只提交一次，驱动把每个图元广播到所有视图，适用于双目立体、反射探针的立方体
+ * 贴图和其他需要同一组物体在多个视角下渲染的场合。
+ */
+class CameraSet
+{
+public:
+    CameraSet(RenderDriver* driver);
+   ~CameraSet();
+
+    VkResult Initialize();
+
+    /* viewCount 不超过 QK_MULTIVIEW_MAX_VIEWS 和设备的 maxMultiviewViewCount */
+    void SetViewCount(uint32_t viewCount);
+    void SetView(uint32_t index, const glm::mat4& view, const glm::mat4& projection);
+    void SetView(uint32_t index, const Camera& camera);
+
+    /* 左右眼沿相机的右方向各偏移 eyeSeparation 的一半，视线平行 */
+    void SetStereo(const Camera& camera, float eyeSeparation);
+
+    /* 立方体贴图的 6 个面，顺序与层号为 +X、-X、+Y、-Y、+Z、-Z */
+    void SetCubemap(const glm::vec3& position, float near, float far);
+
+    /* 在 CmdBeginMultiviewRendering 之前调用 */
+    void CmdUpload(VkCommandBuffer commandBuffer);
+
+    /* binding 为 MultiviewData UBO，与 qk_multiview.glsl 相同 */
+    void WriteDescriptor(VkDescriptorSet descriptorSet, uint32_t binding) const;
+
+    uint32_t GetViewCount() const { return viewCount; }
+    uint32_t GetViewMask() const { return (1u << viewCount) - 1; }
+    const glm::mat4& GetViewMatrix(uint32_t index) const { return views[index]; }
+    const glm::mat4& GetProjectionMatrix(uint32_t index) const { return projections[index]; }
+
+private:
+    RenderDriver* driver = VK_NULL_HANDLE;
+
+    Buffer uniformBuffer = VK_NULL_HANDLE;
+
+    uint32_t viewCount = 1;
+    glm::mat4 views[QK_MULTIVIEW_MAX_VIEWS] = {};
+    glm::mat4 projections[QK_MULTIVIEW_MAX_VIEWS] = {};
+};
+
+#endif /* CAMERA_SET_H_ */
@@ -0,0 +1,206 @@
+#include "debug_panels.h"
+
+#include "driver/render_driver.h"
+#include "core/profiler/profiler.h"
+#include <imgui/imgui.h>
+
+#include <stdio.h>
+
+static void FormatBytes(char* buf, size_t size, VkDeviceSize bytes)
+{
+    if (bytes >= 1024ull * 1024 * 1024)
+        snprintf(buf, size, "%.2f GiB", bytes / (1024.0 * 1024.0 * 1024.0));
+    else if (bytes >= 1024ull * 1024)
+        snprintf(buf, size, "%.2f MiB", bytes / (1024.0 * 1024.0));
+    else if (bytes >= 1024ull)
+        snprintf(buf, size, "%.2f KiB", bytes / 1024.0);
+    else
+        snprintf(buf, size, "%llu B", static_cast<unsigned long long>(bytes));
+}
+
+void QkImGuiMemoryPanel(RenderDriver* driver, bool* pOpen)
+{
+    if (!ImGui::Begin("Memory", pOpen)) {
+        ImGui::End();
+        return;
+    }
+
+    MemoryStatistics stats = {};
+    driver->GetMemoryStatistics(&stats);
+
+    char usage[32], budget[32], blocks[32];
+
+    /* 堆预算 */
+    ImGui::Text("VK_EXT_memory_budget: %s", stats.memoryBudgetExtension ? "enabled" : "unavailable (estimated)");
+
+    if (ImGui::BeginTable("heaps", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupColumn("Heap");
+        ImGui::TableSetupColumn("Usage / Budget");
+        ImGui::TableSetupColumn("Blocks");
+        ImGui::TableSetupColumn("Allocations");
+        ImGui::TableHeadersRow();
+
+        for (uint32_t i = 0; i < stats.heapCount; i++) {
+            const VmaBudget& heap = stats.heapBudgets[i];
+
+            FormatBytes(usage, sizeof(usage), heap.usage);
+            FormatBytes(budget, sizeof(budget), heap.budget);
+            FormatBytes(blocks, sizeof(blocks), heap.statistics.blockBytes);
+
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%u%s", i, (stats.heapFlags[i] & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " (device)" : " (host)");
+            ImGui::TableNextColumn();
+            float fraction = heap.budget > 0 ? static_cast<float>(heap.usage) / static_cast<float>(heap.budget) : 0.0f;
+            char overlay[72];
+            snprintf(overlay, sizeof(overlay), "%s / %s", usage, budget);
+            ImGui::ProgressBar(fraction, ImVec2(-1.0f, 0.0f), overlay);
+            ImGui::TableNextColumn();
+            ImGui::Text("%s (%u)", blocks, heap.statistics.blockCount);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", heap.statistics.allocationCount);
+        }
+
+        ImGui::EndTable();
+    }
+
+    /* 分类统计 */
+    if (ImGui::BeginTable("categories", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupColumn("Category");
+        ImGui::TableSetupColumn("Allocations");
+        ImGui::TableSetupColumn("Size");
+        ImGui::TableHeadersRow();
+
+        for (uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+            const MemoryCategoryStatistics& category = stats.categories[i];
+            if (category.allocationCount == 0)
+                continue;
+
+            FormatBytes(usage, sizeof(usage), category.bytes);
+
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(RenderDriver::GetMemoryCategoryName(static_cast<MemoryCategory>(i)));
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", category.allocationCount);
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(usage);
+        }
+
+        ImGui::EndTable();
+    }
+
+    /* 碎片整理 */
+    FormatBytes(usage, sizeof(usage), stats.defragmentationBytesMoved);
+    FormatBytes(budget, sizeof(budget), stats.defragmentationBytesFreed);
+    ImGui::Text("Defragmentation: %u moves, %s moved, %s freed", stats.defragmentationMoves, usage, budget);
+
+    ImGui::BeginDisabled(stats.defragmenting);
+    if (ImGui::Button(stats.defragmenting ? "Defragmenting..." : "Defragment"))
+        driver->BeginDefragmentation();
+    ImGui::EndDisabled();
+
+    ImGui::SameLine();
+    if (ImGui::Button("Dump VMA JSON"))
+        driver->DumpMemoryStatistics("quokka_vma_stats.json");
+
+    ImGui::End();
+}
+
+static ImU32 ZoneColor(const char* name)
+{
+    /* 同名 zone 颜色固定 */
+    uint32_t hash = 2166136261u;
+    for (const char* c = name; *c != '\0'; c++)
+        hash = (hash ^ static_cast<uint8_t>(*c)) * 16777619u;
+
+    return IM_COL32(96 + (hash & 0x7F), 96 + ((hash >> 8) & 0x7F), 96 + ((hash >> 16) & 0x7F), 255);
+}
+
+void QkImGuiProfilerPanel(bool* pOpen)
+{
+    static ProfileFrame frame = {};
+    static bool paused = false;
+
+    if (!ImGui::Begin("Profiler", pOpen)) {
+        ImGui::End();
+        return;
+    }
+
+    bool enabled = Profiler::IsEnabled();
+    if (ImGui::Checkbox("Enabled", &enabled))
+        Profiler::SetEnabled(enabled);
+
+    ImGui::SameLine();
+    ImGui::Checkbox("Pause", &paused);
+
+    ImGui::SameLine();
+    if (ImGui::Button("Export Chrome Trace"))
+        Profiler::ExportChromeTrace("quokka_trace.json");
+
+#ifndef QK_ENABLE_PROFILER
+    ImGui::TextUnformatted("Built without QK_ENABLE_PROFILER");
+#endif
+
+    if (!paused)
+        Profiler::CollectLastFrame(&frame);
+
+    if (frame.end <= frame.begin) {
+        ImGui::TextUnformatted("No frames recorded");
+        ImGui::End();
+        return;
+    }
+
+    const double frameMs = (frame.end - frame.begin) / 1000000.0;
+    ImGui::Text("Frame %llu: %.3f ms", static_cast<unsigned long long>(frame.frameNumber), frameMs);
+
+    /* 每个线程一条泳道，按嵌套深度分行 */
+    const float rowHeight = ImGui::GetTextLineHeightWithSpacing();
+    const float labelWidth = 96.0f;
+
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+
+    for (const ProfileThread& thread : frame.threads) {
+        uint32_t maxDepth = 0;
+        for (const ProfileEvent& event : thread.events)
+            maxDepth = std::max(maxDepth, event.depth);
+
+        ImVec2 origin = ImGui::GetCursorScreenPos();
+        float width = std::max(ImGui::GetContentRegionAvail().x - labelWidth, 1.0f);
+        float height = rowHeight * (maxDepth + 1);
+
+        char label[64];
+        snprintf(label, sizeof(label), "%s", thread.name != nullptr ? thread.name : "Thread");
+        drawList->AddText(origin, ImGui::GetColorU32(ImGuiCol_Text), label);
+
+        ImVec2 laneMin(origin.x + labelWidth, origin.y);
+        drawList->AddRectFilled(laneMin, ImVec2(laneMin.x + width, laneMin.y + height), ImGui::GetColorU32(ImGuiCol_FrameBg));
+
+        for (const ProfileEvent& event : thread.events) {
+            uint64_t begin = std::max(event.begin, frame.begin);
+            uint64_t end = std::min(event.end, frame.end);
+
+            float x0 = laneMin.x + static_cast<float>((begin - frame.begin) / (frameMs * 1000000.0)) * width;
+            float x1 = laneMin.x + static_cast<float>((end - frame.begin) / (frameMs * 1000000.0)) * width;
+            float y0 = laneMin.y + event.depth * rowHeight;
+            x1 = std::max(x1, x0 + 1.0f);
+
+            ImVec2 min(x0, y0);
+            ImVec2 max(x1, y0 + rowHeight - 1.0f);
+            drawList->AddRectFilled(min, max, ZoneColor(event.name));
+
+            if (x1 - x0 > 24.0f) {
+                drawList->PushClipRect(min, max, true);
+                drawList->AddText(ImVec2(x0 + 2.0f, y0), IM_COL32(0, 0, 0, 255), event.name);
+                drawList->PopClipRect();
+            }
+
+            if (ImGui::IsMouseHoveringRect(min, max))
+                ImGui::SetTooltip("%s\n%.3f ms", event.name, (event.end - event.begin) / 1000000.0);
+        }
+
+        ImGui::Dummy(ImVec2(labelWidth + width, height + 4.0f));
+    }
+
+    ImGui::End();
+}
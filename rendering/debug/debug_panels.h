@@ -0,0 +1,11 @@
+#ifndef DEBUG_PANELS_H_
+#define DEBUG_PANELS_H_
+
+class RenderDriver;
+
+void QkImGuiMemoryPanel(RenderDriver* driver, bool* pOpen);
+
+/* 最近一帧的 CPU zone 火焰图，可暂停和导出 Chrome trace */
+void QkImGuiProfilerPanel(bool* pOpen);
+
+#endif /* DEBUG_PANELS_H_ */
@@ -0,0 +1,164 @@
+#include "clustered_lighting.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#include "core/profiler/profiler.h"
+#include "driver/vkutils.h"
+
+/* 与 qk_cluster_cull.comp 的 local_size_x 保持一致 */
+static const uint32_t CLUSTER_GROUP_SIZE = 64;
+
+ClusteredLighting::ClusteredLighting(RenderDriver* driver) : driver(driver)
+{
+    /* do nothing... */
+}
+
+ClusteredLighting::~ClusteredLighting()
+{
+    if (cullPipeline != VK_NULL_HANDLE)
+        driver->DestroyPipeline(cullPipeline);
+
+    Buffer buffers[] = { lightBuffer, clusterCountBuffer, clusterIndexBuffer, uniformBuffer };
+    for (Buffer buffer : buffers) {
+        if (buffer != VK_NULL_HANDLE)
+            driver->DestroyBuffer(buffer);
+    }
+
+    for (Buffer buffer : stagingBuffers)
+        driver->DestroyBuffer(buffer);
+}
+
+VkResult ClusteredLighting::Initialize(const ClusteredLightingCreateInfo& createInfo)
+{
+    VkResult err;
+
+    info = createInfo;
+    info.maxLights = std::max<uint32_t>(info.maxLights, 1);
+    info.maxLightsPerCluster = std::max<uint32_t>(info.maxLightsPerCluster, 1);
+
+    const uint32_t clusterCount = info.gridX * info.gridY * info.gridZ;
+    const VkDeviceSize lightBufferSize = static_cast<VkDeviceSize>(info.maxLights) * sizeof(PointLight);
+
+    err = driver->CreateBuffer(lightBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, &lightBuffer);
+    VK_CHECK_ERROR(err);
+
+    err = driver->CreateBuffer(sizeof(uint32_t) * clusterCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &clusterCountBuffer);
+    VK_CHECK_ERROR(err);
+
+    err = driver->CreateBuffer(sizeof(uint32_t) * clusterCount * info.maxLightsPerCluster, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &clusterIndexBuffer);
+    VK_CHECK_ERROR(err);
+
+    err = driver->CreateBuffer(sizeof(ClusterUniformData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, &uniformBuffer);
+    VK_CHECK_ERROR(err);
+
+    /* 每个 in-flight 帧一份 staging 缓冲，光源变化时整体上传 */
+    stagingBuffers.resize(driver->GetMaxFramesInFlight(), VK_NULL_HANDLE);
+    for (Buffer& staging : stagingBuffers) {
+        err = driver->CreateBuffer(lightBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &staging);
+        VK_CHECK_ERROR(err);
+    }
+
+    VkDescriptorSetLayoutBinding bindings[] = {
+        { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, VK_NULL_HANDLE },
+        { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, VK_NULL_HANDLE },
+        { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, VK_NULL_HANDLE },
+        { 3, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, VK_NULL_HANDLE },
+    };
+
+    err = driver->CreateComputePipeline("qk_cluster_cull", ARRAY_SIZE(bindings), bindings, 0, &cullPipeline);
+    VK_CHECK_ERROR(err);
+
+    statistics.clusterCount = clusterCount;
+
+    return VK_SUCCESS;
+}
+
+void ClusteredLighting::SetLights(uint32_t lightCount, const PointLight* pLights)
+{
+    lights.assign(pLights, pLights + std::min(lightCount, info.maxLights));
+    lightsDirty = VK_TRUE;
+}
+
+void ClusteredLighting::CmdCull(VkCommandBuffer commandBuffer, const Camera& camera)
+{
+    QK_PROFILE_FUNCTION();
+
+    VkResult err;
+
+    statistics.lightCount = static_cast<uint32_t>(lights.size());
+    statistics.uploadedBytes = 0;
+
+    /* WAR：等待之前的帧读完光源、簇列表和参数 */
+    driver->CmdMemoryBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    if (lightsDirty && !lights.empty()) {
+        const VkDeviceSize size = lights.size() * sizeof(PointLight);
+
+        Buffer staging = stagingBuffers[driver->GetFlightIndex()];
+        memcpy(driver->MapBuffer(staging), lights.data(), size);
+        driver->UnmapBuffer(staging);
+
+        driver->CmdCopyBuffer(commandBuffer, staging, 0, lightBuffer, 0, size);
+        statistics.uploadedBytes = static_cast<uint32_t>(size);
+    }
+
+    lightsDirty = VK_FALSE;
+
+    const glm::mat4& view = camera.GetViewMatrix();
+    const glm::mat4 inverseView = glm::inverse(view);
+    const glm::mat4& projection = camera.GetProjectionMatrix();
+
+    /* 分簇范围限制在相机的近、远平面之内 */
+    const float nearDepth = std::max(info.nearDepth, camera.GetNear());
+    const float farDepth = std::max(std::min(info.farDepth, camera.GetFar()), nearDepth * 2.0f);
+    const float sliceScale = info.gridZ / logf(farDepth / nearDepth);
+
+    ClusterUniformData data = {};
+    memcpy(data.view, glm::value_ptr(view), sizeof(data.view));
+    memcpy(data.inverseView, glm::value_ptr(inverseView), sizeof(data.inverseView));
+    data.projectionScale[0] = 1.0f / projection[0][0];
+    data.projectionScale[1] = 1.0f / projection[1][1];
+    data.projectionScale[2] = nearDepth;
+    data.projectionScale[3] = farDepth;
+    data.sliceParams[0] = sliceScale;
+    data.sliceParams[1] = -sliceScale * logf(nearDepth);
+    data.grid[0] = info.gridX;
+    data.grid[1] = info.gridY;
+    data.grid[2] = info.gridZ;
+    data.limits[0] = static_cast<uint32_t>(lights.size());
+    data.limits[1] = info.maxLightsPerCluster;
+
+    driver->CmdUpdateBuffer(commandBuffer, uniformBuffer, 0, sizeof(data), &data);
+
+    driver->CmdMemoryBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                             VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT);
+
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    err = driver->AllocateDescriptorSet(cullPipeline, &descriptorSet);
+    if (err != VK_SUCCESS)
+        return;
+
+    WriteDescriptor(descriptorSet, 0);
+
+    driver->CmdBindPipeline(commandBuffer, cullPipeline);
+    driver->CmdBindDescriptorSet(commandBuffer, cullPipeline, descriptorSet);
+    driver->CmdDispatch(commandBuffer, (statistics.clusterCount + CLUSTER_GROUP_SIZE - 1) / CLUSTER_GROUP_SIZE, 1, 1);
+
+    driver->CmdMemoryBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                             VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+}
+
+void ClusteredLighting::WriteDescriptor(VkDescriptorSet descriptorSet, uint32_t binding) const
+{
+    driver->WriteDescriptorBuffer(descriptorSet, binding + 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, lightBuffer, 0, VK_WHOLE_SIZE);
+    driver->WriteDescriptorBuffer(descriptorSet, binding + 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, clusterCountBuffer, 0, VK_WHOLE_SIZE);
+    driver->WriteDescriptorBuffer(descriptorSet, binding + 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, clusterIndexBuffer, 0, VK_WHOLE_SIZE);
+    driver->WriteDescriptorBuffer(descriptorSet, binding + 3, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniformBuffer, 0, sizeof(ClusterUniformData));
+}
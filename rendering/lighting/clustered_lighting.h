@@ -0,0 +1,94 @@
+#ifndef CLUSTERED_LIGHTING_H_
+#define CLUSTERED_LIGHTING_H_
+
+#include "driver/render_driver.h"
+#include "rendering/camera/camera.h"
+
+// std
+#include <vector>
+
+/* std430，与 qk_cluster.glsl 中的 QkPointLight 保持一致 */
+struct PointLight
+{
+    float position[3];                          // 世界空间
+    float radius;                               // 影响范围，之外的贡献为 0
+    float color[3];
+    float intensity;
+};
+
+/* std140，与 qk_cluster.glsl 中的 ClusterData 保持一致 */
+struct ClusterUniformData
+{
+    float view[16];
+    float inverseView[16];
+    float projectionScale[4];
+    float sliceParams[4];
+    uint32_t grid[4];
+    uint32_t limits[4];
+};
+
+struct ClusteredLightingCreateInfo
+{
+    uint32_t maxLights = 4096;
+    uint32_t gridX = 16;
+    uint32_t gridY = 9;
+    uint32_t gridZ = 24;
+    uint32_t maxLightsPerCluster = 128;         // 超出的光源被丢弃
+    float nearDepth = 0.1f;                     // 更近的片元归入第 0 段
+    float farDepth = 100.0f;                    // 更远的片元不受点光源影响
+};
+
+struct ClusteredLightingStatistics
+{
+    uint32_t lightCount;
+    uint32_t clusterCount;
+    uint32_t uploadedBytes;                     // 最近一帧上传的光源数据
+};
+
+/**
+ * 分簇前向光照。
+ *
+ * 光源放在 device local 的 SSBO 中，每帧从对应 in-flight 帧的 staging 缓冲拷贝。
+ * CmdCull 在计算着色器中按相机投影把视锥划分为 gridX x gridY x gridZ 个簇（深度按
+ * 指数划分），每个簇与所有光源求交后得到最多 maxLightsPerCluster 个光源的列表。
+ * 片元着色器通过 qk_cluster.glsl 找到所在的簇并只遍历其中的光源，每个像素的开销
+ * 取决于局部的光源密度而不是光源总数。
+ */
+class ClusteredLighting
+{
+public:
+    ClusteredLighting(RenderDriver* driver);
+   ~ClusteredLighting();
+
+    VkResult Initialize(const ClusteredLightingCreateInfo& createInfo);
+
+    /* 超出 maxLights 的部分被忽略，下一次 CmdCull 时上传 */
+    void SetLights(uint32_t lightCount, const PointLight* pLights);
+
+    /* 在 CmdBeginRendering 之前调用 */
+    void CmdCull(VkCommandBuffer commandBuffer, const Camera& camera);
+
+    /* binding 起依次为光源、簇的光源数量、簇的光源下标 (SSBO) 和 ClusterData (UBO)，与 qk_cluster.glsl 相同 */
+    void WriteDescriptor(VkDescriptorSet descriptorSet, uint32_t binding) const;
+
+    void GetStatistics(ClusteredLightingStatistics* pStatistics) const { *pStatistics = statistics; }
+
+private:
+    RenderDriver* driver = VK_NULL_HANDLE;
+    ClusteredLightingCreateInfo info = {};
+
+    Buffer lightBuffer = VK_NULL_HANDLE;
+    Buffer clusterCountBuffer = VK_NULL_HANDLE;
+    Buffer clusterIndexBuffer = VK_NULL_HANDLE;
+    Buffer uniformBuffer = VK_NULL_HANDLE;
+    std::vector<Buffer> stagingBuffers;
+
+    Pipeline cullPipeline = VK_NULL_HANDLE;
+
+    std::vector<PointLight> lights;
+    VkBool32 lightsDirty = VK_FALSE;
+
+    ClusteredLightingStatistics statistics = {};
+};
+
+#endif /* CLUSTERED_LIGHTING_H_ */
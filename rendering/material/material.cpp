@@ -0,0 +1,194 @@
+#include "material.h"
+
+#include <string.h>
+
+#include "core/profiler/profiler.h"
+#include "driver/vkutils.h"
+
+MaterialSystem::MaterialSystem(RenderDriver* driver) : driver(driver)
+{
+    /* do nothing... */
+}
+
+MaterialSystem::~MaterialSystem()
+{
+    if (descriptorSet != VK_NULL_HANDLE)
+        driver->FreeDescriptorSet(descriptorSet);
+
+    for (auto& [key, pipeline] : variants)
+        driver->DestroyPipeline(pipeline);
+
+    for (Buffer buffer : stagingBuffers)
+        driver->DestroyBuffer(buffer);
+
+    if (materialBuffer != VK_NULL_HANDLE)
+        driver->DestroyBuffer(materialBuffer);
+}
+
+VkResult MaterialSystem::Initialize(uint32_t maxMaterials)
+{
+    VkResult err;
+
+    this->maxMaterials = maxMaterials;
+    parameters.resize(maxMaterials);
+
+    const VkDeviceSize bufferSize = static_cast<VkDeviceSize>(maxMaterials) * sizeof(MaterialParameters);
+
+    err = driver->CreateBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, &materialBuffer);
+    VK_CHECK_ERROR(err);
+
+    /* 每个 in-flight 帧一份 staging 缓冲，与材质缓冲等大，按相同偏移拷贝 */
+    const uint32_t frameCount = driver->GetMaxFramesInFlight();
+    stagingBuffers.resize(frameCount, VK_NULL_HANDLE);
+
+    for (uint32_t i = 0; i < frameCount; i++) {
+        err = driver->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &stagingBuffers[i]);
+        VK_CHECK_ERROR(err);
+    }
+
+    return VK_SUCCESS;
+}
+
+VkResult MaterialSystem::CreateMaterial(const MaterialCreateInfo& createInfo, Material* pMaterial)
+{
+    QK_PROFILE_ZONE("CreateMaterial");
+
+    VkResult err;
+
+    Pipeline pipeline = VK_NULL_HANDLE;
+    err = _AcquireVariant(createInfo.shaderName, createInfo.features, &pipeline);
+    VK_CHECK_ERROR(err);
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (statistics.materialCount >= maxMaterials) {
+        printf("[vulkan] material buffer is full (%u materials)\n", maxMaterials);
+        return VK_ERROR_OUT_OF_POOL_MEMORY;
+    }
+
+    uint32_t id = statistics.materialCount++;
+    parameters[id] = createInfo.parameters;
+    dirtyBegin = std::min(dirtyBegin, id);
+    dirtyEnd = std::max(dirtyEnd, id + 1);
+
+    pMaterial->id = id;
+    pMaterial->features = createInfo.features;
+    pMaterial->pipeline = pipeline;
+
+    return VK_SUCCESS;
+}
+
+void MaterialSystem::UpdateMaterial(const Material& material, const MaterialParameters& parameters)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    this->parameters[material.id] = parameters;
+    dirtyBegin = std::min(dirtyBegin, material.id);
+    dirtyEnd = std::max(dirtyEnd, material.id + 1);
+}
+
+void MaterialSystem::CmdUpload(VkCommandBuffer commandBuffer)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    statistics.uploadedBytes = 0;
+
+    if (dirtyBegin >= dirtyEnd)
+        return;
+
+    const VkDeviceSize offset = static_cast<VkDeviceSize>(dirtyBegin) * sizeof(MaterialParameters);
+    const VkDeviceSize size = static_cast<VkDeviceSize>(dirtyEnd - dirtyBegin) * sizeof(MaterialParameters);
+
+    Buffer staging = stagingBuffers[driver->GetFlightIndex()];
+    uint8_t* mapped = static_cast<uint8_t*>(driver->MapBuffer(staging));
+    memcpy(mapped + offset, parameters.data() + dirtyBegin, size);
+    driver->UnmapBuffer(staging);
+
+    /* WAR：等待之前的帧读完参数 */
+    driver->CmdMemoryBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+    driver->CmdCopyBuffer(commandBuffer, staging, offset, materialBuffer, offset, size);
+
+    driver->CmdMemoryBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                             VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+    statistics.uploadedBytes = static_cast<uint32_t>(size);
+    dirtyBegin = UINT32_MAX;
+    dirtyEnd = 0;
+}
+
+void MaterialSystem::GetStatistics(MaterialStatistics* pStatistics) const
+{
+    *pStatistics = statistics;
+    pStatistics->variantCount = static_cast<uint32_t>(variants.size());
+}
+
+VkResult MaterialSystem::_AcquireVariant(const char* shaderName, MaterialFeatureFlags features, Pipeline* pPipeline)
+{
+    VkResult err;
+    VariantKey key = { shaderName, features };
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = variants.find(key);
+        if (it != variants.end()) {
+            statistics.variantHits++;
+            *pPipeline = it->second;
+            return VK_SUCCESS;
+        }
+    }
+
+    /* 每个特性位一个 4 字节的 VkBool32 常量 */
+    VkBool32 constants[QK_MATERIAL_FEATURE_COUNT];
+    VkSpecializationMapEntry mapEntries[QK_MATERIAL_FEATURE_COUNT];
+    for (uint32_t i = 0; i < QK_MATERIAL_FEATURE_COUNT; i++) {
+        constants[i] = (features >> i) & 1 ? VK_TRUE : VK_FALSE;
+        mapEntries[i] = { i, static_cast<uint32_t>(i * sizeof(VkBool32)), sizeof(VkBool32) };
+    }
+
+    VkSpecializationInfo specializationInfo = {};
+    specializationInfo.mapEntryCount = QK_MATERIAL_FEATURE_COUNT;
+    specializationInfo.pMapEntries = mapEntries;
+    specializationInfo.dataSize = sizeof(constants);
+    specializationInfo.pData = constants;
+
+    VkDescriptorSetLayoutBinding binding = {
+        0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, VK_NULL_HANDLE
+    };
+
+    GraphicsPipelineCreateInfo createInfo = {};
+    createInfo.shaderName = shaderName;
+    createInfo.bindingCount = 1;
+    createInfo.pBindings = &binding;
+    createInfo.pushConstantSize = sizeof(MaterialPushConstants);
+    createInfo.pushConstantStages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    createInfo.pSpecializationInfo = &specializationInfo;
+
+    /* 编译不持锁，两个线程同时请求同一个变体时后完成的一方丢弃自己的结果 */
+    Pipeline pipeline = VK_NULL_HANDLE;
+    err = driver->CreateGraphicsPipeline(createInfo, &pipeline);
+    VK_CHECK_ERROR(err);
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto [it, inserted] = variants.emplace(std::move(key), pipeline);
+    if (!inserted) {
+        driver->DestroyPipeline(pipeline);
+        statistics.variantHits++;
+    }
+
+    /* 所有变体的 set 0 布局相同，第一个变体创建时分配共用的描述符集 */
+    if (descriptorSet == VK_NULL_HANDLE) {
+        err = driver->AllocatePersistentDescriptorSet(it->second, &descriptorSet);
+        VK_CHECK_ERROR(err);
+
+        driver->WriteDescriptorBuffer(descriptorSet, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, materialBuffer, 0, VK_WHOLE_SIZE);
+    }
+
+    *pPipeline = it->second;
+
+    return VK_SUCCESS;
+}
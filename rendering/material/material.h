@@ -0,0 +1,126 @@
+#ifndef MATERIAL_H_
+#define MATERIAL_H_
+
+#include "driver/render_driver.h"
+
+// std
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* 特性位 i 对应着色器中 constant_id = i 的 bool 特化常量，与 qk_material.glsl 保持一致 */
+enum MaterialFeatureBits
+{
+    MATERIAL_FEATURE_VERTEX_COLOR = 1 << 0,
+    MATERIAL_FEATURE_EMISSIVE     = 1 << 1,
+    MATERIAL_FEATURE_ALPHA_TEST   = 1 << 2,
+};
+typedef uint32_t MaterialFeatureFlags;
+
+#define QK_MATERIAL_FEATURE_COUNT 32
+
+/* std430 布局，与 qk_material.glsl 中的 MaterialParameters 保持一致 */
+struct MaterialParameters
+{
+    float baseColor[4];
+    float emissive[4];                          // rgb = 颜色, a = 强度
+    float alphaCutoff;
+    float _reserved[3];
+    float custom[4];                            // 着色器自定义
+};
+
+/* 材质着色器的 push constant，顶点和片元阶段都可见 */
+struct MaterialPushConstants
+{
+    float mvp[16];
+    uint32_t materialIndex;
+    uint32_t _padding[3];
+};
+
+struct MaterialCreateInfo
+{
+    const char* shaderName = VK_NULL_HANDLE;
+    MaterialFeatureFlags features = 0;
+    MaterialParameters parameters = {};
+};
+
+struct Material
+{
+    uint32_t id;                                // 材质缓冲中的下标，也用作渲染队列排序键中的材质
+    MaterialFeatureFlags features;
+    Pipeline pipeline;                          // 着色器 + 特性对应的变体，由 MaterialSystem 持有
+};
+
+struct MaterialStatistics
+{
+    uint32_t materialCount;
+    uint32_t variantCount;
+    uint32_t variantHits;                       // 复用已有变体的次数
+    uint32_t uploadedBytes;                     // 最近一帧上传的参数字节数
+};
+
+/**
+ * 材质 = 着色器 + 参数块 + 特性位。
+ *
+ * 特性位转换为特化常量，同一着色器的每种特性组合编译一个变体，按 (着色器, 特性)
+ * 缓存，之后的材质直接复用。所有材质的参数块放在一个 device local 的 SSBO 中，
+ * 着色器用 push constant 中的 materialIndex 索引；修改后的参数在 CmdUpload 中
+ * 通过每帧一份的 staging 缓冲拷贝。所有变体的描述符集布局相同，共用一个描述符集。
+ *
+ * CreateMaterial 可以在工作线程上调用，CmdUpload / UpdateMaterial 在录制线程上调用。
+ */
+class MaterialSystem
+{
+public:
+    MaterialSystem(RenderDriver* driver);
+   ~MaterialSystem();
+
+    VkResult Initialize(uint32_t maxMaterials = 1024);
+
+    VkResult CreateMaterial(const MaterialCreateInfo& createInfo, Material* pMaterial);
+    void UpdateMaterial(const Material& material, const MaterialParameters& parameters);
+
+    /* 在使用材质的 pass 之前调用 */
+    void CmdUpload(VkCommandBuffer commandBuffer);
+
+    VkDescriptorSet GetDescriptorSet() const { return descriptorSet; }
+    Buffer GetMaterialBuffer() const { return materialBuffer; }
+
+    void GetStatistics(MaterialStatistics* pStatistics) const;
+
+private:
+    struct VariantKey
+    {
+        std::string shaderName;
+        MaterialFeatureFlags features;
+
+        bool operator==(const VariantKey& other) const { return features == other.features && shaderName == other.shaderName; }
+    };
+
+    struct VariantKeyHash
+    {
+        size_t operator()(const VariantKey& key) const { return std::hash<std::string>()(key.shaderName) ^ (static_cast<size_t>(key.features) * 0x9E3779B97F4A7C15ull); }
+    };
+
+    VkResult _AcquireVariant(const char* shaderName, MaterialFeatureFlags features, Pipeline* pPipeline);
+
+    RenderDriver* driver = VK_NULL_HANDLE;
+    uint32_t maxMaterials = 0;
+
+    Buffer materialBuffer = VK_NULL_HANDLE;
+    std::vector<Buffer> stagingBuffers;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+    /* 参数的 CPU 镜像，[dirtyBegin, dirtyEnd) 为待上传的材质下标范围 */
+    std::vector<MaterialParameters> parameters;
+    uint32_t dirtyBegin = UINT32_MAX;
+    uint32_t dirtyEnd = 0;
+
+    std::mutex mutex;
+    std::unordered_map<VariantKey, Pipeline, VariantKeyHash> variants;
+
+    MaterialStatistics statistics = {};
+};
+
+#endif /* MATERIAL_H_ */
@@ -0,0 +1,478 @@
+#include "mesh_lod.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unordered_map>
+
+/* 边界约束平面相对普通三角形平面的权重 */
+static const double BOUNDARY_WEIGHT = 10.0;
+
+/* 每次简化最多的趟数，每趟至少折叠一条边 */
+static const uint32_t MAX_SIMPLIFY_PASSES = 128;
+
+/* 简化后三角形数量减少不到这个比例时认为网格已经无法继续简化 */
+static const float MIN_LEVEL_REDUCTION = 0.95f;
+
+/* 对称 4x4 矩阵，error(p) = p^T A p + 2 b^T p + c，weight 为累计的面积权重 */
+struct Quadric
+{
+    double a00, a01, a02, a11, a12, a22;
+    double b0, b1, b2;
+    double c;
+    double weight;
+};
+
+/* 平面 n·p + d = 0，n 为单位向量 */
+static void _QuadricFromPlane(double nx, double ny, double nz, double d, double weight, Quadric* pQuadric)
+{
+    pQuadric->a00 = nx * nx * weight;
+    pQuadric->a01 = nx * ny * weight;
+    pQuadric->a02 = nx * nz * weight;
+    pQuadric->a11 = ny * ny * weight;
+    pQuadric->a12 = ny * nz * weight;
+    pQuadric->a22 = nz * nz * weight;
+    pQuadric->b0 = nx * d * weight;
+    pQuadric->b1 = ny * d * weight;
+    pQuadric->b2 = nz * d * weight;
+    pQuadric->c = d * d * weight;
+    pQuadric->weight = weight;
+}
+
+static void _QuadricAdd(Quadric* pDst, const Quadric& src)
+{
+    pDst->a00 += src.a00; pDst->a01 += src.a01; pDst->a02 += src.a02;
+    pDst->a11 += src.a11; pDst->a12 += src.a12; pDst->a22 += src.a22;
+    pDst->b0 += src.b0; pDst->b1 += src.b1; pDst->b2 += src.b2;
+    pDst->c += src.c;
+    pDst->weight += src.weight;
+}
+
+/* 按权重归一化的平方距离 */
+static double _QuadricError(const Quadric& q, const float* p)
+{
+    const double x = p[0], y = p[1], z = p[2];
+
+    double error = q.a00 * x * x + q.a11 * y * y + q.a22 * z * z
+                 + 2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z)
+                 + 2.0 * (q.b0 * x + q.b1 * y + q.b2 * z)
+                 + q.c;
+
+    return q.weight > 0.0 ? std::max(error, 0.0) / q.weight : 0.0;
+}
+
+static void _Cross(const float* a, const float* b, const float* c, double* pNormal)
+{
+    const double e0[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+    const double e1[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+
+    pNormal[0] = e0[1] * e1[2] - e0[2] * e1[1];
+    pNormal[1] = e0[2] * e1[0] - e0[0] * e1[2];
+    pNormal[2] = e0[0] * e1[1] - e0[1] * e1[0];
+}
+
+static uint64_t _EdgeKey(uint32_t a, uint32_t b)
+{
+    return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+}
+
+static double _Distance(const float* a, const float* b)
+{
+    const double d[3] = { a[0] - b[0], a[1] - b[1], a[2] - b[2] };
+    return sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+}
+
+/* 只被一个三角形使用的边，排序后输出 */
+static void _CollectBoundaryEdges(const uint32_t* pIndices, size_t indexCount, std::vector<uint64_t>* pEdges)
+{
+    std::vector<uint64_t> edges;
+    edges.reserve(indexCount);
+    for (size_t i = 0; i + 2 < indexCount; i += 3) {
+        for (uint32_t k = 0; k < 3; k++)
+            edges.push_back(_EdgeKey(pIndices[i + k], pIndices[i + (k + 1) % 3]));
+    }
+
+    std::sort(edges.begin(), edges.end());
+
+    pEdges->clear();
+    for (size_t i = 0; i < edges.size();) {
+        size_t j = i + 1;
+        while (j < edges.size() && edges[j] == edges[i])
+            j++;
+
+        if (j - i == 1)
+            pEdges->push_back(edges[i]);
+
+        i = j;
+    }
+}
+
+struct PositionKey
+{
+    float x, y, z;
+
+    bool operator==(const PositionKey& other) const { return x == other.x && y == other.y && z == other.z; }
+};
+
+struct PositionKeyHash
+{
+    size_t operator()(const PositionKey& key) const
+    {
+        uint32_t bits[3];
+        memcpy(bits, &key, sizeof(bits));
+        return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+    }
+};
+
+void MeshLod::Simplify(const MeshVertex* pVertices, uint32_t vertexCount, const uint32_t* pIndices, uint32_t indexCount,
+                       uint32_t targetIndexCount, float maxError, VkBool32 lockBoundary, std::vector<uint32_t>* pResult, float* pError)
+{
+    std::vector<uint32_t>& indices = *pResult;
+    indices.assign(pIndices, pIndices + indexCount);
+
+    /* 每个顶点代表的原始曲面点累计移动的距离 */
+    std::vector<double> drift(vertexCount, 0.0);
+    double maxDrift = 0.0;
+
+    /* 位置相同的顶点属于接缝，锁定 */
+    std::vector<uint8_t> locked(vertexCount, 0);
+    {
+        std::unordered_map<PositionKey, uint32_t, PositionKeyHash> positions;
+        positions.reserve(vertexCount);
+
+        for (uint32_t v = 0; v < vertexCount; v++) {
+            const float* p = pVertices[v].position;
+            auto [it, inserted] = positions.emplace(PositionKey{ p[0], p[1], p[2] }, v);
+            if (!inserted) {
+                locked[v] = 1;
+                locked[it->second] = 1;
+            }
+        }
+    }
+
+    /* 开放边界上的顶点不动，平铺的网格块在接缝两侧保留同样的顶点 */
+    std::vector<uint64_t> boundaryEdges;
+    if (lockBoundary) {
+        _CollectBoundaryEdges(pIndices, indexCount, &boundaryEdges);
+        for (uint64_t key : boundaryEdges)
+            locked[static_cast<uint32_t>(key >> 32)] = locked[static_cast<uint32_t>(key & 0xFFFFFFFF)] = 1;
+    }
+
+    std::vector<Quadric> quadrics(vertexCount, Quadric{});
+    {
+        std::unordered_map<uint64_t, uint32_t> edgeTriangles;
+        edgeTriangles.reserve(indexCount);
+
+        for (uint32_t i = 0; i + 2 < indexCount; i += 3) {
+            const uint32_t tri[3] = { indices[i], indices[i + 1], indices[i + 2] };
+
+            double n[3];
+            _Cross(pVertices[tri[0]].position, pVertices[tri[1]].position, pVertices[tri[2]].position, n);
+
+            const double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (length <= 0.0)
+                continue;
+
+            n[0] /= length; n[1] /= length; n[2] /= length;
+            const float* p = pVertices[tri[0]].position;
+            const double d = -(n[0] * p[0] + n[1] * p[1] + n[2] * p[2]);
+
+            Quadric plane;
+            _QuadricFromPlane(n[0], n[1], n[2], d, length * 0.5, &plane);
+            for (uint32_t k = 0; k < 3; k++)
+                _QuadricAdd(&quadrics[tri[k]], plane);
+
+            /* 记录每条边的第一个三角形，只被一个三角形使用的边是边界 */
+            for (uint32_t k = 0; k < 3; k++) {
+                auto [it, inserted] = edgeTriangles.emplace(_EdgeKey(tri[k], tri[(k + 1) % 3]), i);
+                if (!inserted)
+                    it->second = UINT32_MAX;
+            }
+        }
+
+        /* 边界边：经过这条边、垂直于三角形的平面 */
+        for (const auto& [key, triangle] : edgeTriangles) {
+            if (triangle == UINT32_MAX)
+                continue;
+
+            const uint32_t a = static_cast<uint32_t>(key >> 32);
+            const uint32_t b = static_cast<uint32_t>(key & 0xFFFFFFFF);
+            const float* pa = pVertices[a].position;
+            const float* pb = pVertices[b].position;
+
+            double n[3];
+            _Cross(pVertices[indices[triangle]].position, pVertices[indices[triangle + 1]].position, pVertices[indices[triangle + 2]].position, n);
+
+            const double edge[3] = { pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+            double side[3] = {
+                edge[1] * n[2] - edge[2] * n[1],
+                edge[2] * n[0] - edge[0] * n[2],
+                edge[0] * n[1] - edge[1] * n[0],
+            };
+
+            const double length = sqrt(side[0] * side[0] + side[1] * side[1] + side[2] * side[2]);
+            if (length <= 0.0)
+                continue;
+
+            side[0] /= length; side[1] /= length; side[2] /= length;
+            const double d = -(side[0] * pa[0] + side[1] * pa[1] + side[2] * pa[2]);
+            const double edgeLength2 = edge[0] * edge[0] + edge[1] * edge[1] + edge[2] * edge[2];
+
+            Quadric plane;
+            _QuadricFromPlane(side[0], side[1], side[2], d, edgeLength2 * BOUNDARY_WEIGHT, &plane);
+            _QuadricAdd(&quadrics[a], plane);
+            _QuadricAdd(&quadrics[b], plane);
+        }
+    }
+
+    struct Collapse
+    {
+        double cost;
+        uint32_t from;
+        uint32_t to;
+    };
+
+    std::vector<uint64_t> edges;
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> triangleOffsets(vertexCount + 1);
+    std::vector<uint32_t> vertexTriangles;
+    std::vector<uint8_t> touched(vertexCount);
+    std::vector<uint32_t> remap(vertexCount);
+
+    for (uint32_t pass = 0; pass < MAX_SIMPLIFY_PASSES && indices.size() > targetIndexCount; pass++) {
+        const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+        edges.clear();
+        for (uint32_t i = 0; i < indices.size(); i += 3) {
+            for (uint32_t k = 0; k < 3; k++)
+                edges.push_back(_EdgeKey(indices[i + k], indices[i + (k + 1) % 3]));
+        }
+
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+        /* 每条边取代价较小的折叠方向 */
+        collapses.clear();
+        for (uint64_t key : edges) {
+            const uint32_t a = static_cast<uint32_t>(key >> 32);
+            const uint32_t b = static_cast<uint32_t>(key & 0xFFFFFFFF);
+
+            Quadric q = quadrics[a];
+            _QuadricAdd(&q, quadrics[b]);
+
+            Collapse best = { -1.0, 0, 0 };
+            if (!locked[a])
+                best = { _QuadricError(q, pVertices[b].position), a, b };
+
+            if (!locked[b]) {
+                const double cost = _QuadricError(q, pVertices[a].position);
+                if (best.cost < 0.0 || cost < best.cost)
+                    best = { cost, b, a };
+            }
+
+            if (best.cost < 0.0)
+                continue;
+
+            if (drift[best.from] + _Distance(pVertices[best.from].position, pVertices[best.to].position) <= maxError)
+                collapses.push_back(best);
+        }
+
+        if (collapses.empty())
+            break;
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+        /* 顶点到三角形的邻接表 */
+        std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+        for (uint32_t index : indices)
+            triangleOffsets[index + 1]++;
+        for (uint32_t v = 0; v < vertexCount; v++)
+            triangleOffsets[v + 1] += triangleOffsets[v];
+
+        vertexTriangles.resize(indices.size());
+        {
+            std::vector<uint32_t> cursor(triangleOffsets.begin(), triangleOffsets.end() - 1);
+            for (uint32_t i = 0; i < indices.size(); i++)
+                vertexTriangles[cursor[indices[i]]++] = i / 3;
+        }
+
+        std::fill(touched.begin(), touched.end(), 0);
+        for (uint32_t v = 0; v < vertexCount; v++)
+            remap[v] = v;
+
+        const uint32_t targetRemoved = (static_cast<uint32_t>(indices.size()) - targetIndexCount + 2) / 3;
+        uint32_t removed = 0;
+
+        for (const Collapse& collapse : collapses) {
+            if (removed >= targetRemoved)
+                break;
+
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+
+            /* 移动 from 之后，不包含 to 的相邻三角形不能翻转 */
+            bool flipped = false;
+            uint32_t degenerate = 0;
+            for (uint32_t t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1] && !flipped; t++) {
+                const uint32_t* tri = &indices[vertexTriangles[t] * 3];
+                if (tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to) {
+                    degenerate++;
+                    continue;
+                }
+
+                const float* p[3];
+                const float* q[3];
+                for (uint32_t k = 0; k < 3; k++) {
+                    p[k] = pVertices[tri[k]].position;
+                    q[k] = tri[k] == collapse.from ? pVertices[collapse.to].position : p[k];
+                }
+
+                double before[3], after[3];
+                _Cross(p[0], p[1], p[2], before);
+                _Cross(q[0], q[1], q[2], after);
+                flipped = before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0.0;
+            }
+
+            if (flipped)
+                continue;
+
+            /* 锁住整个一环邻域，本趟后续的折叠不会用到过期的三角形 */
+            for (uint32_t t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1]; t++) {
+                const uint32_t* tri = &indices[vertexTriangles[t] * 3];
+                touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = 1;
+            }
+            touched[collapse.to] = 1;
+
+            remap[collapse.from] = collapse.to;
+            _QuadricAdd(&quadrics[collapse.to], quadrics[collapse.from]);
+            drift[collapse.to] = std::max(drift[collapse.to], drift[collapse.from] + _Distance(pVertices[collapse.from].position, pVertices[collapse.to].position));
+            maxDrift = std::max(maxDrift, drift[collapse.to]);
+            removed += degenerate;
+        }
+
+        if (removed == 0)
+            break;
+
+        /* 应用折叠并删除退化的三角形 */
+        uint32_t write = 0;
+        for (uint32_t i = 0; i < triangleCount * 3; i += 3) {
+            const uint32_t a = remap[indices[i]];
+            const uint32_t b = remap[indices[i + 1]];
+            const uint32_t c = remap[indices[i + 2]];
+
+            if (a == b || b == c || a == c)
+                continue;
+
+            indices[write++] = a;
+            indices[write++] = b;
+            indices[write++] = c;
+        }
+
+        indices.resize(write);
+    }
+
+    /* 边界顶点锁定后边界边应当不变，非流形输入等情况下不成立时放弃这一级 */
+    if (lockBoundary) {
+        std::vector<uint64_t> resultBoundaryEdges;
+        _CollectBoundaryEdges(indices.data(), indices.size(), &resultBoundaryEdges);
+
+        if (resultBoundaryEdges != boundaryEdges) {
+            printf("[vulkan] mesh simplification changed the open boundary, keeping the input\n");
+            indices.assign(pIndices, pIndices + indexCount);
+            maxDrift = 0.0;
+        }
+    }
+
+    *pError = static_cast<float>(maxDrift);
+}
+
+void MeshLod::GenerateChain(const MeshVertex* pVertices, uint32_t vertexCount, const uint32_t* pIndices, uint32_t indexCount,
+                            const MeshLodCreateInfo& createInfo, std::vector<uint32_t>* pLodIndices, std::vector<MeshLodLevel>* pLevels)
+{
+    pLodIndices->assign(pIndices, pIndices + indexCount);
+    pLevels->assign(1, { 0, indexCount, 0.0f });
+
+    const uint32_t maxLevels = std::min<uint32_t>(createInfo.maxLevels, QK_MESH_MAX_LODS);
+
+    std::vector<uint32_t> current(pIndices, pIndices + indexCount);
+    std::vector<uint32_t> next;
+    float error = 0.0f;
+
+    /* 每一级从上一级简化，各级的顶点位移累加，作为相对原始网格的保守估计 */
+    while (pLevels->size() < maxLevels && current.size() / 3 > createInfo.minTriangles) {
+        const uint32_t targetTriangles = std::max(static_cast<uint32_t>(current.size() / 3 * createInfo.reduction), createInfo.minTriangles);
+
+        float levelError = 0.0f;
+        Simplify(pVertices, vertexCount, current.data(), static_cast<uint32_t>(current.size()), targetTriangles * 3,
+                 createInfo.maxError - error, createInfo.lockBoundary, &next, &levelError);
+
+        if (next.empty() || next.size() > current.size() * MIN_LEVEL_REDUCTION)
+            break;
+
+        error += levelError;
+
+        const uint32_t firstIndex = static_cast<uint32_t>(pLodIndices->size());
+        pLodIndices->insert(pLodIndices->end(), next.begin(), next.end());
+        pLevels->push_back({ firstIndex, static_cast<uint32_t>(next.size()), error });
+
+        current.swap(next);
+    }
+}
+
+MeshLodSelector::MeshLodSelector()
+{
+    /* do nothing... */
+}
+
+MeshLodSelector::~MeshLodSelector()
+{
+    /* do nothing... */
+}
+
+void MeshLodSelector::BeginFrame(const Camera& camera, VkExtent2D extent)
+{
+    cameraPosition = camera.GetPosition();
+    cameraNear = camera.GetNear();
+    projectionScale = static_cast<float>(extent.height) / (2.0f * tanf(glm::radians(camera.GetFov()) * 0.5f));
+
+    statistics = {};
+}
+
+float MeshLodSelector::ProjectError(float error, const float* center, float radius, float scale) const
+{
+    /* 用包围球上离相机最近的点，保守估计 */
+    const glm::vec3 offset = glm::vec3(center[0], center[1], center[2]) - cameraPosition;
+    const float distance = std::max(glm::length(offset) - radius, cameraNear);
+
+    return error * scale / distance * projectionScale;
+}
+
+uint32_t MeshLodSelector::Select(const PackedMesh& mesh, const float* center, float radius, float scale, MeshLodState* pState)
+{
+    const uint32_t count = mesh.GetLevelCount();
+    const float threshold = settings.pixelThreshold;
+
+    /* 第一次选择没有历史，不使用滞后 */
+    const bool first = pState->level >= count;
+    uint32_t level = first ? 0 : pState->level;
+
+    while (level > 0 && ProjectError(mesh.GetLevel(level).error, center, radius, scale) > threshold)
+        level--;
+
+    const float coarsenThreshold = first ? threshold : threshold * (1.0f - settings.hysteresis);
+    while (level + 1 < count && ProjectError(mesh.GetLevel(level + 1).error, center, radius, scale) <= coarsenThreshold)
+        level++;
+
+    if (!first && level != pState->level)
+        statistics.levelSwitches++;
+
+    pState->level = level;
+
+    statistics.instanceCount++;
+    statistics.levelHistogram[std::min<uint32_t>(level, QK_MESH_MAX_LODS - 1)]++;
+    statistics.triangleCount += mesh.GetLevel(level).indexCount / 3;
+    statistics.fullDetailTriangleCount += mesh.GetLevel(0).indexCount / 3;
+
+    return level;
+}
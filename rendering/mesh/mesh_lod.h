@@ -0,0 +1,104 @@
+#ifndef MESH_LOD_H_
+#define MESH_LOD_H_
+
+#include "packed_mesh.h"
+#include "rendering/camera/camera.h"
+
+// std
+#include <vector>
+
+#define QK_MESH_MAX_LODS 8
+
+struct MeshLodCreateInfo
+{
+    uint32_t maxLevels = QK_MESH_MAX_LODS;      // 包括原始网格
+    float reduction = 0.5f;                     // 每一级相对上一级保留的三角形比例
+    uint32_t minTriangles = 32;                 // 少于这个数量时不再生成下一级
+    float maxError = 1e30f;                     // 对象空间距离，顶点累计位移超过时停止简化
+    VkBool32 lockBoundary = VK_TRUE;            // 锁定开放边界上的顶点，相邻网格块选择不同级别时不出现裂缝
+};
+
+struct MeshLodSettings
+{
+    float pixelThreshold = 1.0f;                // 允许的屏幕空间误差（像素）
+    float hysteresis = 0.25f;                   // 切换到更粗的一级时额外要求的余量比例，避免在阈值附近来回切换
+};
+
+/* 每个实例一份，记录上一帧选择的级别 */
+struct MeshLodState
+{
+    uint32_t level = UINT32_MAX;                // UINT32_MAX 表示还没有选择过
+};
+
+struct MeshLodStatistics
+{
+    uint32_t instanceCount;
+    uint32_t levelSwitches;
+    uint32_t levelHistogram[QK_MESH_MAX_LODS];
+    uint64_t triangleCount;
+    uint64_t fullDetailTriangleCount;           // 全部使用第 0 级时的三角形数量
+};
+
+/**
+ * LOD 链生成。
+ *
+ * 基于二次误差度量（QEM）的半边折叠：顶点只会折叠到已有的邻居上，所有级别共用原始
+ * 顶点缓冲，只有索引不同。每一趟按代价排序所有边，贪心折叠互不相邻的边，拒绝
+ * 使三角形翻转的折叠，直到三角形数量达到目标或误差超过上限。
+ *
+ * 二次误差只用于给折叠排序。报告的误差是按顶点累计位移的保守估计：每次折叠把 from 的
+ * 累计位移加上 from 到 to 的距离传给 to，取所有顶点的最大值。它供 LOD 选择换算屏幕误差，
+ * 不是简化后曲面到原始曲面距离的上界，三角形内部的偏差可能超过它。
+ *
+ * 边界边附加垂直平面的约束保持轮廓；lockBoundary 时开放边界上的顶点全部锁定，简化后检查
+ * 边界边不变，否则返回原始索引。位置相同但属性不同的顶点（UV / 法线接缝）被锁定，
+ * 不会被折叠走。属性不参与误差度量。
+ */
+class MeshLod
+{
+public:
+    /* pError 为顶点相对输入网格的最大累计位移，对象空间的保守估计 */
+    static void Simplify(const MeshVertex* pVertices, uint32_t vertexCount, const uint32_t* pIndices, uint32_t indexCount,
+                         uint32_t targetIndexCount, float maxError, VkBool32 lockBoundary, std::vector<uint32_t>* pResult, float* pError);
+
+    /* 各级索引依次写入 pIndices，第 0 级为原始索引，误差单调递增 */
+    static void GenerateChain(const MeshVertex* pVertices, uint32_t vertexCount, const uint32_t* pIndices, uint32_t indexCount,
+                              const MeshLodCreateInfo& createInfo, std::vector<uint32_t>* pLodIndices, std::vector<MeshLodLevel>* pLevels);
+};
+
+/**
+ * 按投影到屏幕上的几何误差选择每个实例的 LOD。
+ *
+ * 误差 error 在距离 d 处投影为 error / d * height / (2 * tan(fov / 2)) 像素，选择误差不超过
+ * pixelThreshold 的最粗级别。变粗时要求误差不超过 pixelThreshold * (1 - hysteresis)，
+ * 变细时超过 pixelThreshold 立即切换，两个阈值之间保持上一帧的级别。
+ */
+class MeshLodSelector
+{
+public:
+    MeshLodSelector();
+   ~MeshLodSelector();
+
+    void SetSettings(const MeshLodSettings& settings) { this->settings = settings; }
+
+    /* 每帧调用一次，同时清空统计 */
+    void BeginFrame(const Camera& camera, VkExtent2D extent);
+
+    /* center 和 radius 为世界空间的包围球，scale 为实例的最大缩放 */
+    uint32_t Select(const PackedMesh& mesh, const float* center, float radius, float scale, MeshLodState* pState);
+
+    float ProjectError(float error, const float* center, float radius, float scale) const;
+
+    void GetStatistics(MeshLodStatistics* pStatistics) const { *pStatistics = statistics; }
+
+private:
+    MeshLodSettings settings = {};
+
+    glm::vec3 cameraPosition = {};
+    float cameraNear = 0.01f;
+    float projectionScale = 1.0f;               // 每单位 (误差 / 距离) 对应的像素
+
+    MeshLodStatistics statistics = {};
+};
+
+#endif /* MESH_LOD_H_ */
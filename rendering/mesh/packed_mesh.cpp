@@ -0,0 +1,411 @@
+#include "packed_mesh.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <glm/gtc/packing.hpp>
+
+#include "driver/vkutils.h"
+
+/* 与 qk_vertex_pulling.glsl 中的 constant_id 保持一致 */
+static const uint32_t VERTEX_LAYOUT_CONSTANT_ID = 100;
+static const uint32_t VERTEX_LAYOUT_CONSTANT_COUNT = 1 + VERTEX_ATTRIBUTE_COUNT * 2;
+
+static const uint32_t ATTRIBUTE_COMPONENTS[VERTEX_ATTRIBUTE_COUNT] = { 3, 3, 2, 4 };
+
+static uint32_t _ComponentSize(VertexEncoding encoding)
+{
+    switch (encoding) {
+        case VERTEX_ENCODING_FLOAT32:     return 4;
+        case VERTEX_ENCODING_HALF:
+        case VERTEX_ENCODING_UNORM16:
+        case VERTEX_ENCODING_SNORM16:
+        case VERTEX_ENCODING_OCT_SNORM16: return 2;
+        case VERTEX_ENCODING_UNORM8:
+        case VERTEX_ENCODING_SNORM8:
+        case VERTEX_ENCODING_OCT_SNORM8:  return 1;
+        default:                          return 0;
+    }
+}
+
+static VkBool32 _IsOctahedral(VertexEncoding encoding)
+{
+    return encoding == VERTEX_ENCODING_OCT_SNORM8 || encoding == VERTEX_ENCODING_OCT_SNORM16;
+}
+
+static uint32_t _StoredComponentCount(uint32_t attribute, VertexEncoding encoding)
+{
+    return _IsOctahedral(encoding) ? 2 : ATTRIBUTE_COMPONENTS[attribute];
+}
+
+/* 把一个分量写到 pDst，pDst 已按分量大小对齐 */
+static void _EncodeComponent(VertexEncoding encoding, float value, uint8_t* pDst)
+{
+    switch (encoding) {
+        case VERTEX_ENCODING_FLOAT32: {
+            memcpy(pDst, &value, sizeof(value));
+            break;
+        }
+        case VERTEX_ENCODING_HALF: {
+            uint16_t half = glm::packHalf1x16(value);
+            memcpy(pDst, &half, sizeof(half));
+            break;
+        }
+        case VERTEX_ENCODING_UNORM16: {
+            uint16_t q = glm::packUnorm1x16(value);
+            memcpy(pDst, &q, sizeof(q));
+            break;
+        }
+        case VERTEX_ENCODING_SNORM16:
+        case VERTEX_ENCODING_OCT_SNORM16: {
+            uint16_t q = glm::packSnorm1x16(value);
+            memcpy(pDst, &q, sizeof(q));
+            break;
+        }
+        case VERTEX_ENCODING_UNORM8: {
+            *pDst = glm::packUnorm1x8(value);
+            break;
+        }
+        case VERTEX_ENCODING_SNORM8:
+        case VERTEX_ENCODING_OCT_SNORM8: {
+            *pDst = glm::packSnorm1x8(value);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static void _DecodeOctahedral(float ex, float ey, float* pNormal)
+{
+    float n[3] = { ex, ey, 1.0f - fabsf(ex) - fabsf(ey) };
+    float t = std::max(-n[2], 0.0f);
+    n[0] += n[0] >= 0.0f ? -t : t;
+    n[1] += n[1] >= 0.0f ? -t : t;
+
+    float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    for (uint32_t i = 0; i < 3; i++)
+        pNormal[i] = n[i] / length;
+}
+
+/* 先投影到八面体再展开到 [-1, 1]^2，量化时在四个相邻格点中选解码误差最小的一个 */
+static void _EncodeOctahedral(const float* normal, float scale, float* pEncoded)
+{
+    float sum = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+    if (sum <= 0.0f) {
+        pEncoded[0] = 0.0f;
+        pEncoded[1] = 0.0f;
+        return;
+    }
+
+    float x = normal[0] / sum;
+    float y = normal[1] / sum;
+
+    if (normal[2] < 0.0f) {
+        float ox = x;
+        x = (1.0f - fabsf(y)) * (ox >= 0.0f ? 1.0f : -1.0f);
+        y = (1.0f - fabsf(ox)) * (y >= 0.0f ? 1.0f : -1.0f);
+    }
+
+    float bestDot = -2.0f;
+    for (uint32_t i = 0; i < 4; i++) {
+        float qx = (i & 1 ? ceilf(x * scale) : floorf(x * scale)) / scale;
+        float qy = (i & 2 ? ceilf(y * scale) : floorf(y * scale)) / scale;
+        qx = std::clamp(qx, -1.0f, 1.0f);
+        qy = std::clamp(qy, -1.0f, 1.0f);
+
+        float decoded[3];
+        _DecodeOctahedral(qx, qy, decoded);
+
+        float dot = decoded[0] * normal[0] + decoded[1] * normal[1] + decoded[2] * normal[2];
+        if (dot > bestDot) {
+            bestDot = dot;
+            pEncoded[0] = qx;
+            pEncoded[1] = qy;
+        }
+    }
+}
+
+PackedMesh::PackedMesh(RenderDriver* driver) : driver(driver)
+{
+    /* do nothing... */
+}
+
+PackedMesh::~PackedMesh()
+{
+    if (indexBuffer != VK_NULL_HANDLE)
+        driver->DestroyBuffer(indexBuffer);
+
+    if (vertexBuffer != VK_NULL_HANDLE)
+        driver->DestroyBuffer(vertexBuffer);
+}
+
+VkResult PackedMesh::Initialize(const PackedMeshCreateInfo& createInfo)
+{
+    VkResult err;
+
+    if (!ValidateLayout(createInfo.layout) || createInfo.vertexCount == 0 || createInfo.pVertices == VK_NULL_HANDLE ||
+        (createInfo.indexCount > 0 && createInfo.pIndices == VK_NULL_HANDLE) ||
+        (createInfo.levelCount > 0 && (createInfo.pLevels == VK_NULL_HANDLE || createInfo.indexCount == 0))) {
+        printf("[vulkan] invalid packed mesh create info\n");
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    layout = createInfo.layout;
+    vertexCount = createInfo.vertexCount;
+    indexCount = createInfo.indexCount;
+
+    float boundsMax[3];
+    for (uint32_t c = 0; c < 3; c++) {
+        boundsMin[c] = createInfo.pVertices[0].position[c];
+        boundsMax[c] = createInfo.pVertices[0].position[c];
+    }
+
+    for (uint32_t i = 1; i < vertexCount; i++) {
+        for (uint32_t c = 0; c < 3; c++) {
+            boundsMin[c] = std::min(boundsMin[c], createInfo.pVertices[i].position[c]);
+            boundsMax[c] = std::max(boundsMax[c], createInfo.pVertices[i].position[c]);
+        }
+    }
+
+    float radius2 = 0.0f;
+    for (uint32_t c = 0; c < 3; c++) {
+        boundsExtent[c] = boundsMax[c] - boundsMin[c];
+        boundingCenter[c] = boundsMin[c] + boundsExtent[c] * 0.5f;
+        radius2 += boundsExtent[c] * boundsExtent[c] * 0.25f;
+    }
+    boundingRadius = sqrtf(radius2);
+
+    for (uint32_t i = 0; i < createInfo.levelCount; i++) {
+        const MeshLodLevel& level = createInfo.pLevels[i];
+        if (level.indexCount == 0 || static_cast<uint64_t>(level.firstIndex) + level.indexCount > indexCount) {
+            printf("[vulkan] packed mesh LOD %u is out of the index range\n", i);
+            return VK_ERROR_INITIALIZATION_FAILED;
+        }
+    }
+
+    if (createInfo.levelCount > 0)
+        levels.assign(createInfo.pLevels, createInfo.pLevels + createInfo.levelCount);
+    else
+        levels.push_back({ 0, indexCount > 0 ? indexCount : vertexCount, 0.0f });
+
+    std::vector<uint8_t> encoded(GetVertexBufferSize());
+    EncodeVertices(layout, vertexCount, createInfo.pVertices, boundsMin, boundsExtent, encoded.data());
+
+    err = driver->CreateBuffer(encoded.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, &vertexBuffer);
+    VK_CHECK_ERROR(err);
+
+    driver->WriteBuffer(vertexBuffer, encoded.size(), encoded.data());
+
+    if (indexCount > 0) {
+        const size_t indexSize = static_cast<size_t>(indexCount) * sizeof(uint32_t);
+
+        err = driver->CreateBuffer(indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, &indexBuffer);
+        VK_CHECK_ERROR(err);
+
+        driver->WriteBuffer(indexBuffer, indexSize, createInfo.pIndices);
+    }
+
+    return VK_SUCCESS;
+}
+
+void PackedMesh::CmdDraw(VkCommandBuffer commandBuffer, Pipeline pipeline, const float* mvp, uint32_t level)
+{
+    VkResult err;
+
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    err = driver->AllocateDescriptorSet(pipeline, &descriptorSet);
+    if (err != VK_SUCCESS)
+        return;
+
+    CmdDraw(commandBuffer, pipeline, descriptorSet, mvp, level);
+}
+
+void PackedMesh::CmdDraw(VkCommandBuffer commandBuffer, Pipeline pipeline, VkDescriptorSet descriptorSet, const float* mvp, uint32_t level)
+{
+    WriteDescriptor(descriptorSet, 0);
+
+    PackedMeshPushConstants pc = {};
+    GetPushConstants(mvp, &pc);
+
+    driver->CmdBindPipeline(commandBuffer, pipeline);
+    driver->CmdBindDescriptorSet(commandBuffer, pipeline, descriptorSet);
+    driver->CmdPushConstants(commandBuffer, pipeline, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pc), &pc);
+
+    const MeshLodLevel& range = levels[std::min<uint32_t>(level, GetLevelCount() - 1)];
+
+    if (indexCount > 0) {
+        driver->CmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+        driver->CmdDrawIndexed(commandBuffer, range.indexCount, 1, range.firstIndex, 0, 0);
+    } else {
+        driver->CmdDraw(commandBuffer, vertexCount);
+    }
+}
+
+void PackedMesh::WriteDescriptor(VkDescriptorSet descriptorSet, uint32_t binding) const
+{
+    driver->WriteDescriptorBuffer(descriptorSet, binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, vertexBuffer, 0, VK_WHOLE_SIZE);
+}
+
+void PackedMesh::GetPushConstants(const float* mvp, PackedMeshPushConstants* pPushConstants) const
+{
+    memcpy(pPushConstants->mvp, mvp, sizeof(pPushConstants->mvp));
+    memcpy(pPushConstants->boundsMin, boundsMin, sizeof(pPushConstants->boundsMin));
+    memcpy(pPushConstants->boundsExtent, boundsExtent, sizeof(pPushConstants->boundsExtent));
+}
+
+VertexLayout PackedMesh::GetCompressedLayout()
+{
+    VertexLayout compressed = {};
+    compressed.attributes[VERTEX_ATTRIBUTE_POSITION] = { VERTEX_ENCODING_UNORM16, 0 };
+    compressed.attributes[VERTEX_ATTRIBUTE_NORMAL] = { VERTEX_ENCODING_OCT_SNORM8, 6 };
+    compressed.attributes[VERTEX_ATTRIBUTE_UV] = { VERTEX_ENCODING_HALF, 8 };
+    compressed.attributes[VERTEX_ATTRIBUTE_COLOR] = { VERTEX_ENCODING_UNORM8, 12 };
+    compressed.stride = 16;
+
+    return compressed;
+}
+
+VertexLayout PackedMesh::GetFullPrecisionLayout()
+{
+    VertexLayout full = {};
+    full.attributes[VERTEX_ATTRIBUTE_POSITION] = { VERTEX_ENCODING_FLOAT32, offsetof(MeshVertex, position) };
+    full.attributes[VERTEX_ATTRIBUTE_NORMAL] = { VERTEX_ENCODING_FLOAT32, offsetof(MeshVertex, normal) };
+    full.attributes[VERTEX_ATTRIBUTE_UV] = { VERTEX_ENCODING_FLOAT32, offsetof(MeshVertex, uv) };
+    full.attributes[VERTEX_ATTRIBUTE_COLOR] = { VERTEX_ENCODING_FLOAT32, offsetof(MeshVertex, color) };
+    full.stride = sizeof(MeshVertex);
+
+    return full;
+}
+
+VkBool32 PackedMesh::ValidateLayout(const VertexLayout& layout)
+{
+    if (layout.stride == 0 || layout.stride % 4 != 0)
+        return VK_FALSE;
+
+    /* 位置必须存在；八面体编码只用于法线 */
+    if (layout.attributes[VERTEX_ATTRIBUTE_POSITION].encoding == VERTEX_ENCODING_NONE)
+        return VK_FALSE;
+
+    for (uint32_t attribute = 0; attribute < VERTEX_ATTRIBUTE_COUNT; attribute++) {
+        const VertexAttributeFormat& format = layout.attributes[attribute];
+        if (format.encoding == VERTEX_ENCODING_NONE)
+            continue;
+
+        const uint32_t componentSize = _ComponentSize(format.encoding);
+        if (componentSize == 0 || (_IsOctahedral(format.encoding) && attribute != VERTEX_ATTRIBUTE_NORMAL))
+            return VK_FALSE;
+
+        if (format.offset % componentSize != 0 ||
+            format.offset + componentSize * _StoredComponentCount(attribute, format.encoding) > layout.stride)
+            return VK_FALSE;
+    }
+
+    return VK_TRUE;
+}
+
+void PackedMesh::EncodeVertices(const VertexLayout& layout, uint32_t vertexCount, const MeshVertex* pVertices,
+                                const float* boundsMin, const float* boundsExtent, uint8_t* pOutput)
+{
+    memset(pOutput, 0, static_cast<size_t>(vertexCount) * layout.stride);
+
+    for (uint32_t i = 0; i < vertexCount; i++) {
+        const MeshVertex& vertex = pVertices[i];
+        uint8_t* dst = pOutput + static_cast<size_t>(i) * layout.stride;
+
+        for (uint32_t attribute = 0; attribute < VERTEX_ATTRIBUTE_COUNT; attribute++) {
+            const VertexAttributeFormat& format = layout.attributes[attribute];
+            if (format.encoding == VERTEX_ENCODING_NONE)
+                continue;
+
+            float values[4] = {};
+            switch (attribute) {
+                case VERTEX_ATTRIBUTE_POSITION:
+                    memcpy(values, vertex.position, sizeof(vertex.position));
+
+                    /* 无符号归一化的位置映射到包围盒内的 [0, 1] */
+                    if (format.encoding == VERTEX_ENCODING_UNORM16 || format.encoding == VERTEX_ENCODING_UNORM8) {
+                        for (uint32_t c = 0; c < 3; c++)
+                            values[c] = boundsExtent[c] > 0.0f ? (values[c] - boundsMin[c]) / boundsExtent[c] : 0.0f;
+                    }
+                    break;
+                case VERTEX_ATTRIBUTE_NORMAL:
+                    if (format.encoding == VERTEX_ENCODING_OCT_SNORM8)
+                        _EncodeOctahedral(vertex.normal, 127.0f, values);
+                    else if (format.encoding == VERTEX_ENCODING_OCT_SNORM16)
+                        _EncodeOctahedral(vertex.normal, 32767.0f, values);
+                    else
+                        memcpy(values, vertex.normal, sizeof(vertex.normal));
+                    break;
+                case VERTEX_ATTRIBUTE_UV:
+                    memcpy(values, vertex.uv, sizeof(vertex.uv));
+                    break;
+                case VERTEX_ATTRIBUTE_COLOR:
+                    memcpy(values, vertex.color, sizeof(vertex.color));
+                    break;
+                default:
+                    break;
+            }
+
+            const uint32_t componentSize = _ComponentSize(format.encoding);
+            const uint32_t componentCount = _StoredComponentCount(attribute, format.encoding);
+            for (uint32_t c = 0; c < componentCount; c++)
+                _EncodeComponent(format.encoding, values[c], dst + format.offset + c * componentSize);
+        }
+    }
+}
+
+VkResult PackedMesh::CreatePipeline(RenderDriver* driver, const char* shaderName, const VertexLayout& layout, Pipeline* pPipeline)
+{
+    GraphicsPipelineCreateInfo baseInfo = {};
+    baseInfo.shaderName = shaderName;
+
+    return CreatePipeline(driver, baseInfo, layout, pPipeline);
+}
+
+VkResult PackedMesh::CreatePipeline(RenderDriver* driver, const GraphicsPipelineCreateInfo& baseInfo, const VertexLayout& layout, Pipeline* pPipeline)
+{
+    if (!ValidateLayout(layout)) {
+        printf("[vulkan] invalid vertex layout for %s\n", baseInfo.shaderName);
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    /* stride，然后每个属性依次是编码和偏移 */
+    uint32_t constants[VERTEX_LAYOUT_CONSTANT_COUNT];
+    constants[0] = layout.stride;
+    for (uint32_t attribute = 0; attribute < VERTEX_ATTRIBUTE_COUNT; attribute++) {
+        constants[1 + attribute * 2] = layout.attributes[attribute].encoding;
+        constants[2 + attribute * 2] = layout.attributes[attribute].offset;
+    }
+
+    VkSpecializationMapEntry mapEntries[VERTEX_LAYOUT_CONSTANT_COUNT];
+    for (uint32_t i = 0; i < VERTEX_LAYOUT_CONSTANT_COUNT; i++)
+        mapEntries[i] = { VERTEX_LAYOUT_CONSTANT_ID + i, static_cast<uint32_t>(i * sizeof(uint32_t)), sizeof(uint32_t) };
+
+    VkSpecializationInfo specializationInfo = {};
+    specializationInfo.mapEntryCount = VERTEX_LAYOUT_CONSTANT_COUNT;
+    specializationInfo.pMapEntries = mapEntries;
+    specializationInfo.dataSize = sizeof(constants);
+    specializationInfo.pData = constants;
+
+    std::vector<VkDescriptorSetLayoutBinding> bindings = {
+        { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, VK_NULL_HANDLE }
+    };
+    bindings.insert(bindings.end(), baseInfo.pBindings, baseInfo.pBindings + baseInfo.bindingCount);
+
+    /* 顶点全部从 SSBO 读取，没有顶点输入 */
+    VkPipelineVertexInputStateCreateInfo vertexInputState = {};
+    vertexInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+    GraphicsPipelineCreateInfo createInfo = baseInfo;
+    createInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    createInfo.pBindings = bindings.data();
+    createInfo.pushConstantSize = sizeof(PackedMeshPushConstants);
+    createInfo.pushConstantStages = VK_SHADER_STAGE_VERTEX_BIT;
+    createInfo.pSpecializationInfo = &specializationInfo;
+    createInfo.pVertexInputState = &vertexInputState;
+
+    return driver->CreateGraphicsPipeline(createInfo, pPipeline);
+}
@@ -0,0 +1,155 @@
+#ifndef PACKED_MESH_H_
+#define PACKED_MESH_H_
+
+#include "driver/render_driver.h"
+
+// std
+#include <vector>
+
+enum VertexAttribute
+{
+    VERTEX_ATTRIBUTE_POSITION,                  // 3 分量
+    VERTEX_ATTRIBUTE_NORMAL,                    // 3 分量，八面体编码时存 2 分量
+    VERTEX_ATTRIBUTE_UV,                        // 2 分量
+    VERTEX_ATTRIBUTE_COLOR,                     // 4 分量
+    VERTEX_ATTRIBUTE_COUNT,
+};
+
+/* 与 qk_vertex_pulling.glsl 中的 QK_VERTEX_ENCODING_* 保持一致 */
+enum VertexEncoding
+{
+    VERTEX_ENCODING_NONE,                       // 不存储，着色器使用默认值
+    VERTEX_ENCODING_FLOAT32,
+    VERTEX_ENCODING_HALF,
+    VERTEX_ENCODING_UNORM16,                    // 用于位置时相对网格包围盒
+    VERTEX_ENCODING_SNORM16,
+    VERTEX_ENCODING_UNORM8,
+    VERTEX_ENCODING_SNORM8,
+    VERTEX_ENCODING_OCT_SNORM8,                 // 只用于法线
+    VERTEX_ENCODING_OCT_SNORM16,
+};
+
+struct VertexAttributeFormat
+{
+    VertexEncoding encoding;
+    uint32_t offset;                            // 字节，需要按分量大小对齐
+};
+
+/* 顶点布局，stride 需要是 4 的倍数 */
+struct VertexLayout
+{
+    VertexAttributeFormat attributes[VERTEX_ATTRIBUTE_COUNT];
+    uint32_t stride;
+};
+
+/* 导入时的全精度顶点 */
+struct MeshVertex
+{
+    float position[3];
+    float normal[3];
+    float uv[2];
+    float color[4];
+};
+
+/* 压缩网格着色器的 push constant，只在顶点阶段可见 */
+struct PackedMeshPushConstants
+{
+    float mvp[16];
+    float boundsMin[4];
+    float boundsExtent[4];
+};
+
+/* 一个 LOD 级别在索引缓冲中的范围，所有级别共用顶点缓冲 */
+struct MeshLodLevel
+{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error;                                // 顶点相对原始网格的累计位移，对象空间的保守估计，供 LOD 选择使用
+};
+
+struct PackedMeshCreateInfo
+{
+    VertexLayout layout = {};
+    uint32_t vertexCount = 0;
+    const MeshVertex* pVertices = VK_NULL_HANDLE;
+    uint32_t indexCount = 0;                    // 为 0 时按顶点顺序绘制
+    const uint32_t* pIndices = VK_NULL_HANDLE;
+    uint32_t levelCount = 0;                    // 为 0 时整个索引缓冲作为第 0 级，见 MeshLod::GenerateChain
+    const MeshLodLevel* pLevels = VK_NULL_HANDLE;
+};
+
+/**
+ * 顶点拉取的压缩网格。
+ *
+ * 顶点按 VertexLayout 量化后放在 SSBO 中，着色器用 gl_VertexIndex 读取，解码方式由
+ * 同一个布局生成的特化常量决定（见 qk_vertex_pulling.glsl），每种布局编译一个管线。
+ * 默认的压缩布局每个顶点 16 字节：
+ *   位置  3 x unorm16，相对包围盒
+ *   法线  八面体 2 x snorm8
+ *   UV    2 x half
+ *   颜色  RGBA8
+ * 全精度的 MeshVertex 为 48 字节。
+ */
+class PackedMesh
+{
+public:
+    PackedMesh(RenderDriver* driver);
+   ~PackedMesh();
+
+    VkResult Initialize(const PackedMeshCreateInfo& createInfo);
+
+    /* pipeline 需要由与网格相同的布局创建 */
+    void CmdDraw(VkCommandBuffer commandBuffer, Pipeline pipeline, const float* mvp, uint32_t level = 0);
+    /* descriptorSet 由调用方从 pipeline 分配并写入额外的 binding，这里只写入 binding 0 */
+    void CmdDraw(VkCommandBuffer commandBuffer, Pipeline pipeline, VkDescriptorSet descriptorSet, const float* mvp, uint32_t level = 0);
+
+    /* 交给 RenderQueue 等延迟录制的调用方：binding 写入顶点缓冲，push constant 在顶点阶段 offset 0 */
+    void WriteDescriptor(VkDescriptorSet descriptorSet, uint32_t binding) const;
+    void GetPushConstants(const float* mvp, PackedMeshPushConstants* pPushConstants) const;
+
+    const VertexLayout& GetLayout() const { return layout; }
+    Buffer GetVertexBuffer() const { return vertexBuffer; }
+    uint32_t GetVertexCount() const { return vertexCount; }
+    /* uint32 索引，indexCount 为 0 时为 VK_NULL_HANDLE */
+    Buffer GetIndexBuffer() const { return indexBuffer; }
+    uint32_t GetIndexCount() const { return indexCount; }
+    VkDeviceSize GetVertexBufferSize() const { return static_cast<VkDeviceSize>(vertexCount) * layout.stride; }
+    const float* GetBoundsMin() const { return boundsMin; }
+    const float* GetBoundsExtent() const { return boundsExtent; }
+    uint32_t GetLevelCount() const { return static_cast<uint32_t>(levels.size()); }
+    const MeshLodLevel& GetLevel(uint32_t level) const { return levels[level]; }
+    /* 对象空间的包围球，中心为包围盒中心 */
+    const float* GetBoundingCenter() const { return boundingCenter; }
+    float GetBoundingRadius() const { return boundingRadius; }
+
+    static VertexLayout GetCompressedLayout();
+    static VertexLayout GetFullPrecisionLayout();
+    static VkBool32 ValidateLayout(const VertexLayout& layout);
+
+    /* 按布局编码顶点，pOutput 的大小为 vertexCount * stride，位置相对 boundsMin / boundsExtent 量化 */
+    static void EncodeVertices(const VertexLayout& layout, uint32_t vertexCount, const MeshVertex* pVertices,
+                               const float* boundsMin, const float* boundsExtent, uint8_t* pOutput);
+
+    /* 创建读取该布局的图形管线，set 0 binding 0 为顶点缓冲 */
+    static VkResult CreatePipeline(RenderDriver* driver, const char* shaderName, const VertexLayout& layout, Pipeline* pPipeline);
+    /* baseInfo 的 binding 追加在顶点缓冲之后（从 1 开始），特化常量、顶点输入和 push constant 由布局决定 */
+    static VkResult CreatePipeline(RenderDriver* driver, const GraphicsPipelineCreateInfo& baseInfo, const VertexLayout& layout, Pipeline* pPipeline);
+
+private:
+    RenderDriver* driver = VK_NULL_HANDLE;
+
+    VertexLayout layout = {};
+    Buffer vertexBuffer = VK_NULL_HANDLE;
+    Buffer indexBuffer = VK_NULL_HANDLE;
+    uint32_t vertexCount = 0;
+    uint32_t indexCount = 0;
+
+    float boundsMin[4] = {};
+    float boundsExtent[4] = {};
+    float boundingCenter[3] = {};
+    float boundingRadius = 0.0f;
+
+    std::vector<MeshLodLevel> levels;
+};
+
+#endif /* PACKED_MESH_H_ */
@@ -0,0 +1,317 @@
+#include "particle_system.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stddef.h>
+#include <string.h>
+
+#include "core/profiler/profiler.h"
+#include "driver/vkutils.h"
+#include "rendering/atlas/texture_atlas.h"
+
+/* 与计算着色器的 local_size_x 保持一致 */
+static const uint32_t PARTICLE_GROUP_SIZE = 64;
+
+/* qk_particle_args.comp 的两种模式 */
+static const uint32_t PARTICLE_ARGS_DISPATCH = 0;
+static const uint32_t PARTICLE_ARGS_DRAW = 1;
+
+ParticleSystem::ParticleSystem(RenderDriver* driver) : driver(driver)
+{
+    /* do nothing... */
+}
+
+ParticleSystem::~ParticleSystem()
+{
+    Pipeline pipelines[] = { emitPipeline, argsPipeline, simulatePipeline, drawPipeline, spritePipeline };
+    for (Pipeline pipeline : pipelines) {
+        if (pipeline != VK_NULL_HANDLE)
+            driver->DestroyPipeline(pipeline);
+    }
+
+    Buffer buffers[] = { particleBuffer, deadListBuffer, aliveListBuffers[0], aliveListBuffers[1], counterBuffer, spriteBuffer };
+    for (Buffer buffer : buffers) {
+        if (buffer != VK_NULL_HANDLE)
+            driver->DestroyBuffer(buffer);
+    }
+}
+
+VkResult ParticleSystem::Initialize(const ParticleSystemCreateInfo& createInfo)
+{
+    VkResult err;
+
+    info = createInfo;
+
+    if (info.maxParticles == 0 || info.maxParticles > INT32_MAX) {
+        printf("[vulkan] invalid particle system create info\n");
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    const VkDeviceSize listSize = static_cast<VkDeviceSize>(info.maxParticles) * sizeof(uint32_t);
+
+    err = driver->CreateBuffer(static_cast<VkDeviceSize>(info.maxParticles) * sizeof(GpuParticle), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY, &particleBuffer);
+    VK_CHECK_ERROR(err);
+
+    err = driver->CreateBuffer(listSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, &deadListBuffer);
+    VK_CHECK_ERROR(err);
+
+    for (Buffer& aliveList : aliveListBuffers) {
+        err = driver->CreateBuffer(listSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY, &aliveList);
+        VK_CHECK_ERROR(err);
+    }
+
+    err = driver->CreateBuffer(sizeof(ParticleCounters), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, &counterBuffer);
+    VK_CHECK_ERROR(err);
+
+    /* 初始时所有粒子都在死亡列表中，这是唯一一次经过 CPU 的粒子数据 */
+    std::vector<uint32_t> deadIndices(info.maxParticles);
+    std::iota(deadIndices.begin(), deadIndices.end(), 0u);
+    driver->WriteBuffer(deadListBuffer, listSize, deadIndices.data());
+
+    ParticleCounters counters = {};
+    counters.deadCount = static_cast<int32_t>(info.maxParticles);
+    driver->WriteBuffer(counterBuffer, sizeof(counters), &counters);
+
+    /* 三个计算着色器使用相同的描述符集布局，每帧分配的描述符集可以互相绑定 */
+    VkDescriptorSetLayoutBinding computeBindings[] = {
+        { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, VK_NULL_HANDLE },
+        { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, VK_NULL_HANDLE },
+        { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, VK_NULL_HANDLE },
+        { 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, VK_NULL_HANDLE },
+        { 4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, VK_NULL_HANDLE },
+        { 5, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, VK_NULL_HANDLE },
+        { 6, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, VK_NULL_HANDLE },
+    };
+
+    err = driver->CreateComputePipeline("qk_particle_emit", ARRAY_SIZE(computeBindings), computeBindings, sizeof(SimulatePushConstants), &emitPipeline);
+    VK_CHECK_ERROR(err);
+
+    err = driver->CreateComputePipeline("qk_particle_args", ARRAY_SIZE(computeBindings), computeBindings, sizeof(SimulatePushConstants), &argsPipeline);
+    VK_CHECK_ERROR(err);
+
+    err = driver->CreateComputePipeline("qk_particle_simulate", ARRAY_SIZE(computeBindings), computeBindings, sizeof(SimulatePushConstants), &simulatePipeline);
+    VK_CHECK_ERROR(err);
+
+    VkDescriptorSetLayoutBinding drawBindings[] = {
+        { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, VK_NULL_HANDLE },
+        { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, VK_NULL_HANDLE },
+    };
+
+    /* 顶点由 gl_VertexIndex 展开，没有顶点输入 */
+    VkPipelineVertexInputStateCreateInfo vertexInputState = {};
+    vertexInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+    GraphicsPipelineCreateInfo drawCreateInfo = {};
+    drawCreateInfo.shaderName = "qk_particle";
+    drawCreateInfo.bindingCount = ARRAY_SIZE(drawBindings);
+    drawCreateInfo.pBindings = drawBindings;
+    drawCreateInfo.pushConstantSize = sizeof(DrawPushConstants);
+    drawCreateInfo.pushConstantStages = VK_SHADER_STAGE_VERTEX_BIT;
+    drawCreateInfo.pVertexInputState = &vertexInputState;
+    drawCreateInfo.cullMode = VK_CULL_MODE_NONE;
+    drawCreateInfo.depthWriteEnable = VK_FALSE;
+    drawCreateInfo.blendMode = PIPELINE_BLEND_MODE_ADDITIVE;
+
+    err = driver->CreateGraphicsPipeline(drawCreateInfo, &drawPipeline);
+    VK_CHECK_ERROR(err);
+
+    statistics.maxParticles = info.maxParticles;
+
+    return VK_SUCCESS;
+}
+
+void ParticleSystem::CmdSimulate(VkCommandBuffer commandBuffer, float deltaTime)
+{
+    QK_PROFILE_ZONE("ParticleSystem::CmdSimulate");
+
+    VkResult err;
+
+    statistics.emitRequested = 0;
+    statistics.dispatchCount = 0;
+
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    err = driver->AllocateDescriptorSet(emitPipeline, &descriptorSet);
+    if (err != VK_SUCCESS)
+        return;
+
+    driver->WriteDescriptorBuffer(descriptorSet, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, particleBuffer, 0, VK_WHOLE_SIZE);
+    driver->WriteDescriptorBuffer(descriptorSet, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, deadListBuffer, 0, VK_WHOLE_SIZE);
+    driver->WriteDescriptorBuffer(descriptorSet, 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, aliveListBuffers[0], 0, VK_WHOLE_SIZE);
+    driver->WriteDescriptorBuffer(descriptorSet, 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, aliveListBuffers[1], 0, VK_WHOLE_SIZE);
+    driver->WriteDescriptorBuffer(descriptorSet, 4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, counterBuffer, 0, VK_WHOLE_SIZE);
+    driver->WriteDescriptorDepthPyramid(descriptorSet, 5);
+
+    /* 发射数量在 CPU 上累积，小数部分留到下一帧，数量上限为粒子池大小 */
+    emitAccumulator = std::min(emitAccumulator + emitter.rate * deltaTime, static_cast<float>(info.maxParticles));
+    const uint32_t emitCount = static_cast<uint32_t>(emitAccumulator);
+    emitAccumulator -= static_cast<float>(emitCount);
+
+    SimulatePushConstants pc = {};
+    memcpy(pc.emitterPositionRadius, emitter.position, sizeof(emitter.position));
+    pc.emitterPositionRadius[3] = emitter.radius;
+    memcpy(pc.emitterVelocityJitter, emitter.velocity, sizeof(emitter.velocity));
+    pc.emitterVelocityJitter[3] = emitter.velocityJitter;
+    memcpy(pc.emitterColor, emitter.color, sizeof(emitter.color));
+    pc.emitterLifeSize[0] = emitter.lifetimeMin;
+    pc.emitterLifeSize[1] = emitter.lifetimeMax;
+    pc.emitterLifeSize[2] = emitter.sizeMin;
+    pc.emitterLifeSize[3] = emitter.sizeMax;
+    memcpy(pc.gravityDrag, info.gravity, sizeof(info.gravity));
+    pc.gravityDrag[3] = info.drag;
+    pc.deltaTime = deltaTime;
+    pc.restitution = info.restitution;
+    pc.emitCount = emitCount;
+    pc.seed = frameSeed++ * 0x9E3779B9u;
+    pc.currentList = currentList;
+
+    /* 上一帧的模拟、间接参数读取和绘制都结束后才能改写 (WAR / WAW) */
+    driver->CmdMemoryBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                             VK_ACCESS_SHADER_WRITE_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    if (emitCount > 0) {
+        driver->CmdBindPipeline(commandBuffer, emitPipeline);
+        driver->CmdBindDescriptorSet(commandBuffer, emitPipeline, descriptorSet);
+        driver->CmdPushConstants(commandBuffer, emitPipeline, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pc), &pc);
+        driver->CmdDispatch(commandBuffer, (emitCount + PARTICLE_GROUP_SIZE - 1) / PARTICLE_GROUP_SIZE, 1, 1);
+        statistics.dispatchCount++;
+
+        _CmdComputeBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    }
+
+    pc.mode = PARTICLE_ARGS_DISPATCH;
+    driver->CmdBindPipeline(commandBuffer, argsPipeline);
+    driver->CmdBindDescriptorSet(commandBuffer, argsPipeline, descriptorSet);
+    driver->CmdPushConstants(commandBuffer, argsPipeline, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pc), &pc);
+    driver->CmdDispatch(commandBuffer, 1, 1, 1);
+
+    _CmdComputeBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                       VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    driver->CmdBindPipeline(commandBuffer, simulatePipeline);
+    driver->CmdBindDescriptorSet(commandBuffer, simulatePipeline, descriptorSet);
+    driver->CmdPushConstants(commandBuffer, simulatePipeline, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pc), &pc);
+    driver->CmdDispatchIndirect(commandBuffer, counterBuffer, offsetof(ParticleCounters, dispatchArgs));
+
+    _CmdComputeBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    pc.mode = PARTICLE_ARGS_DRAW;
+    driver->CmdBindPipeline(commandBuffer, argsPipeline);
+    driver->CmdBindDescriptorSet(commandBuffer, argsPipeline, descriptorSet);
+    driver->CmdPushConstants(commandBuffer, argsPipeline, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pc), &pc);
+    driver->CmdDispatch(commandBuffer, 1, 1, 1);
+
+    _CmdComputeBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                       VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+
+    statistics.emitRequested = emitCount;
+    statistics.dispatchCount += 3;
+
+    /* 本帧的输出列表就是绘制和下一帧模拟的输入 */
+    currentList = 1 - currentList;
+}
+
+void ParticleSystem::CmdDraw(VkCommandBuffer commandBuffer, const float* view, const float* viewProjection)
+{
+    QK_PROFILE_ZONE("ParticleSystem::CmdDraw");
+
+    VkResult err;
+
+    Pipeline pipeline = spriteAtlas != VK_NULL_HANDLE ? spritePipeline : drawPipeline;
+
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    err = driver->AllocateDescriptorSet(pipeline, &descriptorSet);
+    if (err != VK_SUCCESS)
+        return;
+
+    driver->WriteDescriptorBuffer(descriptorSet, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, particleBuffer, 0, VK_WHOLE_SIZE);
+    driver->WriteDescriptorBuffer(descriptorSet, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, aliveListBuffers[currentList], 0, VK_WHOLE_SIZE);
+
+    if (spriteAtlas != VK_NULL_HANDLE) {
+        spriteAtlas->WriteDescriptorSet(descriptorSet, 2);
+        driver->WriteDescriptorBuffer(descriptorSet, 3, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, spriteBuffer, 0, sizeof(ParticleSpriteUniformData));
+    }
+
+    /* 列主序 view 矩阵的前两行是相机在世界空间中的右和上方向 */
+    DrawPushConstants pc = {};
+    memcpy(pc.viewProjection, viewProjection, sizeof(pc.viewProjection));
+    pc.cameraRight[0] = view[0];
+    pc.cameraRight[1] = view[4];
+    pc.cameraRight[2] = view[8];
+    pc.cameraUp[0] = view[1];
+    pc.cameraUp[1] = view[5];
+    pc.cameraUp[2] = view[9];
+
+    driver->CmdBindPipeline(commandBuffer, pipeline);
+    driver->CmdBindDescriptorSet(commandBuffer, pipeline, descriptorSet);
+    driver->CmdPushConstants(commandBuffer, pipeline, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pc), &pc);
+    driver->CmdDrawIndirect(commandBuffer, counterBuffer, offsetof(ParticleCounters, drawArgs), 1);
+}
+
+VkResult ParticleSystem::SetSpriteAtlas(TextureAtlas* atlas, uint32_t spriteCount, const AtlasRegion* pSprites)
+{
+    VkResult err;
+
+    if (atlas == VK_NULL_HANDLE || spriteCount == 0) {
+        spriteAtlas = VK_NULL_HANDLE;
+        return VK_SUCCESS;
+    }
+
+    /* 第一次设置图集时才创建精灵管线和区域缓冲 */
+    if (spritePipeline == VK_NULL_HANDLE) {
+        VkDescriptorSetLayoutBinding spriteBindings[4] = {
+            { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, VK_NULL_HANDLE },
+            { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, VK_NULL_HANDLE },
+            {},
+            { 3, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, VK_NULL_HANDLE },
+        };
+        TextureAtlas::GetDescriptorSetLayoutBinding(2, VK_SHADER_STAGE_FRAGMENT_BIT, &spriteBindings[2]);
+
+        VkPipelineVertexInputStateCreateInfo vertexInputState = {};
+        vertexInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+        GraphicsPipelineCreateInfo spriteCreateInfo = {};
+        spriteCreateInfo.shaderName = "qk_particle";
+        spriteCreateInfo.fragmentShaderName = "qk_particle_sprite";
+        spriteCreateInfo.bindingCount = ARRAY_SIZE(spriteBindings);
+        spriteCreateInfo.pBindings = spriteBindings;
+        spriteCreateInfo.pushConstantSize = sizeof(DrawPushConstants);
+        spriteCreateInfo.pushConstantStages = VK_SHADER_STAGE_VERTEX_BIT;
+        spriteCreateInfo.pVertexInputState = &vertexInputState;
+        spriteCreateInfo.cullMode = VK_CULL_MODE_NONE;
+        spriteCreateInfo.depthWriteEnable = VK_FALSE;
+        spriteCreateInfo.blendMode = PIPELINE_BLEND_MODE_ADDITIVE;
+
+        err = driver->CreateGraphicsPipeline(spriteCreateInfo, &spritePipeline);
+        VK_CHECK_ERROR(err);
+
+        err = driver->CreateBuffer(sizeof(ParticleSpriteUniformData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, &spriteBuffer);
+        VK_CHECK_ERROR(err);
+    }
+
+    spriteCount = std::min<uint32_t>(spriteCount, QK_PARTICLE_MAX_SPRITES);
+
+    ParticleSpriteUniformData data = {};
+    for (uint32_t i = 0; i < spriteCount; i++) {
+        data.uvRects[i][0] = pSprites[i].uvMin[0];
+        data.uvRects[i][1] = pSprites[i].uvMin[1];
+        data.uvRects[i][2] = pSprites[i].uvMax[0];
+        data.uvRects[i][3] = pSprites[i].uvMax[1];
+        data.layers[i][0] = pSprites[i].layer;
+    }
+    data.spriteCount[0] = spriteCount;
+
+    /* 只在设置时上传一次，之前录制的帧可能还在使用旧数据，先等 GPU 空闲 */
+    driver->DeviceWaitIdle();
+    driver->WriteBuffer(spriteBuffer, sizeof(data), &data);
+
+    spriteAtlas = atlas;
+
+    return VK_SUCCESS;
+}
+
+void ParticleSystem::_CmdComputeBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask)
+{
+    driver->CmdMemoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, dstStageMask, dstAccessMask);
+}
@@ -0,0 +1,160 @@
+#ifndef PARTICLE_SYSTEM_H_
+#define PARTICLE_SYSTEM_H_
+
+#include "driver/render_driver.h"
+
+// std
+#include <vector>
+
+class TextureAtlas;
+struct AtlasRegion;
+
+/* 与 qk_particle_sprite.frag 中的 QK_PARTICLE_MAX_SPRITES 保持一致 */
+#define QK_PARTICLE_MAX_SPRITES 8
+
+/* GPU 端的粒子，std430，与 qk_particle.glsl 中的 Particle 保持一致 */
+struct GpuParticle
+{
+    float positionSize[4];
+    float velocityLife[4];
+    uint32_t color;
+    float lifetime;
+    uint32_t _padding[2];
+};
+
+/* 计数器缓冲，与 qk_particle.glsl 中的 Counters 保持一致 */
+struct ParticleCounters
+{
+    int32_t deadCount;
+    uint32_t aliveCount[2];
+    uint32_t _padding;
+    uint32_t dispatchArgs[4];                   // VkDispatchIndirectCommand
+    VkDrawIndirectCommand drawArgs;
+};
+
+/* std140，与 qk_particle_sprite.frag 中的 SpriteData 保持一致 */
+struct ParticleSpriteUniformData
+{
+    float uvRects[QK_PARTICLE_MAX_SPRITES][4];  // uvMin, uvMax
+    uint32_t layers[QK_PARTICLE_MAX_SPRITES][4];
+    uint32_t spriteCount[4];
+};
+
+struct ParticleEmitter
+{
+    float position[3] = { 0.0f, 0.0f, 0.0f };
+    float radius = 0.0f;                        // 在这个半径的球内随机出生
+    float velocity[3] = { 0.0f, 1.0f, 0.0f };
+    float velocityJitter = 0.0f;
+    float color[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    float lifetimeMin = 1.0f;
+    float lifetimeMax = 1.0f;
+    float sizeMin = 0.01f;
+    float sizeMax = 0.01f;
+    float rate = 0.0f;                          // 每秒发射数量
+};
+
+struct ParticleSystemCreateInfo
+{
+    uint32_t maxParticles = 1 << 20;
+    float gravity[3] = { 0.0f, -9.8f, 0.0f };
+    float drag = 0.0f;
+    float restitution = 0.5f;
+};
+
+struct ParticleStatistics
+{
+    uint32_t maxParticles;
+    uint32_t emitRequested;                     // 最近一帧请求发射的数量，死亡列表不足时 GPU 会丢弃多出的部分
+    uint32_t dispatchCount;
+};
+
+/**
+ * GPU 粒子系统。
+ *
+ * 粒子池、死亡列表和两个存活列表都是常驻的 device local SSBO，每帧在计算着色器中：
+ *   1. 发射：从死亡列表取下标初始化新粒子，压入输入存活列表
+ *   2. 按输入存活数量写 dispatch 参数
+ *   3. 模拟：积分、与上一帧深度 pyramid 碰撞，存活的压缩到输出列表，死亡的归还
+ *   4. 按输出存活数量写 draw 参数，CmdDraw 用 CmdDrawIndirect 绘制
+ * 存活数量只存在于 GPU 上，CPU 不回读，每帧唯一的上传是 push constant。
+ *
+ * CmdSimulate 在 CmdBeginRendering 之前调用，CmdDraw 在场景 pass 中调用，
+ * 碰撞使用的深度来自上一帧的 CmdBuildDepthPyramid。
+ */
+class ParticleSystem
+{
+public:
+    ParticleSystem(RenderDriver* driver);
+   ~ParticleSystem();
+
+    VkResult Initialize(const ParticleSystemCreateInfo& createInfo);
+
+    void SetEmitter(const ParticleEmitter& emitter) { this->emitter = emitter; }
+
+    /*
+     * 粒子改为从图集中采样精灵，每个粒子按下标固定使用 pSprites 中的一个，最多
+     * QK_PARTICLE_MAX_SPRITES 个。图集需要在粒子所在的 pass 之前 CmdUpload，
+     * 生命周期不短于粒子系统。atlas 为空时恢复圆形软边。
+     */
+    VkResult SetSpriteAtlas(TextureAtlas* atlas, uint32_t spriteCount, const AtlasRegion* pSprites);
+
+    void CmdSimulate(VkCommandBuffer commandBuffer, float deltaTime);
+
+    /* view 和 viewProjection 均为列主序的 4x4 矩阵，view 用于取相机的右和上方向 */
+    void CmdDraw(VkCommandBuffer commandBuffer, const float* view, const float* viewProjection);
+
+    void GetStatistics(ParticleStatistics* pStatistics) const { *pStatistics = statistics; }
+
+private:
+    /* 三个计算着色器共用，与 qk_particle.glsl 中的 PushConstants 保持一致 */
+    struct SimulatePushConstants
+    {
+        float emitterPositionRadius[4];
+        float emitterVelocityJitter[4];
+        float emitterColor[4];
+        float emitterLifeSize[4];
+        float gravityDrag[4];
+        float deltaTime;
+        float restitution;
+        uint32_t emitCount;
+        uint32_t seed;
+        uint32_t currentList;
+        uint32_t mode;
+    };
+
+    struct DrawPushConstants
+    {
+        float viewProjection[16];
+        float cameraRight[4];
+        float cameraUp[4];
+    };
+
+    void _CmdComputeBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask);
+
+    RenderDriver* driver = VK_NULL_HANDLE;
+    ParticleSystemCreateInfo info = {};
+    ParticleEmitter emitter = {};
+
+    Buffer particleBuffer = VK_NULL_HANDLE;
+    Buffer deadListBuffer = VK_NULL_HANDLE;
+    Buffer aliveListBuffers[2] = {};
+    Buffer counterBuffer = VK_NULL_HANDLE;
+
+    Pipeline emitPipeline = VK_NULL_HANDLE;
+    Pipeline argsPipeline = VK_NULL_HANDLE;
+    Pipeline simulatePipeline = VK_NULL_HANDLE;
+    Pipeline drawPipeline = VK_NULL_HANDLE;
+    Pipeline spritePipeline = VK_NULL_HANDLE;
+
+    TextureAtlas* spriteAtlas = VK_NULL_HANDLE;
+    Buffer spriteBuffer = VK_NULL_HANDLE;
+
+    uint32_t currentList = 0;
+    uint32_t frameSeed = 0;
+    float emitAccumulator = 0.0f;               // 不足一个粒子的发射量留到下一帧
+
+    ParticleStatistics statistics = {};
+};
+
+#endif /* PARTICLE_SYSTEM_H_ */
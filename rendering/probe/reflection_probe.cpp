@@ -0,0 +1,123 @@
+#include "reflection_probe.h"
+
+#include <algorithm>
+
+#include "core/profiler/profiler.h"
+#include "driver/vkutils.h"
+
+/* 立方体贴图的面数，与 CameraSet::SetCubemap 的视图数量相同 */
+static const uint32_t CUBEMAP_FACES = 6;
+
+ReflectionProbe::ReflectionProbe(RenderDriver* driver) : driver(driver), views(driver)
+{
+    /* do nothing... */
+}
+
+ReflectionProbe::~ReflectionProbe()
+{
+    if (cubemap != VK_NULL_HANDLE)
+        driver->DestroyTexture2D(cubemap);
+
+    if (uniformBuffer != VK_NULL_HANDLE)
+        driver->DestroyBuffer(uniformBuffer);
+
+    if (sampler != VK_NULL_HANDLE)
+        driver->DestroySampler(sampler);
+}
+
+VkResult ReflectionProbe::Initialize(const ReflectionProbeCreateInfo& createInfo)
+{
+    VkResult err;
+
+    info = createInfo;
+    info.captureInterval = std::max<uint32_t>(info.captureInterval, 1);
+
+    captureSupported = driver->HasMultiview() && driver->GetMaxMultiviewViewCount() >= CUBEMAP_FACES;
+
+    /* 不能捕获时也创建纹理，着色器的 binding 始终有效 */
+    err = driver->CreateTexture2DArray(info.size, info.size, CUBEMAP_FACES, 1, info.colorFormat,
+                                       VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, &cubemap);
+    VK_CHECK_ERROR(err);
+
+    err = driver->CreateBuffer(sizeof(ReflectionProbeUniformData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, &uniformBuffer);
+    VK_CHECK_ERROR(err);
+
+    /* 强度为 0 时着色器不采样，第一次捕获之前的内容无关紧要 */
+    ReflectionProbeUniformData data = {};
+    driver->WriteBuffer(uniformBuffer, sizeof(data), &data);
+
+    err = driver->CreateSampler(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, &sampler);
+    VK_CHECK_ERROR(err);
+
+    if (captureSupported) {
+        err = views.Initialize();
+        VK_CHECK_ERROR(err);
+    }
+
+    return VK_SUCCESS;
+}
+
+void ReflectionProbe::CmdUpdate(VkCommandBuffer commandBuffer, const glm::vec3& position, Texture2D depth, PFN_ReflectionProbeCallback callback, void* pUserData)
+{
+    QK_PROFILE_FUNCTION();
+
+    const VkBool32 due = IsCaptureDue();
+    frameCounter++;
+
+    if (!due || depth == VK_NULL_HANDLE) {
+        /* 描述符要求 SHADER_READ_ONLY 布局，捕获之前也转换一次 */
+        if (!layoutReady) {
+            driver->CmdTextureMemoryBarrier(commandBuffer, cubemap, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+            layoutReady = VK_TRUE;
+        }
+        return;
+    }
+
+    views.SetCubemap(position, info.near, info.far);
+    views.CmdUpload(commandBuffer);
+
+    driver->CmdTextureMemoryBarrier(commandBuffer, cubemap, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    driver->CmdBeginMultiviewRendering(commandBuffer, cubemap, depth, views.GetViewMask(), VK_TRUE);
+    callback(commandBuffer, views, pUserData);
+    driver->CmdEndMultiviewRendering(commandBuffer);
+    driver->CmdTextureMemoryBarrier(commandBuffer, cubemap, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    layoutReady = VK_TRUE;
+
+    if (captured)
+        return;
+
+    /* 第一次捕获之后打开采样 */
+    ReflectionProbeUniformData data = {};
+    data.params[0] = info.intensity;
+
+    driver->CmdMemoryBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+    driver->CmdUpdateBuffer(commandBuffer, uniformBuffer, 0, sizeof(data), &data);
+
+    driver->CmdMemoryBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                             VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_UNIFORM_READ_BIT);
+
+    captured = VK_TRUE;
+}
+
+void ReflectionProbe::WriteDescriptor(VkDescriptorSet descriptorSet, uint32_t binding) const
+{
+    driver->WriteDescriptorTexture(descriptorSet, binding + 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, cubemap, sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    driver->WriteDescriptorBuffer(descriptorSet, binding + 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniformBuffer, 0, sizeof(ReflectionProbeUniformData));
+}
+
+void ReflectionProbe::FillCapturePipelineInfo(GraphicsPipelineCreateInfo* pCreateInfo) const
+{
+    pCreateInfo->colorFormat = info.colorFormat;
+    pCreateInfo->depthFormat = info.depthFormat;
+    pCreateInfo->viewMask = (1u << CUBEMAP_FACES) - 1;
+}
+
+void ReflectionProbe::GetDescriptorSetLayoutBindings(uint32_t binding, VkShaderStageFlags stageFlags, VkDescriptorSetLayoutBinding* pBindings)
+{
+    pBindings[0] = { binding + 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, stageFlags, VK_NULL_HANDLE };
+    pBindings[1] = { binding + 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, stageFlags, VK_NULL_HANDLE };
+}
@@ -0,0 +1,77 @@
+#ifndef REFLECTION_PROBE_H_
+#define REFLECTION_PROBE_H_
+
+#include "driver/render_driver.h"
+#include "rendering/camera/camera_set.h"
+
+/* std140，与 qk_reflection_probe.glsl 中的 ProbeData 保持一致 */
+struct ReflectionProbeUniformData
+{
+    float params[4];                            // x = 强度，0 表示还没有捕获过
+};
+
+struct ReflectionProbeCreateInfo
+{
+    uint32_t size = 128;                        // 每个面的边长
+    VkFormat colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+    VkFormat depthFormat = VK_FORMAT_D32_SFLOAT;
+    float near = 0.05f;
+    float far = 50.0f;
+    float intensity = 0.5f;
+    uint32_t captureInterval = 30;              // 每隔几次 CmdUpdate 重新捕获
+};
+
+/* 捕获时的绘制回调，在 6 个面的多视图渲染中调用，views 的 UBO 由管线的 binding 读取 */
+typedef void (*PFN_ReflectionProbeCallback)(VkCommandBuffer commandBuffer, const CameraSet& views, void* pUserData);
+
+/**
+ * 立方体贴图反射探针。
+ *
+ * 6 个面存放在 2D 数组纹理的 6 层中，顺序和朝向由 CameraSet::SetCubemap 决定，一次多视图
+ * 渲染完成捕获。片元着色器通过 qk_reflection_probe.glsl 按立方体贴图的主轴规则选择层和
+ * 坐标采样。设备不支持 6 个视图的多视图时不捕获，强度保持为 0，着色器跳过采样。
+ */
+class ReflectionProbe
+{
+public:
+    ReflectionProbe(RenderDriver* driver);
+   ~ReflectionProbe();
+
+    VkResult Initialize(const ReflectionProbeCreateInfo& createInfo);
+
+    VkBool32 IsCaptureSupported() const { return captureSupported; }
+    /* 下一次 CmdUpdate 是否会捕获，调用方据此准备深度附件 */
+    VkBool32 IsCaptureDue() const { return captureSupported && frameCounter % info.captureInterval == 0; }
+
+    /*
+     * 每帧在 CmdBeginRendering 之前调用。到期时以 position 为中心捕获，depth 为 6 层、
+     * depthFormat 格式、处于 DEPTH_STENCIL_ATTACHMENT_OPTIMAL 布局的附件，为空时跳过。
+     */
+    void CmdUpdate(VkCommandBuffer commandBuffer, const glm::vec3& position, Texture2D depth, PFN_ReflectionProbeCallback callback, void* pUserData);
+
+    /* binding 为 6 层的 sampler2DArray，binding+1 为 ProbeData UBO，与 qk_reflection_probe.glsl 相同 */
+    void WriteDescriptor(VkDescriptorSet descriptorSet, uint32_t binding) const;
+
+    /* 捕获管线的附件格式和 viewMask */
+    void FillCapturePipelineInfo(GraphicsPipelineCreateInfo* pCreateInfo) const;
+
+    static void GetDescriptorSetLayoutBindings(uint32_t binding, VkShaderStageFlags stageFlags, VkDescriptorSetLayoutBinding* pBindings);
+
+    const ReflectionProbeCreateInfo& GetCreateInfo() const { return info; }
+
+private:
+    RenderDriver* driver = VK_NULL_HANDLE;
+    ReflectionProbeCreateInfo info = {};
+
+    CameraSet views;
+    Texture2D cubemap = VK_NULL_HANDLE;
+    Buffer uniformBuffer = VK_NULL_HANDLE;
+    VkSampler sampler = VK_NULL_HANDLE;
+
+    VkBool32 captureSupported = VK_FALSE;
+    VkBool32 captured = VK_FALSE;
+    VkBool32 layoutReady = VK_FALSE;
+    uint64_t frameCounter = 0;
+};
+
+#endif /* REFLECTION_PROBE_H_ */
@@ -0,0 +1,326 @@
+#include "render_queue.h"
+
+#include <string.h>
+
+#include "core/profiler/profiler.h"
+
+/* 少于这个数量的 packet 在调用线程上排序，分块的开销比排序本身大 */
+static const uint32_t PARALLEL_SORT_THRESHOLD = 8192;
+static const uint32_t RADIX_BUCKETS = 256;
+
+RenderQueue::RenderQueue(RenderDriver* driver, JobSystem* jobSystem) : driver(driver), jobSystem(jobSystem)
+{
+    /* do nothing... */
+}
+
+RenderQueue::~RenderQueue()
+{
+    /* do nothing... */
+}
+
+void RenderQueue::Reset()
+{
+    packets.clear();
+    pushConstants.clear();
+    pushConstantData.clear();
+    entries.clear();
+    sorted = VK_FALSE;
+
+    if (pipelineIdsExhausted) {
+        pipelineIds.clear();
+        freePipelineIds.clear();
+        nextPipelineId = 0;
+        pipelineIdGeneration++;
+        pipelineIdsExhausted = VK_FALSE;
+    }
+
+    statistics = {};
+    statistics.pipelineIdGeneration = pipelineIdGeneration;
+}
+
+void RenderQueue::ReleasePipeline(Pipeline pipeline)
+{
+    auto it = pipelineIds.find(pipeline);
+    if (it == pipelineIds.end())
+        return;
+
+    freePipelineIds.push_back(it->second);
+    pipelineIds.erase(it);
+}
+
+void RenderQueue::Submit(const DrawPacket& packet, VkShaderStageFlags pushConstantStages, uint32_t pushConstantSize, const void* pPushConstants)
+{
+    const uint32_t index = static_cast<uint32_t>(packets.size());
+    const uint64_t key = MakeSortKey(packet.pass, _GetPipelineId(packet.pipeline), packet.material, packet.depth, packet.backToFront);
+
+    packets.push_back(packet);
+    entries.push_back({ key, index });
+
+    PushConstantRange range = { pushConstantStages, static_cast<uint32_t>(pushConstantData.size()), pushConstantSize };
+    if (pushConstantSize > 0) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(pPushConstants);
+        pushConstantData.insert(pushConstantData.end(), bytes, bytes + pushConstantSize);
+    }
+    pushConstants.push_back(range);
+
+    statistics.packetCount++;
+    sorted = VK_FALSE;
+}
+
+void RenderQueue::Sort()
+{
+    QK_PROFILE_ZONE("RenderQueue::Sort");
+
+    uint64_t begin = Profiler::Now();
+    _RadixSort();
+    statistics.sortTime += Profiler::Now() - begin;
+
+    sorted = VK_TRUE;
+}
+
+void RenderQueue::Execute(VkCommandBuffer commandBuffer, uint32_t pass)
+{
+    QK_PROFILE_ZONE("RenderQueue::Execute");
+
+    if (!sorted) {
+        printf("[vulkan] render queue executed before Sort\n");
+        return;
+    }
+
+    uint64_t begin = Profiler::Now();
+
+    /* 键的最高位是 pass，排序后同一 pass 的 packet 连续 */
+    const uint32_t passShift = 64 - QK_RENDER_QUEUE_PASS_BITS;
+    auto first = std::lower_bound(entries.begin(), entries.end(), static_cast<uint64_t>(pass) << passShift,
+                                  [](const SortEntry& entry, uint64_t key) { return entry.key < key; });
+    auto last = first;
+    while (last != entries.end() && (last->key >> passShift) == pass)
+        ++last;
+
+    if (first == last)
+        return;
+
+    const VolkDeviceTable& table = driver->GetDeviceTable();
+
+    driver->CmdSetViewportScissor(commandBuffer);
+    statistics.dynamicStateSets += 2;
+
+    Pipeline boundPipeline = VK_NULL_HANDLE;
+    VkPipelineLayout boundLayout = VK_NULL_HANDLE;
+    VkDescriptorSet boundSet = VK_NULL_HANDLE;
+    uint32_t boundOffsetCount = 0;
+    uint32_t boundOffsets[QK_RENDER_QUEUE_MAX_DYNAMIC_OFFSETS] = {};
+    VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+    VkDeviceSize boundVertexOffset = 0;
+    VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+    const PushConstantRange* boundPushConstants = VK_NULL_HANDLE;
+
+    for (auto it = first; it != last; ++it) {
+        const DrawPacket& packet = packets[it->index];
+        const PushConstantRange& range = pushConstants[it->index];
+
+        if (packet.pipeline != boundPipeline) {
+            table.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, RenderDriver::GetVkPipeline(packet.pipeline));
+            boundPipeline = packet.pipeline;
+            statistics.pipelineBinds++;
+
+            /* 布局不同时不再假设描述符集和 push constant 仍然有效 */
+            VkPipelineLayout layout = RenderDriver::GetVkPipelineLayout(packet.pipeline);
+            if (layout != boundLayout) {
+                boundLayout = layout;
+                boundSet = VK_NULL_HANDLE;
+                boundPushConstants = VK_NULL_HANDLE;
+            }
+        } else {
+            statistics.elidedCommands++;
+        }
+
+        if (packet.descriptorSet != VK_NULL_HANDLE) {
+            const uint32_t offsetCount = std::min<uint32_t>(packet.dynamicOffsetCount, QK_RENDER_QUEUE_MAX_DYNAMIC_OFFSETS);
+
+            if (packet.descriptorSet != boundSet || offsetCount != boundOffsetCount ||
+                memcmp(packet.dynamicOffsets, boundOffsets, offsetCount * sizeof(uint32_t)) != 0) {
+                table.vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, boundLayout, 0, 1,
+                                              &packet.descriptorSet, offsetCount, packet.dynamicOffsets);
+                boundSet = packet.descriptorSet;
+                boundOffsetCount = offsetCount;
+                memcpy(boundOffsets, packet.dynamicOffsets, offsetCount * sizeof(uint32_t));
+                statistics.descriptorSetBinds++;
+            } else {
+                statistics.elidedCommands++;
+            }
+        }
+
+        if (packet.vertexBuffer != VK_NULL_HANDLE) {
+            VkBuffer vertexBuffer = RenderDriver::GetVkBuffer(packet.vertexBuffer);
+
+            if (vertexBuffer != boundVertexBuffer || packet.vertexOffset != boundVertexOffset) {
+                table.vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &packet.vertexOffset);
+                boundVertexBuffer = vertexBuffer;
+                boundVertexOffset = packet.vertexOffset;
+                statistics.vertexBufferBinds++;
+            } else {
+                statistics.elidedCommands++;
+            }
+        }
+
+        if (packet.indexBuffer != VK_NULL_HANDLE) {
+            VkBuffer indexBuffer = RenderDriver::GetVkBuffer(packet.indexBuffer);
+
+            if (indexBuffer != boundIndexBuffer) {
+                table.vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+                boundIndexBuffer = indexBuffer;
+                statistics.indexBufferBinds++;
+            } else {
+                statistics.elidedCommands++;
+            }
+        }
+
+        if (range.size > 0) {
+            const uint8_t* data = pushConstantData.data() + range.offset;
+
+            if (boundPushConstants == VK_NULL_HANDLE || boundPushConstants->size != range.size ||
+                boundPushConstants->stageFlags != range.stageFlags ||
+                memcmp(pushConstantData.data() + boundPushConstants->offset, data, range.size) != 0) {
+                table.vkCmdPushConstants(commandBuffer, boundLayout, range.stageFlags, 0, range.size, data);
+                boundPushConstants = &range;
+                statistics.pushConstantWrites++;
+            } else {
+                statistics.elidedCommands++;
+            }
+        }
+
+        if (packet.indirectBuffer != VK_NULL_HANDLE) {
+            driver->CmdDrawIndirect(commandBuffer, packet.indirectBuffer, packet.indirectOffset, packet.indirectDrawCount);
+        } else if (packet.indexBuffer != VK_NULL_HANDLE) {
+            table.vkCmdDrawIndexed(commandBuffer, packet.indexCount, packet.instanceCount, packet.firstIndex, 0, packet.firstInstance);
+        } else {
+            table.vkCmdDraw(commandBuffer, packet.vertexCount, packet.instanceCount, packet.firstVertex, packet.firstInstance);
+        }
+    }
+
+    statistics.recordTime += Profiler::Now() - begin;
+}
+
+uint64_t RenderQueue::MakeSortKey(uint32_t pass, uint32_t pipelineId, uint32_t material, float depth, VkBool32 backToFront)
+{
+    const uint32_t materialShift = 32;
+    const uint32_t pipelineShift = materialShift + QK_RENDER_QUEUE_MATERIAL_BITS;
+    const uint32_t passShift = pipelineShift + QK_RENDER_QUEUE_PIPELINE_BITS;
+
+    /* 负数的位模式不单调，相机后面的物体按 0 处理 */
+    uint32_t depthBits = 0;
+    if (depth > 0.0f)
+        memcpy(&depthBits, &depth, sizeof(depthBits));
+
+    if (backToFront)
+        depthBits = ~depthBits;
+
+    return (static_cast<uint64_t>(pass & ((1u << QK_RENDER_QUEUE_PASS_BITS) - 1)) << passShift)
+         | (static_cast<uint64_t>(pipelineId & ((1u << QK_RENDER_QUEUE_PIPELINE_BITS) - 1)) << pipelineShift)
+         | (static_cast<uint64_t>(material & ((1u << QK_RENDER_QUEUE_MATERIAL_BITS) - 1)) << materialShift)
+         | depthBits;
+}
+
+uint32_t RenderQueue::_GetPipelineId(Pipeline pipeline)
+{
+    auto it = pipelineIds.find(pipeline);
+    if (it != pipelineIds.end())
+        return it->second;
+
+    const uint32_t maxPipelineId = (1u << QK_RENDER_QUEUE_PIPELINE_BITS) - 1;
+
+    uint32_t id;
+    if (!freePipelineIds.empty()) {
+        id = freePipelineIds.back();
+        freePipelineIds.pop_back();
+    } else if (nextPipelineId <= maxPipelineId) {
+        id = nextPipelineId++;
+    } else {
+        /* 本帧已经提交的键不能改，先共用最后一个编号，只影响合批效果；不记录映射，下一代重新分配 */
+        pipelineIdsExhausted = VK_TRUE;
+        return maxPipelineId;
+    }
+
+    pipelineIds.emplace(pipeline, id);
+
+    return id;
+}
+
+void RenderQueue::_RadixSort()
+{
+    const uint32_t count = static_cast<uint32_t>(entries.size());
+    if (count < 2)
+        return;
+
+    /* 分块并行：每块独立统计直方图，按 (数字, 块) 的顺序做前缀和，分发时保持稳定 */
+    uint32_t chunkCount = 1;
+    if (jobSystem != VK_NULL_HANDLE && count >= PARALLEL_SORT_THRESHOLD)
+        chunkCount = std::min(jobSystem->GetWorkerCount() * 4, count / (PARALLEL_SORT_THRESHOLD / 4));
+    chunkCount = std::max(chunkCount, 1u);
+
+    const uint32_t chunkSize = (count + chunkCount - 1) / chunkCount;
+
+    scratch.resize(count);
+    std::vector<uint32_t> histograms(static_cast<size_t>(chunkCount) * RADIX_BUCKETS);
+
+    SortEntry* src = entries.data();
+    SortEntry* dst = scratch.data();
+
+    auto forEachChunk = [&](const auto& func) {
+        if (chunkCount == 1) {
+            func(0u);
+            return;
+        }
+        jobSystem->ParallelFor(chunkCount, 1, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t chunk = begin; chunk < end; chunk++)
+                func(chunk);
+        });
+    };
+
+    for (uint32_t shift = 0; shift < 64; shift += 8) {
+        std::fill(histograms.begin(), histograms.end(), 0);
+
+        forEachChunk([&](uint32_t chunk) {
+            uint32_t* histogram = histograms.data() + chunk * RADIX_BUCKETS;
+            const uint32_t end = std::min(count, (chunk + 1) * chunkSize);
+            for (uint32_t i = chunk * chunkSize; i < end; i++)
+                histogram[(src[i].key >> shift) & 0xFF]++;
+        });
+
+        /* 所有键在这个字节上相同时跳过这一趟，pass 和 pipeline 的高位通常如此 */
+        uint32_t offset = 0;
+        bool uniform = false;
+        for (uint32_t digit = 0; digit < RADIX_BUCKETS && !uniform; digit++) {
+            uint32_t total = 0;
+            for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+                total += histograms[chunk * RADIX_BUCKETS + digit];
+            uniform = total == count;
+        }
+
+        if (uniform)
+            continue;
+
+        for (uint32_t digit = 0; digit < RADIX_BUCKETS; digit++) {
+            for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+                uint32_t& slot = histograms[chunk * RADIX_BUCKETS + digit];
+                uint32_t n = slot;
+                slot = offset;
+                offset += n;
+            }
+        }
+
+        forEachChunk([&](uint32_t chunk) {
+            uint32_t* histogram = histograms.data() + chunk * RADIX_BUCKETS;
+            const uint32_t end = std::min(count, (chunk + 1) * chunkSize);
+            for (uint32_t i = chunk * chunkSize; i < end; i++)
+                dst[histogram[(src[i].key >> shift) & 0xFF]++] = src[i];
+        });
+
+        std::swap(src, dst);
+        statistics.sortPasses++;
+    }
+
+    if (src != entries.data())
+        entries.swap(scratch);
+}
@@ -0,0 +1,143 @@
+#ifndef RENDER_QUEUE_H_
+#define RENDER_QUEUE_H_
+
+#include "driver/render_driver.h"
+#include "core/job/job_system.h"
+
+// std
+#include <unordered_map>
+#include <vector>
+
+#define QK_RENDER_QUEUE_MAX_DYNAMIC_OFFSETS 4
+
+/*
+ * 64 位排序键，从高到低：
+ *   pass     4 位   同一队列中的多个 pass 依次执行
+ *   pipeline 12 位  提交时按 Pipeline 首次出现的顺序编号，ReleasePipeline 归还的编号优先复用
+ *   material 16 位  调用方给出，相同材质的描述符集和顶点缓冲排在一起
+ *   depth    32 位  非负浮点的位模式单调，由近到远；backToFront 时取反
+ */
+#define QK_RENDER_QUEUE_PASS_BITS       4
+#define QK_RENDER_QUEUE_PIPELINE_BITS   12
+#define QK_RENDER_QUEUE_MATERIAL_BITS   16
+
+struct DrawPacket
+{
+    uint32_t pass;
+    uint32_t material;
+    float depth;                                // 到相机的距离，只用于排序
+    VkBool32 backToFront;                       // 半透明物体由远到近
+
+    Pipeline pipeline;
+    VkDescriptorSet descriptorSet;              // set 0，可以为 VK_NULL_HANDLE
+    uint32_t dynamicOffsetCount;
+    uint32_t dynamicOffsets[QK_RENDER_QUEUE_MAX_DYNAMIC_OFFSETS];
+    Buffer vertexBuffer;                        // binding 0，可以为 VK_NULL_HANDLE
+    VkDeviceSize vertexOffset;
+
+    /* indirectBuffer 不为空时按 CmdDrawIndirect 执行，vertexCount 等字段被忽略 */
+    Buffer indirectBuffer;
+    VkDeviceSize indirectOffset;
+    uint32_t indirectDrawCount;
+
+    /* indexBuffer 不为空时按 uint32 索引执行 CmdDrawIndexed，使用 indexCount 和 firstIndex */
+    Buffer indexBuffer;
+    uint32_t indexCount;
+    uint32_t firstIndex;
+
+    uint32_t vertexCount;
+    uint32_t instanceCount;
+    uint32_t firstVertex;
+    uint32_t firstInstance;
+};
+
+struct RenderQueueStatistics
+{
+    uint32_t packetCount;
+    uint32_t pipelineBinds;
+    uint32_t descriptorSetBinds;
+    uint32_t vertexBufferBinds;
+    uint32_t indexBufferBinds;
+    uint32_t pushConstantWrites;
+    uint32_t dynamicStateSets;
+    uint32_t elidedCommands;                    // 因为与当前状态相同而跳过的绑定
+    uint32_t sortPasses;                        // 实际执行的基数排序趟数，键相同的字节会跳过
+    uint32_t pipelineIdGeneration;              // 编号用完后整体重新分配的次数
+    uint64_t sortTime;                          // 纳秒
+    uint64_t recordTime;
+};
+
+/**
+ * 延迟提交的渲染队列。
+ *
+ * Submit 只记录 draw packet 和排序键，Sort 按键做 8 趟 8 位的 LSD 基数排序，
+ * 设置了 JobSystem 且 packet 足够多时每一趟的直方图和分发在工作线程上并行。
+ * Execute 按排序后的顺序录制，和当前命令缓冲状态相同的 pipeline、描述符集、
+ * 顶点缓冲、索引缓冲和 push constant 直接跳过，viewport 和 scissor 每次 Execute 只设置一次。
+ *
+ * Submit 不是线程安全的；每帧 Reset，Execute 需要在 CmdBeginRendering 之后调用。
+ */
+class RenderQueue
+{
+public:
+    RenderQueue(RenderDriver* driver, JobSystem* jobSystem = VK_NULL_HANDLE);
+   ~RenderQueue();
+
+    void Reset();
+
+    /* push constant 写入 offset 0，size 为 0 表示不需要 */
+    void Submit(const DrawPacket& packet, VkShaderStageFlags pushConstantStages = 0, uint32_t pushConstantSize = 0, const void* pPushConstants = VK_NULL_HANDLE);
+
+    void Sort();
+
+    /* 录制指定 pass 的所有 packet，需要先 Sort */
+    void Execute(VkCommandBuffer commandBuffer, uint32_t pass);
+
+    void GetStatistics(RenderQueueStatistics* pStatistics) const { *pStatistics = statistics; }
+
+    /* 销毁 Pipeline 之前调用，删除映射并归还编号，避免之后复用相同地址的 Pipeline 沿用旧编号 */
+    void ReleasePipeline(Pipeline pipeline);
+
+    static uint64_t MakeSortKey(uint32_t pass, uint32_t pipelineId, uint32_t material, float depth, VkBool32 backToFront);
+
+private:
+    struct SortEntry
+    {
+        uint64_t key;
+        uint32_t index;
+    };
+
+    struct PushConstantRange
+    {
+        VkShaderStageFlags stageFlags;
+        uint32_t offset;                        // pushConstantData 中的偏移
+        uint32_t size;
+    };
+
+    uint32_t _GetPipelineId(Pipeline pipeline);
+    void _RadixSort();
+
+    RenderDriver* driver = VK_NULL_HANDLE;
+    JobSystem* jobSystem = VK_NULL_HANDLE;
+
+    std::vector<DrawPacket> packets;
+    std::vector<PushConstantRange> pushConstants;
+    std::vector<uint8_t> pushConstantData;
+    std::vector<SortEntry> entries;
+    std::vector<SortEntry> scratch;
+    VkBool32 sorted = VK_FALSE;
+
+    /*
+     * Pipeline 到排序键中编号的映射，跨帧保持稳定。编号用完时当前帧剩余的 Pipeline
+     * 共用最后一个编号，下一次 Reset 进入新的一代，清空映射后从 0 重新分配
+     */
+    std::unordered_map<Pipeline, uint32_t> pipelineIds;
+    std::vector<uint32_t> freePipelineIds;
+    uint32_t nextPipelineId = 0;
+    uint32_t pipelineIdGeneration = 0;
+    VkBool32 pipelineIdsExhausted = VK_FALSE;
+
+    RenderQueueStatistics statistics = {};
+};
+
+#endif /* RENDER_QUEUE_H_ */
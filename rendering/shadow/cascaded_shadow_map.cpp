@@ -0,0 +1,274 @@
+#include "cascaded_shadow_map.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#include "core/profiler/profiler.h"
+#include "driver/vkutils.h"
+
+/* 两张图集和遮挡物管线共用的深度格式，所有设备都支持作为附件和采样 */
+static const VkFormat SHADOW_FORMAT = VK_FORMAT_D32_SFLOAT;
+
+CascadedShadowMap::CascadedShadowMap(RenderDriver* driver) : driver(driver)
+{
+    /* do nothing... */
+}
+
+CascadedShadowMap::~CascadedShadowMap()
+{
+    if (staticAtlas != VK_NULL_HANDLE)
+        driver->DestroyTexture2D(staticAtlas);
+
+    if (shadowAtlas != VK_NULL_HANDLE)
+        driver->DestroyTexture2D(shadowAtlas);
+
+    if (uniformBuffer != VK_NULL_HANDLE)
+        driver->DestroyBuffer(uniformBuffer);
+
+    if (sampler != VK_NULL_HANDLE)
+        driver->DestroySampler(sampler);
+}
+
+VkResult CascadedShadowMap::Initialize(const CascadedShadowMapCreateInfo& createInfo)
+{
+    VkResult err;
+
+    info = createInfo;
+    info.cascadeCount = std::clamp<uint32_t>(info.cascadeCount, 1, QK_SHADOW_MAX_CASCADES);
+
+    /* 级联按 2 列排列 */
+    const uint32_t columns = info.cascadeCount > 1 ? 2 : 1;
+    const uint32_t rows = (info.cascadeCount + columns - 1) / columns;
+    atlasWidth = columns * info.resolution;
+    atlasHeight = rows * info.resolution;
+
+    for (uint32_t i = 0; i < info.cascadeCount; i++) {
+        cascades[i].rect.offset = { static_cast<int32_t>((i % columns) * info.resolution), static_cast<int32_t>((i / columns) * info.resolution) };
+        cascades[i].rect.extent = { info.resolution, info.resolution };
+        cascades[i].valid = VK_FALSE;
+    }
+
+    err = driver->CreateTexture2D(atlasWidth, atlasHeight, SHADOW_FORMAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, &staticAtlas);
+    VK_CHECK_ERROR(err);
+
+    err = driver->CreateTexture2D(atlasWidth, atlasHeight, SHADOW_FORMAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, &shadowAtlas);
+    VK_CHECK_ERROR(err);
+
+    err = driver->CreateBuffer(sizeof(ShadowUniformData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, &uniformBuffer);
+    VK_CHECK_ERROR(err);
+
+    err = driver->CreateComparisonSampler(VK_COMPARE_OP_LESS_OR_EQUAL, &sampler);
+    VK_CHECK_ERROR(err);
+
+    SetLightDirection(glm::value_ptr(lightDirection));
+
+    statistics.cascadeCount = info.cascadeCount;
+
+    return VK_SUCCESS;
+}
+
+void CascadedShadowMap::SetLightDirection(const float* direction)
+{
+    lightDirection = glm::normalize(glm::vec3(direction[0], direction[1], direction[2]));
+
+    /* 光源空间的朝向固定，相机移动时投影只平移 */
+    glm::vec3 up = fabsf(lightDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    lightView = glm::lookAt(glm::vec3(0.0f), -lightDirection, up);
+
+    staticDirty = VK_TRUE;
+}
+
+void CascadedShadowMap::CmdUpdate(VkCommandBuffer commandBuffer, const Camera& camera, PFN_ShadowCasterCallback callback, void* pUserData)
+{
+    QK_PROFILE_FUNCTION();
+
+    const uint32_t cascadeCount = info.cascadeCount;
+    const float nearDepth = camera.GetNear();
+    const float farDepth = std::min(camera.GetFar(), info.maxDistance);
+
+    /* 包围球只取决于分段和视场，相机旋转时半径不变 */
+    const float tanHalfFov = tanf(glm::radians(camera.GetFov()) * 0.5f);
+    const float k2 = tanHalfFov * tanHalfFov * (1.0f + camera.GetAspectRatio() * camera.GetAspectRatio());
+    const glm::vec3 direction = glm::normalize(camera.GetDirection());
+
+    VkBool32 refit[QK_SHADOW_MAX_CASCADES] = {};
+    VkBool32 update[QK_SHADOW_MAX_CASCADES] = {};
+    uint32_t staticCount = 0;
+    uint32_t dynamicCount = 0;
+
+    float sliceNear = nearDepth;
+    for (uint32_t i = 0; i < cascadeCount; i++) {
+        float p = static_cast<float>(i + 1) / cascadeCount;
+        float logSplit = nearDepth * powf(farDepth / nearDepth, p);
+        float uniformSplit = nearDepth + (farDepth - nearDepth) * p;
+        float sliceFar = info.splitLambda * logSplit + (1.0f - info.splitLambda) * uniformSplit;
+        splitDepths[i] = sliceFar;
+
+        /* 视锥切片的最小包围球，中心在视线上与近、远四角等距的位置 */
+        float d = std::min(0.5f * (sliceNear + sliceFar) * (1.0f + k2), sliceFar);
+        float radius = sqrtf((sliceFar - d) * (sliceFar - d) + sliceFar * sliceFar * k2);
+        radius = ceilf(radius * 16.0f) / 16.0f;
+
+        refit[i] = _FitCascade(i, camera.GetPosition() + direction * d, radius);
+
+        uint32_t interval = std::max<uint32_t>(info.updateIntervals[i], 1);
+        update[i] = refit[i] || (frameCounter + i) % interval == 0;
+
+        staticCount += refit[i] ? 1 : 0;
+        dynamicCount += update[i] ? 1 : 0;
+        sliceNear = sliceFar;
+    }
+
+    staticDirty = VK_FALSE;
+    frameCounter++;
+
+    /* 接收端数据每帧更新，视图空间到图集的变换随相机变化 */
+    const float width = static_cast<float>(atlasWidth);
+    const float height = static_cast<float>(atlasHeight);
+    const glm::mat4 inverseView = glm::inverse(camera.GetViewMatrix());
+    const glm::mat4& projection = camera.GetProjectionMatrix();
+
+    ShadowUniformData data = {};
+    for (uint32_t i = 0; i < cascadeCount; i++) {
+        const VkRect2D& rect = cascades[i].rect;
+        glm::vec2 scale(rect.extent.width / width, rect.extent.height / height);
+        glm::vec2 offset(rect.offset.x / width, rect.offset.y / height);
+
+        /* NDC xy -> 级联在图集中的 uv，深度不变 */
+        glm::mat4 atlasTransform = glm::translate(glm::mat4(1.0f), glm::vec3(offset + 0.5f * scale, 0.0f)) *
+                                   glm::scale(glm::mat4(1.0f), glm::vec3(0.5f * scale, 1.0f));
+        glm::mat4 viewToShadow = atlasTransform * cascades[i].viewProjection * inverseView;
+        memcpy(data.viewToShadow[i], glm::value_ptr(viewToShadow), sizeof(data.viewToShadow[i]));
+
+        data.uvClamp[i][0] = offset.x + 1.0f / width;
+        data.uvClamp[i][1] = offset.y + 1.0f / height;
+        data.uvClamp[i][2] = offset.x + scale.x - 1.0f / width;
+        data.uvClamp[i][3] = offset.y + scale.y - 1.0f / height;
+        data.splitDepths[i] = splitDepths[i];
+    }
+
+    data.projectionScale[0] = 1.0f / projection[0][0];
+    data.projectionScale[1] = 1.0f / projection[1][1];
+    data.projectionScale[2] = 1.0f / width;
+    data.projectionScale[3] = 1.0f / height;
+    data.lightDirection[0] = lightDirection.x;
+    data.lightDirection[1] = lightDirection.y;
+    data.lightDirection[2] = lightDirection.z;
+    data.lightDirection[3] = static_cast<float>(cascadeCount);
+
+    driver->CmdMemoryBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+    driver->CmdUpdateBuffer(commandBuffer, uniformBuffer, 0, sizeof(data), &data);
+    driver->CmdMemoryBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                             VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_UNIFORM_READ_BIT);
+
+    const VkPipelineStageFlags depthStages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    const VkAccessFlags depthAccess = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    /* 静态深度只在级联重新拟合时渲染，其余时间作为拷贝源保留 */
+    if (staticCount > 0) {
+        driver->CmdTextureMemoryBarrier(commandBuffer, staticAtlas, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_FALSE,
+                                        VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                                        depthStages, depthAccess);
+
+        _CmdRenderCascades(commandBuffer, refit, VK_TRUE, callback, pUserData);
+
+        driver->CmdTextureMemoryBarrier(commandBuffer, staticAtlas, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_FALSE,
+                                        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                                        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    }
+
+    /* 静态深度拷贝到采样图集，动态遮挡物在其上深度测试绘制；不更新的级联保留上次的结果 */
+    if (dynamicCount > 0) {
+        driver->CmdTextureMemoryBarrier(commandBuffer, shadowAtlas, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_FALSE,
+                                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                                        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+        for (uint32_t i = 0; i < cascadeCount; i++) {
+            if (update[i])
+                driver->CmdCopyTexture2D(commandBuffer, staticAtlas, shadowAtlas, cascades[i].rect);
+        }
+
+        driver->CmdTextureMemoryBarrier(commandBuffer, shadowAtlas, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_FALSE,
+                                        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                                        depthStages, depthAccess);
+
+        _CmdRenderCascades(commandBuffer, update, VK_FALSE, callback, pUserData);
+
+        driver->CmdTextureMemoryBarrier(commandBuffer, shadowAtlas, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_FALSE,
+                                        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    }
+
+    statistics.staticRenders = staticCount;
+    statistics.dynamicRenders = dynamicCount;
+    statistics.totalStaticRenders += staticCount;
+    statistics.totalDynamicRenders += dynamicCount;
+}
+
+void CascadedShadowMap::WriteDescriptor(VkDescriptorSet descriptorSet, uint32_t binding) const
+{
+    driver->WriteDescriptorTexture(descriptorSet, binding + 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, shadowAtlas, sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    driver->WriteDescriptorBuffer(descriptorSet, binding + 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniformBuffer, 0, sizeof(ShadowUniformData));
+}
+
+void CascadedShadowMap::FillCasterPipelineInfo(GraphicsPipelineCreateInfo* pCreateInfo)
+{
+    pCreateInfo->depthOnly = VK_TRUE;
+    pCreateInfo->depthFormat = SHADOW_FORMAT;
+    pCreateInfo->cullMode = VK_CULL_MODE_NONE;
+    pCreateInfo->depthWriteEnable = VK_TRUE;
+    pCreateInfo->blendMode = PIPELINE_BLEND_MODE_OPAQUE;
+    pCreateInfo->depthBiasConstant = 1.25f;
+    pCreateInfo->depthBiasSlope = 1.75f;
+}
+
+VkBool32 CascadedShadowMap::_FitCascade(uint32_t index, const glm::vec3& sphereCenter, float radius)
+{
+    Cascade& cascade = cascades[index];
+    const glm::vec3 center = glm::vec3(lightView * glm::vec4(sphereCenter, 1.0f));
+
+    /* 包围球仍在上次的范围内时投影不变，缓存的静态深度继续有效 */
+    if (cascade.valid && !staticDirty && radius == cascade.fitRadius) {
+        glm::vec3 distance = glm::abs(center - cascade.center) + radius;
+        if (distance.x <= cascade.halfExtent && distance.y <= cascade.halfExtent && distance.z <= cascade.halfExtent)
+            return VK_FALSE;
+    }
+
+    /* 中心对齐到 texel，重新拟合前后静态遮挡物的光栅化位置一致 */
+    const float halfExtent = radius * (1.0f + info.guardBand);
+    const float texelSize = 2.0f * halfExtent / info.resolution;
+
+    cascade.center = glm::vec3(floorf(center.x / texelSize) * texelSize, floorf(center.y / texelSize) * texelSize, center.z);
+    cascade.halfExtent = halfExtent;
+    cascade.fitRadius = radius;
+    cascade.valid = VK_TRUE;
+
+    /* 光源空间看向 -z，靠近光源的一侧多延伸 casterDistance */
+    glm::mat4 projection = glm::orthoRH_ZO(cascade.center.x - halfExtent, cascade.center.x + halfExtent,
+                                           cascade.center.y - halfExtent, cascade.center.y + halfExtent,
+                                           -(cascade.center.z + halfExtent + info.casterDistance),
+                                           -(cascade.center.z - halfExtent));
+    cascade.viewProjection = projection * lightView;
+
+    return VK_TRUE;
+}
+
+void CascadedShadowMap::_CmdRenderCascades(VkCommandBuffer commandBuffer, const VkBool32* pUpdate, VkBool32 staticCasters,
+                                           PFN_ShadowCasterCallback callback, void* pUserData)
+{
+    Texture2D target = staticCasters ? staticAtlas : shadowAtlas;
+
+    for (uint32_t i = 0; i < info.cascadeCount; i++) {
+        if (!pUpdate[i])
+            continue;
+
+        /* 静态深度从清除开始，动态遮挡物叠加在拷贝过来的静态深度上 */
+        driver->CmdBeginDepthRendering(commandBuffer, target, cascades[i].rect, staticCasters);
+        callback(commandBuffer, i, glm::value_ptr(cascades[i].viewProjection), staticCasters, pUserData);
+        driver->CmdEndDepthRendering(commandBuffer);
+    }
+}
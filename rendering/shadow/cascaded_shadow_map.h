@@ -0,0 +1,119 @@
+#ifndef CASCADED_SHADOW_MAP_H_
+#define CASCADED_SHADOW_MAP_H_
+
+#include "driver/render_driver.h"
+#include "rendering/camera/camera.h"
+
+/* 与 qk_shadow.glsl 中的 QK_SHADOW_MAX_CASCADES 保持一致 */
+#define QK_SHADOW_MAX_CASCADES 4
+
+/* std140，与 qk_shadow.glsl 中的 ShadowData 保持一致 */
+struct ShadowUniformData
+{
+    float viewToShadow[QK_SHADOW_MAX_CASCADES][16];
+    float uvClamp[QK_SHADOW_MAX_CASCADES][4];
+    float splitDepths[4];
+    float projectionScale[4];
+    float lightDirection[4];
+};
+
+struct CascadedShadowMapCreateInfo
+{
+    uint32_t cascadeCount = QK_SHADOW_MAX_CASCADES;
+    uint32_t resolution = 1024;                 // 每个级联的边长，级联按 2 列排在一张图集中
+    float maxDistance = 40.0f;                  // 阴影覆盖的最远视深
+    float splitLambda = 0.75f;                  // 对数分割与均匀分割的混合比例
+    float guardBand = 0.25f;                    // 级联范围向外扩展的比例，相机在其中移动时复用缓存的静态深度
+    float casterDistance = 50.0f;               // 沿光源方向向后延伸，包含视锥外的遮挡物
+    uint32_t updateIntervals[QK_SHADOW_MAX_CASCADES] = { 1, 1, 2, 4 };  // 动态遮挡物每隔几帧重新渲染
+};
+
+struct CascadedShadowStatistics
+{
+    uint32_t cascadeCount;
+    uint32_t staticRenders;                     // 最近一帧重新渲染静态深度的级联数量
+    uint32_t dynamicRenders;                    // 最近一帧合成动态遮挡物的级联数量
+    uint64_t totalStaticRenders;
+    uint64_t totalDynamicRenders;
+};
+
+/*
+ * 遮挡物绘制回调，在级联的区域内调用。staticCasters 为真时只绘制静态遮挡物，否则只绘制
+ * 动态遮挡物。viewProjection 为列主序的 4x4 矩阵，管线使用 FillCasterPipelineInfo 创建。
+ */
+typedef void (*PFN_ShadowCasterCallback)(VkCommandBuffer commandBuffer, uint32_t cascade, const float* viewProjection,
+                                         VkBool32 staticCasters, void* pUserData);
+
+/**
+ * 缓存的级联阴影。
+ *
+ * 相机视锥在 maxDistance 内按混合对数分割为若干段，每段用包围球拟合一个光源空间的
+ * 正交投影。投影的范围按 guardBand 放大并对齐到 texel，只要包围球仍在范围内就保持
+ * 不变，因此静态遮挡物的深度可以缓存在单独的图集中，只在相机移出范围、光源方向改变
+ * 或 InvalidateStatic 之后重新渲染。
+ *
+ * 动态遮挡物每次更新时先把缓存的静态深度拷贝到采样用的图集，再在其上深度测试绘制。
+ * 远处的级联按 updateIntervals 降低更新频率，错开在不同帧中进行。
+ */
+class CascadedShadowMap
+{
+public:
+    CascadedShadowMap(RenderDriver* driver);
+   ~CascadedShadowMap();
+
+    VkResult Initialize(const CascadedShadowMapCreateInfo& createInfo);
+
+    /* direction 指向光源，改变时所有级联的静态深度失效 */
+    void SetLightDirection(const float* direction);
+
+    /* 静态遮挡物增删或移动后调用 */
+    void InvalidateStatic() { staticDirty = VK_TRUE; }
+
+    /* 在 CmdBeginRendering 之前调用 */
+    void CmdUpdate(VkCommandBuffer commandBuffer, const Camera& camera, PFN_ShadowCasterCallback callback, void* pUserData);
+
+    /* binding 为 sampler2DShadow，binding+1 为 ShadowData UBO，与 qk_shadow.glsl 相同 */
+    void WriteDescriptor(VkDescriptorSet descriptorSet, uint32_t binding) const;
+
+    /* 纯深度、不剔除、带斜率深度偏移的遮挡物管线 */
+    static void FillCasterPipelineInfo(GraphicsPipelineCreateInfo* pCreateInfo);
+
+    void GetStatistics(CascadedShadowStatistics* pStatistics) const { *pStatistics = statistics; }
+
+private:
+    struct Cascade
+    {
+        glm::vec3 center;                       // 光源空间中投影范围的中心
+        float halfExtent;
+        float fitRadius;                        // 拟合时的包围球半径
+        glm::mat4 viewProjection;
+        VkRect2D rect;
+        VkBool32 valid;
+    };
+
+    VkBool32 _FitCascade(uint32_t index, const glm::vec3& sphereCenter, float radius);
+    void _CmdRenderCascades(VkCommandBuffer commandBuffer, const VkBool32* pUpdate, VkBool32 staticCasters,
+                            PFN_ShadowCasterCallback callback, void* pUserData);
+
+    RenderDriver* driver = VK_NULL_HANDLE;
+    CascadedShadowMapCreateInfo info = {};
+
+    Texture2D staticAtlas = VK_NULL_HANDLE;
+    Texture2D shadowAtlas = VK_NULL_HANDLE;
+    Buffer uniformBuffer = VK_NULL_HANDLE;
+    VkSampler sampler = VK_NULL_HANDLE;
+    uint32_t atlasWidth = 0;
+    uint32_t atlasHeight = 0;
+
+    glm::vec3 lightDirection = glm::normalize(glm::vec3(0.5f, 0.8f, 0.3f));
+    glm::mat4 lightView = glm::mat4(1.0f);
+    VkBool32 staticDirty = VK_TRUE;
+
+    Cascade cascades[QK_SHADOW_MAX_CASCADES] = {};
+    float splitDepths[QK_SHADOW_MAX_CASCADES] = {};
+    uint64_t frameCounter = 0;
+
+    CascadedShadowStatistics statistics = {};
+};
+
+#endif /* CASCADED_SHADOW_MAP_H_ */
@@ -0,0 +1,295 @@
+#include "transient_pool.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "core/profiler/profiler.h"
+#include "driver/vkutils.h"
+
+/* 内容只在 tile 上存在的附件用途 */
+static const VkImageUsageFlags TRANSIENT_ATTACHMENT_USAGE = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                                                            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                                                            VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+
+static VkDeviceSize _AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static bool _IsSameDeclaration(const TransientTextureDesc& a, const TransientTextureDesc& b)
+{
+    return a.width == b.width && a.height == b.height && a.layers == b.layers && a.format == b.format && a.usage == b.usage;
+}
+
+TransientResourcePool::TransientResourcePool(RenderDriver* driver) : driver(driver)
+{
+    /* do nothing... */
+}
+
+TransientResourcePool::~TransientResourcePool()
+{
+    _Destroy();
+}
+
+void TransientResourcePool::BeginFrame()
+{
+    declarations.clear();
+}
+
+TransientTexture TransientResourcePool::Declare(const TransientTextureDesc& desc)
+{
+    declarations.push_back({ desc, UINT32_MAX, 0 });
+    return (TransientTexture) (declarations.size() - 1);
+}
+
+void TransientResourcePool::Use(TransientTexture texture, uint32_t pass)
+{
+    Declaration& declaration = declarations[texture];
+    declaration.firstPass = std::min(declaration.firstPass, pass);
+    declaration.lastPass = std::max(declaration.lastPass, pass);
+}
+
+VkResult TransientResourcePool::Compile()
+{
+    QK_PROFILE_FUNCTION();
+
+    VkResult err;
+
+    /* 声明了但没有 Use 的纹理按整帧存活处理 */
+    for (Declaration& declaration : declarations) {
+        if (declaration.firstPass > declaration.lastPass) {
+            declaration.firstPass = 0;
+            declaration.lastPass = UINT32_MAX;
+        }
+    }
+
+    bool unchanged = declarations.size() == compiledDeclarations.size();
+    for (size_t i = 0; unchanged && i < declarations.size(); i++) {
+        const Declaration& a = declarations[i];
+        const Declaration& b = compiledDeclarations[i];
+        unchanged = _IsSameDeclaration(a.desc, b.desc) && a.firstPass == b.firstPass && a.lastPass == b.lastPass;
+    }
+
+    if (unchanged)
+        return VK_SUCCESS;
+
+    /* 旧资源可能还在飞行中的帧里使用 */
+    if (!resources.empty())
+        driver->DeviceWaitIdle();
+
+    _Destroy();
+
+    lazyMemorySupported = driver->HasLazilyAllocatedMemory();
+
+    resources.resize(declarations.size());
+
+    statistics.textureCount = (uint32_t) resources.size();
+    statistics.lazyCount = 0;
+    statistics.aliasedCount = 0;
+    statistics.requestedBytes = 0;
+    statistics.allocatedBytes = 0;
+
+    for (size_t i = 0; i < resources.size(); i++) {
+        const TransientTextureDesc& desc = declarations[i].desc;
+        Resource& resource = resources[i];
+
+        VkImageUsageFlags usage = desc.usage;
+        if (_IsLazyCandidate(desc))
+            usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+
+        err = driver->CreateUnboundTexture2DArray(desc.width, desc.height, std::max(desc.layers, 1u), desc.format, usage, &resource.texture);
+        VK_CHECK_ERROR(err);
+
+        driver->GetTexture2DMemoryRequirements(resource.texture, &resource.requirements);
+        statistics.requestedBytes += resource.requirements.size;
+    }
+
+    /*
+     * 按大小从大到小放置，每个纹理在内存类型兼容的第一个堆中取最低的可用偏移：
+     * 只需要避开生命周期与它重叠的纹理占用的范围。
+     */
+    std::vector<uint32_t> order(resources.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+        return resources[a].requirements.size > resources[b].requirements.size;
+    });
+
+    for (uint32_t index : order) {
+        Resource& resource = resources[index];
+
+        if (_IsLazyCandidate(declarations[index].desc)) {
+            err = driver->AllocateMemory(resource.requirements, VK_TRUE, &resource.lazyAllocation);
+            if (err == VK_SUCCESS) {
+                statistics.lazyCount++;
+                continue;
+            }
+
+            /* 没有兼容的 lazy 内存类型，退回到普通显存参与别名 */
+            resource.lazyAllocation = VK_NULL_HANDLE;
+        }
+
+        uint32_t heapIndex = UINT32_MAX;
+        for (uint32_t i = 0; i < heaps.size(); i++) {
+            if (heaps[i].memoryTypeBits & resource.requirements.memoryTypeBits) {
+                heapIndex = i;
+                break;
+            }
+        }
+
+        if (heapIndex == UINT32_MAX) {
+            heaps.push_back({ resource.requirements.memoryTypeBits, 1, 0, {}, VK_NULL_HANDLE });
+            heapIndex = (uint32_t) heaps.size() - 1;
+        }
+
+        Heap& heap = heaps[heapIndex];
+        resource.heap = heapIndex;
+        resource.offset = _FindOffset(heap, index);
+
+        heap.memoryTypeBits &= resource.requirements.memoryTypeBits;
+        heap.alignment = std::max(heap.alignment, resource.requirements.alignment);
+        heap.size = std::max(heap.size, resource.offset + resource.requirements.size);
+        heap.members.push_back(index);
+    }
+
+    for (Heap& heap : heaps) {
+        VkMemoryRequirements requirements = {};
+        requirements.size = heap.size;
+        requirements.alignment = heap.alignment;
+        requirements.memoryTypeBits = heap.memoryTypeBits;
+
+        err = driver->AllocateMemory(requirements, VK_FALSE, &heap.allocation);
+        VK_CHECK_ERROR(err);
+
+        statistics.allocatedBytes += heap.size;
+    }
+
+    for (size_t i = 0; i < resources.size(); i++) {
+        Resource& resource = resources[i];
+
+        if (resource.lazyAllocation != VK_NULL_HANDLE) {
+            err = driver->BindTexture2DMemory(resource.texture, resource.lazyAllocation, 0);
+        } else {
+            err = driver->BindTexture2DMemory(resource.texture, heaps[resource.heap].allocation, resource.offset);
+        }
+        VK_CHECK_ERROR(err);
+
+        if (resource.heap == UINT32_MAX)
+            continue;
+
+        for (uint32_t other : heaps[resource.heap].members) {
+            const Resource& o = resources[other];
+            if (other != i && resource.offset < o.offset + o.requirements.size && o.offset < resource.offset + resource.requirements.size) {
+                statistics.aliasedCount++;
+                break;
+            }
+        }
+    }
+
+    /* 全部成功后才记录，失败时下一帧会重新分配 */
+    compiledDeclarations = declarations;
+
+    statistics.heapCount = (uint32_t) heaps.size();
+    statistics.compileCount++;
+
+    printf("[vulkan] transient pool compiled: %u textures, %u heaps, %llu KB allocated / %llu KB requested, %u aliased, %u lazy\n",
+           statistics.textureCount, statistics.heapCount,
+           (unsigned long long) (statistics.allocatedBytes >> 10), (unsigned long long) (statistics.requestedBytes >> 10),
+           statistics.aliasedCount, statistics.lazyCount);
+
+    return VK_SUCCESS;
+}
+
+void TransientResourcePool::CmdAcquire(VkCommandBuffer commandBuffer, TransientTexture texture, VkImageLayout layout)
+{
+    VkPipelineStageFlags dstStageMask;
+    VkAccessFlags dstAccessMask;
+
+    switch (layout) {
+        case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+            dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            break;
+        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+            dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+            dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            break;
+        case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+            dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            break;
+        default:
+            dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+            dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            break;
+    }
+
+    /* 之前占用这段内存的纹理可能由任意阶段写入，包括上一帧 */
+    driver->CmdTextureMemoryBarrier(commandBuffer, resources[texture].texture, layout, VK_TRUE,
+                                    VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_MEMORY_WRITE_BIT,
+                                    dstStageMask, dstAccessMask);
+}
+
+VkBool32 TransientResourcePool::_IsLazyCandidate(const TransientTextureDesc& desc) const
+{
+    return lazyMemorySupported && (desc.usage & TRANSIENT_ATTACHMENT_USAGE) && !(desc.usage & ~TRANSIENT_ATTACHMENT_USAGE);
+}
+
+VkBool32 TransientResourcePool::_IsOverlapping(uint32_t a, uint32_t b) const
+{
+    const Declaration& x = declarations[a];
+    const Declaration& y = declarations[b];
+    return x.firstPass <= y.lastPass && y.firstPass <= x.lastPass;
+}
+
+VkDeviceSize TransientResourcePool::_FindOffset(const Heap& heap, uint32_t index) const
+{
+    const VkMemoryRequirements& requirements = resources[index].requirements;
+
+    /* 候选偏移：堆首以及每个冲突纹理的末尾 */
+    std::vector<VkDeviceSize> candidates = { 0 };
+    for (uint32_t member : heap.members) {
+        if (_IsOverlapping(index, member)) {
+            const Resource& m = resources[member];
+            candidates.push_back(_AlignUp(m.offset + m.requirements.size, requirements.alignment));
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end());
+
+    for (VkDeviceSize offset : candidates) {
+        bool fits = true;
+        for (uint32_t member : heap.members) {
+            const Resource& m = resources[member];
+            if (_IsOverlapping(index, member) && offset < m.offset + m.requirements.size && m.offset < offset + requirements.size) {
+                fits = false;
+                break;
+            }
+        }
+
+        if (fits)
+            return offset;
+    }
+
+    /* 最后一个候选在所有冲突纹理之后，不会走到这里 */
+    return candidates.back();
+}
+
+void TransientResourcePool::_Destroy()
+{
+    for (Resource& resource : resources) {
+        if (resource.texture != VK_NULL_HANDLE)
+            driver->DestroyTexture2D(resource.texture);
+
+        if (resource.lazyAllocation != VK_NULL_HANDLE)
+            driver->FreeMemory(resource.lazyAllocation);
+    }
+
+    for (Heap& heap : heaps) {
+        if (heap.allocation != VK_NULL_HANDLE)
+            driver->FreeMemory(heap.allocation);
+    }
+
+    resources.clear();
+    heaps.clear();
+    compiledDeclarations.clear();
+}
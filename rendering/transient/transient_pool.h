@@ -0,0 +1,110 @@
+#ifndef TRANSIENT_POOL_H_
+#define TRANSIENT_POOL_H_
+
+#include "driver/render_driver.h"
+
+// std
+#include <vector>
+
+typedef uint32_t TransientTexture;
+
+#define QK_TRANSIENT_TEXTURE_NONE UINT32_MAX
+
+struct TransientTextureDesc
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t layers = 1;                        // 大于 1 时为 2D 数组纹理，例如多视图渲染的附件
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkImageUsageFlags usage = 0;                // 只有附件用途时可以放到 LAZILY_ALLOCATED 内存上
+    const char* name = "";
+};
+
+struct TransientPoolStatistics
+{
+    uint32_t textureCount;
+    uint32_t heapCount;
+    uint32_t aliasedCount;                      // 与其它纹理共享了内存范围的纹理数量
+    uint32_t lazyCount;                         // 放在 LAZILY_ALLOCATED 内存上的纹理数量
+    VkDeviceSize requestedBytes;                // 不做别名时需要的显存
+    VkDeviceSize allocatedBytes;                // 实际分配的显存，不含 lazy 分配
+    uint32_t compileCount;                      // 重新分配的次数，声明不变时应当保持不变
+};
+
+/**
+ * 帧内中间纹理（深度、G-buffer、后处理链）的瞬态资源池。
+ *
+ * 每帧 BeginFrame 之后按 pass 顺序 Declare 和 Use，Compile 根据每个纹理被使用的
+ * 第一个和最后一个 pass 计算生命周期，生命周期不重叠的纹理绑定到同一个 VmaAllocation
+ * 的重叠范围上。只作为附件使用、内容不会离开 tile 的纹理在设备支持时使用
+ * LAZILY_ALLOCATED 内存，每个单独分配，不参与别名。
+ *
+ * 声明和生命周期与上一次 Compile 完全一致时直接复用，只有分辨率或 pass 结构变化时
+ * 才会等待设备空闲并重新分配。共享内存的纹理内容不保留，每次使用前需要 CmdAcquire
+ * 丢弃旧内容并等待之前占用这段内存的写入完成。
+ */
+class TransientResourcePool
+{
+public:
+    TransientResourcePool(RenderDriver* driver);
+   ~TransientResourcePool();
+
+    void BeginFrame();
+
+    TransientTexture Declare(const TransientTextureDesc& desc);
+
+    /* 标记纹理在第 pass 个 pass 中被读或写，pass 编号由调用方按执行顺序给出 */
+    void Use(TransientTexture texture, uint32_t pass);
+
+    VkResult Compile();
+
+    Texture2D GetTexture(TransientTexture texture) const { return resources[texture].texture; }
+
+    /* 第一次使用前调用，丢弃旧内容并转换到 layout */
+    void CmdAcquire(VkCommandBuffer commandBuffer, TransientTexture texture, VkImageLayout layout);
+
+    void GetStatistics(TransientPoolStatistics* pStatistics) const { *pStatistics = statistics; }
+
+private:
+    struct Declaration
+    {
+        TransientTextureDesc desc;
+        uint32_t firstPass;
+        uint32_t lastPass;
+    };
+
+    struct Resource
+    {
+        Texture2D texture = VK_NULL_HANDLE;
+        VkMemoryRequirements requirements = {};
+        uint32_t heap = UINT32_MAX;             // UINT32_MAX 表示单独的 lazy 分配
+        VkDeviceSize offset = 0;
+        VmaAllocation lazyAllocation = VK_NULL_HANDLE;
+    };
+
+    struct Heap
+    {
+        uint32_t memoryTypeBits;
+        VkDeviceSize alignment;
+        VkDeviceSize size;
+        std::vector<uint32_t> members;
+        VmaAllocation allocation;
+    };
+
+    VkBool32 _IsLazyCandidate(const TransientTextureDesc& desc) const;
+    VkBool32 _IsOverlapping(uint32_t a, uint32_t b) const;
+    VkDeviceSize _FindOffset(const Heap& heap, uint32_t index) const;
+    void _Destroy();
+
+    RenderDriver* driver = VK_NULL_HANDLE;
+    VkBool32 lazyMemorySupported = VK_FALSE;
+
+    std::vector<Declaration> declarations;
+    std::vector<Declaration> compiledDeclarations;
+    std::vector<Resource> resources;
+    std::vector<Heap> heaps;
+
+    TransientPoolStatistics statistics = {};
+};
+
+#endif /* TRANSIENT_POOL_H_ */
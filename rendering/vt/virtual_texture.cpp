@@ -0,0 +1,448 @@
+#include "virtual_texture.h"
+
+#include <algorithm>
+#include <functional>
+#include <string.h>
+
+#include "driver/vkutils.h"
+
+VirtualTexture::VirtualTexture(RenderDriver* driver) : driver(driver)
+{
+    /* do nothing... */
+}
+
+VirtualTexture::~VirtualTexture()
+{
+    if (loaderThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(loaderMutex);
+            loaderExit = true;
+        }
+        loaderCondition.notify_all();
+        loaderThread.join();
+    }
+
+    for (Buffer buffer : stagingBuffers)
+        driver->DestroyBuffer(buffer);
+
+    for (Buffer buffer : feedbackReadbackBuffers)
+        driver->DestroyBuffer(buffer);
+
+    if (feedbackBuffer != VK_NULL_HANDLE)
+        driver->DestroyBuffer(feedbackBuffer);
+
+    if (paramsBuffer != VK_NULL_HANDLE)
+        driver->DestroyBuffer(paramsBuffer);
+
+    if (atlasSampler != VK_NULL_HANDLE)
+        driver->DestroySampler(atlasSampler);
+
+    if (pageTableSampler != VK_NULL_HANDLE)
+        driver->DestroySampler(pageTableSampler);
+
+    if (physicalAtlas != VK_NULL_HANDLE)
+        driver->DestroyTexture2D(physicalAtlas);
+
+    if (pageTable != VK_NULL_HANDLE)
+        driver->DestroyTexture2D(pageTable);
+}
+
+VkResult VirtualTexture::Initialize(const VirtualTextureCreateInfo& createInfo)
+{
+    VkResult err;
+
+    info = createInfo;
+
+    /* 页坐标在 key 中占 12 位，物理页坐标在页表中占 8 位 */
+    if (info.pageProvider == VK_NULL_HANDLE ||
+        info.pageCountX == 0 || info.pageCountX > 4096 || (info.pageCountX & (info.pageCountX - 1)) != 0 ||
+        info.pageCountY == 0 || info.pageCountY > 4096 || (info.pageCountY & (info.pageCountY - 1)) != 0 ||
+        info.atlasPageCountX == 0 || info.atlasPageCountX > 256 ||
+        info.atlasPageCountY == 0 || info.atlasPageCountY > 256) {
+        printf("[vulkan] invalid virtual texture create info\n");
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    feedbackEnabled = driver->HasFragmentStoresAndAtomics();
+    if (!feedbackEnabled)
+        printf("[vulkan] fragmentStoresAndAtomics unsupported, virtual texture feedback disabled\n");
+
+    mipCount = std::min(VkUtils::MipLevelCount(std::min(info.pageCountX, info.pageCountY), 1), 16u);
+    physicalPageSize = info.pageSize + info.border * 2;
+
+    feedbackCount = 0;
+    mipOffsets.resize(mipCount);
+    for (uint32_t mip = 0; mip < mipCount; mip++) {
+        mipOffsets[mip] = feedbackCount;
+        feedbackCount += (info.pageCountX >> mip) * (info.pageCountY >> mip);
+    }
+
+    pageTableEntries.assign(feedbackCount, 0);
+
+    err = driver->CreateTexture2D(info.pageCountX, info.pageCountY, mipCount, VK_FORMAT_R8G8B8A8_UINT,
+                                  VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, &pageTable);
+    VK_CHECK_ERROR(err);
+
+    err = driver->CreateTexture2D(info.atlasPageCountX * physicalPageSize, info.atlasPageCountY * physicalPageSize,
+                                  VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, &physicalAtlas);
+    VK_CHECK_ERROR(err);
+
+    err = driver->CreateSampler(VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, &pageTableSampler);
+    VK_CHECK_ERROR(err);
+
+    err = driver->CreateSampler(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, &atlasSampler);
+    VK_CHECK_ERROR(err);
+
+    VirtualTextureParams params = {};
+    params.pageCount[0] = info.pageCountX;
+    params.pageCount[1] = info.pageCountY;
+    params.mipCount = mipCount;
+    params.pageSize = info.pageSize;
+    params.atlasPageCount[0] = static_cast<float>(info.atlasPageCountX);
+    params.atlasPageCount[1] = static_cast<float>(info.atlasPageCountY);
+    params.physicalPageSize = static_cast<float>(physicalPageSize);
+    params.border = static_cast<float>(info.border);
+    for (uint32_t mip = 0; mip < mipCount; mip++)
+        params.feedbackOffsets[mip][0] = mipOffsets[mip];
+
+    err = driver->CreateBuffer(sizeof(VirtualTextureParams), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, &paramsBuffer);
+    VK_CHECK_ERROR(err);
+    driver->WriteBuffer(paramsBuffer, sizeof(VirtualTextureParams), &params);
+
+    const VkDeviceSize feedbackSize = feedbackCount * sizeof(uint32_t);
+
+    err = driver->CreateBuffer(feedbackSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, &feedbackBuffer);
+    VK_CHECK_ERROR(err);
+
+    /* 每个 in-flight 帧一份读回缓冲和 staging 缓冲，CPU 只访问 fence 已经完成的那一份 */
+    const uint32_t frameCount = driver->GetMaxFramesInFlight();
+    stagingSize = static_cast<VkDeviceSize>(info.maxUploadsPerFrame) * physicalPageSize * physicalPageSize * 4 + feedbackSize;
+
+    feedbackReadbackBuffers.resize(frameCount, VK_NULL_HANDLE);
+    stagingBuffers.resize(frameCount, VK_NULL_HANDLE);
+    feedbackWritten.resize(frameCount, VK_FALSE);
+
+    for (uint32_t i = 0; i < frameCount; i++) {
+        err = driver->CreateBuffer(feedbackSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU, &feedbackReadbackBuffers[i]);
+        VK_CHECK_ERROR(err);
+
+        err = driver->CreateBuffer(stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &stagingBuffers[i]);
+        VK_CHECK_ERROR(err);
+    }
+
+    const uint32_t slotCount = info.atlasPageCountX * info.atlasPageCountY;
+    slots.assign(slotCount, { UINT32_MAX, 0 });
+    freeSlots.resize(slotCount);
+    for (uint32_t i = 0; i < slotCount; i++)
+        freeSlots[i] = slotCount - 1 - i;
+
+    /* 最粗的 mip 同步加载，保证任何位置都有可回退的页 */
+    for (uint32_t y = 0; y < (info.pageCountY >> (mipCount - 1)); y++) {
+        for (uint32_t x = 0; x < (info.pageCountX >> (mipCount - 1)); x++) {
+            LoadedPage page = { _MakeKey(mipCount - 1, x, y), {} };
+            if (!_LoadPage(page.key, page.pixels)) {
+                printf("[vulkan] virtual texture failed to load root page (%u, %u)\n", x, y);
+                return VK_ERROR_INITIALIZATION_FAILED;
+            }
+            pendingPages.insert(page.key);
+            loadedPages.push_back(std::move(page));
+        }
+    }
+
+    loaderThread = std::thread(&VirtualTexture::_LoaderThread, this);
+
+    return VK_SUCCESS;
+}
+
+void VirtualTexture::CmdUpdate(VkCommandBuffer commandBuffer)
+{
+    const uint32_t flightIndex = driver->GetFlightIndex();
+
+    if (feedbackEnabled && feedbackWritten[flightIndex])
+        _ProcessFeedback();
+
+    std::vector<LoadedPage> uploads;
+    {
+        std::lock_guard<std::mutex> lock(loaderMutex);
+        const size_t count = std::min<size_t>(loadedPages.size(), info.maxUploadsPerFrame);
+        uploads.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            pendingPages.erase(loadedPages[i].key);
+            uploads.push_back(std::move(loadedPages[i]));
+        }
+        loadedPages.erase(loadedPages.begin(), loadedPages.begin() + count);
+    }
+
+    statistics.uploadedPages = 0;
+
+    if (!layoutInitialized) {
+        driver->CmdTextureMemoryBarrier(commandBuffer, pageTable, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        driver->CmdTextureMemoryBarrier(commandBuffer, physicalAtlas, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        driver->CmdFillBuffer(commandBuffer, feedbackBuffer, 0, VK_WHOLE_SIZE, 0);
+        driver->CmdMemoryBarrier(commandBuffer,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                                 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+        pageTableDirty = VK_TRUE;
+    } else {
+        if (uploads.empty() && !pageTableDirty)
+            return;
+
+        driver->CmdTextureMemoryBarrier(commandBuffer, pageTable, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        driver->CmdTextureMemoryBarrier(commandBuffer, physicalAtlas, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    }
+
+    Buffer staging = stagingBuffers[flightIndex];
+    uint8_t* mapped = static_cast<uint8_t*>(driver->MapBuffer(staging));
+    VkDeviceSize stagingOffset = 0;
+
+    const VkDeviceSize pageBytes = static_cast<VkDeviceSize>(physicalPageSize) * physicalPageSize * 4;
+
+    for (LoadedPage& page : uploads) {
+        if (residentPages.count(page.key))
+            continue;
+
+        uint32_t slot = _AllocateSlot();
+        if (slot == UINT32_MAX)
+            break;
+
+        memcpy(mapped + stagingOffset, page.pixels.data(), pageBytes);
+
+        const uint32_t slotX = slot % info.atlasPageCountX;
+        const uint32_t slotY = slot / info.atlasPageCountX;
+        driver->CmdCopyBufferToTexture2D(commandBuffer, staging, stagingOffset, physicalAtlas, 0,
+                                         slotX * physicalPageSize, slotY * physicalPageSize,
+                                         physicalPageSize, physicalPageSize);
+        stagingOffset += pageBytes;
+
+        /* 根页固定驻留，不参与 LRU */
+        slots[slot].key = page.key;
+        slots[slot].lastUsedFrame = _KeyMip(page.key) == mipCount - 1 ? UINT64_MAX : driver->GetFrameNumber();
+        residentPages[page.key] = slot;
+        pageTableDirty = VK_TRUE;
+        statistics.uploadedPages++;
+    }
+
+    if (pageTableDirty) {
+        _RebuildPageTable();
+        memcpy(mapped + stagingOffset, pageTableEntries.data(), pageTableEntries.size() * sizeof(uint32_t));
+
+        for (uint32_t mip = 0; mip < mipCount; mip++) {
+            driver->CmdCopyBufferToTexture2D(commandBuffer, staging, stagingOffset + mipOffsets[mip] * sizeof(uint32_t),
+                                             pageTable, mip, 0, 0, info.pageCountX >> mip, info.pageCountY >> mip);
+        }
+
+        pageTableDirty = VK_FALSE;
+    }
+
+    driver->UnmapBuffer(staging);
+
+    driver->CmdTextureMemoryBarrier(commandBuffer, pageTable, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    driver->CmdTextureMemoryBarrier(commandBuffer, physicalAtlas, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    layoutInitialized = VK_TRUE;
+}
+
+void VirtualTexture::CmdResolveFeedback(VkCommandBuffer commandBuffer)
+{
+    if (!feedbackEnabled)
+        return;
+
+    const uint32_t flightIndex = driver->GetFlightIndex();
+    const VkDeviceSize feedbackSize = feedbackCount * sizeof(uint32_t);
+
+    driver->CmdMemoryBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+
+    driver->CmdCopyBuffer(commandBuffer, feedbackBuffer, 0, feedbackReadbackBuffers[flightIndex], 0, feedbackSize);
+
+    driver->CmdMemoryBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+    /* 清零供下一帧写入 */
+    driver->CmdFillBuffer(commandBuffer, feedbackBuffer, 0, feedbackSize, 0);
+
+    driver->CmdMemoryBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                             VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                             VK_ACCESS_HOST_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    feedbackWritten[flightIndex] = VK_TRUE;
+}
+
+void VirtualTexture::WriteDescriptorSet(VkDescriptorSet descriptorSet, uint32_t binding)
+{
+    driver->WriteDescriptorTexture(descriptorSet, binding + 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, pageTable, pageTableSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    driver->WriteDescriptorTexture(descriptorSet, binding + 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, physicalAtlas, atlasSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    driver->WriteDescriptorBuffer(descriptorSet, binding + 2, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, paramsBuffer, 0, sizeof(VirtualTextureParams));
+    driver->WriteDescriptorBuffer(descriptorSet, binding + 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, feedbackBuffer, 0, feedbackCount * sizeof(uint32_t));
+}
+
+void VirtualTexture::GetDescriptorSetLayoutBindings(uint32_t binding, VkShaderStageFlags stageFlags, VkDescriptorSetLayoutBinding* pBindings)
+{
+    const VkDescriptorType types[4] = {
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    };
+
+    for (uint32_t i = 0; i < ARRAY_SIZE(types); i++)
+        pBindings[i] = { binding + i, types[i], 1, stageFlags, VK_NULL_HANDLE };
+}
+
+void VirtualTexture::GetStatistics(VirtualTextureStatistics* pStatistics) const
+{
+    *pStatistics = statistics;
+    pStatistics->residentPages = static_cast<uint32_t>(residentPages.size());
+}
+
+void VirtualTexture::_LoaderThread()
+{
+    std::vector<uint8_t> pixels;
+
+    while (true) {
+        uint32_t key;
+        {
+            std::unique_lock<std::mutex> lock(loaderMutex);
+            loaderCondition.wait(lock, [this] { return loaderExit || !requestQueue.empty(); });
+
+            if (loaderExit)
+                return;
+
+            key = requestQueue.front();
+            requestQueue.pop_front();
+        }
+
+        bool loaded = _LoadPage(key, pixels);
+
+        std::lock_guard<std::mutex> lock(loaderMutex);
+        if (loaded) {
+            loadedPages.push_back({ key, std::move(pixels) });
+            pixels = {};
+        } else {
+            /* 允许之后重新请求 */
+            pendingPages.erase(key);
+        }
+    }
+}
+
+bool VirtualTexture::_LoadPage(uint32_t key, std::vector<uint8_t>& pixels)
+{
+    pixels.resize(static_cast<size_t>(physicalPageSize) * physicalPageSize * 4);
+    return info.pageProvider(_KeyMip(key), _KeyX(key), _KeyY(key), info.pageSize, info.border, pixels.data(), info.pUserData);
+}
+
+void VirtualTexture::_ProcessFeedback()
+{
+    const uint64_t frame = driver->GetFrameNumber();
+    Buffer readback = feedbackReadbackBuffers[driver->GetFlightIndex()];
+    const uint32_t* requested = static_cast<const uint32_t*>(driver->MapBuffer(readback));
+
+    std::vector<uint32_t> missing;
+    statistics.requestedPages = 0;
+
+    for (uint32_t mip = 0; mip < mipCount; mip++) {
+        const uint32_t w = info.pageCountX >> mip;
+        const uint32_t h = info.pageCountY >> mip;
+        const uint32_t* level = requested + mipOffsets[mip];
+
+        for (uint32_t y = 0; y < h; y++) {
+            for (uint32_t x = 0; x < w; x++) {
+                if (level[y * w + x] == 0)
+                    continue;
+
+                statistics.requestedPages++;
+
+                /* 自身及回退用的父级页都标记为最近使用，缺失的加入请求 */
+                for (uint32_t m = mip; m < mipCount; m++) {
+                    uint32_t key = _MakeKey(m, x >> (m - mip), y >> (m - mip));
+                    auto it = residentPages.find(key);
+                    if (it != residentPages.end()) {
+                        if (slots[it->second].lastUsedFrame != UINT64_MAX)
+                            slots[it->second].lastUsedFrame = frame;
+                        break;
+                    }
+                    missing.push_back(key);
+                }
+            }
+        }
+    }
+
+    driver->UnmapBuffer(readback);
+
+    /* mip 在 key 的最高位，按 key 降序即先加载粗糙的 mip，尽快得到可用的回退；相同的页相邻，unique 去重 */
+    std::sort(missing.begin(), missing.end(), std::greater<uint32_t>());
+    missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+
+    {
+        std::lock_guard<std::mutex> lock(loaderMutex);
+        for (uint32_t key : missing) {
+            if (pendingPages.size() >= info.maxPendingRequests)
+                break;
+
+            if (pendingPages.insert(key).second)
+                requestQueue.push_back(key);
+        }
+        statistics.pendingPages = static_cast<uint32_t>(pendingPages.size());
+    }
+
+    loaderCondition.notify_one();
+}
+
+uint32_t VirtualTexture::_AllocateSlot()
+{
+    if (!freeSlots.empty()) {
+        uint32_t slot = freeSlots.back();
+        freeSlots.pop_back();
+        return slot;
+    }
+
+    /* 驱逐最久未使用的页，本帧刚被请求过的页不驱逐 */
+    const uint64_t frame = driver->GetFrameNumber();
+    uint32_t victim = UINT32_MAX;
+    uint64_t oldest = frame;
+
+    for (uint32_t i = 0; i < slots.size(); i++) {
+        if (slots[i].lastUsedFrame < oldest) {
+            oldest = slots[i].lastUsedFrame;
+            victim = i;
+        }
+    }
+
+    if (victim == UINT32_MAX)
+        return UINT32_MAX;
+
+    residentPages.erase(slots[victim].key);
+    slots[victim].key = UINT32_MAX;
+    pageTableDirty = VK_TRUE;
+    statistics.evictedPages++;
+
+    return victim;
+}
+
+void VirtualTexture::_RebuildPageTable()
+{
+    /* 从最粗的 mip 往下，未驻留的页继承父级的条目 */
+    for (int32_t mip = static_cast<int32_t>(mipCount) - 1; mip >= 0; mip--) {
+        const uint32_t w = info.pageCountX >> mip;
+        const uint32_t h = info.pageCountY >> mip;
+        uint32_t* level = pageTableEntries.data() + mipOffsets[mip];
+
+        for (uint32_t y = 0; y < h; y++) {
+            for (uint32_t x = 0; x < w; x++) {
+                auto it = residentPages.find(_MakeKey(mip, x, y));
+                if (it != residentPages.end()) {
+                    const uint32_t slotX = it->second % info.atlasPageCountX;
+                    const uint32_t slotY = it->second / info.atlasPageCountX;
+                    level[y * w + x] = slotX | (slotY << 8) | (static_cast<uint32_t>(mip) << 16) | (1u << 24);
+                } else if (mip + 1 < static_cast<int32_t>(mipCount)) {
+                    const uint32_t* parent = pageTableEntries.data() + mipOffsets[mip + 1];
+                    level[y * w + x] = parent[(y >> 1) * (w >> 1) + (x >> 1)];
+                } else {
+                    level[y * w + x] = 0;
+                }
+            }
+        }
+    }
+}
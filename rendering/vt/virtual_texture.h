@@ -0,0 +1,157 @@
+#ifndef VIRTUAL_TEXTURE_H_
+#define VIRTUAL_TEXTURE_H_
+
+#include "driver/render_driver.h"
+
+// std
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+/**
+ * 填充一个物理页，pPixels 为 (pageSize + 2 * border)^2 个 RGBA8 像素。
+ * border 区域需要填入相邻页的像素，保证双线性过滤在页边缘连续。
+ * 在加载线程中调用，返回 false 表示该页暂时不可用，之后会重新请求。
+ */
+typedef bool (*PFN_VirtualTexturePageProvider)(uint32_t mipLevel, uint32_t pageX, uint32_t pageY,
+                                              uint32_t pageSize, uint32_t border, void* pPixels, void* pUserData);
+
+struct VirtualTextureCreateInfo
+{
+    uint32_t pageCountX = 64;                   // 虚拟纹理 mip 0 的页数，需要是 2 的幂
+    uint32_t pageCountY = 64;
+    uint32_t pageSize = 128;                    // 每页有效像素
+    uint32_t border = 4;                        // 每页四周的冗余像素
+    uint32_t atlasPageCountX = 32;              // 物理页缓存大小
+    uint32_t atlasPageCountY = 32;
+    uint32_t maxUploadsPerFrame = 16;           // 每帧最多上传的页数，限制传输带宽
+    uint32_t maxPendingRequests = 256;          // 加载队列上限，超出的请求下一帧再提
+    PFN_VirtualTexturePageProvider pageProvider = VK_NULL_HANDLE;
+    void* pUserData = VK_NULL_HANDLE;
+};
+
+/* std140 布局，与 qk_virtual_texture.glsl 中的 VirtualTextureParams 保持一致 */
+struct VirtualTextureParams
+{
+    uint32_t pageCount[2];
+    uint32_t mipCount;
+    uint32_t pageSize;
+    float atlasPageCount[2];
+    float physicalPageSize;
+    float border;
+    uint32_t feedbackOffsets[16][4];            // 每个 mip 在反馈缓冲中的起始下标，只用 x 分量
+};
+
+struct VirtualTextureStatistics
+{
+    uint32_t residentPages;
+    uint32_t pendingPages;
+    uint32_t requestedPages;                    // 最近一次反馈中请求的页数
+    uint32_t uploadedPages;                     // 最近一帧上传的页数
+    uint32_t evictedPages;                      // 累计驱逐的页数
+};
+
+/**
+ * 软件页表实现的虚拟纹理。
+ *
+ * 主 pass 的片元着色器通过 qk_virtual_texture.glsl 查询页表并采样物理页缓存，
+ * 同时把需要的页写入反馈缓冲。每帧 CPU 读回已经完成的那一帧的反馈，把缺失的页
+ * 交给加载线程，加载完成的页在下一次 CmdUpdate 中通过 staging 缓冲上传。
+ * 未驻留的页在页表中回退到最近的已驻留父级 mip，最粗的 mip 始终驻留。
+ */
+class VirtualTexture
+{
+public:
+    VirtualTexture(RenderDriver* driver);
+   ~VirtualTexture();
+
+    VkResult Initialize(const VirtualTextureCreateInfo& createInfo);
+
+    /* 在主 pass 之前调用：处理反馈、上传页、更新页表 */
+    void CmdUpdate(VkCommandBuffer commandBuffer);
+
+    /* 在主 pass 之后调用：让反馈缓冲对 CPU 可见 */
+    void CmdResolveFeedback(VkCommandBuffer commandBuffer);
+
+    /* 写入 binding, binding+1 (页表, 物理页), binding+2 (参数), binding+3 (反馈) */
+    void WriteDescriptorSet(VkDescriptorSet descriptorSet, uint32_t binding);
+    static void GetDescriptorSetLayoutBindings(uint32_t binding, VkShaderStageFlags stageFlags, VkDescriptorSetLayoutBinding* pBindings);
+
+    void GetStatistics(VirtualTextureStatistics* pStatistics) const;
+
+    /*
+     * 设备不支持 fragmentStoresAndAtomics 时反馈关闭，只有始终驻留的最粗 mip 可用。
+     * 此时片元着色器需要定义 QK_VT_NO_FEEDBACK 编译，不能写反馈缓冲。
+     */
+    VkBool32 IsFeedbackEnabled() const { return feedbackEnabled; }
+
+    Texture2D GetPageTable() const { return pageTable; }
+    Texture2D GetPhysicalAtlas() const { return physicalAtlas; }
+
+private:
+    struct PageSlot
+    {
+        uint32_t key;
+        uint64_t lastUsedFrame;
+    };
+
+    struct LoadedPage
+    {
+        uint32_t key;
+        std::vector<uint8_t> pixels;
+    };
+
+    static uint32_t _MakeKey(uint32_t mipLevel, uint32_t x, uint32_t y) { return (mipLevel << 24) | (y << 12) | x; }
+    static uint32_t _KeyMip(uint32_t key) { return key >> 24; }
+    static uint32_t _KeyY(uint32_t key) { return (key >> 12) & 0xFFF; }
+    static uint32_t _KeyX(uint32_t key) { return key & 0xFFF; }
+
+    void _LoaderThread();
+    bool _LoadPage(uint32_t key, std::vector<uint8_t>& pixels);
+    void _ProcessFeedback();
+    uint32_t _AllocateSlot();
+    void _RebuildPageTable();
+
+    RenderDriver* driver = VK_NULL_HANDLE;
+    VirtualTextureCreateInfo info = {};
+    uint32_t mipCount = 0;
+    uint32_t physicalPageSize = 0;
+    uint32_t feedbackCount = 0;
+    VkBool32 feedbackEnabled = VK_FALSE;
+    std::vector<uint32_t> mipOffsets;
+
+    Texture2D pageTable = VK_NULL_HANDLE;
+    Texture2D physicalAtlas = VK_NULL_HANDLE;
+    VkSampler pageTableSampler = VK_NULL_HANDLE;
+    VkSampler atlasSampler = VK_NULL_HANDLE;
+    Buffer paramsBuffer = VK_NULL_HANDLE;
+    Buffer feedbackBuffer = VK_NULL_HANDLE;
+    std::vector<Buffer> feedbackReadbackBuffers;
+    std::vector<Buffer> stagingBuffers;
+    std::vector<VkBool32> feedbackWritten;
+    VkDeviceSize stagingSize = 0;
+
+    /* 页表的 CPU 镜像，每项 RGBA8: 物理页 x, y, 驻留 mip, 有效标记 */
+    std::vector<uint32_t> pageTableEntries;
+    std::vector<PageSlot> slots;
+    std::vector<uint32_t> freeSlots;
+    std::unordered_map<uint32_t, uint32_t> residentPages;
+    VkBool32 pageTableDirty = VK_FALSE;
+    VkBool32 layoutInitialized = VK_FALSE;
+
+    /* 加载线程 */
+    std::thread loaderThread;
+    std::mutex loaderMutex;
+    std::condition_variable loaderCondition;
+    std::deque<uint32_t> requestQueue;
+    std::unordered_set<uint32_t> pendingPages;
+    std::vector<LoadedPage> loadedPages;
+    bool loaderExit = false;
+
+    VirtualTextureStatistics statistics = {};
+};
+
+#endif /* VIRTUAL_TEXTURE_H_ */
@@ -0,0 +1,109 @@
+/**
+ * -- Clustered Lighting Include File --
+ *
+ * 分簇前向光照。视锥在屏幕上按 grid.xy 划分，深度按指数划分为 grid.z 段，每个簇
+ * 的光源列表由 qk_cluster_cull.comp 生成，片元只遍历自己所在簇的光源。
+ * ClusterData 布局与 rendering/lighting/clustered_lighting.h 中的 ClusterUniformData
+ * 保持一致，QkPointLight 与 PointLight 保持一致。
+ *
+ * 使用方式：
+ *   #extension GL_GOOGLE_include_directive : require
+ *   #include "qk_cluster.glsl"
+ *   vec3 irradiance = QkClusteredLighting(viewPosition, normal);
+ *
+ * QK_CLUSTER_SET / QK_CLUSTER_BINDING 可覆盖，占用 QK_CLUSTER_BINDING 开始的 4 个 binding。
+ * 定义 QK_CLUSTER_CULL 时簇列表可写，供剔除着色器使用。
+ */
+#ifndef QK_CLUSTER_GLSL_
+#define QK_CLUSTER_GLSL_
+
+#ifndef QK_CLUSTER_SET
+#define QK_CLUSTER_SET 0
+#endif
+
+#ifndef QK_CLUSTER_BINDING
+#define QK_CLUSTER_BINDING 0
+#endif
+
+#ifdef QK_CLUSTER_CULL
+#define QK_CLUSTER_ACCESS
+#else
+#define QK_CLUSTER_ACCESS readonly
+#endif
+
+struct QkPointLight {
+    vec4 positionRadius;                        // 世界空间
+    vec4 colorIntensity;
+};
+
+layout(std430, set = QK_CLUSTER_SET, binding = QK_CLUSTER_BINDING + 0) readonly buffer LightBuffer {
+    QkPointLight lights[];
+} qkLights;
+
+layout(std430, set = QK_CLUSTER_SET, binding = QK_CLUSTER_BINDING + 1) QK_CLUSTER_ACCESS buffer ClusterCountBuffer {
+    uint counts[];
+} qkClusterCounts;
+
+/* 每个簇固定 limits.y 个槽位 */
+layout(std430, set = QK_CLUSTER_SET, binding = QK_CLUSTER_BINDING + 2) QK_CLUSTER_ACCESS buffer ClusterIndexBuffer {
+    uint indices[];
+} qkClusterIndices;
+
+layout(std140, set = QK_CLUSTER_SET, binding = QK_CLUSTER_BINDING + 3) uniform ClusterData {
+    mat4 view;
+    mat4 inverseView;
+    vec4 projectionScale;                       // xy = 1 / P[0][0], 1 / P[1][1]，zw = 分簇的近、远视深
+    vec4 sliceParams;                           // slice = log(depth) * x + y
+    uvec4 grid;                                 // xyz = 簇的数量
+    uvec4 limits;                               // x = 光源数量，y = 每个簇最多的光源数量
+} qkCluster;
+
+/* 返回视图空间位置所在的簇，超出分簇范围时返回 0xFFFFFFFF */
+uint QkClusterIndex(vec3 viewPosition)
+{
+    float depth = -viewPosition.z;
+    if (depth > qkCluster.projectionScale.w)
+        return 0xFFFFFFFFu;
+
+    /* 近于分簇近平面的部分归入第 0 段 */
+    int slice = int(floor(log(max(depth, qkCluster.projectionScale.z)) * qkCluster.sliceParams.x + qkCluster.sliceParams.y));
+    vec2 ndc = viewPosition.xy / (max(depth, 1e-4f) * qkCluster.projectionScale.xy);
+    ivec2 tile = ivec2(floor((ndc * 0.5f + 0.5f) * vec2(qkCluster.grid.xy)));
+
+    ivec3 coord = clamp(ivec3(tile, slice), ivec3(0), ivec3(qkCluster.grid.xyz) - 1);
+    return uint(coord.x) + qkCluster.grid.x * (uint(coord.y) + qkCluster.grid.y * uint(coord.z));
+}
+
+#ifndef QK_CLUSTER_CULL
+/* 世界空间法线，返回所在簇中点光源的漫反射辐照度 */
+vec3 QkClusteredLighting(vec3 viewPosition, vec3 normal)
+{
+    uint cluster = QkClusterIndex(viewPosition);
+    if (cluster == 0xFFFFFFFFu)
+        return vec3(0.0f);
+
+    vec3 worldPosition = (qkCluster.inverseView * vec4(viewPosition, 1.0f)).xyz;
+    uint count = qkClusterCounts.counts[cluster];
+    uint first = cluster * qkCluster.limits.y;
+    vec3 irradiance = vec3(0.0f);
+
+    for (uint i = 0u; i < count; i++) {
+        QkPointLight light = qkLights.lights[qkClusterIndices.indices[first + i]];
+
+        vec3 toLight = light.positionRadius.xyz - worldPosition;
+        float distanceSquared = dot(toLight, toLight);
+        float radiusSquared = light.positionRadius.w * light.positionRadius.w;
+        if (distanceSquared >= radiusSquared)
+            continue;
+
+        /* 在半径处平滑衰减到 0 */
+        float falloff = 1.0f - distanceSquared / radiusSquared;
+        float lambert = max(dot(normal, toLight * inversesqrt(max(distanceSquared, 1e-8f))), 0.0f);
+        irradiance += light.colorIntensity.rgb * light.colorIntensity.a * falloff * falloff * lambert;
+    }
+
+    return irradiance;
+}
+#endif
+
+#endif /* QK_CLUSTER_GLSL_ */
@@ -0,0 +1,45 @@
+/**
+ * -- Draw Data Include File --
+ *
+ * 每帧与每个 draw 的数据，来自 RenderDriver 的临时数据环形缓冲，两个 binding 都是
+ * *_DYNAMIC 描述符，绑定时传入 AllocateTransient 返回的 dynamicOffset。
+ * FrameData 布局与 render_driver.h 中的 FrameUniformData 保持一致。
+ *
+ * 使用方式：
+ *   #extension GL_GOOGLE_include_directive : require
+ *   struct DrawData { mat4 model; vec4 color; };
+ *   #define QK_DRAW_DATA_TYPE DrawData
+ *   #include "qk_draw_data.glsl"
+ *
+ * QK_DRAW_SET / QK_DRAW_BINDING 可覆盖，占用 QK_DRAW_BINDING 开始的 2 个 binding。
+ * per-draw 数据按 gl_InstanceIndex 索引，绘制时 firstInstance = draw 序号。
+ */
+#ifndef QK_DRAW_DATA_GLSL_
+#define QK_DRAW_DATA_GLSL_
+
+#ifndef QK_DRAW_SET
+#define QK_DRAW_SET 0
+#endif
+
+#ifndef QK_DRAW_BINDING
+#define QK_DRAW_BINDING 0
+#endif
+
+layout(std140, set = QK_DRAW_SET, binding = QK_DRAW_BINDING + 0) uniform FrameData {
+    mat4 viewProjection;
+    mat4 view;
+    mat4 projection;
+    vec4 cameraPosition;
+    float time;
+    uint frameNumber;
+} qkFrame;
+
+#ifdef QK_DRAW_DATA_TYPE
+layout(std430, set = QK_DRAW_SET, binding = QK_DRAW_BINDING + 1) readonly buffer DrawDataBuffer {
+    QK_DRAW_DATA_TYPE draws[];
+} qkDrawData;
+
+#define QkGetDrawData() qkDrawData.draws[gl_InstanceIndex]
+#endif
+
+#endif /* QK_DRAW_DATA_GLSL_ */
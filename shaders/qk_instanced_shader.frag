@@ -0,0 +1,13 @@
+/**
+ * -- Fragment Shader File --
+ */
+#version 450
+
+layout(location = 0) in vec3 inColor;
+
+layout(location = 0) out vec4 fragColor;
+
+void main()
+{
+    fragColor = vec4(inColor, 1.0f);
+}
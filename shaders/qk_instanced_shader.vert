@@ -0,0 +1,28 @@
+/**
+ * -- Vertex Shader File --
+ *
+ * 变换与颜色来自 per-draw SSBO，不使用 push constant。
+ */
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+struct DrawData {
+    mat4 model;
+    vec4 color;
+};
+
+#define QK_DRAW_DATA_TYPE DrawData
+#include "qk_draw_data.glsl"
+
+layout(location = 0) in vec2 pos;
+layout(location = 1) in vec3 color;
+
+layout(location = 0) out vec3 outColor;
+
+void main()
+{
+    DrawData draw = QkGetDrawData();
+
+    gl_Position = qkFrame.viewProjection * draw.model * vec4(pos, 0.0f, 1.0f);
+    outColor = color * draw.color.rgb;
+}
@@ -0,0 +1,43 @@
+/**
+ * -- Material Include File --
+ *
+ * 材质参数缓冲与特性开关，布局与 rendering/material/material.h 保持一致。
+ * 特性位 i 对应 constant_id = i 的 bool 特化常量，管线编译时关闭的分支被剔除。
+ *
+ * 使用方式：
+ *   #extension GL_GOOGLE_include_directive : require
+ *   #include "qk_material.glsl"
+ *   MaterialParameters material = QkGetMaterial(pc.materialIndex);
+ *
+ * QK_MATERIAL_SET / QK_MATERIAL_BINDING 可覆盖，占用 1 个 binding。
+ */
+#ifndef QK_MATERIAL_GLSL_
+#define QK_MATERIAL_GLSL_
+
+#ifndef QK_MATERIAL_SET
+#define QK_MATERIAL_SET 0
+#endif
+
+#ifndef QK_MATERIAL_BINDING
+#define QK_MATERIAL_BINDING 0
+#endif
+
+layout(constant_id = 0) const bool QK_MATERIAL_VERTEX_COLOR = false;
+layout(constant_id = 1) const bool QK_MATERIAL_EMISSIVE = false;
+layout(constant_id = 2) const bool QK_MATERIAL_ALPHA_TEST = false;
+
+struct MaterialParameters {
+    vec4 baseColor;
+    vec4 emissive;          // rgb = 颜色, a = 强度
+    float alphaCutoff;
+    float _reserved[3];
+    vec4 custom;
+};
+
+layout(std430, set = QK_MATERIAL_SET, binding = QK_MATERIAL_BINDING) readonly buffer MaterialBuffer {
+    MaterialParameters materials[];
+} qkMaterials;
+
+#define QkGetMaterial(index) qkMaterials.materials[index]
+
+#endif /* QK_MATERIAL_GLSL_ */
@@ -0,0 +1,31 @@
+/**
+ * -- Fragment Shader File --
+ */
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "qk_material.glsl"
+
+layout(location = 0) in vec3 inColor;
+
+layout(location = 0) out vec4 fragColor;
+
+layout(push_constant) uniform PushConstants {
+    mat4 mvp;
+    uint materialIndex;
+} pc;
+
+void main()
+{
+    MaterialParameters material = QkGetMaterial(pc.materialIndex);
+
+    vec4 color = material.baseColor * vec4(inColor, 1.0f);
+
+    if (QK_MATERIAL_ALPHA_TEST && color.a < material.alphaCutoff)
+        discard;
+
+    if (QK_MATERIAL_EMISSIVE)
+        color.rgb += material.emissive.rgb * material.emissive.a;
+
+    fragColor = color;
+}
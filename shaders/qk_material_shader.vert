@@ -0,0 +1,25 @@
+/**
+ * -- Vertex Shader File --
+ *
+ * 材质系统的默认着色器，特性由特化常量选择。
+ */
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "qk_material.glsl"
+
+layout(location = 0) in vec2 pos;
+layout(location = 1) in vec3 color;
+
+layout(location = 0) out vec3 outColor;
+
+layout(push_constant) uniform PushConstants {
+    mat4 mvp;
+    uint materialIndex;
+} pc;
+
+void main()
+{
+    gl_Position = pc.mvp * vec4(pos, 0.0f, 1.0f);
+    outColor = QK_MATERIAL_VERTEX_COLOR ? color : vec3(1.0f);
+}
@@ -0,0 +1,9 @@
+/**
+ * -- Fragment Shader File --
+ *
+ * 主体在 qk_mesh_lit_frag.glsl 中。
+ */
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "qk_mesh_lit_frag.glsl"
@@ -0,0 +1,35 @@
+/**
+ * -- Vertex Shader File --
+ *
+ * 完整光照的压缩网格着色器：binding 0 为顶点缓冲，1、2 为级联阴影，3 ~ 6 为分簇点光源，
+ * 7 ~ 10 为虚拟纹理，11、12 为反射探针。
+ */
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "qk_vertex_pulling.glsl"
+
+#define QK_SHADOW_BINDING 1
+#include "qk_shadow.glsl"
+
+layout(push_constant) uniform PushConstants {
+    mat4 mvp;
+    vec4 boundsMin;
+    vec4 boundsExtent;
+} pc;
+
+layout(location = 0) out vec3 outNormal;
+layout(location = 1) out vec2 outUV;
+layout(location = 2) out vec4 outColor;
+layout(location = 3) out vec3 outViewPosition;
+
+void main()
+{
+    uint vertexIndex = uint(gl_VertexIndex);
+
+    gl_Position = pc.mvp * vec4(QkFetchPosition(vertexIndex, pc.boundsMin.xyz, pc.boundsExtent.xyz), 1.0f);
+    outNormal = QkFetchNormal(vertexIndex);
+    outUV = QkFetchUV(vertexIndex);
+    outColor = QkFetchColor(vertexIndex);
+    outViewPosition = QkShadowViewPosition(gl_Position);
+}
@@ -0,0 +1,48 @@
+/**
+ * -- Lit Mesh Fragment Include File --
+ *
+ * qk_mesh_lit 的片元着色器主体：binding 1、2 为级联阴影，3 ~ 6 为分簇点光源，
+ * 7 ~ 10 为虚拟纹理，11、12 为反射探针。qk_mesh_lit.frag 和 qk_mesh_lit_nofeedback.frag 只在是否
+ * 定义 QK_VT_NO_FEEDBACK 上不同。
+ */
+#ifndef QK_MESH_LIT_FRAG_GLSL_
+#define QK_MESH_LIT_FRAG_GLSL_
+
+#define QK_SHADOW_BINDING 1
+#include "qk_shadow.glsl"
+
+#define QK_CLUSTER_BINDING 3
+#include "qk_cluster.glsl"
+
+#define QK_VT_BINDING 7
+#include "qk_virtual_texture.glsl"
+
+#define QK_PROBE_BINDING 11
+#include "qk_reflection_probe.glsl"
+
+layout(location = 0) in vec3 inNormal;
+layout(location = 1) in vec2 inUV;
+layout(location = 2) in vec4 inColor;
+layout(location = 3) in vec3 inViewPosition;
+
+layout(location = 0) out vec4 fragColor;
+
+const float AMBIENT = 0.1f;
+
+void main()
+{
+    vec3 normal = normalize(inNormal);
+
+    float lambert = max(dot(normal, normalize(qkShadow.lightDirection.xyz)), 0.0f);
+    float visibility = QkSampleShadow(inViewPosition);
+    vec3 irradiance = vec3(AMBIENT + 0.5f * lambert * visibility) + QkClusteredLighting(inViewPosition, normal);
+
+    vec3 albedo = inColor.rgb * QkVTSample(inUV).rgb;
+
+    vec3 worldPosition = (qkCluster.inverseView * vec4(inViewPosition, 1.0f)).xyz;
+    vec3 reflection = QkSampleReflectionProbe(worldPosition, normal, qkCluster.inverseView[3].xyz);
+
+    fragColor = vec4(albedo * irradiance + reflection, inColor.a);
+}
+
+#endif /* QK_MESH_LIT_FRAG_GLSL_ */
@@ -0,0 +1,10 @@
+/**
+ * -- Fragment Shader File --
+ *
+ * 设备不支持 fragmentStoresAndAtomics 时 qk_mesh_lit 使用的片元着色器，不写虚拟纹理反馈。
+ */
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#define QK_VT_NO_FEEDBACK
+#include "qk_mesh_lit_frag.glsl"
@@ -0,0 +1,21 @@
+/**
+ * -- Fragment Shader File --
+ */
+#version 450
+
+layout(location = 0) in vec3 inNormal;
+layout(location = 1) in vec2 inUV;
+layout(location = 2) in vec4 inColor;
+
+layout(location = 0) out vec4 fragColor;
+
+const vec3 LIGHT_DIRECTION = vec3(0.3f, 0.9f, 0.3f);
+
+void main()
+{
+    float diffuse = dot(normalize(inNormal), normalize(LIGHT_DIRECTION)) * 0.5f + 0.5f;
+    vec2 cell = floor(inUV * 8.0f);
+    float checker = mod(cell.x + cell.y, 2.0f) * 0.15f + 0.85f;
+
+    fragColor = vec4(inColor.rgb * diffuse * checker, inColor.a);
+}
@@ -0,0 +1,36 @@
+/**
+ * -- Vertex Shader File --
+ *
+ * 多视图的压缩网格着色器：binding 0 为顶点缓冲，1 为 MultiviewData。
+ * 推送常量的 mvp 位置存放模型矩阵，每个视图的 viewProjection 由 gl_ViewIndex 选择。
+ */
+#version 450
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_multiview : require
+
+#include "qk_vertex_pulling.glsl"
+
+#define QK_MULTIVIEW_BINDING 1
+#include "qk_multiview.glsl"
+
+layout(push_constant) uniform PushConstants {
+    mat4 model;
+    vec4 boundsMin;
+    vec4 boundsExtent;
+} pc;
+
+layout(location = 0) out vec3 outNormal;
+layout(location = 1) out vec2 outUV;
+layout(location = 2) out vec4 outColor;
+
+void main()
+{
+    uint vertexIndex = uint(gl_VertexIndex);
+
+    vec4 worldPosition = pc.model * vec4(QkFetchPosition(vertexIndex, pc.boundsMin.xyz, pc.boundsExtent.xyz), 1.0f);
+
+    gl_Position = QkViewProjection() * worldPosition;
+    outNormal = mat3(pc.model) * QkFetchNormal(vertexIndex);
+    outUV = QkFetchUV(vertexIndex);
+    outColor = QkFetchColor(vertexIndex);
+}
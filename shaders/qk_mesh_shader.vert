@@ -0,0 +1,29 @@
+/**
+ * -- Vertex Shader File --
+ *
+ * 压缩网格的默认着色器，顶点由 qk_vertex_pulling.glsl 按布局解码。
+ */
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "qk_vertex_pulling.glsl"
+
+layout(push_constant) uniform PushConstants {
+    mat4 mvp;
+    vec4 boundsMin;
+    vec4 boundsExtent;
+} pc;
+
+layout(location = 0) out vec3 outNormal;
+layout(location = 1) out vec2 outUV;
+layout(location = 2) out vec4 outColor;
+
+void main()
+{
+    uint vertexIndex = uint(gl_VertexIndex);
+
+    gl_Position = pc.mvp * vec4(QkFetchPosition(vertexIndex, pc.boundsMin.xyz, pc.boundsExtent.xyz), 1.0f);
+    outNormal = QkFetchNormal(vertexIndex);
+    outUV = QkFetchUV(vertexIndex);
+    outColor = QkFetchColor(vertexIndex);
+}
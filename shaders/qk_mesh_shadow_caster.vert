@@ -0,0 +1,20 @@
+/**
+ * -- Vertex Shader File --
+ *
+ * 压缩网格的阴影投射，只输出深度，没有片元着色器。mvp 为级联的视图投影乘以模型矩阵。
+ */
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "qk_vertex_pulling.glsl"
+
+layout(push_constant) uniform PushConstants {
+    mat4 mvp;
+    vec4 boundsMin;
+    vec4 boundsExtent;
+} pc;
+
+void main()
+{
+    gl_Position = pc.mvp * vec4(QkFetchPosition(uint(gl_VertexIndex), pc.boundsMin.xyz, pc.boundsExtent.xyz), 1.0f);
+}
@@ -0,0 +1,28 @@
+/**
+ * -- Fragment Shader File --
+ */
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#define QK_SHADOW_BINDING 1
+#include "qk_shadow.glsl"
+
+layout(location = 0) in vec3 inNormal;
+layout(location = 1) in vec2 inUV;
+layout(location = 2) in vec4 inColor;
+layout(location = 3) in vec3 inViewPosition;
+
+layout(location = 0) out vec4 fragColor;
+
+const float AMBIENT = 0.3f;
+
+void main()
+{
+    float lambert = max(dot(normalize(inNormal), normalize(qkShadow.lightDirection.xyz)), 0.0f);
+    float visibility = QkSampleShadow(inViewPosition);
+
+    vec2 cell = floor(inUV * 8.0f);
+    float checker = mod(cell.x + cell.y, 2.0f) * 0.15f + 0.85f;
+
+    fragColor = vec4(inColor.rgb * (AMBIENT + (1.0f - AMBIENT) * lambert * visibility) * checker, inColor.a);
+}
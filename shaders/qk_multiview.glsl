@@ -0,0 +1,50 @@
+/**
+ * -- Multiview Include File --
+ *
+ * 多视图渲染的视图矩阵，数据由 rendering/camera/camera_set.h 中的 CameraSet 通过
+ * WriteDescriptor 写入，MultiviewData 布局与 MultiviewUniformData 保持一致。
+ * 同一次绘制广播到 viewMask 中的每个视图，gl_ViewIndex 为当前视图（数组层）的序号。
+ *
+ * 使用方式：
+ *   #extension GL_GOOGLE_include_directive : require
+ *   #extension GL_EXT_multiview : require
+ *   #include "qk_multiview.glsl"
+ *   gl_Position = QkViewProjection() * worldPosition;
+ *
+ * QK_MULTIVIEW_SET / QK_MULTIVIEW_BINDING 可覆盖，占用 1 个 binding。
+ */
+#ifndef QK_MULTIVIEW_GLSL_
+#define QK_MULTIVIEW_GLSL_
+
+#ifndef QK_MULTIVIEW_SET
+#define QK_MULTIVIEW_SET 0
+#endif
+
+#ifndef QK_MULTIVIEW_BINDING
+#define QK_MULTIVIEW_BINDING 0
+#endif
+
+#define QK_MULTIVIEW_MAX_VIEWS 6
+
+layout(std140, set = QK_MULTIVIEW_SET, binding = QK_MULTIVIEW_BINDING) uniform MultiviewData {
+    mat4 viewProjection[QK_MULTIVIEW_MAX_VIEWS];
+    mat4 view[QK_MULTIVIEW_MAX_VIEWS];
+    vec4 cameraPosition[QK_MULTIVIEW_MAX_VIEWS];     // 世界空间，w 未使用
+} qkViews;
+
+mat4 QkViewProjection()
+{
+    return qkViews.viewProjection[gl_ViewIndex];
+}
+
+mat4 QkViewMatrix()
+{
+    return qkViews.view[gl_ViewIndex];
+}
+
+vec3 QkCameraPosition()
+{
+    return qkViews.cameraPosition[gl_ViewIndex].xyz;
+}
+
+#endif /* QK_MULTIVIEW_GLSL_ */
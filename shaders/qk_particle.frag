@@ -0,0 +1,19 @@
+/**
+ * -- Fragment Shader File --
+ */
+#version 450
+
+layout(location = 0) in vec4 inColor;
+layout(location = 1) in vec2 inCorner;
+
+layout(location = 0) out vec4 fragColor;
+
+void main()
+{
+    /* 圆形软边 */
+    float falloff = 1.0f - dot(inCorner, inCorner);
+    if (falloff <= 0.0f)
+        discard;
+
+    fragColor = vec4(inColor.rgb, inColor.a * falloff);
+}
@@ -0,0 +1,106 @@
+/**
+ * -- Particle Include File --
+ *
+ * GPU 粒子的持久缓冲，布局与 rendering/particles/particle_system.h 保持一致。
+ * 计算着色器共用 binding 0 ~ 6，绘制只用 binding 0 和当前的存活列表。
+ *
+ *   0  粒子池
+ *   1  死亡列表，deadCount 个空闲下标
+ *   2  存活列表 0
+ *   3  存活列表 1，两个列表每帧交换，模拟时从一个压缩到另一个
+ *   4  计数器与间接参数
+ *   5  上一帧的深度 pyramid (见 RenderDriver::WriteDescriptorDepthPyramid)
+ *   6  pyramid 参数
+ */
+#ifndef QK_PARTICLE_GLSL_
+#define QK_PARTICLE_GLSL_
+
+struct Particle {
+    vec4 positionSize;          // xyz = 位置, w = 尺寸
+    vec4 velocityLife;          // xyz = 速度, w = 剩余寿命（秒）
+    uint color;                 // RGBA8
+    float lifetime;
+    uint _padding0;
+    uint _padding1;
+};
+
+#ifndef QK_PARTICLE_DRAW
+
+layout(std430, binding = 0) buffer Particles {
+    Particle particles[];
+};
+
+layout(std430, binding = 1) buffer DeadList {
+    uint deadIndices[];
+};
+
+layout(std430, binding = 2) buffer AliveList0 {
+    uint aliveIndices0[];
+};
+
+layout(std430, binding = 3) buffer AliveList1 {
+    uint aliveIndices1[];
+};
+
+layout(std430, binding = 4) buffer Counters {
+    int deadCount;
+    uint aliveCount[2];
+    uint _counterPadding;
+    uint dispatchArgs[4];       // VkDispatchIndirectCommand + 1 个填充
+    uint drawArgs[4];           // VkDrawIndirectCommand
+} counters;
+
+layout(binding = 5) uniform sampler2D depthPyramid;
+
+layout(binding = 6) uniform PyramidParams {
+    mat4 viewProjection;
+    vec2 size;
+    float mipCount;
+    float valid;
+} pyramid;
+
+layout(push_constant) uniform PushConstants {
+    vec4 emitterPositionRadius;     // xyz = 发射点, w = 发射球半径
+    vec4 emitterVelocityJitter;     // xyz = 初速度, w = 速度随机扰动
+    vec4 emitterColor;
+    vec4 emitterLifeSize;           // x, y = 寿命范围, z, w = 尺寸范围
+    vec4 gravityDrag;               // xyz = 重力加速度, w = 空气阻力系数
+    float deltaTime;
+    float restitution;              // 碰撞后法向速度保留的比例
+    uint emitCount;
+    uint seed;
+    uint currentList;               // 本帧的输入存活列表
+    uint mode;                      // qk_particle_args.comp 使用
+} pc;
+
+void PushAlive(uint list, uint index)
+{
+    uint slot = atomicAdd(counters.aliveCount[list], 1u);
+    if (list == 0u)
+        aliveIndices0[slot] = index;
+    else
+        aliveIndices1[slot] = index;
+}
+
+uint GetAlive(uint list, uint slot)
+{
+    return list == 0u ? aliveIndices0[slot] : aliveIndices1[slot];
+}
+
+/* PCG 哈希，按 (seed, 下标) 生成每个线程独立的随机序列 */
+uint QkHash(uint v)
+{
+    uint state = v * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+float QkRandom(inout uint state)
+{
+    state = QkHash(state);
+    return float(state) / 4294967295.0f;
+}
+
+#endif /* QK_PARTICLE_DRAW */
+
+#endif /* QK_PARTICLE_GLSL_ */
@@ -0,0 +1,53 @@
+/**
+ * -- Vertex Shader File --
+ *
+ * 每个粒子一个实例，6 个顶点展开成朝向相机的四边形，粒子数据直接从 SSBO 读取。
+ * 粒子下标传给片元着色器，qk_particle_sprite.frag 用它为每个粒子固定选一个精灵。
+ */
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#define QK_PARTICLE_DRAW
+#include "qk_particle.glsl"
+
+layout(std430, binding = 0) readonly buffer Particles {
+    Particle particles[];
+};
+
+layout(std430, binding = 1) readonly buffer AliveList {
+    uint aliveIndices[];
+};
+
+layout(push_constant) uniform PushConstants {
+    mat4 viewProjection;
+    vec4 cameraRight;
+    vec4 cameraUp;
+} pc;
+
+layout(location = 0) out vec4 outColor;
+layout(location = 1) out vec2 outCorner;
+layout(location = 2) flat out uint outParticleIndex;
+
+const vec2 CORNERS[6] = vec2[](
+    vec2(-1.0f, -1.0f), vec2(1.0f, -1.0f), vec2(1.0f, 1.0f),
+    vec2(-1.0f, -1.0f), vec2(1.0f, 1.0f), vec2(-1.0f, 1.0f)
+);
+
+void main()
+{
+    uint particleIndex = aliveIndices[gl_InstanceIndex];
+    Particle particle = particles[particleIndex];
+    vec2 corner = CORNERS[gl_VertexIndex];
+
+    float size = particle.positionSize.w;
+    vec3 position = particle.positionSize.xyz + (pc.cameraRight.xyz * corner.x + pc.cameraUp.xyz * corner.y) * size;
+
+    /* 寿命末尾淡出 */
+    vec4 color = unpackUnorm4x8(particle.color);
+    color.a *= clamp(particle.velocityLife.w / max(particle.lifetime, 1e-4f), 0.0f, 1.0f);
+
+    gl_Position = pc.viewProjection * vec4(position, 1.0f);
+    outColor = color;
+    outCorner = corner;
+    outParticleIndex = particleIndex;
+}
@@ -0,0 +1,39 @@
+/**
+ * -- Fragment Shader File --
+ *
+ * 带精灵图集的粒子，顶点着色器与 qk_particle 相同。binding 2 为 TextureAtlas，
+ * binding 3 为精灵在图集中的区域，与 rendering/particles/particle_system.h 中的
+ * ParticleSpriteUniformData 保持一致。
+ */
+#version 450
+
+#define QK_PARTICLE_MAX_SPRITES 8
+
+layout(binding = 2) uniform sampler2DArray spriteAtlas;
+
+layout(std140, binding = 3) uniform SpriteData {
+    vec4 uvRects[QK_PARTICLE_MAX_SPRITES];      // xy = uvMin, zw = uvMax
+    uvec4 layers[QK_PARTICLE_MAX_SPRITES];      // x = 图集的层
+    uvec4 spriteCount;                          // x = 精灵数量
+} sprites;
+
+layout(location = 0) in vec4 inColor;
+layout(location = 1) in vec2 inCorner;
+layout(location = 2) flat in uint inParticleIndex;
+
+layout(location = 0) out vec4 fragColor;
+
+void main()
+{
+    /* 粒子的生命周期内精灵保持不变 */
+    uint sprite = inParticleIndex % max(sprites.spriteCount.x, 1u);
+    vec4 rect = sprites.uvRects[sprite];
+
+    vec2 uv = mix(rect.xy, rect.zw, inCorner * 0.5f + 0.5f);
+    vec4 texel = texture(spriteAtlas, vec3(uv, float(sprites.layers[sprite].x)));
+
+    if (texel.a <= 0.0f)
+        discard;
+
+    fragColor = vec4(inColor.rgb * texel.rgb, inColor.a * texel.a);
+}
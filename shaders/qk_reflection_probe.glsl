@@ -0,0 +1,73 @@
+/**
+ * -- Reflection Probe Include File --
+ *
+ * 立方体贴图反射探针，数据由 rendering/probe/reflection_probe.h 中的 ReflectionProbe
+ * 通过 WriteDescriptor 写入，ProbeData 布局与 ReflectionProbeUniformData 保持一致。
+ * 6 个面存放在数组纹理的 6 层中，顺序和朝向与 CameraSet::SetCubemap 相同，即 Vulkan
+ * 立方体贴图的约定，这里按主轴规则手动选择层和面内坐标。
+ *
+ * 使用方式：
+ *   #extension GL_GOOGLE_include_directive : require
+ *   #include "qk_reflection_probe.glsl"
+ *   片元：vec3 reflection = QkSampleReflectionProbe(worldPosition, normal, cameraPosition);
+ *
+ * QK_PROBE_SET / QK_PROBE_BINDING 可覆盖，占用 QK_PROBE_BINDING 开始的 2 个 binding。
+ */
+#ifndef QK_REFLECTION_PROBE_GLSL_
+#define QK_REFLECTION_PROBE_GLSL_
+
+#ifndef QK_PROBE_SET
+#define QK_PROBE_SET 0
+#endif
+
+#ifndef QK_PROBE_BINDING
+#define QK_PROBE_BINDING 0
+#endif
+
+layout(set = QK_PROBE_SET, binding = QK_PROBE_BINDING + 0) uniform sampler2DArray qkProbeCubemap;
+
+layout(std140, set = QK_PROBE_SET, binding = QK_PROBE_BINDING + 1) uniform ProbeData {
+    vec4 params;                                // x = 强度，0 表示还没有捕获过
+} qkProbe;
+
+/* 返回 (s, t, 层)，与硬件立方体贴图的面选择相同 */
+vec3 QkProbeCubeCoord(vec3 direction)
+{
+    vec3 a = abs(direction);
+    float ma;
+    vec2 sc;
+    float layer;
+
+    if (a.x >= a.y && a.x >= a.z) {
+        ma = a.x;
+        layer = direction.x > 0.0f ? 0.0f : 1.0f;
+        sc = vec2(direction.x > 0.0f ? -direction.z : direction.z, -direction.y);
+    } else if (a.y >= a.z) {
+        ma = a.y;
+        layer = direction.y > 0.0f ? 2.0f : 3.0f;
+        sc = vec2(direction.x, direction.y > 0.0f ? direction.z : -direction.z);
+    } else {
+        ma = a.z;
+        layer = direction.z > 0.0f ? 4.0f : 5.0f;
+        sc = vec2(direction.z > 0.0f ? direction.x : -direction.x, -direction.y);
+    }
+
+    return vec3(sc / max(ma, 1e-8f) * 0.5f + 0.5f, layer);
+}
+
+/* 世界空间，按 Schlick 近似（F0 = 0.04）加权的远景反射 */
+vec3 QkSampleReflectionProbe(vec3 worldPosition, vec3 normal, vec3 cameraPosition)
+{
+    if (qkProbe.params.x <= 0.0f)
+        return vec3(0.0f);
+
+    vec3 view = normalize(worldPosition - cameraPosition);
+    vec3 direction = reflect(view, normal);
+
+    float cosine = max(dot(-view, normal), 0.0f);
+    float fresnel = 0.04f + 0.96f * pow(1.0f - cosine, 5.0f);
+
+    return texture(qkProbeCubemap, QkProbeCubeCoord(direction)).rgb * fresnel * qkProbe.params.x;
+}
+
+#endif /* QK_REFLECTION_PROBE_GLSL_ */
@@ -0,0 +1,77 @@
+/**
+ * -- Cascaded Shadow Include File --
+ *
+ * 级联阴影的接收端，数据由 rendering/shadow/cascaded_shadow_map.h 中的 CascadedShadowMap
+ * 通过 WriteDescriptor 写入，ShadowData 布局与 ShadowUniformData 保持一致。
+ * 所有级联在同一张深度图集中，viewToShadow 直接把相机视图空间变换到图集的 uv 和深度。
+ *
+ * 使用方式：
+ *   #extension GL_GOOGLE_include_directive : require
+ *   #include "qk_shadow.glsl"
+ *   顶点：outViewPosition = QkShadowViewPosition(gl_Position);
+ *   片元：float visibility = QkSampleShadow(inViewPosition);
+ *
+ * QK_SHADOW_SET / QK_SHADOW_BINDING 可覆盖，占用 QK_SHADOW_BINDING 开始的 2 个 binding。
+ */
+#ifndef QK_SHADOW_GLSL_
+#define QK_SHADOW_GLSL_
+
+#ifndef QK_SHADOW_SET
+#define QK_SHADOW_SET 0
+#endif
+
+#ifndef QK_SHADOW_BINDING
+#define QK_SHADOW_BINDING 0
+#endif
+
+#define QK_SHADOW_MAX_CASCADES 4
+
+layout(set = QK_SHADOW_SET, binding = QK_SHADOW_BINDING + 0) uniform sampler2DShadow qkShadowAtlas;
+
+layout(std140, set = QK_SHADOW_SET, binding = QK_SHADOW_BINDING + 1) uniform ShadowData {
+    mat4 viewToShadow[QK_SHADOW_MAX_CASCADES];
+    vec4 uvClamp[QK_SHADOW_MAX_CASCADES];       // 级联在图集中的区域，向内收缩一个 texel
+    vec4 splitDepths;                           // 每个级联远端的视深
+    vec4 projectionScale;                       // xy = 1 / P[0][0], 1 / P[1][1]，zw = 图集 texel 大小
+    vec4 lightDirection;                        // xyz 指向光源，w = 级联数量
+} qkShadow;
+
+/* 透视投影的 w 就是视深，x、y 按投影的缩放还原，不需要经过深度的逆变换 */
+vec3 QkShadowViewPosition(vec4 clipPosition)
+{
+    return vec3(clipPosition.xy * qkShadow.projectionScale.xy, -clipPosition.w);
+}
+
+/* 返回 0 (完全遮挡) 到 1 (完全照亮)，超出阴影距离的部分不受遮挡 */
+float QkSampleShadow(vec3 viewPosition)
+{
+    float depth = -viewPosition.z;
+    uint cascadeCount = uint(qkShadow.lightDirection.w);
+
+    uint cascade = 0u;
+    while (cascade < cascadeCount && depth > qkShadow.splitDepths[cascade])
+        cascade++;
+
+    if (cascade == cascadeCount)
+        return 1.0f;
+
+    vec4 shadowPosition = qkShadow.viewToShadow[cascade] * vec4(viewPosition, 1.0f);
+    if (shadowPosition.z >= 1.0f)
+        return 1.0f;
+
+    /* 3x3 PCF，每次采样本身是 2x2 的双线性比较 */
+    vec4 bounds = qkShadow.uvClamp[cascade];
+    vec2 texelSize = qkShadow.projectionScale.zw;
+    float visibility = 0.0f;
+
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            vec2 uv = clamp(shadowPosition.xy + vec2(x, y) * texelSize, bounds.xy, bounds.zw);
+            visibility += texture(qkShadowAtlas, vec3(uv, shadowPosition.z));
+        }
+    }
+
+    return visibility / 9.0f;
+}
+
+#endif /* QK_SHADOW_GLSL_ */
@@ -0,0 +1,150 @@
+/**
+ * -- Vertex Pulling Include File --
+ *
+ * 顶点数据放在 SSBO 中，按 gl_VertexIndex 读取并解码，不使用固定功能的顶点输入。
+ * 顶点布局由特化常量描述，与 rendering/mesh/packed_mesh.h 中的 VertexLayout 保持一致；
+ * 编码和偏移在管线编译时已知，解码的 switch 会被折叠成固定的几条指令。
+ *
+ * 使用方式：
+ *   #extension GL_GOOGLE_include_directive : require
+ *   #include "qk_vertex_pulling.glsl"
+ *   vec3 position = QkFetchPosition(gl_VertexIndex, pc.boundsMin.xyz, pc.boundsExtent.xyz);
+ *
+ * QK_VERTEX_SET / QK_VERTEX_BINDING 可覆盖，占用 1 个 binding。
+ * 特化常量 constant_id 从 100 开始，不与材质特性位冲突。
+ */
+#ifndef QK_VERTEX_PULLING_GLSL_
+#define QK_VERTEX_PULLING_GLSL_
+
+#ifndef QK_VERTEX_SET
+#define QK_VERTEX_SET 0
+#endif
+
+#ifndef QK_VERTEX_BINDING
+#define QK_VERTEX_BINDING 0
+#endif
+
+/* 与 VertexEncoding 保持一致 */
+#define QK_VERTEX_ENCODING_NONE         0u
+#define QK_VERTEX_ENCODING_FLOAT32      1u
+#define QK_VERTEX_ENCODING_HALF         2u
+#define QK_VERTEX_ENCODING_UNORM16      3u
+#define QK_VERTEX_ENCODING_SNORM16      4u
+#define QK_VERTEX_ENCODING_UNORM8       5u
+#define QK_VERTEX_ENCODING_SNORM8       6u
+#define QK_VERTEX_ENCODING_OCT_SNORM8   7u
+#define QK_VERTEX_ENCODING_OCT_SNORM16  8u
+
+/* 默认值为全精度布局 */
+layout(constant_id = 100) const uint QK_VERTEX_STRIDE = 48u;
+layout(constant_id = 101) const uint QK_VERTEX_POSITION_ENCODING = QK_VERTEX_ENCODING_FLOAT32;
+layout(constant_id = 102) const uint QK_VERTEX_POSITION_OFFSET = 0u;
+layout(constant_id = 103) const uint QK_VERTEX_NORMAL_ENCODING = QK_VERTEX_ENCODING_FLOAT32;
+layout(constant_id = 104) const uint QK_VERTEX_NORMAL_OFFSET = 12u;
+layout(constant_id = 105) const uint QK_VERTEX_UV_ENCODING = QK_VERTEX_ENCODING_FLOAT32;
+layout(constant_id = 106) const uint QK_VERTEX_UV_OFFSET = 24u;
+layout(constant_id = 107) const uint QK_VERTEX_COLOR_ENCODING = QK_VERTEX_ENCODING_FLOAT32;
+layout(constant_id = 108) const uint QK_VERTEX_COLOR_OFFSET = 32u;
+
+layout(std430, set = QK_VERTEX_SET, binding = QK_VERTEX_BINDING) readonly buffer VertexBuffer {
+    uint words[];
+} qkVertices;
+
+uint QkLoadU32(uint byteOffset)
+{
+    return qkVertices.words[byteOffset >> 2u];
+}
+
+/* 16 位分量 2 字节对齐，8 位分量不要求对齐，都不会跨越 32 位字 */
+uint QkLoadU16(uint byteOffset)
+{
+    return (QkLoadU32(byteOffset) >> ((byteOffset & 2u) * 8u)) & 0xFFFFu;
+}
+
+uint QkLoadU8(uint byteOffset)
+{
+    return (QkLoadU32(byteOffset) >> ((byteOffset & 3u) * 8u)) & 0xFFu;
+}
+
+float QkDecodeComponent(uint encoding, uint byteOffset, uint component)
+{
+    switch (encoding) {
+        case QK_VERTEX_ENCODING_FLOAT32:
+            return uintBitsToFloat(QkLoadU32(byteOffset + component * 4u));
+        case QK_VERTEX_ENCODING_HALF:
+            return unpackHalf2x16(QkLoadU16(byteOffset + component * 2u)).x;
+        case QK_VERTEX_ENCODING_UNORM16:
+            return float(QkLoadU16(byteOffset + component * 2u)) / 65535.0f;
+        case QK_VERTEX_ENCODING_SNORM16:
+        case QK_VERTEX_ENCODING_OCT_SNORM16:
+            return max(float(int(QkLoadU16(byteOffset + component * 2u) << 16u) >> 16) / 32767.0f, -1.0f);
+        case QK_VERTEX_ENCODING_UNORM8:
+            return float(QkLoadU8(byteOffset + component)) / 255.0f;
+        case QK_VERTEX_ENCODING_SNORM8:
+        case QK_VERTEX_ENCODING_OCT_SNORM8:
+            return max(float(int(QkLoadU8(byteOffset + component) << 24u) >> 24) / 127.0f, -1.0f);
+        default:
+            return 0.0f;
+    }
+}
+
+vec3 QkDecodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return normalize(n);
+}
+
+/* 无符号归一化的位置是相对网格包围盒的 */
+vec3 QkFetchPosition(uint vertexIndex, vec3 boundsMin, vec3 boundsExtent)
+{
+    uint base = vertexIndex * QK_VERTEX_STRIDE + QK_VERTEX_POSITION_OFFSET;
+    vec3 position = vec3(QkDecodeComponent(QK_VERTEX_POSITION_ENCODING, base, 0u),
+                         QkDecodeComponent(QK_VERTEX_POSITION_ENCODING, base, 1u),
+                         QkDecodeComponent(QK_VERTEX_POSITION_ENCODING, base, 2u));
+
+    if (QK_VERTEX_POSITION_ENCODING == QK_VERTEX_ENCODING_UNORM16 || QK_VERTEX_POSITION_ENCODING == QK_VERTEX_ENCODING_UNORM8)
+        position = boundsMin + position * boundsExtent;
+
+    return position;
+}
+
+vec3 QkFetchNormal(uint vertexIndex)
+{
+    if (QK_VERTEX_NORMAL_ENCODING == QK_VERTEX_ENCODING_NONE)
+        return vec3(0.0f, 0.0f, 1.0f);
+
+    uint base = vertexIndex * QK_VERTEX_STRIDE + QK_VERTEX_NORMAL_OFFSET;
+
+    if (QK_VERTEX_NORMAL_ENCODING == QK_VERTEX_ENCODING_OCT_SNORM8 || QK_VERTEX_NORMAL_ENCODING == QK_VERTEX_ENCODING_OCT_SNORM16) {
+        return QkDecodeOctahedral(vec2(QkDecodeComponent(QK_VERTEX_NORMAL_ENCODING, base, 0u),
+                                       QkDecodeComponent(QK_VERTEX_NORMAL_ENCODING, base, 1u)));
+    }
+
+    return normalize(vec3(QkDecodeComponent(QK_VERTEX_NORMAL_ENCODING, base, 0u),
+                          QkDecodeComponent(QK_VERTEX_NORMAL_ENCODING, base, 1u),
+                          QkDecodeComponent(QK_VERTEX_NORMAL_ENCODING, base, 2u)));
+}
+
+vec2 QkFetchUV(uint vertexIndex)
+{
+    uint base = vertexIndex * QK_VERTEX_STRIDE + QK_VERTEX_UV_OFFSET;
+    return vec2(QkDecodeComponent(QK_VERTEX_UV_ENCODING, base, 0u),
+                QkDecodeComponent(QK_VERTEX_UV_ENCODING, base, 1u));
+}
+
+vec4 QkFetchColor(uint vertexIndex)
+{
+    if (QK_VERTEX_COLOR_ENCODING == QK_VERTEX_ENCODING_NONE)
+        return vec4(1.0f);
+
+    uint base = vertexIndex * QK_VERTEX_STRIDE + QK_VERTEX_COLOR_OFFSET;
+    return vec4(QkDecodeComponent(QK_VERTEX_COLOR_ENCODING, base, 0u),
+                QkDecodeComponent(QK_VERTEX_COLOR_ENCODING, base, 1u),
+                QkDecodeComponent(QK_VERTEX_COLOR_ENCODING, base, 2u),
+                QkDecodeComponent(QK_VERTEX_COLOR_ENCODING, base, 3u));
+}
+
+#endif /* QK_VERTEX_PULLING_GLSL_ */
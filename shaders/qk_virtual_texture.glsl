@@ -0,0 +1,84 @@
+/**
+ * -- Virtual Texture Include File --
+ *
+ * 软件页表虚拟纹理的采样与反馈，布局与 rendering/vt/virtual_texture.h 保持一致。
+ *
+ * 使用方式：
+ *   #extension GL_GOOGLE_include_directive : require
+ *   #define QK_VT_SET 0
+ *   #define QK_VT_BINDING 0
+ *   #include "qk_virtual_texture.glsl"
+ *
+ * 占用 QK_VT_BINDING 开始的 4 个 binding。设备不支持 fragmentStoresAndAtomics 时
+ * （VirtualTexture::IsFeedbackEnabled 为假）定义 QK_VT_NO_FEEDBACK，反馈缓冲只声明不写入。
+ */
+#ifndef QK_VIRTUAL_TEXTURE_GLSL_
+#define QK_VIRTUAL_TEXTURE_GLSL_
+
+#ifndef QK_VT_SET
+#define QK_VT_SET 0
+#endif
+
+#ifndef QK_VT_BINDING
+#define QK_VT_BINDING 0
+#endif
+
+layout(set = QK_VT_SET, binding = QK_VT_BINDING + 0) uniform usampler2D qkVTPageTable;
+layout(set = QK_VT_SET, binding = QK_VT_BINDING + 1) uniform sampler2D qkVTAtlas;
+
+layout(std140, set = QK_VT_SET, binding = QK_VT_BINDING + 2) uniform VirtualTextureParams {
+    uvec2 pageCount;
+    uint mipCount;
+    uint pageSize;
+    vec2 atlasPageCount;
+    float physicalPageSize;
+    float border;
+    uvec4 feedbackOffsets[16];
+} qkVT;
+
+#ifdef QK_VT_NO_FEEDBACK
+#define QK_VT_FEEDBACK_ACCESS readonly
+#else
+#define QK_VT_FEEDBACK_ACCESS writeonly
+#endif
+
+layout(std430, set = QK_VT_SET, binding = QK_VT_BINDING + 3) QK_VT_FEEDBACK_ACCESS buffer VirtualTextureFeedback {
+    uint requested[];
+} qkVTFeedback;
+
+float QkVTMipLevel(vec2 uv)
+{
+    vec2 texel = uv * vec2(qkVT.pageCount * qkVT.pageSize);
+    vec2 dx = dFdx(texel);
+    vec2 dy = dFdy(texel);
+    float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy)));
+    return clamp(lod, 0.0, float(qkVT.mipCount - 1u));
+}
+
+vec4 QkVTSample(vec2 uv)
+{
+    uint mip = uint(QkVTMipLevel(uv));
+    uv = fract(uv);
+
+    uvec2 pages = max(qkVT.pageCount >> mip, uvec2(1u));
+    uvec2 page = min(uvec2(uv * vec2(pages)), pages - 1u);
+
+#ifndef QK_VT_NO_FEEDBACK
+    /* 每 2x2 像素写一次反馈，相同的值并发写入无需原子操作 */
+    if (((uint(gl_FragCoord.x) | uint(gl_FragCoord.y)) & 1u) == 0u)
+        qkVTFeedback.requested[qkVT.feedbackOffsets[mip].x + page.y * pages.x + page.x] = 1u;
+#endif
+
+    /* rg = 物理页坐标, b = 实际驻留的 mip, a = 有效标记 */
+    uvec4 entry = texelFetch(qkVTPageTable, ivec2(page), int(mip));
+    if (entry.a == 0u)
+        return vec4(0.0);
+
+    uvec2 residentPages = max(qkVT.pageCount >> entry.b, uvec2(1u));
+    vec2 inPage = fract(uv * vec2(residentPages));
+    vec2 texel = vec2(entry.rg) * qkVT.physicalPageSize + qkVT.border + inPage * float(qkVT.pageSize);
+
+    return textureLod(qkVTAtlas, texel / (qkVT.atlasPageCount * qkVT.physicalPageSize), 0.0);
+}
+
+#endif /* QK_VIRTUAL_TEXTURE_GLSL_ */
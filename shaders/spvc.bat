@@ -5,7 +5,7 @@ set SCRIPT_DIR=%~dp0
 echo [spvc] script dirname: %SCRIPT_DIR%
 cd /d "%SCRIPT_DIR%"
 
-for %%f in (*.vert *.frag) do (
+for %%f in (*.vert *.frag *.comp) do (
     if exist "%%f" (
         echo [spvc] compiling %%f ...
         glslangValidator -V "%%f" -o "%%f.spv"
@@ -0,0 +1,370 @@
+/**
+ * 离线批量渲染。
+ *
+ *   QuokkaBatch <job file>
+ *
+ * 按 job 文件中的相机路径逐帧离屏渲染，GPU 渲染、异步读回和图片编码三级流水：
+ * 渲染保持 MAX_FRAMES_IN_FLIGHT 帧在途，读回结果到达后交给编码线程池，编码队列
+ * 有上限，编码跟不上时才阻塞渲染线程，吞吐量取决于最慢的一级。
+ *
+ * job 文件格式 (# 开头为注释)：
+ *
+ *   size 1280 720              # 输出分辨率，所有 job 共享
+ *   format png                 # png | exr
+ *   threads 0                  # 编码线程数，0 = 硬件线程数
+ *
+ *   job orbit
+ *   output out/orbit_{frame}.png  # {frame} 替换为 5 位补零的帧号
+ *   frames 240
+ *   key 0.0  0 0 3   0 0 -1  45  # t(0~1) 位置 方向 fov，帧之间线性插值
+ *   key 1.0  2 0 3  -1 0 -1  60
+ */
+#include "core/profiler/startup_timeline.h"
+#include "driver/render_driver.h"
+#include "rendering/camera/camera.h"
+#include "utils/image_writer.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct Vertex
+{
+    float pos[2];
+    float color[3];
+};
+
+static Vertex vertices[] = {
+    {{  0.0f, -0.5f }, { 1.0f, 0.0f, 0.0f }},
+    {{  0.5f,  0.5f }, { 0.0f, 1.0f, 0.0f }},
+    {{ -0.5f,  0.5f }, { 0.0f, 0.0f, 1.0f }}
+};
+
+struct CameraKey
+{
+    float t;
+    glm::vec3 position;
+    glm::vec3 direction;
+    float fov;
+};
+
+struct BatchJob
+{
+    std::string name;
+    std::string output;
+    uint32_t frameCount = 0;
+    std::vector<CameraKey> keys;
+};
+
+struct BatchConfig
+{
+    uint32_t width = 1280;
+    uint32_t height = 720;
+    bool exr = false;
+    uint32_t threads = 0;
+    std::vector<BatchJob> jobs;
+};
+
+/* 输出路径中的帧号占位符，路径本身不作为格式串使用 */
+static const char* FRAME_TOKEN = "{frame}";
+
+static std::string FormatFramePath(const std::string& output, uint32_t frame)
+{
+    char number[16];
+    snprintf(number, sizeof(number), "%05u", frame);
+
+    std::string path = output;
+    for (size_t pos = path.find(FRAME_TOKEN); pos != std::string::npos; pos = path.find(FRAME_TOKEN, pos + strlen(number)))
+        path.replace(pos, strlen(FRAME_TOKEN), number);
+
+    return path;
+}
+
+static bool ParseJobFile(const char* path, BatchConfig* pConfig)
+{
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        printf("[batch] open job file %s failed\n", path);
+        return false;
+    }
+
+    char line[1024];
+    uint32_t lineNumber = 0;
+
+    while (fgets(line, sizeof(line), file)) {
+        lineNumber++;
+
+        char* comment = strchr(line, '#');
+        if (comment != NULL)
+            *comment = '\0';
+
+        char keyword[64] = {};
+        if (sscanf(line, "%63s", keyword) != 1)
+            continue;
+
+        const char* args = strstr(line, keyword) + strlen(keyword);
+        bool ok = true;
+
+        if (strcmp(keyword, "size") == 0) {
+            ok = sscanf(args, "%u %u", &pConfig->width, &pConfig->height) == 2;
+        } else if (strcmp(keyword, "format") == 0) {
+            char format[16] = {};
+            ok = sscanf(args, "%15s", format) == 1 && (strcmp(format, "png") == 0 || strcmp(format, "exr") == 0);
+            pConfig->exr = strcmp(format, "exr") == 0;
+        } else if (strcmp(keyword, "threads") == 0) {
+            ok = sscanf(args, "%u", &pConfig->threads) == 1;
+        } else if (strcmp(keyword, "job") == 0) {
+            char name[256] = {};
+            ok = sscanf(args, "%255s", name) == 1;
+            pConfig->jobs.emplace_back();
+            pConfig->jobs.back().name = name;
+        } else if (pConfig->jobs.empty()) {
+            ok = false;
+        } else if (strcmp(keyword, "output") == 0) {
+            char output[512] = {};
+            ok = sscanf(args, "%511s", output) == 1;
+            pConfig->jobs.back().output = output;
+        } else if (strcmp(keyword, "frames") == 0) {
+            ok = sscanf(args, "%u", &pConfig->jobs.back().frameCount) == 1;
+        } else if (strcmp(keyword, "key") == 0) {
+            CameraKey key = {};
+            ok = sscanf(args, "%f %f %f %f %f %f %f %f", &key.t,
+                        &key.position.x, &key.position.y, &key.position.z,
+                        &key.direction.x, &key.direction.y, &key.direction.z, &key.fov) == 8;
+            pConfig->jobs.back().keys.push_back(key);
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            printf("[batch] %s:%u: invalid line: %s\n", path, lineNumber, line);
+            fclose(file);
+            return false;
+        }
+    }
+
+    fclose(file);
+
+    for (const BatchJob& job : pConfig->jobs) {
+        if (job.output.empty() || job.frameCount == 0 || job.keys.empty()) {
+            printf("[batch] job %s needs output, frames and at least one key\n", job.name.c_str());
+            return false;
+        }
+
+        if (job.frameCount > 1 && job.output.find(FRAME_TOKEN) == std::string::npos) {
+            printf("[batch] job %s output needs a %s token\n", job.name.c_str(), FRAME_TOKEN);
+            return false;
+        }
+    }
+
+    return !pConfig->jobs.empty();
+}
+
+static CameraKey SampleCameraPath(const BatchJob& job, uint32_t frame)
+{
+    float t = job.frameCount > 1 ? static_cast<float>(frame) / static_cast<float>(job.frameCount - 1) : 0.0f;
+
+    if (t <= job.keys.front().t)
+        return job.keys.front();
+
+    for (size_t i = 1; i < job.keys.size(); i++) {
+        const CameraKey& a = job.keys[i - 1];
+        const CameraKey& b = job.keys[i];
+
+        if (t <= b.t) {
+            float f = b.t > a.t ? (t - a.t) / (b.t - a.t) : 1.0f;
+            return { t, glm::mix(a.position, b.position, f), glm::normalize(glm::mix(a.direction, b.direction, f)), glm::mix(a.fov, b.fov, f) };
+        }
+    }
+
+    return job.keys.back();
+}
+
+/* 编码线程池，队列有上限，满了之后提交方阻塞，形成反压 */
+class EncodeWorkerPool
+{
+public:
+    EncodeWorkerPool(uint32_t threadCount, size_t capacity) : capacity(capacity)
+    {
+        for (uint32_t i = 0; i < threadCount; i++)
+            threads.emplace_back(&EncodeWorkerPool::_Run, this);
+    }
+
+   ~EncodeWorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            exit = true;
+        }
+        condition.notify_all();
+
+        for (std::thread& thread : threads)
+            thread.join();
+    }
+
+    void Submit(std::function<void()> task)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [this] { return tasks.size() < capacity; });
+        tasks.push_back(std::move(task));
+        condition.notify_all();
+    }
+
+private:
+    void _Run()
+    {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this] { return exit || !tasks.empty(); });
+
+                /* 退出前把队列中的任务做完 */
+                if (tasks.empty())
+                    return;
+
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            condition.notify_all();
+
+            task();
+        }
+    }
+
+    size_t capacity;
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool exit = false;
+};
+
+struct FrameReadback
+{
+    EncodeWorkerPool* pool;
+    std::string path;
+    uint32_t width;
+    uint32_t height;
+    bool exr;
+};
+
+static void OnFrameReadback(QK_MAYBE_UNUSED ReadbackHandle handle, const void* pData, VkDeviceSize size, void* pUserData)
+{
+    FrameReadback* frame = static_cast<FrameReadback*>(pUserData);
+
+    /* 回调返回后环形缓冲就会被复用，先拷贝出来 */
+    auto pixels = std::make_shared<std::vector<uint8_t>>(static_cast<const uint8_t*>(pData), static_cast<const uint8_t*>(pData) + size);
+
+    frame->pool->Submit([frame, pixels] {
+        bool ok = frame->exr
+            ? io_write_exr(frame->path.c_str(), frame->width, frame->height, reinterpret_cast<const float*>(pixels->data()))
+            : io_write_png(frame->path.c_str(), frame->width, frame->height, 4, pixels->data());
+
+        if (!ok)
+            printf("[batch] write %s failed\n", frame->path.c_str());
+
+        delete frame;
+    });
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        printf("usage: %s <job file>\n", argv[0]);
+        return 1;
+    }
+
+    StartupTimeline::Begin();
+
+    BatchConfig config = {};
+    if (!ParseJobFile(argv[1], &config))
+        return 1;
+
+    uint32_t threadCount = config.threads > 0 ? config.threads : std::max(1u, std::thread::hardware_concurrency());
+
+    const std::unique_ptr<RenderDriver> driver = std::make_unique<RenderDriver>(VK_TRUE);
+
+    const VkFormat colorFormat = config.exr ? VK_FORMAT_R32G32B32A32_SFLOAT : VK_FORMAT_R8G8B8A8_UNORM;
+    VkResult err = driver->InitializeHeadless(config.width, config.height, colorFormat);
+    if (err != VK_SUCCESS) {
+        printf("[batch] initialize headless driver failed: %d\n", err);
+        return 1;
+    }
+
+    Pipeline pipeline;
+    driver->CreatePipeline("qk_simple_shader", &pipeline);
+
+    Buffer vertexBuffer;
+    driver->CreateBuffer(sizeof(vertices), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, &vertexBuffer);
+    driver->WriteBuffer(vertexBuffer, sizeof(vertices), vertices);
+
+    Camera camera(glm::vec3(0.0f, 0.0f, 3.0f), static_cast<float>(config.width) / static_cast<float>(config.height));
+
+    uint64_t totalFrames = 0;
+    auto startTime = std::chrono::steady_clock::now();
+
+    {
+        EncodeWorkerPool pool(threadCount, threadCount * 2);
+
+        for (const BatchJob& job : config.jobs) {
+            printf("[batch] job %s: %u frames -> %s\n", job.name.c_str(), job.frameCount, job.output.c_str());
+
+            for (uint32_t frame = 0; frame < job.frameCount; frame++) {
+                CameraKey key = SampleCameraPath(job, frame);
+                camera.SetPosition(key.position);
+                camera.SetDirection(key.direction);
+                camera.SetFov(key.fov);
+                camera.Update();
+
+                glm::mat4 PC_MVP = camera.GetProjectionMatrix() * camera.GetViewMatrix() * glm::mat4(1.0f);
+
+                /* 等待 MAX_FRAMES_IN_FLIGHT 帧之前的提交，顺带触发已完成帧的读回回调 */
+                VkCommandBuffer cmd;
+                driver->AcquiredNextFrame(&cmd);
+                driver->BeginCommandBuffer(cmd);
+
+                driver->CmdBeginRendering(cmd);
+                driver->CmdBindPipeline(cmd, pipeline);
+                driver->CmdPushConstants(cmd, pipeline, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), glm::value_ptr(PC_MVP));
+                driver->CmdBindVertexBuffer(cmd, vertexBuffer, 0);
+                driver->CmdDraw(cmd, ARRAY_SIZE(vertices));
+                driver->CmdEndRendering(cmd);
+
+                FrameReadback* readback = new FrameReadback { &pool, FormatFramePath(job.output, frame), config.width, config.height, config.exr };
+                ReadbackHandle handle = driver->CmdReadbackTexture2D(cmd, driver->GetSceneColorTexture(), 0, { 0, 0 },
+                                                                     { config.width, config.height }, OnFrameReadback, readback);
+                if (handle == 0) {
+                    printf("[batch] frame %u of job %s dropped\n", frame, job.name.c_str());
+                    delete readback;
+                }
+
+                driver->EndCommandBuffer(cmd);
+                driver->SubmitAndPresentFrame(cmd);
+                StartupTimeline::MarkFirstFrame();
+
+                totalFrames++;
+            }
+        }
+
+        /* 取回最后几帧，pool 析构时等待编码完成 */
+        driver->DeviceWaitIdle();
+        driver->PollReadbacks();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    printf("[batch] %llu frames in %.2fs (%.2f fps, %u encode threads)\n",
+           static_cast<unsigned long long>(totalFrames), seconds, totalFrames / std::max(seconds, 1e-6), threadCount);
+
+    driver->DestroyPipeline(pipeline);
+    driver->DestroyBuffer(vertexBuffer);
+
+    return 0;
+}
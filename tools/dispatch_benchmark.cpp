@@ -0,0 +1,162 @@
+/**
+ * 设备级函数分发的微基准。
+ *
+ *   QuokkaDispatchBench [draw count] [iterations]
+ *
+ * 离屏初始化驱动，把同样的 push constant / bind vertex buffer / draw 序列分别通过
+ * loader 的 trampoline 和 VolkDeviceTable 中的驱动入口录制到帧命令缓冲中，比较
+ * 每条命令的录制耗时。每种方式取 iterations 次中最快的一次，录制完正常提交。
+ * 未设置 QK_VULKAN_VALIDATION 时关闭验证层，否则测到的是验证层的开销。
+ */
+#include "driver/render_driver.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <memory>
+
+struct Vertex
+{
+    float pos[2];
+    float color[3];
+};
+
+static Vertex vertices[] = {
+    {{  0.0f, -0.5f }, { 1.0f, 0.0f, 0.0f }},
+    {{  0.5f,  0.5f }, { 0.0f, 1.0f, 0.0f }},
+    {{ -0.5f,  0.5f }, { 0.0f, 0.0f, 1.0f }}
+};
+
+struct DispatchFunctions
+{
+    const char* name;
+    PFN_vkCmdPushConstants vkCmdPushConstants;
+    PFN_vkCmdBindVertexBuffers vkCmdBindVertexBuffers;
+    PFN_vkCmdDraw vkCmdDraw;
+};
+
+static const uint32_t COMMANDS_PER_DRAW = 3;
+
+/* 录制一帧，返回循环部分的耗时（秒） */
+static double RecordFrame(RenderDriver* driver, const DispatchFunctions& functions, Pipeline pipeline, Buffer vertexBuffer, uint32_t drawCount)
+{
+    VkCommandBuffer cmd;
+    driver->AcquiredNextFrame(&cmd);
+    driver->BeginCommandBuffer(cmd);
+    driver->CmdBeginRendering(cmd);
+    driver->CmdBindPipeline(cmd, pipeline);
+
+    const VkPipelineLayout layout = RenderDriver::GetVkPipelineLayout(pipeline);
+    const VkBuffer buffer = RenderDriver::GetVkBuffer(vertexBuffer);
+    const VkDeviceSize offset = 0;
+
+    /* 缩到看不见，只测录制开销 */
+    float mvp[16] = {};
+
+    auto begin = std::chrono::steady_clock::now();
+
+    for (uint32_t i = 0; i < drawCount; i++) {
+        mvp[15] = 1.0f + static_cast<float>(i & 0xFF);
+        functions.vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(mvp), mvp);
+        functions.vkCmdBindVertexBuffers(cmd, 0, 1, &buffer, &offset);
+        functions.vkCmdDraw(cmd, ARRAY_SIZE(vertices), 1, 0, 0);
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    driver->CmdEndRendering(cmd);
+    driver->EndCommandBuffer(cmd);
+    driver->SubmitAndPresentFrame(cmd);
+
+    return seconds;
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t drawCount = argc > 1 ? static_cast<uint32_t>(strtoul(argv[1], NULL, 10)) : 100000;
+    uint32_t iterations = argc > 2 ? static_cast<uint32_t>(strtoul(argv[2], NULL, 10)) : 10;
+
+    if (drawCount == 0 || iterations == 0) {
+        printf("usage: %s [draw count] [iterations]\n", argv[0]);
+        return 1;
+    }
+
+#ifdef _WIN32
+    if (getenv("QK_VULKAN_VALIDATION") == NULL)
+        _putenv_s("QK_VULKAN_VALIDATION", "0");
+#else
+    setenv("QK_VULKAN_VALIDATION", "0", 0);
+#endif
+
+    const std::unique_ptr<RenderDriver> driver = std::make_unique<RenderDriver>(VK_TRUE);
+
+    /* 全局函数指针保持 loader 的 trampoline，作为对照组 */
+    driver->SetDeviceDispatchMode(DEVICE_DISPATCH_TABLE);
+
+    VkResult err = driver->InitializeHeadless(256, 256, VK_FORMAT_R8G8B8A8_UNORM);
+    if (err != VK_SUCCESS) {
+        printf("[bench] initialize headless driver failed: %d\n", err);
+        return 1;
+    }
+
+    Pipeline pipeline;
+    err = driver->CreatePipeline("qk_simple_shader", &pipeline);
+    if (err != VK_SUCCESS) {
+        printf("[bench] create pipeline failed: %d\n", err);
+        return 1;
+    }
+
+    Buffer vertexBuffer;
+    driver->CreateBuffer(sizeof(vertices), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, &vertexBuffer);
+    driver->WriteBuffer(vertexBuffer, sizeof(vertices), vertices);
+
+    /* 通过 instance 查询设备级函数得到的是 loader 的 trampoline */
+    VkInstance instance = driver->GetInstance();
+    const VolkDeviceTable& table = driver->GetDeviceTable();
+
+    const DispatchFunctions modes[] = {
+        {
+            "loader trampoline",
+            reinterpret_cast<PFN_vkCmdPushConstants>(vkGetInstanceProcAddr(instance, "vkCmdPushConstants")),
+            reinterpret_cast<PFN_vkCmdBindVertexBuffers>(vkGetInstanceProcAddr(instance, "vkCmdBindVertexBuffers")),
+            reinterpret_cast<PFN_vkCmdDraw>(vkGetInstanceProcAddr(instance, "vkCmdDraw")),
+        },
+        {
+            "device table",
+            table.vkCmdPushConstants,
+            table.vkCmdBindVertexBuffers,
+            table.vkCmdDraw,
+        },
+    };
+
+    double best[ARRAY_SIZE(modes)];
+    for (double& seconds : best)
+        seconds = 1e30;
+
+    /* 交替执行，减少频率和缓存状态对某一种方式的偏向；第一轮作为预热丢弃 */
+    for (uint32_t iteration = 0; iteration <= iterations; iteration++) {
+        for (size_t mode = 0; mode < ARRAY_SIZE(modes); mode++) {
+            double seconds = RecordFrame(driver.get(), modes[mode], pipeline, vertexBuffer, drawCount);
+            if (iteration > 0)
+                best[mode] = std::min(best[mode], seconds);
+        }
+    }
+
+    driver->DeviceWaitIdle();
+
+    const double commandCount = static_cast<double>(drawCount) * COMMANDS_PER_DRAW;
+    printf("[bench] %u draws x %u commands, best of %u\n", drawCount, COMMANDS_PER_DRAW, iterations);
+
+    for (size_t mode = 0; mode < ARRAY_SIZE(modes); mode++) {
+        printf("[bench] %-18s %8.3f ms  %6.2f ns/command\n",
+               modes[mode].name, best[mode] * 1e3, best[mode] * 1e9 / commandCount);
+    }
+
+    printf("[bench] saved %.2f ns/command (%.1f%%)\n",
+           (best[0] - best[1]) * 1e9 / commandCount, (1.0 - best[1] / best[0]) * 100.0);
+
+    driver->DestroyPipeline(pipeline);
+    driver->DestroyBuffer(vertexBuffer);
+
+    return 0;
+}
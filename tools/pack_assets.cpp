@@ -0,0 +1,168 @@
+/**
+ * 资源打包。
+ *
+ *   QuokkaPack <output> <file | directory>...
+ *
+ * 目录递归打包，条目名为相对该目录的路径（'/' 分隔）；单个文件以文件名为条目名。
+ * 扩展名决定条目类型，数据按 ASSET_PACK_ALIGNMENT 对齐，格式见 utils/asset_pack.h。
+ */
+#include "utils/asset_pack.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#define ASSET_PACK_ALIGNMENT 256
+
+struct PackInput
+{
+    std::filesystem::path path;
+    std::string name;
+    uint64_t size;
+    uint32_t type;
+    uint64_t hash;
+};
+
+static uint32_t GuessAssetType(const std::filesystem::path& path)
+{
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(tolower(c)); });
+
+    if (ext == ".spv")
+        return ASSET_TYPE_SHADER;
+    if (ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".tga" || ext == ".hdr" || ext == ".ktx" || ext == ".ktx2" || ext == ".dds")
+        return ASSET_TYPE_TEXTURE;
+    if (ext == ".obj" || ext == ".gltf" || ext == ".glb" || ext == ".mesh")
+        return ASSET_TYPE_MESH;
+
+    return ASSET_TYPE_RAW;
+}
+
+static void AddInput(std::vector<PackInput>& inputs, const std::filesystem::path& path, const std::string& name)
+{
+    PackInput input = {};
+    input.path = path;
+    input.name = name;
+    input.size = std::filesystem::file_size(path);
+    input.type = GuessAssetType(path);
+    input.hash = io_pack_hash_name(name.c_str(), name.size());
+    inputs.push_back(input);
+}
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static bool WritePadding(FILE* file, uint64_t offset)
+{
+    static const uint8_t zeros[ASSET_PACK_ALIGNMENT] = {};
+    long current = ftell(file);
+    return fwrite(zeros, 1, static_cast<size_t>(offset - current), file) == offset - current;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        printf("usage: %s <output> <file | directory>...\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<PackInput> inputs;
+
+    for (int i = 2; i < argc; i++) {
+        std::filesystem::path root(argv[i]);
+        std::error_code ec;
+
+        if (std::filesystem::is_directory(root, ec)) {
+            for (const auto& it : std::filesystem::recursive_directory_iterator(root)) {
+                if (it.is_regular_file())
+                    AddInput(inputs, it.path(), std::filesystem::relative(it.path(), root).generic_string());
+            }
+        } else if (std::filesystem::is_regular_file(root, ec)) {
+            AddInput(inputs, root, root.filename().generic_string());
+        } else {
+            printf("[pack] %s not found\n", argv[i]);
+            return 1;
+        }
+    }
+
+    /* 索引按哈希排序，查找时二分 */
+    std::sort(inputs.begin(), inputs.end(), [](const PackInput& a, const PackInput& b) {
+        return a.hash != b.hash ? a.hash < b.hash : a.name < b.name;
+    });
+
+    for (size_t i = 1; i < inputs.size(); i++) {
+        if (inputs[i].name == inputs[i - 1].name) {
+            printf("[pack] duplicate entry %s\n", inputs[i].name.c_str());
+            return 1;
+        }
+    }
+
+    /* 布局 */
+    std::string names;
+    std::vector<AssetPackEntry> entries(inputs.size());
+
+    for (size_t i = 0; i < inputs.size(); i++) {
+        entries[i].nameHash = inputs[i].hash;
+        entries[i].nameOffset = static_cast<uint32_t>(names.size());
+        entries[i].nameLength = static_cast<uint32_t>(inputs[i].name.size());
+        entries[i].size = inputs[i].size;
+        entries[i].type = inputs[i].type;
+        names += inputs[i].name;
+    }
+
+    AssetPackHeader header = {};
+    header.magic = ASSET_PACK_MAGIC;
+    header.version = ASSET_PACK_VERSION;
+    header.entryCount = static_cast<uint32_t>(inputs.size());
+    header.alignment = ASSET_PACK_ALIGNMENT;
+    header.namesOffset = sizeof(AssetPackHeader) + entries.size() * sizeof(AssetPackEntry);
+    header.namesSize = names.size();
+
+    uint64_t offset = AlignUp(header.namesOffset + header.namesSize, ASSET_PACK_ALIGNMENT);
+    for (AssetPackEntry& entry : entries) {
+        entry.dataOffset = offset;
+        offset = AlignUp(offset + entry.size, ASSET_PACK_ALIGNMENT);
+    }
+
+    FILE* file = fopen(argv[1], "wb");
+    if (file == NULL) {
+        printf("[pack] open %s failed\n", argv[1]);
+        return 1;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && fwrite(entries.data(), sizeof(AssetPackEntry), entries.size(), file) == entries.size();
+    ok = ok && fwrite(names.data(), 1, names.size(), file) == names.size();
+
+    std::vector<char> buffer;
+    for (size_t i = 0; ok && i < inputs.size(); i++) {
+        ok = WritePadding(file, entries[i].dataOffset);
+
+        FILE* input = fopen(inputs[i].path.string().c_str(), "rb");
+        if (input == NULL) {
+            printf("[pack] open %s failed\n", inputs[i].path.string().c_str());
+            ok = false;
+            break;
+        }
+
+        buffer.resize(static_cast<size_t>(inputs[i].size));
+        ok = ok && fread(buffer.data(), 1, buffer.size(), input) == buffer.size();
+        ok = ok && fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+        fclose(input);
+    }
+
+    fclose(file);
+
+    if (!ok) {
+        printf("[pack] write %s failed\n", argv[1]);
+        return 1;
+    }
+
+    printf("[pack] %zu entries, %llu bytes -> %s\n", inputs.size(), static_cast<unsigned long long>(offset), argv[1]);
+    return 0;
+}
@@ -0,0 +1,219 @@
+#include "asset_pack.h"
+
+#include <quokka/typedefs.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+struct AssetPack_T {
+    const uint8_t *base;
+    size_t size;
+    const AssetPackHeader *header;
+    const AssetPackEntry *entries;
+    const char *names;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+};
+
+uint64_t io_pack_hash_name(const char *name, size_t length)
+{
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < length; i++)
+        hash = (hash ^ static_cast<uint8_t>(name[i])) * 0x100000001B3ull;
+    return hash;
+}
+
+static bool _ValidatePack(const uint8_t *base, size_t size)
+{
+    if (size < sizeof(AssetPackHeader))
+        return false;
+
+    const AssetPackHeader *header = reinterpret_cast<const AssetPackHeader *>(base);
+    if (header->magic != ASSET_PACK_MAGIC || header->version != ASSET_PACK_VERSION)
+        return false;
+
+    /* SPIR-V 直接作为 pCode 使用，对齐至少 16 且为 2 的幂，每个条目的起点都要满足 */
+    const uint32_t alignment = header->alignment;
+    if (alignment < 16 || (alignment & (alignment - 1)) != 0)
+        return false;
+
+    /* 先检查起点再比较剩余长度，offset + size 可能回绕 */
+    const uint64_t fileSize = size;
+
+    uint64_t indexEnd = sizeof(AssetPackHeader) + static_cast<uint64_t>(header->entryCount) * sizeof(AssetPackEntry);
+    if (indexEnd > fileSize)
+        return false;
+
+    if (header->namesOffset > fileSize || header->namesSize > fileSize - header->namesOffset)
+        return false;
+
+    const AssetPackEntry *entries = reinterpret_cast<const AssetPackEntry *>(base + sizeof(AssetPackHeader));
+    for (uint32_t i = 0; i < header->entryCount; i++) {
+        if (entries[i].dataOffset > fileSize || entries[i].size > fileSize - entries[i].dataOffset)
+            return false;
+        if (entries[i].dataOffset % alignment != 0)
+            return false;
+        if (static_cast<uint64_t>(entries[i].nameOffset) + entries[i].nameLength > header->namesSize)
+            return false;
+    }
+
+    return true;
+}
+
+bool io_pack_open(const char *path, AssetPack *pPack)
+{
+    const uint8_t *base = NULL;
+    size_t size = 0;
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    size = static_cast<size_t>(fileSize.QuadPart);
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL) {
+        CloseHandle(file);
+        return false;
+    }
+
+    base = static_cast<const uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (base == NULL) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    size = static_cast<size_t>(st.st_size);
+
+    void *mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mapped == MAP_FAILED)
+        return false;
+
+    base = static_cast<const uint8_t *>(mapped);
+#endif
+
+    AssetPack pack = (AssetPack) malloc(sizeof(AssetPack_T));
+    pack->base = base;
+    pack->size = size;
+#ifdef _WIN32
+    pack->file = file;
+    pack->mapping = mapping;
+#endif
+
+    if (!_ValidatePack(base, size)) {
+        printf("[io] invalid asset pack %s\n", path);
+        io_pack_close(pack);
+        return false;
+    }
+
+    pack->header = reinterpret_cast<const AssetPackHeader *>(base);
+    pack->entries = reinterpret_cast<const AssetPackEntry *>(base + sizeof(AssetPackHeader));
+    pack->names = reinterpret_cast<const char *>(base + pack->header->namesOffset);
+
+    printf("[io] mapped asset pack %s, %u entries, %zu bytes\n", path, pack->header->entryCount, size);
+
+    *pPack = pack;
+    return true;
+}
+
+void io_pack_close(AssetPack pack)
+{
+#ifdef _WIN32
+    UnmapViewOfFile(pack->base);
+    CloseHandle(pack->mapping);
+    CloseHandle(pack->file);
+#else
+    munmap(const_cast<uint8_t *>(pack->base), pack->size);
+#endif
+    free(pack);
+}
+
+bool io_pack_find(AssetPack pack, const char *name, AssetSpan *pSpan)
+{
+    size_t length = strlen(name);
+    uint64_t hash = io_pack_hash_name(name, length);
+
+    /* 索引按哈希排序，二分找到第一个相同哈希再逐个比较名字 */
+    uint32_t lo = 0, hi = pack->header->entryCount;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (pack->entries[mid].nameHash < hash)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    for (uint32_t i = lo; i < pack->header->entryCount && pack->entries[i].nameHash == hash; i++) {
+        const AssetPackEntry &entry = pack->entries[i];
+        if (entry.nameLength == length && memcmp(pack->names + entry.nameOffset, name, length) == 0) {
+            io_pack_entry_span(pack, &entry, pSpan);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+uint32_t io_pack_entry_count(AssetPack pack)
+{
+    return pack->header->entryCount;
+}
+
+const AssetPackEntry *io_pack_entry(AssetPack pack, uint32_t index)
+{
+    return &pack->entries[index];
+}
+
+const char *io_pack_entry_name(AssetPack pack, const AssetPackEntry *entry, uint32_t *pLength)
+{
+    *pLength = entry->nameLength;
+    return pack->names + entry->nameOffset;
+}
+
+void io_pack_entry_span(AssetPack pack, const AssetPackEntry *entry, AssetSpan *pSpan)
+{
+    pSpan->data = pack->base + entry->dataOffset;
+    pSpan->size = static_cast<size_t>(entry->size);
+    pSpan->type = entry->type;
+}
+
+void io_pack_prefetch(QK_MAYBE_UNUSED AssetPack pack, const AssetSpan *span)
+{
+#ifdef _WIN32
+    WIN32_MEMORY_RANGE_ENTRY range = { const_cast<void *>(span->data), span->size };
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+    /* madvise 需要页对齐的起始地址 */
+    const long pageSize = sysconf(_SC_PAGESIZE);
+    uintptr_t begin = reinterpret_cast<uintptr_t>(span->data) & ~static_cast<uintptr_t>(pageSize - 1);
+    uintptr_t end = reinterpret_cast<uintptr_t>(span->data) + span->size;
+    madvise(reinterpret_cast<void *>(begin), end - begin, MADV_WILLNEED);
+#endif
+}
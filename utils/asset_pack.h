@@ -0,0 +1,75 @@
+#ifndef _ASSET_PACK_H_
+#define _ASSET_PACK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * 资源包：文件头 + 按名字哈希排序的索引 + 名字表 + 对齐的数据区。
+ * 读取时整个文件 mmap 进来，查找返回指向映射内存的 span，不做拷贝。
+ *
+ *   [AssetPackHeader][AssetPackEntry * entryCount][names][pad][data ...]
+ *
+ * 所有数据按 alignment 对齐（至少 16），SPIR-V 可以直接作为 pCode 使用。
+ */
+
+#define ASSET_PACK_MAGIC 0x4B50514Bu             // "KQPK"
+#define ASSET_PACK_VERSION 1u
+
+enum AssetType
+{
+    ASSET_TYPE_RAW = 0,
+    ASSET_TYPE_SHADER,
+    ASSET_TYPE_TEXTURE,
+    ASSET_TYPE_MESH,
+};
+
+struct AssetPackHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t alignment;
+    uint64_t namesOffset;
+    uint64_t namesSize;
+};
+
+struct AssetPackEntry
+{
+    uint64_t nameHash;                          // FNV-1a 64
+    uint32_t nameOffset;                        // 相对名字表
+    uint32_t nameLength;
+    uint64_t dataOffset;                        // 相对文件头
+    uint64_t size;
+    uint32_t type;
+    uint32_t _reserved;
+};
+
+struct AssetSpan
+{
+    const void *data;
+    size_t size;
+    uint32_t type;
+};
+
+typedef struct AssetPack_T *AssetPack;
+
+/* 打开并映射资源包，失败返回 false */
+bool io_pack_open(const char *path, AssetPack *pPack);
+void io_pack_close(AssetPack pack);
+
+/* 按名字查找，名字使用 '/' 分隔的相对路径；span 在 io_pack_close 之前有效 */
+bool io_pack_find(AssetPack pack, const char *name, AssetSpan *pSpan);
+
+uint32_t io_pack_entry_count(AssetPack pack);
+const AssetPackEntry *io_pack_entry(AssetPack pack, uint32_t index);
+const char *io_pack_entry_name(AssetPack pack, const AssetPackEntry *entry, uint32_t *pLength);
+/* 遍历索引时直接取条目的数据，不再按名字查找 */
+void io_pack_entry_span(AssetPack pack, const AssetPackEntry *entry, AssetSpan *pSpan);
+
+/* 提示系统预读映射区域，冷启动时对即将使用的资源调用 */
+void io_pack_prefetch(AssetPack pack, const AssetSpan *span);
+
+uint64_t io_pack_hash_name(const char *name, size_t length);
+
+#endif /* _ASSET_PACK_H_ */
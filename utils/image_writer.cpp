@@ -0,0 +1,319 @@
+#include "image_writer.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <array>
+#include <vector>
+
+/* ------------------------------------------------------------------------ */
+/* PNG: 每行 Sub 滤波 + 固定 Huffman 的 deflate                             */
+/* ------------------------------------------------------------------------ */
+
+static uint32_t _crc32(uint32_t crc, const uint8_t *data, size_t size)
+{
+    /* 局部静态变量的初始化是线程安全的，编码线程可以并发调用 */
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t = {};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+
+    return ~crc;
+}
+
+struct _BitWriter {
+    std::vector<uint8_t> &out;
+    uint32_t bits = 0;
+    int count = 0;
+
+    void Put(uint32_t value, int n)
+    {
+        bits |= value << count;
+        count += n;
+        while (count >= 8) {
+            out.push_back(bits & 0xFF);
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+
+    /* Huffman 码按高位在前写入 */
+    void PutReversed(uint32_t code, int n)
+    {
+        uint32_t r = 0;
+        for (int i = 0; i < n; i++)
+            r |= ((code >> i) & 1) << (n - 1 - i);
+        Put(r, n);
+    }
+
+    void Flush()
+    {
+        if (count > 0)
+            out.push_back(bits & 0xFF);
+        bits = 0;
+        count = 0;
+    }
+};
+
+static void _PutLiteral(_BitWriter &writer, uint32_t v)
+{
+    if (v < 144)      writer.PutReversed(0x30 + v, 8);
+    else if (v < 256) writer.PutReversed(0x190 + (v - 144), 9);
+    else if (v < 280) writer.PutReversed(v - 256, 7);
+    else              writer.PutReversed(0xC0 + (v - 280), 8);
+}
+
+static void _PutMatch(_BitWriter &writer, uint32_t length, uint32_t distance)
+{
+    static const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    static const uint8_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    static const uint16_t distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    static const uint8_t distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+    int l = 28;
+    while (lengthBase[l] > length)
+        l--;
+    _PutLiteral(writer, 257 + l);
+    writer.Put(length - lengthBase[l], lengthExtra[l]);
+
+    int d = 29;
+    while (distanceBase[d] > distance)
+        d--;
+    writer.PutReversed(d, 5);
+    writer.Put(distance - distanceBase[d], distanceExtra[d]);
+}
+
+static void _Deflate(const uint8_t *data, size_t size, std::vector<uint8_t> &out)
+{
+    const uint32_t WINDOW = 32768;
+    const uint32_t HASH_SIZE = 1 << 15;
+    const uint32_t MAX_MATCH = 258;
+
+    std::vector<int64_t> head(HASH_SIZE, -1);
+
+    /* zlib 头，最快压缩级别 */
+    out.push_back(0x78);
+    out.push_back(0x01);
+
+    _BitWriter writer = { out };
+    writer.Put(1, 1);   // BFINAL
+    writer.Put(1, 2);   // BTYPE = 固定 Huffman
+
+    size_t i = 0;
+    while (i < size) {
+        uint32_t bestLength = 0;
+        size_t bestDistance = 0;
+
+        if (i + 3 <= size) {
+            uint32_t hash = ((data[i] << 16) | (data[i + 1] << 8) | data[i + 2]) * 2654435761u >> 17;
+            int64_t candidate = head[hash];
+            head[hash] = static_cast<int64_t>(i);
+
+            if (candidate >= 0 && i - candidate <= WINDOW) {
+                size_t maxLength = std::min<size_t>(MAX_MATCH, size - i);
+                uint32_t length = 0;
+                while (length < maxLength && data[candidate + length] == data[i + length])
+                    length++;
+
+                if (length >= 3) {
+                    bestLength = length;
+                    bestDistance = i - candidate;
+                }
+            }
+        }
+
+        if (bestLength >= 3) {
+            _PutMatch(writer, bestLength, static_cast<uint32_t>(bestDistance));
+            i += bestLength;
+        } else {
+            _PutLiteral(writer, data[i]);
+            i++;
+        }
+    }
+
+    _PutLiteral(writer, 256);
+    writer.Flush();
+
+    uint32_t a = 1, b = 0;
+    for (size_t k = 0; k < size; k++) {
+        a = (a + data[k]) % 65521;
+        b = (b + a) % 65521;
+    }
+    uint32_t adler = (b << 16) | a;
+
+    out.push_back(adler >> 24);
+    out.push_back(adler >> 16);
+    out.push_back(adler >> 8);
+    out.push_back(adler);
+}
+
+static void _PutU32BE(std::vector<uint8_t> &out, uint32_t v)
+{
+    out.push_back(v >> 24);
+    out.push_back(v >> 16);
+    out.push_back(v >> 8);
+    out.push_back(v);
+}
+
+static void _PutChunk(std::vector<uint8_t> &out, const char *type, const std::vector<uint8_t> &data)
+{
+    _PutU32BE(out, static_cast<uint32_t>(data.size()));
+
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+
+    _PutU32BE(out, _crc32(0, out.data() + start, out.size() - start));
+}
+
+bool io_write_png(const char *path, uint32_t width, uint32_t height, uint32_t channels, const uint8_t *pixels)
+{
+    if (channels != 3 && channels != 4)
+        return false;
+
+    const size_t stride = static_cast<size_t>(width) * channels;
+
+    /* 每行前加滤波类型字节，Sub: 当前像素减去左侧像素 */
+    std::vector<uint8_t> filtered((stride + 1) * height);
+    for (uint32_t y = 0; y < height; y++) {
+        const uint8_t *src = pixels + y * stride;
+        uint8_t *dst = filtered.data() + y * (stride + 1);
+
+        dst[0] = 1;
+        for (size_t x = 0; x < stride; x++)
+            dst[1 + x] = x < channels ? src[x] : static_cast<uint8_t>(src[x] - src[x - channels]);
+    }
+
+    std::vector<uint8_t> out;
+    const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    out.insert(out.end(), signature, signature + 8);
+
+    std::vector<uint8_t> ihdr;
+    _PutU32BE(ihdr, width);
+    _PutU32BE(ihdr, height);
+    ihdr.push_back(8);                          // bit depth
+    ihdr.push_back(channels == 4 ? 6 : 2);      // color type
+    ihdr.push_back(0);                          // compression
+    ihdr.push_back(0);                          // filter
+    ihdr.push_back(0);                          // interlace
+    _PutChunk(out, "IHDR", ihdr);
+
+    std::vector<uint8_t> idat;
+    _Deflate(filtered.data(), filtered.size(), idat);
+    _PutChunk(out, "IDAT", idat);
+
+    _PutChunk(out, "IEND", {});
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+        return false;
+
+    bool ok = fwrite(out.data(), 1, out.size(), file) == out.size();
+    fclose(file);
+
+    return ok;
+}
+
+/* ------------------------------------------------------------------------ */
+/* OpenEXR                                                                  */
+/* ------------------------------------------------------------------------ */
+
+template<typename T>
+static void _PutLE(std::vector<uint8_t> &out, T v)
+{
+    uint8_t bytes[sizeof(T)];
+    memcpy(bytes, &v, sizeof(T));
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+static void _PutAttribute(std::vector<uint8_t> &out, const char *name, const char *type, const std::vector<uint8_t> &value)
+{
+    out.insert(out.end(), name, name + strlen(name) + 1);
+    out.insert(out.end(), type, type + strlen(type) + 1);
+    _PutLE<int32_t>(out, static_cast<int32_t>(value.size()));
+    out.insert(out.end(), value.begin(), value.end());
+}
+
+bool io_write_exr(const char *path, uint32_t width, uint32_t height, const float *rgba)
+{
+    const int32_t PIXEL_TYPE_FLOAT = 2;
+
+    /* 通道必须按名字排序 */
+    const char *channelNames[4] = { "A", "B", "G", "R" };
+    const int channelIndices[4] = { 3, 2, 1, 0 };
+
+    std::vector<uint8_t> out;
+    _PutLE<uint32_t>(out, 20000630);            // magic
+    _PutLE<uint32_t>(out, 2);                   // version, scanline
+
+    std::vector<uint8_t> value;
+    for (const char *name : channelNames) {
+        value.insert(value.end(), name, name + strlen(name) + 1);
+        _PutLE<int32_t>(value, PIXEL_TYPE_FLOAT);
+        _PutLE<uint32_t>(value, 0);             // pLinear + reserved
+        _PutLE<int32_t>(value, 1);              // xSampling
+        _PutLE<int32_t>(value, 1);              // ySampling
+    }
+    value.push_back(0);
+    _PutAttribute(out, "channels", "chlist", value);
+
+    _PutAttribute(out, "compression", "compression", { 0 });
+
+    value.clear();
+    _PutLE<int32_t>(value, 0);
+    _PutLE<int32_t>(value, 0);
+    _PutLE<int32_t>(value, static_cast<int32_t>(width) - 1);
+    _PutLE<int32_t>(value, static_cast<int32_t>(height) - 1);
+    _PutAttribute(out, "dataWindow", "box2i", value);
+    _PutAttribute(out, "displayWindow", "box2i", value);
+
+    _PutAttribute(out, "lineOrder", "lineOrder", { 0 });
+
+    value.clear();
+    _PutLE<float>(value, 1.0f);
+    _PutAttribute(out, "pixelAspectRatio", "float", value);
+    _PutAttribute(out, "screenWindowWidth", "float", value);
+
+    value.clear();
+    _PutLE<float>(value, 0.0f);
+    _PutLE<float>(value, 0.0f);
+    _PutAttribute(out, "screenWindowCenter", "v2f", value);
+
+    out.push_back(0);
+
+    /* scanline 偏移表，每行一个块 */
+    const uint32_t lineBytes = width * 4 * sizeof(float);
+    const uint64_t tableEnd = out.size() + static_cast<uint64_t>(height) * sizeof(uint64_t);
+    for (uint32_t y = 0; y < height; y++)
+        _PutLE<uint64_t>(out, tableEnd + static_cast<uint64_t>(y) * (8 + lineBytes));
+
+    out.reserve(out.size() + static_cast<size_t>(height) * (8 + lineBytes));
+    for (uint32_t y = 0; y < height; y++) {
+        _PutLE<int32_t>(out, static_cast<int32_t>(y));
+        _PutLE<int32_t>(out, static_cast<int32_t>(lineBytes));
+
+        const float *row = rgba + static_cast<size_t>(y) * width * 4;
+        for (int c : channelIndices)
+            for (uint32_t x = 0; x < width; x++)
+                _PutLE<float>(out, row[x * 4 + c]);
+    }
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+        return false;
+
+    bool ok = fwrite(out.data(), 1, out.size(), file) == out.size();
+    fclose(file);
+
+    return ok;
+}
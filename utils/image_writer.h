@@ -0,0 +1,12 @@
+#ifndef _IMAGE_WRITER_H_
+#define _IMAGE_WRITER_H_
+
+#include <stdint.h>
+
+/* 写出 8 位 PNG，channels 为 3 (RGB) 或 4 (RGBA)，行间无填充 */
+bool io_write_png(const char *path, uint32_t width, uint32_t height, uint32_t channels, const uint8_t *pixels);
+
+/* 写出无压缩的 32 位浮点 RGBA OpenEXR (scanline) */
+bool io_write_exr(const char *path, uint32_t width, uint32_t height, const float *rgba);
+
+#endif /* _IMAGE_WRITER_H_ */
@@ -3,11 +3,12 @@
 
 #include <fstream>
 
+/* 读取整个文件，失败返回 NULL；大量小文件请使用 asset_pack.h 的资源包 */
 static char *io_read_bytecode(const char *path, size_t *size)
 {
     std::ifstream file(path, std::ios::ate | std::ios::binary);
     if (!file.is_open())
-        throw std::runtime_error("error open file failed!");
+        return NULL;
 
     *size = file.tellg();
     file.seekg(0);